@@ -27,19 +27,21 @@
 #ifndef Audio_h_
 #define Audio_h_
 
-#if TEENSYDUINO < 120
+#if TEENSYDUINO < 120 && !defined(AUDIO_HOST)
 #error "Teensyduino version 1.20 or later is required to compile the Audio library."
 #endif
 #ifdef __AVR__
 #error "The Audio Library only works with Teensy 3.X.  Teensy 2.0 is unsupported."
 #endif
 
+#if !defined(AUDIO_HOST)
 #include "DMAChannel.h"
 #if !defined(DMACHANNEL_HAS_BEGIN) || !defined(DMACHANNEL_HAS_BOOLEAN_CTOR)
 #error "You need to update DMAChannel.h & DMAChannel.cpp"
 #error "https://github.com/PaulStoffregen/cores/blob/master/teensy3/DMAChannel.h"
 #error "https://github.com/PaulStoffregen/cores/blob/master/teensy3/DMAChannel.cpp"
 #endif
+#endif
 
 // When changing multiple audio object settings that must update at
 // the same time, these functions allow the audio library interrupt
@@ -58,13 +60,19 @@
 // include all the library headers, so a sketch can use a single
 // #include <Audio.h> to get the whole library
 //
+#include "AudioProfiler.h"
 #include "analyze_fft256.h"
 #include "analyze_fft1024.h"
+#include "analyze_fft.h"
 #include "analyze_print.h"
 #include "analyze_tonedetect.h"
+#include "analyze_tonebank.h"
 #include "analyze_notefreq.h"
+#include "analyze_multipitch.h"
 #include "analyze_peak.h"
 #include "analyze_rms.h"
+#include "analyze_meter.h"
+#if !defined(AUDIO_HOST)
 #include "async_input_spdif3.h"
 #include "control_sgtl5000.h"
 #include "control_wm8731.h"
@@ -72,6 +80,7 @@
 #include "control_cs4272.h"
 #include "control_cs42448.h"
 #include "control_tlv320aic3206.h"
+#endif
 #include "effect_bitcrusher.h"
 #include "effect_chorus.h"
 #include "effect_fade.h"
@@ -79,18 +88,23 @@
 #include "effect_envelope.h"
 #include "effect_multiply.h"
 #include "effect_delay.h"
+#if !defined(AUDIO_HOST)
 #include "effect_delay_ext.h"
+#endif
 #include "effect_midside.h"
 #include "effect_reverb.h"
 #include "effect_freeverb.h"
+#include "effect_reverb_fdn.h"
 #include "effect_waveshaper.h"
 #include "effect_granular.h"
 #include "effect_combine.h"
 #include "effect_rectifier.h"
 #include "filter_biquad.h"
 #include "filter_fir.h"
+#include "filter_convolution.h"
 #include "filter_variable.h"
 #include "filter_ladder.h"
+#if !defined(AUDIO_HOST)
 #include "input_adc.h"
 #include "input_adcs.h"
 #include "input_i2s.h"
@@ -103,7 +117,9 @@
 #include "input_pdm.h"
 #include "input_pdm_i2s2.h"
 #include "input_spdif3.h"
+#endif
 #include "mixer.h"
+#if !defined(AUDIO_HOST)
 #include "output_dac.h"
 #include "output_dacs.h"
 #include "output_i2s.h"
@@ -121,11 +137,14 @@
 #include "output_tdm.h"
 #include "output_tdm2.h"
 #include "output_adat.h"
+#endif
 #include "play_memory.h"
 #include "play_queue.h"
 #include "play_sd_raw.h"
 #include "play_sd_wav.h"
+#if !defined(AUDIO_HOST)
 #include "play_serialflash_raw.h"
+#endif
 #include "record_queue.h"
 #include "synth_tonesweep.h"
 #include "synth_sine.h"
@@ -137,5 +156,11 @@
 #include "synth_simple_drum.h"
 #include "synth_pwm.h"
 #include "synth_wavetable.h"
+#include "synth_wavetable_poly.h"
+
+// host builds on a PC replace the hardware inputs and outputs with WAV files
+#if defined(AUDIO_HOST)
+#include "host_render.h"
+#endif
 
 #endif
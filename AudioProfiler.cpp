@@ -0,0 +1,175 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "AudioProfiler.h"
+
+// Teensy 4 can change its clock speed at runtime
+#if defined(__IMXRT1062__) || defined(AUDIO_HOST)
+#define PROFILER_CPU_HZ F_CPU_ACTUAL
+#else
+#define PROFILER_CPU_HZ F_CPU
+#endif
+
+static unsigned int bin_index(uint32_t units)
+{
+	if (units < 4) return units;
+	unsigned int octave = 31 - __builtin_clz(units);
+	unsigned int index = (octave - 1) * 4 + ((units >> (octave - 2)) & 3);
+	return (index < AUDIO_PROFILER_BINS) ? index : AUDIO_PROFILER_BINS - 1;
+}
+
+// largest value counted by a histogram bin
+static uint32_t bin_upper(unsigned int index)
+{
+	if (index < 4) return index;
+	unsigned int octave = index / 4 + 1;
+	return ((4 + (index & 3) + 1) << (octave - 2)) - 1;
+}
+
+bool AudioProfiler::add(AudioStream &object, const char *name)
+{
+	if (count >= AUDIO_PROFILER_MAX_OBJECTS) return false;
+	struct stats *s = &entry[count];
+	memset(s, 0, sizeof(struct stats));
+	s->object = &object;
+	s->name = name;
+	__disable_irq();
+	count++;
+	__enable_irq();
+	return true;
+}
+
+void AudioProfiler::begin(float budget_percent)
+{
+	float cycles = (float)PROFILER_CPU_HZ * (AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT);
+	budget = cycles * budget_percent / (100.0f * 64.0f);
+	reset();
+	active = true;
+}
+
+void AudioProfiler::reset(void)
+{
+	__disable_irq();
+	for (unsigned int i=0; i < count; i++) {
+		entry[i].max = 0;
+		entry[i].overruns = 0;
+		memset(entry[i].histogram, 0, sizeof(entry[i].histogram));
+	}
+	memset(&total, 0, sizeof(total));
+	block_count = 0;
+	overrun_count = 0;
+	worst = 255;
+	__enable_irq();
+}
+
+void AudioProfiler::record(struct stats *s, uint32_t cycles)
+{
+	uint16_t *h = s->histogram;
+	unsigned int i = bin_index(cycles);
+
+	if (h[i] == 65535) {
+		// keep the shape of the distribution, but forget half the history
+		for (unsigned int j=0; j < AUDIO_PROFILER_BINS; j++) {
+			h[j] = (h[j] + 1) >> 1;
+		}
+	}
+	h[i]++;
+	if (cycles > s->max) s->max = cycles;
+}
+
+void AudioProfiler::update(void)
+{
+	uint32_t cycles, most = 0;
+	unsigned int i, w = 255;
+
+	// cpu_cycles_total is written after every object has updated,
+	// so here it is the total of the previous block
+	if (block_count > 0) {
+		cycles = AudioStream::cpu_cycles_total;
+		record(&total, cycles);
+		if (cycles > budget) {
+			overrun_count++;
+			if (worst < count) entry[worst].overruns++;
+		}
+	}
+	for (i=0; i < count; i++) {
+		AudioStream *p = entry[i].object;
+		if (!p->isActive()) continue;
+		cycles = p->cpu_cycles;
+		record(&entry[i], cycles);
+		if (cycles > most) {
+			most = cycles;
+			w = i;
+		}
+	}
+	worst = w;
+	block_count++;
+}
+
+uint32_t AudioProfiler::cyclesPercentile(unsigned int n, float percent)
+{
+	const struct stats *s = lookup(n);
+	uint32_t sum = 0, target, cumulative = 0;
+	unsigned int i;
+
+	for (i=0; i < AUDIO_PROFILER_BINS; i++) {
+		sum += s->histogram[i];
+	}
+	if (sum == 0) return 0;
+	target = (uint32_t)(sum * percent / 100.0f + 0.5f);
+	if (target < 1) target = 1;
+	for (i=0; i < AUDIO_PROFILER_BINS; i++) {
+		cumulative += s->histogram[i];
+		if (cumulative >= target) break;
+	}
+	uint32_t units = bin_upper(i);
+	if (units > s->max) units = s->max;
+	return units * 64;
+}
+
+uint32_t AudioProfiler::cyclesMax(unsigned int n)
+{
+	return lookup(n)->max * 64;
+}
+
+void AudioProfiler::printCSV(Print &out)
+{
+	out.println("name,blocks,p50_cycles,p99_cycles,max_cycles,overruns");
+	for (unsigned int i=0; i <= count; i++) {
+		out.print(name(i));
+		out.print(',');
+		out.print(block_count);
+		out.print(',');
+		out.print(cyclesPercentile(i, 50.0f));
+		out.print(',');
+		out.print(cyclesPercentile(i, 99.0f));
+		out.print(',');
+		out.print(cyclesMax(i));
+		out.print(',');
+		out.println(overruns(i));
+	}
+}
@@ -0,0 +1,91 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef AudioProfiler_h_
+#define AudioProfiler_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+#if defined(__IMXRT1062__) || defined(__MK66FX1M0__) || defined(__MK64FX512__) || defined(AUDIO_HOST)
+#define AUDIO_PROFILER_MAX_OBJECTS 48
+#else
+#define AUDIO_PROFILER_MAX_OBJECTS 16
+#endif
+
+// Histogram of update() cost, 4 bins per octave.  Bins 0-3 count single
+// 64 cycle units, bin 79 collects everything above 2^19 units.
+#define AUDIO_PROFILER_BINS 80
+
+// Records the update() cost of other audio objects, every block, to find
+// which object is responsible for occasional CPU spikes.  The cost of each
+// update is read from the object's cpu_cycles, in units of 64 CPU cycles,
+// so the profiler adds only a small cost of its own.
+//
+// Create the profiler after all the objects it measures, so its update()
+// runs last in each audio cycle.  A block is an overrun when the total
+// CPU usage of the audio library exceeds the budget (100% = one block
+// period).  Each overrun is blamed on the profiled object which used the
+// most cycles in that block.
+class AudioProfiler : public AudioStream
+{
+public:
+	AudioProfiler(void) : AudioStream(0, NULL), count(0) { reset(); }
+	bool add(AudioStream &object, const char *name);
+	void begin(float budget_percent = 100.0f);
+	void end(void) { active = false; }
+	void reset(void);
+	unsigned int objects(void) { return count; }
+	const char * name(unsigned int n) { return n < count ? entry[n].name : "total"; }
+	// Statistics for object n, in CPU cycles.  n = objects() gives the
+	// total for the whole audio library.
+	uint32_t cyclesPercentile(unsigned int n, float percent);
+	uint32_t cyclesMax(unsigned int n);
+	uint32_t blocks(void) { return block_count; }
+	uint32_t overruns(void) { return overrun_count; }
+	uint32_t overruns(unsigned int n) { return n < count ? entry[n].overruns : overrun_count; }
+	void printCSV(Print &out);
+	virtual void update(void);
+private:
+	struct stats {
+		AudioStream *object;
+		const char *name;
+		uint32_t max;
+		uint32_t overruns;
+		uint16_t histogram[AUDIO_PROFILER_BINS];
+	};
+	static void record(struct stats *s, uint32_t cycles);
+	struct stats * lookup(unsigned int n) { return n < count ? &entry[n] : &total; }
+	struct stats entry[AUDIO_PROFILER_MAX_OBJECTS];
+	struct stats total;
+	unsigned int count;
+	uint32_t budget;
+	uint32_t block_count;
+	uint32_t overrun_count;
+	uint8_t worst;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <math.h>
+#include "FFTSpectrum.h"
+
+// constexpr guarantees the table is computed at compile time
+constexpr FFTSineTable fft_sine_table;
+
+static float hz_to_mel(float hz)
+{
+	return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float mel_to_hz(float mel)
+{
+	return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+bool FFTBands::set(unsigned int n, float lowFreq, float highFreq, bool mel,
+	float binWidth, unsigned int bins)
+{
+	count = 0;
+	if (n < 1 || n > FFT_MAX_BANDS) return false;
+	if (!(lowFreq > 0.0f) || !(highFreq > lowFreq)) return false;
+	float low = mel ? hz_to_mel(lowFreq) : logf(lowFreq);
+	float high = mel ? hz_to_mel(highFreq) : logf(highFreq);
+	for (unsigned int i=0; i <= n; i++) {
+		float f = low + (high - low) * i / n;
+		f = mel ? mel_to_hz(f) : expf(f);
+		// first bin with its center frequency at or above f
+		unsigned int bin = (unsigned int)ceilf(f / binWidth - 0.5f);
+		if (i > 0 && bin <= edge[i - 1]) bin = edge[i - 1] + 1;
+		if (bin > bins) bin = bins;
+		edge[i] = bin;
+	}
+	count = n;
+	return true;
+}
+
+void FFTBands::read(const uint16_t *output, float *values) const
+{
+	for (int i=0; i < count; i++) {
+		uint32_t sum = 0;
+		for (int bin = edge[i]; bin < edge[i + 1]; bin++) {
+			sum += output[bin];
+		}
+		values[i] = (float)sum * (1.0f / 16384.0f);
+	}
+}
+
+void FFTBands::read(const float *output, float *values) const
+{
+	for (int i=0; i < count; i++) {
+		float sum = 0.0f;
+		for (int bin = edge[i]; bin < edge[i + 1]; bin++) {
+			sum += output[bin];
+		}
+		values[i] = sum;
+	}
+}
@@ -0,0 +1,115 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FFTSpectrum_h_
+#define FFTSpectrum_h_
+
+#include <stdint.h>
+#include "FilterTables.h"
+
+// Helpers shared by the FFT analyzers: averaging of the spectrum in the
+// output array itself, grouping bins into log or mel spaced bands, and
+// a sine table for twiddle factors and windows of any FFT size.
+
+#define FFT_MAX_BANDS 32
+#define FFT_SINE_TABLE_SIZE 8192	// points per cycle, largest FFT
+
+// sin(2 pi j / 8192), j = 0 to 2048 (one quarter cycle), as Q31
+struct FFTSineTable {
+	int32_t sine[FFT_SINE_TABLE_SIZE / 4 + 1];
+	static constexpr int32_t q31(double x) {
+		return (x >= 1.0) ? 2147483647 : (int32_t)(x * 2147483648.0 + 0.5);
+	}
+	constexpr FFTSineTable() : sine() {
+		for (int j=0; j <= FFT_SINE_TABLE_SIZE / 4; j++) {
+			sine[j] = q31(FilterTableMath::sin_series(
+				j * (6.28318530717958647692 / FFT_SINE_TABLE_SIZE)));
+		}
+	}
+};
+
+extern const FFTSineTable fft_sine_table;
+
+// sin(2 pi j / 8192), for any j
+static inline int32_t fft_sin(uint32_t j)
+{
+	const int32_t *t = fft_sine_table.sine;
+	const uint32_t quarter = FFT_SINE_TABLE_SIZE / 4;
+	j &= FFT_SINE_TABLE_SIZE - 1;
+	if (j <= quarter) return t[j];
+	if (j <= quarter * 2) return t[quarter * 2 - j];
+	if (j <= quarter * 3) return -t[j - quarter * 2];
+	return -t[quarter * 4 - j];
+}
+
+// cos(2 pi j / 8192), for any j
+static inline int32_t fft_cos(uint32_t j)
+{
+	return fft_sin(j + FFT_SINE_TABLE_SIZE / 4);
+}
+
+// Average a new bin's power (magnitude squared) into *power, as
+// recommended by G. Heinzel's paper, and return the average power.  The
+// caller stores its square root in output[].  weight is the fraction of
+// the new power, 65536 = 1.0.  A running mean of n spectra uses weight
+// 65536 / n for the nth.  The power is kept separately from the 16 bit
+// output, and rounded toward the new power, so a steady input reads the
+// same with or without averaging.
+static inline uint32_t fft_average(uint32_t *power, uint32_t magsq, uint32_t weight)
+{
+	if (weight >= 65536) return *power = magsq;
+	int64_t diff = (int64_t)magsq - *power;
+	int64_t change = (diff * weight + (diff > 0 ? 65535 : 0)) >> 16;
+	return *power += (int32_t)change;
+}
+
+// For floating point, output[] holds the average magnitude precisely
+// enough to average in place.  Returns the average power.
+static inline float fft_average(float output, float magsq, uint32_t weight)
+{
+	if (weight >= 65536) return magsq;
+	float prev = output * output;
+	return prev + (magsq - prev) * ((float)weight * (1.0f / 65536.0f));
+}
+
+class FFTBands
+{
+public:
+	FFTBands() : count(0) { }
+	// Compute the first bin of each band, for "n" bands from lowFreq to
+	// highFreq, evenly spaced on a log or mel frequency scale.  Every
+	// band has at least 1 bin, so narrow low bands may extend past
+	// highFreq.  Uses the math library, so call from setup() or loop().
+	bool set(unsigned int n, float lowFreq, float highFreq, bool mel,
+		float binWidth, unsigned int bins);
+	// Each band is the sum of its bins, the same as read(first, last).
+	void read(const uint16_t *output, float *values) const;
+	void read(const float *output, float *values) const;
+	uint8_t count;
+	uint16_t edge[FFT_MAX_BANDS + 1];
+};
+
+#endif
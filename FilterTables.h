@@ -0,0 +1,113 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FilterTables_h_
+#define FilterTables_h_
+
+#include <stdint.h>
+#include <string.h>
+
+// Lookup tables with linear interpolation, shared by the filters, so
+// changing or modulating a filter's frequency costs a table lookup
+// instead of sin(), cos(), pow() or exp() from the math library.  The
+// tables are computed by the compiler (constexpr), so they are stored
+// in flash and need no startup time.
+
+#define FILTER_TABLE_SIZE 256  // segments per table, 257 points
+
+// Compile time math, only for generating the tables.  Taylor series are
+// accurate to double precision over the small ranges needed.
+struct FilterTableMath {
+	static constexpr double sin_series(double x) {
+		double sum = x, term = x;
+		for (int n=1; n < 15; n++) {
+			term *= -x * x / ((2 * n) * (2 * n + 1));
+			sum += term;
+		}
+		return sum;
+	}
+	static constexpr double exp_series(double x) {
+		double sum = 1.0, term = 1.0;
+		for (int n=1; n < 25; n++) {
+			term *= x / n;
+			sum += term;
+		}
+		return sum;
+	}
+};
+
+struct FilterTableData {
+	float sine[FILTER_TABLE_SIZE + 2];  // sin(x), x = 0 to pi/2
+	float exp2[FILTER_TABLE_SIZE + 2];  // 2^x, x = 0 to 1
+	constexpr FilterTableData() : sine(), exp2() {
+		for (int i=0; i <= FILTER_TABLE_SIZE + 1; i++) {
+			// one extra point, so interpolation at the end needs no test
+			double x = (double)i / FILTER_TABLE_SIZE;
+			sine[i] = FilterTableMath::sin_series(x * 1.57079632679489661923);
+			exp2[i] = FilterTableMath::exp_series(x * 0.69314718055994530942);
+		}
+	}
+};
+
+extern const FilterTableData filter_tables;
+
+// sin(x), for 0 <= x <= pi/2
+static inline float filter_sin(float x)
+{
+	float index = x * (float)(FILTER_TABLE_SIZE / 1.57079632679489661923);
+	if (index < 0.0f) index = 0.0f;
+	else if (index > (float)FILTER_TABLE_SIZE) index = (float)FILTER_TABLE_SIZE;
+	int i = (int)index;
+	float frac = index - (float)i;
+	const float *p = filter_tables.sine + i;
+	return p[0] + (p[1] - p[0]) * frac;
+}
+
+// cos(x), for 0 <= x <= pi/2
+static inline float filter_cos(float x)
+{
+	return filter_sin(1.57079632679489661923f - x);
+}
+
+// 2^x, for -126 < x < 128
+static inline float filter_exp2(float x)
+{
+	float floor_x = (float)(int)x;
+	if (floor_x > x) floor_x -= 1.0f;
+	int exponent = (int)floor_x;
+	float index = (x - floor_x) * (float)FILTER_TABLE_SIZE;
+	int i = (int)index;
+	float frac = index - (float)i;
+	const float *p = filter_tables.exp2 + i;
+	float n = p[0] + (p[1] - p[0]) * frac;
+	// multiply by 2^exponent, by building the float directly
+	uint32_t bits = (uint32_t)(exponent + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return n * scale;
+}
+
+#endif
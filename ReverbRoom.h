@@ -0,0 +1,66 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef ReverbRoom_h_
+#define ReverbRoom_h_
+
+#include <stdint.h>
+
+// Room scale for the reverbs with delay lines in a buffer from the
+// sketch, AudioEffectFreeverbStereoBuffer and AudioEffectReverbFDN.  The
+// scale multiplies every delay line's length.
+
+#define REVERB_ROOM_MIN 0.05f
+#define REVERB_ROOM_MAX 4.0f
+
+static inline float reverb_room_limit(float scale)
+{
+	if (scale < REVERB_ROOM_MIN) return REVERB_ROOM_MIN;
+	if (scale > REVERB_ROOM_MAX) return REVERB_ROOM_MAX;
+	return scale;
+}
+
+// The largest room scale, up to scale, whose delay lines fit in length
+// samples, or 0 if not even the smallest room fits.  required(scale, n)
+// is the number of samples a scale needs, which must grow with the scale.
+// It is found to within 0.001 by bisection, a dozen calls to required().
+static inline float reverb_room_fit(float scale, uint32_t length,
+	uint32_t (*required)(float scale, unsigned int n), unsigned int n)
+{
+	scale = reverb_room_limit(scale);
+	if (required(scale, n) <= length) return scale;
+	if (required(REVERB_ROOM_MIN, n) > length) return 0.0f;
+	float fits = REVERB_ROOM_MIN, too_large = scale;
+	while (too_large - fits > 0.001f) {
+		float mid = 0.5f * (fits + too_large);
+		if (required(mid, n) <= length) fits = mid;
+		else too_large = mid;
+	}
+	return fits;
+}
+
+#endif
@@ -0,0 +1,333 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "analyze_fft.h"
+#include "sqrt_integer.h"
+
+// The fft_size real samples are treated as fft_size / 2 complex numbers,
+// even samples in the real part and odd ones in the imaginary part, like
+// AudioAnalyzeFFT1024.  When the radix-4 FFT can not do fft_size / 2, or
+// for floating point, that FFT is computed as two FFTs of the even and
+// odd complex numbers, which are combined by one radix-2 step.  Then the
+// result is split into the spectrum of the real signal.
+
+// a0 - a1 cos(x) + a2 cos(2x) - a3 cos(3x) + a4 cos(4x), as Q15
+static const int16_t cosine_sum_windows[][5] = {
+	{16384, 16384,    0,    0,   0},	// Hanning
+	{17695, 15073,    0,    0,   0},	// Hamming
+	{13763, 16384, 2621,    0,   0},	// Blackman
+	{11756, 16000, 4629,  383,   0},	// Blackman-Harris
+	{11658, 15971, 4726,  413,   0},	// Nuttall
+	{11914, 16029, 4476,  349,   0},	// Blackman-Nuttall
+	{ 7064, 13652, 9085, 2739, 228}		// flat top
+};
+
+AudioAnalyzeFFTBase::AudioAnalyzeFFTBase(unsigned int n, bool use_float,
+	audio_block_t **blocks, audio_block_t **iqueue, void *memory)
+	: AudioStream(1, iqueue), blocklist(blocks), fft_size(n),
+	nblocks(n / AUDIO_BLOCK_SAMPLES), state(0), work(0), count(0),
+	naverage(1), window(AUDIO_WINDOW_HANNING), is_float(use_float),
+	distribute(false), average_weight(0), outputflag(false)
+{
+	unsigned int sample_size = use_float ? sizeof(float) : sizeof(int16_t);
+	// 16 bit output is followed by the average power of each bin
+	unsigned int output_size = use_float ? n / 2 * sizeof(float) :
+		n / 2 * (sizeof(uint16_t) + sizeof(uint32_t));
+	if (!memory) memory = malloc(n * sample_size + output_size);
+	buffer = memory;
+	outputmem = memory ? (uint8_t *)memory + n * sample_size : NULL;
+	if (outputmem) memset(outputmem, 0, output_size);
+	hop = nblocks / 2;
+	if (use_float) {
+		halves = true;
+		arm_cfft_radix2_init_f32(&fft_f32, n / 4, 0, 1);
+	} else {
+		// radix-4 needs a power of 4, n / 4 is when log2(n) is even
+		halves = (__builtin_ctz(n) & 1) == 0;
+		arm_cfft_radix4_init_q15(&fft_q15, halves ? n / 4 : n / 2, 0, 1);
+	}
+}
+
+float AudioAnalyzeFFTBase::read(unsigned int binNumber)
+{
+	if (binNumber >= fft_size / 2u || !outputmem) return 0.0f;
+	if (is_float) return ((float *)outputmem)[binNumber];
+	return (float)((uint16_t *)outputmem)[binNumber] * (1.0f / 16384.0f);
+}
+
+float AudioAnalyzeFFTBase::read(unsigned int binFirst, unsigned int binLast)
+{
+	if (binFirst > binLast) {
+		unsigned int tmp = binLast;
+		binLast = binFirst;
+		binFirst = tmp;
+	}
+	if (binFirst >= fft_size / 2u || !outputmem) return 0.0f;
+	if (binLast >= fft_size / 2u) binLast = fft_size / 2 - 1;
+	if (is_float) {
+		const float *p = (float *)outputmem;
+		float sum = 0.0f;
+		do {
+			sum += p[binFirst++];
+		} while (binFirst <= binLast);
+		return sum;
+	}
+	const uint16_t *p = (uint16_t *)outputmem;
+	uint32_t sum = 0;
+	do {
+		sum += p[binFirst++];
+	} while (binFirst <= binLast);
+	return (float)sum * (1.0f / 16384.0f);
+}
+
+void AudioAnalyzeFFTBase::readBands(float *values)
+{
+	if (!outputmem) return;
+	if (is_float) {
+		bands.read((float *)outputmem, values);
+	} else {
+		bands.read((uint16_t *)outputmem, values);
+	}
+}
+
+void AudioAnalyzeFFTBase::overlap(unsigned int percent)
+{
+	unsigned int n;
+	if (percent >= 63) n = nblocks / 4;
+	else if (percent >= 38) n = nblocks / 2;
+	else n = nblocks * 3 / 4;
+	hop = (n > 0) ? n : 1;
+}
+
+// Window for sample n of fft_size, as Q15
+int16_t AudioAnalyzeFFTBase::window_value(unsigned int n)
+{
+	uint32_t j = n * (FFT_SINE_TABLE_SIZE / fft_size);	// 2 pi n / fft_size
+	int32_t x = (n << 16) / fft_size - 32768;		// -1.0 to 1.0, as Q15
+	int32_t w;
+
+	switch (window) {
+	case AUDIO_WINDOW_BARTLETT:
+		w = 32768 - abs(x);
+		break;
+	case AUDIO_WINDOW_WELCH:
+		w = 32768 - ((x * x) >> 15);
+		break;
+	case AUDIO_WINDOW_COSINE:
+		// sin(x / 2) is the square root of Hanning
+		w = sqrt_uint32((32768 - (fft_cos(j) >> 16)) << 14);
+		break;
+	case AUDIO_WINDOW_TUKEY:
+		// half of the samples are tapered by Hanning, half are 1.0
+		if (n < fft_size / 4u || n > fft_size * 3 / 4u) {
+			w = (32768 - (fft_cos(j * 2) >> 16)) >> 1;
+		} else {
+			w = 32768;
+		}
+		break;
+	default:
+		const int16_t *a = cosine_sum_windows[window - AUDIO_WINDOW_HANNING];
+		w = a[0] << 15;
+		for (int m=1; m < 5 && a[m]; m++) {
+			int32_t term = a[m] * (fft_cos(j * m) >> 16);
+			w += (m & 1) ? -term : term;
+		}
+		w >>= 15;
+	}
+	return (w > 32767) ? 32767 : w;
+}
+
+void AudioAnalyzeFFTBase::copy_to_fft_buffer(unsigned int offset, const int16_t *src)
+{
+	unsigned int half = fft_size / 2;
+
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		unsigned int n = offset + i;
+		// with halves, even complex numbers in the first half, odd in the second
+		unsigned int index = halves ? ((n & 2) ? half : 0) + ((n >> 1) & ~1u) + (n & 1) : n;
+		int32_t w = (window == AUDIO_WINDOW_NONE) ? 32768 : window_value(n);
+		if (is_float) {
+			((float *)buffer)[index] = (float)(src[i] * w) * (1.0f / 1073741824.0f);
+		} else {
+			((int16_t *)buffer)[index] = (src[i] * w) >> 15;
+		}
+	}
+}
+
+// Combine the FFTs of the even and odd halves, into the fft_size / 2
+// point FFT.  16 bit is scaled by 1/2, like the 2 FFTs were scaled down.
+void AudioAnalyzeFFTBase::combine(void)
+{
+	unsigned int quarter = fft_size / 4;
+	uint32_t step = FFT_SINE_TABLE_SIZE * 2 / fft_size;	// 2 pi k / (fft_size / 2)
+
+	if (is_float) {
+		float *a = (float *)buffer;
+		float *b = a + fft_size / 2;
+		for (unsigned int k=0; k < quarter; k++) {
+			float c = (float)fft_cos(k * step) * (1.0f / 2147483648.0f);
+			float s = (float)fft_sin(k * step) * (1.0f / 2147483648.0f);
+			float br = b[k * 2], bi = b[k * 2 + 1];
+			float tr = c * br + s * bi;
+			float ti = c * bi - s * br;
+			b[k * 2] = a[k * 2] - tr;
+			b[k * 2 + 1] = a[k * 2 + 1] - ti;
+			a[k * 2] += tr;
+			a[k * 2 + 1] += ti;
+		}
+	} else {
+		int16_t *a = (int16_t *)buffer;
+		int16_t *b = a + fft_size / 2;
+		for (unsigned int k=0; k < quarter; k++) {
+			int32_t c = fft_cos(k * step) >> 16, s = fft_sin(k * step) >> 16;
+			int32_t ar = a[k * 2], ai = a[k * 2 + 1];
+			int32_t br = b[k * 2], bi = b[k * 2 + 1];
+			int32_t tr = (c * br + s * bi) >> 15;
+			int32_t ti = (c * bi - s * br) >> 15;
+			a[k * 2] = (ar + tr) >> 1;
+			a[k * 2 + 1] = (ai + ti) >> 1;
+			b[k * 2] = (ar - tr) >> 1;
+			b[k * 2 + 1] = (ai - ti) >> 1;
+		}
+	}
+}
+
+// Split into bins 0 to fft_size / 2 - 1 of the real FFT, and average
+void AudioAnalyzeFFTBase::split(void)
+{
+	unsigned int bins = fft_size / 2;
+	uint32_t step = FFT_SINE_TABLE_SIZE / fft_size;	// 2 pi k / fft_size
+	uint32_t weight = average_weight ? average_weight : 65536 / (count + 1);
+
+	if (is_float) {
+		const float *z = (float *)buffer;
+		float *output = (float *)outputmem;
+		float scale = 1.0f / ((float)fft_size * (float)fft_size);
+		for (unsigned int k=0; k < bins; k++) {
+			unsigned int n = (k == 0) ? 0 : bins - k;
+			float zr = z[k * 2], zi = z[k * 2 + 1];
+			float wr = z[n * 2], wi = z[n * 2 + 1];
+			float c = (float)fft_cos(k * step) * (1.0f / 2147483648.0f);
+			float s = (float)fft_sin(k * step) * (1.0f / 2147483648.0f);
+			float er = zr + wr, ei = zi - wi;	// 2 x even part
+			float orl = zi + wi, oim = wr - zr;	// 2 x odd part
+			float xr = er + c * orl + s * oim;
+			float xi = ei + c * oim - s * orl;
+			// xr and xi are 2 times the bin, output is 2 / fft_size
+			float magsq = (xr * xr + xi * xi) * scale;
+			output[k] = sqrtf(fft_average(output[k], magsq, weight));
+		}
+	} else {
+		const int16_t *z = (int16_t *)buffer;
+		uint16_t *output = (uint16_t *)outputmem;
+		uint32_t *power = (uint32_t *)(output + bins);
+		for (unsigned int k=0; k < bins; k++) {
+			unsigned int n = (k == 0) ? 0 : bins - k;
+			int32_t zr = z[k * 2], zi = z[k * 2 + 1];
+			int32_t wr = z[n * 2], wi = z[n * 2 + 1];
+			int32_t c = fft_cos(k * step) >> 16, s = fft_sin(k * step) >> 16;
+			int32_t er = zr + wr, ei = zi - wi;	// 2 x even part
+			int32_t orl = zi + wi, oim = wr - zr;	// 2 x odd part
+			int32_t xr = er + ((c * orl + s * oim) >> 15);
+			int32_t xi = ei + ((c * oim - s * orl) >> 15);
+			// xr and xi are 4 times the bin, 17 bits
+			uint64_t magsq = (int64_t)xr * xr + (int64_t)xi * xi;
+			output[k] = sqrt_uint32_approx(fft_average(&power[k], magsq >> 4, weight));
+		}
+	}
+}
+
+void AudioAnalyzeFFTBase::fft_step(void)
+{
+	switch (work) {
+	case 1:
+		if (is_float) {
+			arm_cfft_radix2_f32(&fft_f32, (float *)buffer);
+		} else {
+			arm_cfft_radix4_q15(&fft_q15, (int16_t *)buffer);
+		}
+		work = halves ? 2 : 3;
+		break;
+	case 2:
+		if (is_float) {
+			arm_cfft_radix2_f32(&fft_f32, (float *)buffer + fft_size / 2);
+		} else {
+			arm_cfft_radix4_q15(&fft_q15, (int16_t *)buffer + fft_size / 2);
+		}
+		work = 3;
+		break;
+	case 3:
+		if (halves) combine();
+		split();
+		if (average_weight || ++count >= naverage) {
+			count = 0;
+			analyze();
+			outputflag = true;
+		}
+		work = 0;
+		break;
+	}
+}
+
+void AudioAnalyzeFFTBase::update(void)
+{
+	audio_block_t *block;
+
+	block = receiveReadOnly();
+	if (!block) return;
+
+#if defined(__ARM_ARCH_7EM__)
+	if (!buffer) {
+		release(block);
+		return;
+	}
+	if (work) fft_step();
+	blocklist[state] = block;
+	if (state < nblocks - 1) {
+		state++;
+		return;
+	}
+	// fft_size samples are ready, "hop" blocks of them new since the last FFT
+	while (work) fft_step();
+	for (int i=0; i < nblocks; i++) {
+		copy_to_fft_buffer(i * AUDIO_BLOCK_SAMPLES, blocklist[i]->data);
+	}
+	work = 1;
+	if (!distribute) {
+		while (work) fft_step();
+	}
+	for (int i=0; i < hop; i++) {
+		release(blocklist[i]);
+	}
+	for (int i=hop; i < nblocks; i++) {
+		blocklist[i - hop] = blocklist[i];
+	}
+	state = nblocks - hop;
+#else
+	release(block);
+#endif
+}
@@ -0,0 +1,172 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef analyze_fft_h_
+#define analyze_fft_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+#include "FFTSpectrum.h"
+
+// FFT analysis of any power of 2 size, from 256 to 8192 points, with
+// 16 bit fixed point (int16_t) or floating point (float) math.  The
+// windows are computed from a sine table shared by all sizes, rather
+// than stored as tables of every type and size.
+//
+//   AudioAnalyzeFFT<4096>         fft4096;  // 16 bit, 2048 bins
+//   AudioAnalyzeFFT<8192, float>  fft8192;  // float, 4096 bins
+//
+// 16 bit math scales each stage down to avoid overflow, so small signals
+// are lost in rounding with large sizes.  Floating point has much more
+// dynamic range, but is slow on Teensy 3.2 without an FPU.
+//
+// The last N samples are kept in the audio blocks they arrived in, so
+// AudioAnalyzeFFT<N> holds N / 128 blocks of the AudioMemory() pool, 32
+// for 4096 points and 64 for 8192, in addition to the memory below.
+// Include them in the number given to AudioMemory().
+
+enum AudioFFTWindow_t {
+	AUDIO_WINDOW_NONE = 0,
+	AUDIO_WINDOW_HANNING,
+	AUDIO_WINDOW_HAMMING,
+	AUDIO_WINDOW_BLACKMAN,
+	AUDIO_WINDOW_BLACKMAN_HARRIS,
+	AUDIO_WINDOW_NUTTALL,
+	AUDIO_WINDOW_BLACKMAN_NUTTALL,
+	AUDIO_WINDOW_FLATTOP,
+	AUDIO_WINDOW_BARTLETT,
+	AUDIO_WINDOW_WELCH,
+	AUDIO_WINDOW_COSINE,
+	AUDIO_WINDOW_TUKEY
+};
+
+// Number of 32 bit words for the memory given to the constructor.  The
+// buffers are allocated with malloc() when no memory is given.  On
+// Teensy 4.1, large sizes may use PSRAM, for example:
+//   EXTMEM uint32_t fftmem[AUDIO_FFT_MEMORY(8192, float)];
+//   AudioAnalyzeFFT<8192, float> fft8192(fftmem);
+#define AUDIO_FFT_MEMORY(n, type) (((n) * sizeof(type) * 3 / 2 \
+	+ (sizeof(type) == sizeof(float) ? 0 : (n) * 2) + 3) / 4)
+
+class AudioAnalyzeFFTBase : public AudioStream
+{
+public:
+	bool available() {
+		if (outputflag == true) {
+			outputflag = false;
+			return true;
+		}
+		return false;
+	}
+	float read(unsigned int binNumber);
+	float read(unsigned int binFirst, unsigned int binLast);
+	void averageTogether(uint8_t n) {
+		if (n == 0) n = 1;
+		naverage = n;
+		average_weight = 0;
+	}
+	// Exponential averaging, each new spectrum has "weight" (0 to 1.0)
+	// and the previous average has 1 - weight.  Output is not delayed.
+	void averageExponential(float weight) {
+		if (weight >= 1.0f) weight = 1.0f;
+		else if (weight < 0.0001f) weight = 0.0001f;
+		average_weight = weight * 65536.0f;
+	}
+	// 25, 50 (default) or 75 percent overlap, rounded to whole blocks
+	void overlap(unsigned int percent);
+	void windowFunction(AudioFFTWindow_t type) {
+		window = type;
+	}
+	// Spread the FFT over the updates between outputs, instead of all
+	// in the update which completes each FFT's samples.
+	void distributeWork(bool enable) {
+		distribute = enable;
+	}
+	bool logBands(unsigned int n, float lowFreq, float highFreq) {
+		return bands.set(n, lowFreq, highFreq, false,
+			AUDIO_SAMPLE_RATE_EXACT / fft_size, fft_size / 2);
+	}
+	bool melBands(unsigned int n, float lowFreq, float highFreq) {
+		return bands.set(n, lowFreq, highFreq, true,
+			AUDIO_SAMPLE_RATE_EXACT / fft_size, fft_size / 2);
+	}
+	void readBands(float *values);
+	virtual void update(void);
+protected:
+	AudioAnalyzeFFTBase(unsigned int n, bool use_float, audio_block_t **blocks,
+		audio_block_t **iqueue, void *memory);
+	// Called with each new spectrum, before available() is true
+	virtual void analyze(void) { }
+	void *outputmem;	// uint16_t or float, fft_size / 2 bins, and for
+				// uint16_t the uint32_t average power of each bin
+private:
+	int16_t window_value(unsigned int n);
+	void copy_to_fft_buffer(unsigned int offset, const int16_t *src);
+	void fft_step(void);
+	void combine(void);
+	void split(void);
+	audio_block_t **blocklist;
+	void *buffer;		// fft_size int16_t or float samples
+	uint16_t fft_size;
+	uint8_t nblocks;
+	uint8_t state;
+	uint8_t work;		// next step of the FFT, 0 when done
+	uint8_t hop;		// blocks between FFTs
+	uint8_t count;		// spectra averaged so far
+	uint8_t naverage;
+	uint8_t window;
+	bool is_float;
+	bool halves;		// two FFTs of fft_size / 4, combined by a radix-2 step
+	bool distribute;
+	uint32_t average_weight;	// exponential averaging, 0 when not used
+	FFTBands bands;
+	volatile bool outputflag;
+	arm_cfft_radix4_instance_q15 fft_q15;
+	arm_cfft_radix2_instance_f32 fft_f32;
+};
+
+template <typename T> struct AudioAnalyzeFFTOutput;
+template <> struct AudioAnalyzeFFTOutput<int16_t> { typedef uint16_t type; };
+template <> struct AudioAnalyzeFFTOutput<float> { typedef float type; };
+
+template <int N, typename T = int16_t>
+class AudioAnalyzeFFT : public AudioAnalyzeFFTBase
+{
+	static_assert(N >= 256 && N <= 8192 && (N & (N - 1)) == 0,
+		"AudioAnalyzeFFT size must be 256, 512, 1024, 2048, 4096 or 8192");
+public:
+	AudioAnalyzeFFT(void *memory = NULL) : AudioAnalyzeFFTBase(N,
+	  sizeof(T) == sizeof(float), blocklistArray, inputQueueArray, memory),
+	  output((typename AudioAnalyzeFFTOutput<T>::type *)outputmem) { }
+	// N / 2 bins, 16 bit (16384 = 1.0) or float, NULL if out of memory
+	typename AudioAnalyzeFFTOutput<T>::type * const output;
+private:
+	audio_block_t *blocklistArray[N / AUDIO_BLOCK_SAMPLES];
+	audio_block_t *inputQueueArray[1];
+};
+
+#endif
@@ -28,31 +28,118 @@
 #include "analyze_fft1024.h"
 #include "sqrt_integer.h"
 #include "utility/dspinst.h"
+#include "FilterTables.h"
 
 
-// 140312 - PAH - slightly faster copy
-static void copy_to_fft_buffer(void *destination, const void *source)
+// The 1024 real samples are treated as 512 complex numbers, even
+// samples in the real part and odd ones in the imaginary part.  That
+// FFT is computed as 256 point FFTs of the even and odd complex numbers,
+// which are combined by one radix-2 step, and the result split into the
+// spectrum of the real signal.  This is about half the work of a 1024
+// point complex FFT, and the steps can run in separate updates.
+
+// cos and sin of 2 pi k / 1024, for k = 0 to 511, as Q15.  Computed by
+// the compiler, so it is stored in flash.
+struct FFT1024Twiddle {
+	int16_t w[1024];
+	static constexpr int16_t q15(double x) {
+		return (x >= 1.0) ? 32767 : (int16_t)(x * 32768.0 + (x < 0 ? -0.5 : 0.5));
+	}
+	constexpr FFT1024Twiddle() : w() {
+		const double half_pi = 1.57079632679489661923;
+		for (int k=0; k < 512; k++) {
+			double x = k * (half_pi / 256.0);
+			if (k <= 256) {
+				w[k * 2] = q15(FilterTableMath::sin_series(half_pi - x));
+				w[k * 2 + 1] = q15(FilterTableMath::sin_series(x));
+			} else {
+				w[k * 2] = q15(-FilterTableMath::sin_series(x - half_pi));
+				w[k * 2 + 1] = q15(FilterTableMath::sin_series(2.0 * half_pi - x));
+			}
+		}
+	}
+};
+
+static constexpr FFT1024Twiddle fft1024_twiddle;
+
+// Window 4 samples at a time, into one complex number of each half
+static void copy_to_fft_buffer(int16_t *buffer, int offset, const int16_t *src, const int16_t *window)
 {
-	const uint16_t *src = (const uint16_t *)source;
-	uint32_t *dst = (uint32_t *)destination;
+	int16_t *even = buffer + offset / 2;
+	int16_t *odd = buffer + 512 + offset / 2;
 
-	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
-		*dst++ = *src++;  // real sample plus a zero for imaginary
+	if (window) {
+		const int16_t *win = window + offset;
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i += 4) {
+			*even++ = (src[0] * win[0]) >> 15;
+			*even++ = (src[1] * win[1]) >> 15;
+			*odd++ = (src[2] * win[2]) >> 15;
+			*odd++ = (src[3] * win[3]) >> 15;
+			src += 4;
+			win += 4;
+		}
+	} else {
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i += 4) {
+			*even++ = src[0];
+			*even++ = src[1];
+			*odd++ = src[2];
+			*odd++ = src[3];
+			src += 4;
+		}
 	}
 }
 
-static void apply_window_to_fft_buffer(void *buffer, const void *window)
+void AudioAnalyzeFFT1024::fft_step(void)
 {
-	int16_t *buf = (int16_t *)buffer;
-	const int16_t *win = (int16_t *)window;;
+	const int16_t *tw = fft1024_twiddle.w;
+	int16_t *z = buffer;
+	uint32_t weight;
 
-	for (int i=0; i < 1024; i++) {
-		int32_t val = *buf * *win++;
-		//*buf = signed_saturate_rshift(val, 16, 15);
-		*buf = val >> 15;
-		buf += 2;
+	switch (work) {
+	case 1:
+		arm_cfft_radix4_q15(&fft_inst, buffer);
+		work = 2;
+		break;
+	case 2:
+		arm_cfft_radix4_q15(&fft_inst, buffer + 512);
+		work = 3;
+		break;
+	case 3:
+		// combine into the 512 point FFT, scaled by 1/512 like the 256
+		// point FFTs are scaled by 1/256.  Twiddle 2k of 1024 is k of 512.
+		for (int k=0; k < 256; k++) {
+			int32_t c = tw[k * 4], s = tw[k * 4 + 1];
+			int32_t ar = z[k * 2], ai = z[k * 2 + 1];
+			int32_t br = z[512 + k * 2], bi = z[512 + k * 2 + 1];
+			int32_t tr = (c * br + s * bi) >> 15;
+			int32_t ti = (c * bi - s * br) >> 15;
+			z[k * 2] = (ar + tr) >> 1;
+			z[k * 2 + 1] = (ai + ti) >> 1;
+			z[512 + k * 2] = (ar - tr) >> 1;
+			z[512 + k * 2 + 1] = (ai - ti) >> 1;
+		}
+		// split into bins 0 to 511 of the real FFT, scaled by 1/1024
+		weight = average_weight ? average_weight : 65536 / (count + 1);
+		for (int k=0; k < 512; k++) {
+			int n = (k == 0) ? 0 : 512 - k;
+			int32_t zr = z[k * 2], zi = z[k * 2 + 1];
+			int32_t wr = z[n * 2], wi = z[n * 2 + 1];
+			int32_t c = tw[k * 2], s = tw[k * 2 + 1];
+			int32_t er = zr + wr, ei = zi - wi;	// 2 x even part
+			int32_t orl = zi + wi, oim = wr - zr;	// 2 x odd part
+			int32_t xr = er + ((c * orl + s * oim) >> 15);
+			int32_t xi = ei + ((c * oim - s * orl) >> 15);
+			// xr and xi are 4 times the bin, 17 bits
+			uint64_t magsq = (int64_t)xr * xr + (int64_t)xi * xi;
+			output[k] = sqrt_uint32_approx(fft_average(&power[k], magsq >> 4, weight));
+		}
+		if (average_weight || ++count >= naverage) {
+			count = 0;
+			outputflag = true;
+		}
+		work = 0;
+		break;
 	}
-
 }
 
 void AudioAnalyzeFFT1024::update(void)
@@ -63,67 +150,28 @@ void AudioAnalyzeFFT1024::update(void)
 	if (!block) return;
 
 #if defined(__ARM_ARCH_7EM__)
-	switch (state) {
-	case 0:
-		blocklist[0] = block;
-		state = 1;
-		break;
-	case 1:
-		blocklist[1] = block;
-		state = 2;
-		break;
-	case 2:
-		blocklist[2] = block;
-		state = 3;
-		break;
-	case 3:
-		blocklist[3] = block;
-		state = 4;
-		break;
-	case 4:
-		blocklist[4] = block;
-		state = 5;
-		break;
-	case 5:
-		blocklist[5] = block;
-		state = 6;
-		break;
-	case 6:
-		blocklist[6] = block;
-		state = 7;
-		break;
-	case 7:
-		blocklist[7] = block;
-		// TODO: perhaps distribute the work over multiple update() ??
-		//       github pull requsts welcome......
-		copy_to_fft_buffer(buffer+0x000, blocklist[0]->data);
-		copy_to_fft_buffer(buffer+0x100, blocklist[1]->data);
-		copy_to_fft_buffer(buffer+0x200, blocklist[2]->data);
-		copy_to_fft_buffer(buffer+0x300, blocklist[3]->data);
-		copy_to_fft_buffer(buffer+0x400, blocklist[4]->data);
-		copy_to_fft_buffer(buffer+0x500, blocklist[5]->data);
-		copy_to_fft_buffer(buffer+0x600, blocklist[6]->data);
-		copy_to_fft_buffer(buffer+0x700, blocklist[7]->data);
-		if (window) apply_window_to_fft_buffer(buffer, window);
-		arm_cfft_radix4_q15(&fft_inst, buffer);
-		// TODO: support averaging multiple copies
-		for (int i=0; i < 512; i++) {
-			uint32_t tmp = *((uint32_t *)buffer + i); // real & imag
-			uint32_t magsq = multiply_16tx16t_add_16bx16b(tmp, tmp);
-			output[i] = sqrt_uint32_approx(magsq);
-		}
-		outputflag = true;
-		release(blocklist[0]);
-		release(blocklist[1]);
-		release(blocklist[2]);
-		release(blocklist[3]);
-		blocklist[0] = blocklist[4];
-		blocklist[1] = blocklist[5];
-		blocklist[2] = blocklist[6];
-		blocklist[3] = blocklist[7];
-		state = 4;
-		break;
+	if (work) fft_step();
+	blocklist[state] = block;
+	if (state < 7) {
+		state++;
+		return;
+	}
+	// 1024 samples are ready, "hop" blocks of them new since the last FFT
+	while (work) fft_step();
+	for (int i=0; i < 8; i++) {
+		copy_to_fft_buffer(buffer, i * AUDIO_BLOCK_SAMPLES, blocklist[i]->data, window);
+	}
+	work = 1;
+	if (!distribute) {
+		while (work) fft_step();
+	}
+	for (int i=0; i < hop; i++) {
+		release(blocklist[i]);
+	}
+	for (int i=hop; i < 8; i++) {
+		blocklist[i - hop] = blocklist[i];
 	}
+	state = 8 - hop;
 #else
 	release(block);
 #endif
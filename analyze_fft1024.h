@@ -30,6 +30,7 @@
 #include "Arduino.h"
 #include "AudioStream.h"
 #include "arm_math.h"
+#include "FFTSpectrum.h"
 
 // windows.c
 extern "C" {
@@ -50,8 +51,9 @@ class AudioAnalyzeFFT1024 : public AudioStream
 {
 public:
 	AudioAnalyzeFFT1024() : AudioStream(1, inputQueueArray),
-	  window(AudioWindowHanning1024), state(0), outputflag(false) {
-		arm_cfft_radix4_init_q15(&fft_inst, 1024, 0, 1);
+	  window(AudioWindowHanning1024), state(0), work(0), distribute(false),
+	  hop(4), count(0), naverage(1), average_weight(0), outputflag(false) {
+		arm_cfft_radix4_init_q15(&fft_inst, 256, 0, 1);
 	}
 	bool available() {
 		if (outputflag == true) {
@@ -79,22 +81,59 @@ public:
 		return (float)sum * (1.0 / 16384.0);
 	}
 	void averageTogether(uint8_t n) {
-		// not implemented yet (may never be, 86 Hz output rate is ok)
+		if (n == 0) n = 1;
+		naverage = n;
+		average_weight = 0;
+	}
+	// Exponential averaging, each new spectrum has "weight" (0 to 1.0)
+	// and the previous average has 1 - weight.  Output is not delayed.
+	void averageExponential(float weight) {
+		if (weight >= 1.0f) weight = 1.0f;
+		else if (weight < 0.0001f) weight = 0.0001f;
+		average_weight = weight * 65536.0f;
+	}
+	// 25, 50 (default) or 75 percent overlap, for an output every 6, 4
+	// or 2 updates.
+	void overlap(unsigned int percent) {
+		hop = (percent >= 63) ? 2 : (percent >= 38) ? 4 : 6;
+	}
+	// Group the bins into bands, read all of them with readBands()
+	bool logBands(unsigned int n, float lowFreq, float highFreq) {
+		return bands.set(n, lowFreq, highFreq, false, AUDIO_SAMPLE_RATE_EXACT / 1024.0f, 512);
+	}
+	bool melBands(unsigned int n, float lowFreq, float highFreq) {
+		return bands.set(n, lowFreq, highFreq, true, AUDIO_SAMPLE_RATE_EXACT / 1024.0f, 512);
+	}
+	void readBands(float *values) {
+		bands.read(output, values);
 	}
 	void windowFunction(const int16_t *w) {
 		window = w;
 	}
+	// Spread the FFT over the updates between outputs, instead of all
+	// in the update which completes each 1024 samples.  The output rate
+	// is the same, but is 3 updates (8.7 ms) later.
+	void distributeWork(bool enable) {
+		distribute = enable;
+	}
 	virtual void update(void);
 	uint16_t output[512] __attribute__ ((aligned (4)));
 private:
 	void init(void);
+	void fft_step(void);
 	const int16_t *window;
 	audio_block_t *blocklist[8];
-	int16_t buffer[2048] __attribute__ ((aligned (4)));
-	//uint32_t sum[512];
-	//uint8_t count;
+	// 1024 real samples as 512 complex, even ones in the first half
+	int16_t buffer[1024] __attribute__ ((aligned (4)));
 	uint8_t state;
-	//uint8_t naverage;
+	uint8_t work;			// next step of the FFT, 0 when done
+	bool distribute;
+	uint8_t hop;			// blocks between FFTs
+	uint8_t count;			// spectra averaged so far
+	uint8_t naverage;
+	uint32_t average_weight;	// exponential averaging, 0 when not used
+	uint32_t power[512];		// average of magnitude squared
+	FFTBands bands;
 	volatile bool outputflag;
 	audio_block_t *inputQueueArray[1];
 	arm_cfft_radix4_instance_q15 fft_inst;
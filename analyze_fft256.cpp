@@ -32,12 +32,12 @@
 
 // 140312 - PAH - slightly faster copy
 __attribute__((unused))
-static void copy_to_fft_buffer(void *destination, const void *source)
+static void copy_to_fft_buffer(void *destination, const void *source, int count)
 {
 	const uint16_t *src = (const uint16_t *)source;
 	uint32_t *dst = (uint32_t *)destination;
 
-	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+	for (int i=0; i < count; i++) {
 		*dst++ = *src++;  // real sample plus a zero for imaginary
 	}
 }
@@ -63,40 +63,35 @@ void AudioAnalyzeFFT256::update(void)
 	block = receiveReadOnly();
 	if (!block) return;
 #if AUDIO_BLOCK_SAMPLES == 128 && defined (__ARM_ARCH_7EM__)
-	if (!prevblock) {
-		prevblock = block;
-		return;
-	}
-	copy_to_fft_buffer(buffer, prevblock->data);
-	copy_to_fft_buffer(buffer+256, block->data);
-	//window = AudioWindowBlackmanNuttall256;
-	//window = NULL;
-	if (window) apply_window_to_fft_buffer(buffer, window);
-	arm_cfft_radix4_q15(&fft_inst, buffer);
-	// G. Heinzel's paper says we're supposed to average the magnitude
-	// squared, then do the square root at the end.
-	if (count == 0) {
-		for (int i=0; i < 128; i++) {
-			uint32_t tmp = *((uint32_t *)buffer + i);
-			uint32_t magsq = multiply_16tx16t_add_16bx16b(tmp, tmp);
-			sum[i] = magsq / naverage;
+	// the FFT may start at any 64 sample boundary in these 3 blocks
+	const audio_block_t *src[3] = {prevblocks[1], prevblocks[0], block};
+	while (frame_end <= 384) {
+		int start = frame_end - 256;
+		frame_end += hop;
+		if (!src[start >> 7]) continue; // not enough data yet
+		for (int i=0; i < 4; i++) {
+			int n = start + i * 64;
+			copy_to_fft_buffer(buffer + i * 128, src[n >> 7]->data + (n & 127), 64);
 		}
-	} else {
+		if (window) apply_window_to_fft_buffer(buffer, window);
+		arm_cfft_radix4_q15(&fft_inst, buffer);
+		// G. Heinzel's paper says we're supposed to average the magnitude
+		// squared, then do the square root at the end.
+		uint32_t weight = average_weight ? average_weight : 65536 / (count + 1);
 		for (int i=0; i < 128; i++) {
 			uint32_t tmp = *((uint32_t *)buffer + i);
 			uint32_t magsq = multiply_16tx16t_add_16bx16b(tmp, tmp);
-			sum[i] += magsq / naverage;
+			output[i] = sqrt_uint32_approx(fft_average(&power[i], magsq, weight));
 		}
-	}
-	if (++count == naverage) {
-		count = 0;
-		for (int i=0; i < 128; i++) {
-			output[i] = sqrt_uint32_approx(sum[i]);
+		if (average_weight || ++count >= naverage) {
+			count = 0;
+			outputflag = true;
 		}
-		outputflag = true;
 	}
-	release(prevblock);
-	prevblock = block;
+	frame_end -= 128;
+	if (prevblocks[1]) release(prevblocks[1]);
+	prevblocks[1] = prevblocks[0];
+	prevblocks[0] = block;
 #elif AUDIO_BLOCK_SAMPLES == 64
 	if (prevblocks[2] == NULL) {
 		prevblocks[2] = prevblocks[1];
@@ -106,10 +101,10 @@ void AudioAnalyzeFFT256::update(void)
 	}
 	if (count == 0) {
 		count = 1;
-		copy_to_fft_buffer(buffer, prevblocks[2]->data);
-		copy_to_fft_buffer(buffer+128, prevblocks[1]->data);
-		copy_to_fft_buffer(buffer+256, prevblocks[1]->data);
-		copy_to_fft_buffer(buffer+384, block->data);
+		copy_to_fft_buffer(buffer, prevblocks[2]->data, 64);
+		copy_to_fft_buffer(buffer+128, prevblocks[1]->data, 64);
+		copy_to_fft_buffer(buffer+256, prevblocks[1]->data, 64);
+		copy_to_fft_buffer(buffer+384, block->data, 64);
 		if (window) apply_window_to_fft_buffer(buffer, window);
 		arm_cfft_radix4_q15(&fft_inst, buffer);
 	} else {
@@ -30,6 +30,7 @@
 #include "Arduino.h"
 #include "AudioStream.h"
 #include "arm_math.h"
+#include "FFTSpectrum.h"
 
 // windows.c
 extern "C" {
@@ -53,8 +54,12 @@ public:
 	  window(AudioWindowHanning256), count(0), outputflag(false) {
 		arm_cfft_radix4_init_q15(&fft_inst, 256, 0, 1);
 #if AUDIO_BLOCK_SAMPLES == 128
-		prevblock = NULL;
+		prevblocks[0] = NULL;
+		prevblocks[1] = NULL;
 		naverage = 8;
+		average_weight = 0;
+		hop = 128;
+		frame_end = 512;
 #elif AUDIO_BLOCK_SAMPLES == 64
 		prevblocks[0] = NULL;
 		prevblocks[1] = NULL;
@@ -90,8 +95,35 @@ public:
 #if AUDIO_BLOCK_SAMPLES == 128
 		if (n == 0) n = 1;
 		naverage = n;
+		average_weight = 0;
+#endif
+	}
+	// Exponential averaging, each new spectrum has "weight" (0 to 1.0)
+	// and the previous average has 1 - weight.  Output is not delayed.
+	void averageExponential(float weight) {
+#if AUDIO_BLOCK_SAMPLES == 128
+		if (weight >= 1.0f) weight = 1.0f;
+		else if (weight < 0.0001f) weight = 0.0001f;
+		average_weight = weight * 65536.0f;
 #endif
 	}
+	// 25, 50 (default) or 75 percent overlap.  With 75%, two FFTs are
+	// computed in some updates.
+	void overlap(unsigned int percent) {
+#if AUDIO_BLOCK_SAMPLES == 128
+		hop = (percent >= 63) ? 64 : (percent >= 38) ? 128 : 192;
+#endif
+	}
+	// Group the bins into bands, read all of them with readBands()
+	bool logBands(unsigned int n, float lowFreq, float highFreq) {
+		return bands.set(n, lowFreq, highFreq, false, AUDIO_SAMPLE_RATE_EXACT / 256.0f, 128);
+	}
+	bool melBands(unsigned int n, float lowFreq, float highFreq) {
+		return bands.set(n, lowFreq, highFreq, true, AUDIO_SAMPLE_RATE_EXACT / 256.0f, 128);
+	}
+	void readBands(float *values) {
+		bands.read(output, values);
+	}
 	void windowFunction(const int16_t *w) {
 		window = w;
 	}
@@ -100,16 +132,20 @@ public:
 private:
 	const int16_t *window;
 #if AUDIO_BLOCK_SAMPLES == 128
-	audio_block_t *prevblock;
+	audio_block_t *prevblocks[2];
 #elif AUDIO_BLOCK_SAMPLES == 64
 	audio_block_t *prevblocks[3];
 #endif
 	int16_t buffer[512] __attribute__ ((aligned (4)));
 #if AUDIO_BLOCK_SAMPLES == 128
-	uint32_t sum[128];
+	uint32_t average_weight;	// exponential averaging, 0 when not used
+	uint32_t power[128];		// average of magnitude squared
+	uint16_t hop;			// samples between FFTs
+	uint16_t frame_end;		// end of the next FFT, from the oldest block
 	uint8_t naverage;
 #endif
 	uint8_t count;
+	FFTBands bands;
 	volatile bool outputflag;
 	audio_block_t *inputQueueArray[1];
 	arm_cfft_radix4_instance_q15 fft_inst;
@@ -0,0 +1,458 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "analyze_meter.h"
+#include "utility/dspinst.h"
+
+// 4x oversampling for true-peak, Kaiser windowed sinc (beta 5), 12 taps
+// for each of the points at 1/4, 1/2 and 3/4 between the 6th and 7th
+// samples.  Within 0.05 dB to 0.36 of the sample rate, 16 kHz at 44.1 kHz.
+// The 1/2 filter is symmetric and the 1/4 and 3/4 filters mirror each
+// other, so all 3 are computed from the sums and differences of the
+// sample pairs 0 & 11, 1 & 10, ... 5 & 6, with half the multiplies.
+static const float truepeak_half[6] = {	// 1/2, of the sums
+	-0.00484387f, 0.01632949f, -0.03983627f, 0.08515047f, -0.18444533f, 0.62764551f
+};
+static const float truepeak_even[6] = {	// (1/4 + 3/4) / 2, of the sums
+	-0.00357536f, 0.01180268f, -0.02861682f, 0.06122562f, -0.13476569f, 0.59392957f
+};
+static const float truepeak_odd[6] = {	// (1/4 - 3/4) / 2, of the differences
+	-0.00130420f, 0.00291687f, -0.00568401f, 0.01117634f, -0.02868141f, 0.30384588f
+};
+
+static float energy_to_lufs(float energy)
+{
+	if (energy < 1.0e-10f) return -100.0f;
+	return -0.691f + 10.0f * log10f(energy);
+}
+
+AudioAnalyzeMeterBase::AudioAnalyzeMeterBase(unsigned char ninput,
+  audio_block_t **iqueue, audio_meter_channel_t *channels)
+  : AudioStream(ninput, iqueue), chan(channels), segment_sum(0.0f),
+  momentary(0.0f), shortterm(0.0f), integrated(0.0f), segment_index(0),
+  segment_count(0), new_output(false), truepeak_enabled(true),
+  loudness_enabled(true)
+{
+	// K-weighting, BS.1770 pre-filter and RLB high pass, from their
+	// analog prototypes for any sample rate.  Stored like the float
+	// biquad filter, b0, b1, b2, -a1, -a2.
+	double K, a0, Vh, Vb;
+	const double Q1 = 0.7071752369554196, Q2 = 0.5003270373238773;
+	K = tan(3.14159265358979323846 * 1681.974450955533 / AUDIO_SAMPLE_RATE_EXACT);
+	Vh = pow(10.0, 3.999843853973347 / 20.0);
+	Vb = pow(Vh, 0.4996667741545416);
+	a0 = 1.0 + K / Q1 + K * K;
+	kcoef[0] = (Vh + Vb * K / Q1 + K * K) / a0;
+	kcoef[1] = 2.0 * (K * K - Vh) / a0;
+	kcoef[2] = (Vh - Vb * K / Q1 + K * K) / a0;
+	kcoef[3] = -2.0 * (K * K - 1.0) / a0;
+	kcoef[4] = -(1.0 - K / Q1 + K * K) / a0;
+	K = tan(3.14159265358979323846 * 38.13547087602444 / AUDIO_SAMPLE_RATE_EXACT);
+	a0 = 1.0 + K / Q2 + K * K;
+	kcoef[5] = 1.0f;
+	kcoef[6] = -2.0f;
+	kcoef[7] = 1.0f;
+	kcoef[8] = -2.0 * (K * K - 1.0) / a0;
+	kcoef[9] = -(1.0 - K / Q2 + K * K) / a0;
+
+	segment_length = (int)(AUDIO_SAMPLE_RATE_EXACT / 20.0f + 0.5f) * 2;
+	segment_remain = segment_length;
+	for (int i=0; i < 30; i++) segment[i] = 0.0f;
+	for (int i=0; i < AUDIO_METER_HISTOGRAM_BINS; i++) {
+		histogram_count[i] = 0;
+		histogram_energy[i] = 0.0;
+	}
+	for (int i=0; i < ninput; i++) {
+		audio_meter_channel_t *c = chan + i;
+		c->sum_squares = 0;
+		c->count = 0;
+		c->min_sample = 32767;
+		c->max_sample = -32768;
+		c->true_peak = 0.0f;
+		c->weight = 1.0f;
+		for (int j=0; j < 4; j++) c->kstate[j] = 0.0f;
+		for (int j=0; j < AUDIO_METER_TRUEPEAK_TAPS - 1; j++) c->history[j] = 0.0f;
+	}
+}
+
+float AudioAnalyzeMeterBase::readPeak(unsigned int channel)
+{
+	if (channel >= num_inputs) return 0.0f;
+	audio_meter_channel_t *c = chan + channel;
+	__disable_irq();
+	int min = c->min_sample;
+	int max = c->max_sample;
+	c->min_sample = 32767;
+	c->max_sample = -32768;
+	__enable_irq();
+	min = abs(min);
+	max = abs(max);
+	if (min > max) max = min;
+	return (float)max / 32767.0f;
+}
+
+float AudioAnalyzeMeterBase::readRMS(unsigned int channel)
+{
+	if (channel >= num_inputs) return 0.0f;
+	audio_meter_channel_t *c = chan + channel;
+	__disable_irq();
+	int64_t sum = c->sum_squares;
+	uint32_t num = c->count;
+	c->sum_squares = 0;
+	c->count = 0;
+	__enable_irq();
+	if (num == 0) return 0.0f;
+	float meansq = sum / (num * AUDIO_BLOCK_SAMPLES);
+	return sqrtf(meansq) / 32767.0f;
+}
+
+float AudioAnalyzeMeterBase::readTruePeak(unsigned int channel)
+{
+	if (channel >= num_inputs) return 0.0f;
+	audio_meter_channel_t *c = chan + channel;
+	__disable_irq();
+	float peak = c->true_peak;
+	c->true_peak = 0.0f;
+	__enable_irq();
+	return peak;
+}
+
+float AudioAnalyzeMeterBase::readMomentary(void)
+{
+	__disable_irq();
+	float energy = momentary;
+	__enable_irq();
+	return energy_to_lufs(energy);
+}
+
+float AudioAnalyzeMeterBase::readShortTerm(void)
+{
+	__disable_irq();
+	float energy = shortterm;
+	__enable_irq();
+	return energy_to_lufs(energy);
+}
+
+float AudioAnalyzeMeterBase::readIntegrated(void)
+{
+	__disable_irq();
+	float energy = integrated;
+	__enable_irq();
+	return energy_to_lufs(energy);
+}
+
+void AudioAnalyzeMeterBase::resetIntegrated(void)
+{
+	__disable_irq();
+	for (int i=0; i < AUDIO_METER_HISTOGRAM_BINS; i++) {
+		histogram_count[i] = 0;
+		histogram_energy[i] = 0.0;
+	}
+	integrated = 0.0f;
+	__enable_irq();
+}
+
+void AudioAnalyzeMeterBase::truePeak(bool enable)
+{
+	__disable_irq();
+	if (enable && !truepeak_enabled) {
+		// don't interpolate from the samples before it was off
+		for (int i=0; i < num_inputs; i++) {
+			for (int j=0; j < AUDIO_METER_TRUEPEAK_TAPS - 1; j++) {
+				chan[i].history[j] = 0.0f;
+			}
+		}
+	}
+	truepeak_enabled = enable;
+	__enable_irq();
+}
+
+void AudioAnalyzeMeterBase::loudness(bool enable)
+{
+	__disable_irq();
+	if (enable && !loudness_enabled) {
+		for (int i=0; i < num_inputs; i++) {
+			for (int j=0; j < 4; j++) chan[i].kstate[j] = 0.0f;
+		}
+		for (int i=0; i < 30; i++) segment[i] = 0.0f;
+		segment_sum = 0.0f;
+		segment_remain = segment_length;
+		segment_index = 0;
+		segment_count = 0;
+	}
+	loudness_enabled = enable;
+	if (!enable) new_output = false;
+	__enable_irq();
+}
+
+// Called every 100 ms, from update
+void AudioAnalyzeMeterBase::end_segment(void)
+{
+	int i, n;
+
+	segment[segment_index] = segment_sum / (float)segment_length;
+	if (++segment_index >= 30) segment_index = 0;
+	if (segment_count < 30) segment_count++;
+
+	// momentary: the last 4 segments, short-term: all 30
+	float sum4 = 0.0f, sum30 = 0.0f;
+	for (i=0; i < 30; i++) {
+		sum30 += segment[i];
+	}
+	for (i=1; i <= 4; i++) {
+		sum4 += segment[(segment_index + 30 - i) % 30];
+	}
+	n = segment_count < 4 ? segment_count : 4;
+	momentary = sum4 / (float)n;
+	shortterm = sum30 / (float)segment_count;
+	if (segment_count < 4) return;
+
+	// integrated: each 400 ms block, overlapping by 75%, above the
+	// absolute gate of -70 LUFS goes into a histogram
+	float lufs = energy_to_lufs(momentary);
+	if (lufs >= -70.0f) {
+		int bin = (lufs + 70.0f) * 4.0f;
+		if (bin >= AUDIO_METER_HISTOGRAM_BINS) bin = AUDIO_METER_HISTOGRAM_BINS - 1;
+		histogram_count[bin]++;
+		histogram_energy[bin] += momentary;
+	}
+	// relative gate, 10 LU below the loudness of all blocks
+	uint32_t count = 0;
+	double energy = 0.0;
+	for (i=0; i < AUDIO_METER_HISTOGRAM_BINS; i++) {
+		count += histogram_count[i];
+		energy += histogram_energy[i];
+	}
+	if (count == 0) return;
+	float gate = (energy_to_lufs(energy / count) - 10.0f + 70.0f) * 4.0f;
+	// blocks in the bin with the gate are counted if the gate is in the
+	// lower half of the bin
+	int first = (int)ceilf(gate - 0.5f);
+	if (first < 0) first = 0;
+	count = 0;
+	energy = 0.0;
+	for (i=first; i < AUDIO_METER_HISTOGRAM_BINS; i++) {
+		count += histogram_count[i];
+		energy += histogram_energy[i];
+	}
+	integrated = count ? energy / count : 0.0f;
+}
+
+#if defined(__ARM_ARCH_7EM__)
+
+static inline float kweight(float x, const float *k, float *s) __attribute__((always_inline));
+static inline float kweight(float x, const float *k, float *s)
+{
+	float y = k[0] * x + s[0];
+	s[0] = k[1] * x + k[3] * y + s[1];
+	s[1] = k[2] * x + k[4] * y;
+	float z = y + s[2];
+	s[2] = k[6] * y + k[8] * z + s[3];
+	s[3] = y + k[9] * z;
+	return z;
+}
+
+// One pass over n samples, n even, for the sample peak, the RMS sum of
+// squares and the K-weighted loudness.  The samples are also converted to
+// float, for the true-peak filter.  Returns the K-weighted sum of squares.
+float AudioAnalyzeMeterBase::measure(audio_meter_channel_t *c,
+  const int16_t *data, unsigned int n, float *x)
+{
+	const uint32_t *p = (const uint32_t *)data;
+	const uint32_t *end = p + n / 2;
+	const float *k = kcoef;
+	const float scale = 1.0f / 32767.0f;
+	int64_t sum = c->sum_squares;
+	int32_t min = c->min_sample;
+	int32_t max = c->max_sample;
+	float s[4] = {c->kstate[0], c->kstate[1], c->kstate[2], c->kstate[3]};
+	float zsum = 0.0f;
+
+	while (p < end) {
+		uint32_t in = *p++;
+		sum = multiply_accumulate_16tx16t_add_16bx16b(sum, in, in);
+		int32_t a = (int16_t)in;
+		int32_t b = (int32_t)in >> 16;
+		if (a < min) min = a;
+		if (a > max) max = a;
+		if (b < min) min = b;
+		if (b > max) max = b;
+		float xa = (float)a * scale;
+		float xb = (float)b * scale;
+		*x++ = xa;
+		*x++ = xb;
+		float za = kweight(xa, k, s);
+		float zb = kweight(xb, k, s);
+		zsum += za * za + zb * zb;
+	}
+	c->sum_squares = sum;
+	c->min_sample = min;
+	c->max_sample = max;
+	for (int i=0; i < 4; i++) {
+		// flush denormals, which are very slow on some CPUs
+		if (fabsf(s[i]) < 1.0e-20f) s[i] = 0.0f;
+		c->kstate[i] = s[i];
+	}
+	return zsum;
+}
+
+// Sample peak and RMS sum of squares only, for a whole block
+void AudioAnalyzeMeterBase::level(audio_meter_channel_t *c, const int16_t *data)
+{
+	const uint32_t *p = (const uint32_t *)data;
+	const uint32_t *end = p + AUDIO_BLOCK_SAMPLES / 2;
+	int64_t sum = c->sum_squares;
+	int32_t min = c->min_sample;
+	int32_t max = c->max_sample;
+
+	do {
+		uint32_t in1 = *p++;
+		uint32_t in2 = *p++;
+		sum = multiply_accumulate_16tx16t_add_16bx16b(sum, in1, in1);
+		sum = multiply_accumulate_16tx16t_add_16bx16b(sum, in2, in2);
+		int32_t a = (int16_t)in1;
+		int32_t b = (int32_t)in1 >> 16;
+		if (a < min) min = a;
+		if (a > max) max = a;
+		if (b < min) min = b;
+		if (b > max) max = b;
+		a = (int16_t)in2;
+		b = (int32_t)in2 >> 16;
+		if (a < min) min = a;
+		if (a > max) max = a;
+		if (b < min) min = b;
+		if (b > max) max = b;
+	} while (p < end);
+	c->sum_squares = sum;
+	c->min_sample = min;
+	c->max_sample = max;
+	c->count++;
+}
+
+// Largest of the samples and the 3 points between each pair of samples.
+// x has the previous 11 samples, followed by the block.
+static float true_peak(const float *x, float peak)
+{
+	const float *end = x + AUDIO_BLOCK_SAMPLES;
+
+	do {
+		float even = 0.0f, odd = 0.0f, half = 0.0f;
+		for (int i=0; i < 6; i++) {
+			float sum = x[i] + x[11 - i];
+			float diff = x[i] - x[11 - i];
+			half += truepeak_half[i] * sum;
+			even += truepeak_even[i] * sum;
+			odd += truepeak_odd[i] * diff;
+		}
+		float y0 = fabsf(x[5]);
+		float y1 = fabsf(even + odd);
+		float y2 = fabsf(half);
+		float y3 = fabsf(even - odd);
+		if (y1 > y0) y0 = y1;
+		if (y3 > y2) y2 = y3;
+		if (y2 > y0) y0 = y2;
+		if (y0 > peak) peak = y0;
+		x++;
+	} while (x < end);
+	return peak;
+}
+
+// x has room for the channel's previous 11 samples, followed by the block
+static void update_true_peak(audio_meter_channel_t *c, float *x)
+{
+	memcpy(x, c->history, sizeof(c->history));
+	c->true_peak = true_peak(x, c->true_peak);
+	memcpy(c->history, x + AUDIO_BLOCK_SAMPLES, sizeof(c->history));
+}
+
+void AudioAnalyzeMeterBase::update(void)
+{
+	static const int16_t silence[AUDIO_BLOCK_SAMPLES] = {0};
+	float x[AUDIO_METER_TRUEPEAK_TAPS - 1 + AUDIO_BLOCK_SAMPLES];
+	const unsigned int hist = AUDIO_METER_TRUEPEAK_TAPS - 1;
+	audio_block_t *block;
+	unsigned int split;
+	float sum1 = 0.0f, sum2 = 0.0f;
+
+	if (!loudness_enabled) {
+		for (int i=0; i < num_inputs; i++) {
+			audio_meter_channel_t *c = chan + i;
+			block = receiveReadOnly(i);
+			const int16_t *data = block ? block->data : silence;
+			level(c, data);
+			if (truepeak_enabled) {
+				for (int j=0; j < AUDIO_BLOCK_SAMPLES; j++) {
+					x[hist + j] = (float)data[j] * (1.0f / 32767.0f);
+				}
+				update_true_peak(c, x);
+			}
+			if (block) release(block);
+		}
+		return;
+	}
+
+	// the 100 ms segment may end within this block
+	split = segment_remain;
+	if (split > AUDIO_BLOCK_SAMPLES) split = AUDIO_BLOCK_SAMPLES;
+	for (int i=0; i < num_inputs; i++) {
+		audio_meter_channel_t *c = chan + i;
+		block = receiveReadOnly(i);
+		const int16_t *data = block ? block->data : silence;
+		float z1 = measure(c, data, split, x + hist);
+		float z2 = 0.0f;
+		if (split < AUDIO_BLOCK_SAMPLES) {
+			z2 = measure(c, data + split, AUDIO_BLOCK_SAMPLES - split,
+			  x + hist + split);
+		}
+		c->count++;
+		if (block) release(block);
+		sum1 += c->weight * z1;
+		sum2 += c->weight * z2;
+		if (truepeak_enabled) update_true_peak(c, x);
+	}
+	segment_sum += sum1;
+	segment_remain -= split;
+	if (segment_remain == 0) {
+		end_segment();
+		segment_sum = sum2;
+		segment_remain = segment_length - (AUDIO_BLOCK_SAMPLES - split);
+		new_output = true;
+	}
+}
+
+#elif defined(KINETISL)
+
+void AudioAnalyzeMeterBase::update(void)
+{
+	audio_block_t *block;
+	for (int i=0; i < num_inputs; i++) {
+		block = receiveReadOnly(i);
+		if (block) release(block);
+	}
+}
+
+#endif
@@ -0,0 +1,141 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef analyze_meter_h_
+#define analyze_meter_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+// Level meter for 1 to 16 channels, measuring in one pass over each block
+// the sample peak and RMS, like AudioAnalyzePeak and AudioAnalyzeRMS, the
+// 4x oversampled true-peak, and the ITU-R BS.1770 / EBU R128 loudness of
+// all channels together: momentary (400 ms), short-term (3 s) and
+// integrated (gated, since resetIntegrated).  Loudness is in LUFS,
+// updated every 100 ms.
+//
+// The true-peak and the loudness are float and cost far more than the
+// peak and RMS: with all 4 measured, AudioAnalyzeMeter<8> takes
+// 10 to 15 times the CPU time of 8 AudioAnalyzePeak and 8 AudioAnalyzeRMS.
+// Turn off what isn't needed with truePeak(false) and loudness(false).
+// With both off, only the peak and RMS are measured, in integer math,
+// in a little less time than the separate objects.
+//
+// Needs a floating point unit, Teensy 3.5, 3.6 or 4.x.
+
+// Integrated loudness histogram, -70 to +10 LUFS in 0.25 LU steps
+#define AUDIO_METER_HISTOGRAM_BINS 320
+// Taps per phase of the true-peak interpolation filter
+#define AUDIO_METER_TRUEPEAK_TAPS 12
+
+typedef struct audio_meter_channel_struct {
+	int64_t sum_squares;	// RMS, since readRMS()
+	uint32_t count;		// blocks in sum_squares
+	int16_t min_sample;	// sample peak, since readPeak()
+	int16_t max_sample;
+	float true_peak;	// since readTruePeak()
+	float weight;		// loudness weight, BS.1770 G
+	float kstate[4];	// K-weighting filter state
+	float history[AUDIO_METER_TRUEPEAK_TAPS - 1];
+} audio_meter_channel_t;
+
+class AudioAnalyzeMeterBase : public AudioStream
+{
+public:
+	// True each time new loudness values are ready, every 100 ms
+	bool available(void) {
+		__disable_irq();
+		bool flag = new_output;
+		if (flag) new_output = false;
+		__enable_irq();
+		return flag;
+	}
+	// Levels since the previous read of the same channel, 0 to 1.0.  The
+	// true-peak between samples may be above 1.0.
+	float readPeak(unsigned int channel);
+	float readRMS(unsigned int channel);
+	float readTruePeak(unsigned int channel);
+	// Loudness in LUFS, -100 for silence
+	float readMomentary(void);
+	float readShortTerm(void);
+	float readIntegrated(void);
+	void resetIntegrated(void);
+	// Loudness weight of a channel, default 1.0.  BS.1770 uses 1.41 for
+	// surround channels and 0 for the LFE channel.
+	void channelWeight(unsigned int channel, float weight) {
+		if (channel >= num_inputs) return;
+		if (weight < 0.0f) weight = 0.0f;
+		__disable_irq();
+		chan[channel].weight = weight;
+		__enable_irq();
+	}
+	// Measure the true-peak and the loudness, both on by default.  While
+	// the loudness is off, available() stays false and the loudness
+	// readings keep their last values.  Turning it back on restarts the
+	// momentary and short-term loudness; the integrated loudness carries
+	// on until resetIntegrated.
+	void truePeak(bool enable);
+	void loudness(bool enable);
+	virtual void update(void);
+protected:
+	AudioAnalyzeMeterBase(unsigned char ninput, audio_block_t **iqueue,
+	  audio_meter_channel_t *channels);
+private:
+	float measure(audio_meter_channel_t *c, const int16_t *data,
+	  unsigned int n, float *x);
+	void level(audio_meter_channel_t *c, const int16_t *data);
+	void end_segment(void);
+	audio_meter_channel_t *chan;
+	float kcoef[10];		// K-weighting, 2 biquad stages
+	float segment_sum;		// weighted sum of squares, this segment
+	float segment[30];		// mean square of the last 3 seconds
+	float momentary;		// mean squares, for the loudness
+	float shortterm;
+	float integrated;
+	uint16_t segment_length;	// samples in 100 ms, always even
+	uint16_t segment_remain;
+	uint8_t segment_index;
+	uint8_t segment_count;
+	volatile bool new_output;
+	bool truepeak_enabled;
+	bool loudness_enabled;
+	uint32_t histogram_count[AUDIO_METER_HISTOGRAM_BINS];
+	// summed in double, so a bin keeps counting after 2^24 blocks
+	double histogram_energy[AUDIO_METER_HISTOGRAM_BINS];
+};
+
+template <int NN>
+class AudioAnalyzeMeter : public AudioAnalyzeMeterBase
+{
+	static_assert(NN >= 1 && NN <= 16, "AudioAnalyzeMeter supports 1 to 16 channels");
+public:
+	AudioAnalyzeMeter(void) : AudioAnalyzeMeterBase(NN, inputQueueArray, channelArray) { }
+private:
+	audio_meter_channel_t channelArray[NN];
+	audio_block_t *inputQueueArray[NN];
+};
+
+#endif
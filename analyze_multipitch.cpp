@@ -0,0 +1,241 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "analyze_multipitch.h"
+
+// Harmonic summation with iterative cancellation, based on A. Klapuri,
+// "Multiple Fundamental Frequency Estimation by Summing Harmonic
+// Amplitudes", ISMIR 2006.  The magnitude spectrum is compressed by a
+// square root, which brings the upper harmonics closer to the level of
+// the fundamental, and the average of the nearby bins is subtracted to
+// leave only the peaks.  The candidates are 25 cents apart.  Each one's
+// salience is the sum of the largest bin within an eighth semitone of
+// each harmonic, weighted by (f0 + 52) / (h * f0 + 320), less half of
+// the peak halfway between harmonics, where only a lower note has one.
+// The strongest candidate's harmonics are then removed from the
+// spectrum.  Each harmonic is limited to the average of its neighbors
+// first, so a harmonic shared with another note is not removed entirely.
+// A candidate is skipped when it has no fundamental, or its frequency is
+// another note already found, which are leftovers of the notes removed.
+
+#define MULTIPITCH_HARMONICS	20
+#define STEPS			4		// candidates per semitone
+#define STEP_RATIO		1.0145453f	// 2^(1/48)
+#define TOLERANCE_DOWN		0.9927913f	// 2^(-1/96), an eighth semitone
+#define TOLERANCE_UP		1.0072611f	// 2^(1/96)
+#define CANCEL_AMOUNT		0.9f
+#define FLOOR_BINS		5		// noise floor from 11 bins
+#define PENALTY			0.5f		// for peaks between harmonics
+#define MAX_TRIES		(AUDIO_MULTIPITCH_MAX_NOTES * 2)
+
+static const float bin_width = AUDIO_SAMPLE_RATE_EXACT / 4096.0f;
+static const int top = MULTIPITCH_BINS - FLOOR_BINS - 3;	// highest harmonic bin
+
+// Bins within an eighth semitone of frequency f
+static inline void harmonic_range(float f, int *first, int *last)
+{
+	*first = (int)(f * (TOLERANCE_DOWN / bin_width) + 0.5f);
+	*last = (int)(f * (TOLERANCE_UP / bin_width) + 0.5f);
+}
+
+static inline float max_in_range(const float *r, float f)
+{
+	int first, last;
+	harmonic_range(f, &first, &last);
+	float peak = r[first];
+	for (int k=first + 1; k <= last; k++) {
+		if (r[k] > peak) peak = r[k];
+	}
+	return peak;
+}
+
+float AudioAnalyzeMultiPitch::salience(float f0)
+{
+	const float highest = top * bin_width * TOLERANCE_DOWN;
+	float sum = 0.0f;
+
+	for (int h=1; h <= MULTIPITCH_HARMONICS && h * f0 < highest; h++) {
+		float peak = max_in_range(residual, h * f0);
+		// a peak halfway to the previous harmonic means a lower note
+		float between = max_in_range(residual, (h - 0.5f) * f0);
+		sum += (peak - PENALTY * between) * (f0 + 52.0f) / (h * f0 + 320.0f);
+	}
+	return sum;
+}
+
+// Start a search of the new spectrum
+void AudioAnalyzeMultiPitch::analyze(void)
+{
+	const float *x = (const float *)outputmem;
+	float sum = 0.0f;
+	int first, last;
+
+	while (searching) search();
+	// compress, then subtract the average of the nearby bins, which
+	// leaves the peaks and removes most of the noise
+	for (int k=0; k < MULTIPITCH_BINS; k++) {
+		spectrum[k] = sqrtf(x[k]);
+	}
+	// the candidates are 25 cents apart, from 37.5 cents below low_note
+	lowest = 440.0f * powf(2.0f, (low_note - 69 - 0.375f) * (1.0f / 12.0f));
+	candidates = (high_note - low_note + 1) * STEPS;
+	harmonic_range(lowest, &first, &last);
+	total = 0.0f;
+	for (int k=0; k < FLOOR_BINS; k++) sum += spectrum[k];
+	for (int k=0; k <= top + 2; k++) {
+		sum += spectrum[k + FLOOR_BINS];
+		if (k > FLOOR_BINS) sum -= spectrum[k - FLOOR_BINS - 1];
+		int width = FLOOR_BINS + 1 + ((k < FLOOR_BINS) ? k : FLOOR_BINS);
+		float v = spectrum[k] - sum / width;
+		residual[k] = (v > 0.0f) ? v : 0.0f;
+		if (k >= first && k <= top) total += residual[k];
+	}
+	memset(taken, 0, candidates);
+	tries = 0;
+	nfound = 0;
+	searching = true;
+}
+
+// Find one note, and remove it from the residual spectrum
+void AudioAnalyzeMultiPitch::search(void)
+{
+	const float *x = spectrum;
+	float *r = residual;
+	int first, last;
+
+	if (nfound >= max_notes || tries >= MAX_TRIES || total <= 0.0f) {
+		__disable_irq();
+		for (int i=0; i < nfound; i++) {
+			note_freq[i] = search_freq[i];
+			note_conf[i] = search_conf[i];
+		}
+		found = nfound;
+		__enable_irq();
+		searching = false;
+		new_notes = true;
+		return;
+	}
+	tries++;
+
+	// the strongest candidate
+	float best = 0.0f, f0 = lowest;
+	int note = -1;
+	for (int i=0; i < candidates; i++) {
+		if (!taken[i]) {
+			float s = salience(f0);
+			if (s > best) {
+				best = s;
+				note = i;
+			}
+		}
+		f0 *= STEP_RATIO;
+	}
+	if (note < 0) {
+		tries = MAX_TRIES;
+		return;
+	}
+	taken[note] = 1;
+	f0 = lowest * powf(STEP_RATIO, note);
+
+	// its harmonics, and the frequency from the strongest of them
+	int peak[MULTIPITCH_HARMONICS];
+	float amp[MULTIPITCH_HARMONICS];
+	int nh = 0;
+	float fsum = 0.0f, wsum = 0.0f;
+	for (int h=1; h <= MULTIPITCH_HARMONICS; h++) {
+		harmonic_range(h * f0, &first, &last);
+		if (last > top) break;
+		int k = first;
+		for (int j=first + 1; j <= last; j++) {
+			if (r[j] > r[k]) k = j;
+		}
+		peak[nh] = k;
+		amp[nh] = r[k];
+		nh++;
+		if (h <= 8 && k > 0 && x[k] >= x[k - 1] && x[k] >= x[k + 1]) {
+			// parabolic interpolation between bins
+			float d = x[k - 1] - 2.0f * x[k] + x[k + 1];
+			float offset = (d < 0.0f) ? 0.5f * (x[k - 1] - x[k + 1]) / d : 0.0f;
+			fsum += amp[nh - 1] * (k + offset) * bin_width / h;
+			wsum += amp[nh - 1];
+		}
+	}
+	float freq = (wsum > 0.0f) ? fsum / wsum : f0;
+
+	// remove the harmonics, limited to the average of their neighbors
+	float removed = 0.0f;
+	for (int h=0; h < nh; h++) {
+		float a = amp[h];
+		if (a <= 0.0f) continue;
+		float sum = a, count = 1.0f;
+		if (h > 0) {
+			sum += amp[h - 1];
+			count += 1.0f;
+		}
+		if (h < nh - 1) {
+			sum += amp[h + 1];
+			count += 1.0f;
+		}
+		float smooth = sum / count;
+		float scale = CANCEL_AMOUNT * ((smooth < a) ? smooth / a : 1.0f);
+		for (int k=peak[h] - 2; k <= peak[h] + 2; k++) {
+			if (k < 0) continue;
+			float d = r[k] * scale;
+			r[k] -= d;
+			removed += d;
+		}
+	}
+	float confidence = removed / total;
+
+	// what is left of a note already found, or a mix of other notes
+	bool repeat = freq < f0 * TOLERANCE_DOWN * TOLERANCE_DOWN ||
+		freq > f0 * TOLERANCE_UP * TOLERANCE_UP;
+	for (int i=0; i < nfound; i++) {
+		if (freq > search_freq[i] * 0.9715319f && freq < search_freq[i] * 1.0293022f) {
+			repeat = true;
+		}
+	}
+	// a note needs its fundamental, or it is probably harmonics of others
+	float strongest = 0.0f;
+	for (int h=0; h < nh && h < 4; h++) {
+		if (amp[h] > strongest) strongest = amp[h];
+	}
+	if (repeat || nh == 0 || amp[0] < 0.25f * strongest) return;
+	if (confidence < min_confidence) {
+		tries = MAX_TRIES;
+		return;
+	}
+	search_freq[nfound] = freq;
+	search_conf[nfound] = (confidence < 1.0f) ? confidence : 1.0f;
+	nfound++;
+}
+
+void AudioAnalyzeMultiPitch::update(void)
+{
+	AudioAnalyzeFFTBase::update();
+	if (searching) search();
+}
@@ -0,0 +1,138 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef analyze_multipitch_h_
+#define analyze_multipitch_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "analyze_fft.h"
+
+// Detects up to 8 simultaneous notes, such as the strings of a chord,
+// from one 4096 point FFT.  Each candidate note is scored by summing the
+// weighted peaks at its harmonics.  The best note is taken, its harmonics
+// are removed from the spectrum, and the search repeats until maxNotes()
+// are found or the next note explains too little of the spectrum.
+//
+// Needs a floating point unit, Teensy 3.5, 3.6 or 4.x.  The FFT is spread
+// over several updates (distributeWork), and each update searches for one
+// note, so no update takes much more time than the others.  New notes
+// are available every 16 updates (46 ms), or as set by overlap(), about
+// 10 updates after the last of their samples.  The spectrum may still be
+// read, like AudioAnalyzeFFT<4096, float>.
+
+#define AUDIO_MULTIPITCH_MAX_NOTES 8
+
+// Number of 32 bit words for the memory given to the constructor.  The
+// buffers are allocated with malloc() when no memory is given.  Like
+// AudioAnalyzeFFT<4096>, it also holds 32 blocks of the AudioMemory()
+// pool, the last 4096 samples.
+#define AUDIO_MULTIPITCH_MEMORY AUDIO_FFT_MEMORY(4096, float)
+
+// Harmonics up to 2 kHz are used, plus the bins for the noise floor
+#define MULTIPITCH_MAX_FREQ	2000.0f
+#define MULTIPITCH_BINS		((int)(MULTIPITCH_MAX_FREQ * 4096.0f / AUDIO_SAMPLE_RATE_EXACT) + 8)
+
+class AudioAnalyzeMultiPitch : public AudioAnalyzeFFTBase
+{
+public:
+	AudioAnalyzeMultiPitch(void *memory = NULL) : AudioAnalyzeFFTBase(4096, true,
+	  blocklistArray, inputQueueArray, memory), low_note(40), high_note(88),
+	  max_notes(6), min_confidence(0.02f), found(0), searching(false),
+	  new_notes(false) {
+		distributeWork(true);
+	}
+	// True when a new set of notes has been found, which may be none
+	bool available() {
+		if (new_notes) {
+			new_notes = false;
+			return true;
+		}
+		return false;
+	}
+	// MIDI note numbers of the lowest and highest notes, default 40 (E2,
+	// 82.4 Hz) to 88 (E6, 1319 Hz).  Notes below 28 (E1) are not resolved.
+	void noteRange(uint8_t lowNote, uint8_t highNote) {
+		if (lowNote < 28) lowNote = 28;
+		if (highNote > 108) highNote = 108;
+		if (highNote < lowNote) highNote = lowNote;
+		__disable_irq();
+		low_note = lowNote;
+		high_note = highNote;
+		__enable_irq();
+	}
+	// Most notes to report, 1 to 8, default 6
+	void maxNotes(unsigned int n) {
+		if (n < 1) n = 1;
+		if (n > AUDIO_MULTIPITCH_MAX_NOTES) n = AUDIO_MULTIPITCH_MAX_NOTES;
+		max_notes = n;
+	}
+	// Lowest confidence for a note to be reported, default 0.02
+	void threshold(float level) {
+		min_confidence = level;
+	}
+	// Copy the notes found in the latest spectrum, strongest first.
+	// Confidence is the fraction of the spectrum explained by the note.
+	unsigned int readNotes(float *frequency, float *confidence = NULL) {
+		__disable_irq();
+		unsigned int n = found;
+		for (unsigned int i=0; i < n; i++) {
+			frequency[i] = note_freq[i];
+			if (confidence) confidence[i] = note_conf[i];
+		}
+		__enable_irq();
+		return n;
+	}
+	virtual void update(void);
+protected:
+	virtual void analyze(void);
+private:
+	void search(void);
+	float salience(float f0);
+	float spectrum[MULTIPITCH_BINS];	// compressed magnitude
+	float residual[MULTIPITCH_BINS];	// less the noise floor and notes found
+	float total;
+	float lowest;
+	uint8_t taken[(108 - 28 + 1) * 4];
+	uint16_t candidates;
+	uint8_t tries;
+	uint8_t nfound;		// notes found by the search so far
+	float search_freq[AUDIO_MULTIPITCH_MAX_NOTES];
+	float search_conf[AUDIO_MULTIPITCH_MAX_NOTES];
+	float note_freq[AUDIO_MULTIPITCH_MAX_NOTES];
+	float note_conf[AUDIO_MULTIPITCH_MAX_NOTES];
+	uint8_t low_note;
+	uint8_t high_note;
+	uint8_t max_notes;
+	float min_confidence;
+	uint8_t found;
+	bool searching;
+	volatile bool new_notes;
+	audio_block_t *blocklistArray[4096 / AUDIO_BLOCK_SAMPLES];
+	audio_block_t *inputQueueArray[1];
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include "analyze_notefreq.h"
 #include "utility/dspinst.h"
 #include "arm_math.h"
+#include "FFTSpectrum.h"
 
 #define HALF_BLOCKS AUDIO_GUITARTUNER_BLOCKS * 64
 
@@ -84,13 +85,16 @@ void AudioAnalyzeNoteFrequency::update( void ) {
 /**
  *  Start the Yin algorithm
  *
- *  TODO: Significant speed up would be to use spectral domain to find fundamental frequency.
- *  This paper explains: https://aubio.org/phd/thesis/brossier06thesis.pdf -> Section 3.2.4
- *  page 79. Might have to downsample for low fundmental frequencies because of fft buffer
- *  size limit.
+ *  The spectral domain version, from https://aubio.org/phd/thesis/brossier06thesis.pdf
+ *  Section 3.2.4 page 79, is process_fft(), used with begin( threshold, NOTEFREQ_FFT ).
  */
 void AudioAnalyzeNoteFrequency::process( void ) {
     
+    if ( algorithm != NOTEFREQ_YIN ) {
+        process_fft( );
+        return;
+    }
+    
     const int16_t *p;
     p = AudioBuffer;
     
@@ -155,6 +159,181 @@ void AudioAnalyzeNoteFrequency::process( void ) {
     tau_global = tau;
 }
 
+/**
+ *  Real FFT of "size" samples, as a size / 2 complex FFT of the even and
+ *  odd samples, split into the spectrum of the real signal.  data[0] is
+ *  DC and data[1] is Nyquist, then bins 1 to size / 2 - 1.
+ *
+ *  @param fft  complex FFT of size / 2
+ *  @param data samples, replaced by the spectrum
+ *  @param size number of samples
+ */
+static void real_fft( const arm_cfft_radix2_instance_f32 *fft, float *data, uint16_t size ) {
+    const int M = size / 2;
+    const uint32_t step = FFT_SINE_TABLE_SIZE / size;
+    arm_cfft_radix2_f32( fft, data );
+    float z0r = data[0], z0i = data[1];
+    data[0] = z0r + z0i;
+    data[1] = z0r - z0i;
+    for ( int k = 1; k <= M/2; k++ ) {
+        float *a = data + k * 2;
+        float *b = data + ( M - k ) * 2;
+        float c = fft_cos( k * step ) * ( 1.0f / 2147483648.0f );
+        float s = fft_sin( k * step ) * ( 1.0f / 2147483648.0f );
+        // spectra of the even and odd samples
+        float er = 0.5f * ( a[0] + b[0] ), ei = 0.5f * ( a[1] - b[1] );
+        float or_ = 0.5f * ( a[1] + b[1] ), oi = 0.5f * ( b[0] - a[0] );
+        float wr = c * or_ + s * oi, wi = c * oi - s * or_;
+        a[0] = er + wr;
+        a[1] = ei + wi;
+        b[0] = er - wr;
+        b[1] = wi - ei;
+    }
+}
+
+/**
+ *  Inverse of real_fft(), including the 1/N scaling
+ *
+ *  @param ifft inverse complex FFT of size / 2
+ *  @param data spectrum, replaced by the samples
+ *  @param size number of samples
+ */
+static void inverse_real_fft( const arm_cfft_radix2_instance_f32 *ifft, float *data, uint16_t size ) {
+    const int M = size / 2;
+    const uint32_t step = FFT_SINE_TABLE_SIZE / size;
+    float dc = data[0], nyquist = data[1];
+    data[0] = 0.5f * ( dc + nyquist );
+    data[1] = 0.5f * ( dc - nyquist );
+    for ( int k = 1; k <= M/2; k++ ) {
+        float *a = data + k * 2;
+        float *b = data + ( M - k ) * 2;
+        float c = fft_cos( k * step ) * ( 1.0f / 2147483648.0f );
+        float s = fft_sin( k * step ) * ( 1.0f / 2147483648.0f );
+        float er = 0.5f * ( a[0] + b[0] ), ei = 0.5f * ( a[1] - b[1] );
+        float gr = 0.5f * ( a[0] - b[0] ), gi = 0.5f * ( a[1] + b[1] );
+        float or_ = gr * c - gi * s, oi = gr * s + gi * c;
+        a[0] = er - oi;
+        a[1] = ei + or_;
+        b[0] = er + oi;
+        b[1] = or_ - ei;
+    }
+    arm_cfft_radix2_f32( ifft, data );
+}
+
+/**
+ *  The spectral approach mentioned above.  The YIN difference function
+ *  is d(tau) = e0 + e(tau) - 2 * r(tau), where e0 and e(tau) are the energy
+ *  of the samples at x and x+tau, and r(tau) is their cross correlation.
+ *  r(tau) for every tau comes from one FFT of each and an inverse FFT, and
+ *  e(tau) is a running sum.  The same x (every 4th sample of the first
+ *  half) and the same search as process() are used, so the results are
+ *  the same except for floating point rounding.  Each step runs in its
+ *  own update, the last searches for the period.
+ */
+void AudioAnalyzeNoteFrequency::process_fft( void ) {
+    
+    const uint16_t stride = ( algorithm == NOTEFREQ_FFT_DECIMATED ) ? 2 : 4;
+    const uint16_t n = AUDIO_GUITARTUNER_BLOCKS * 128 / ( 4 / stride );
+    const uint16_t half = n / 2;
+    float *a = fft_buffer;
+    float *p = fft_buffer + fft_size;
+    int16_t *x = AudioBuffer;
+    
+    switch ( fft_state++ ) {
+        case 0:
+            if ( algorithm == NOTEFREQ_FFT_DECIMATED ) {
+                // halfband lowpass filter, keeping every 2nd sample
+                for ( int i = 0; i < n; i++ ) {
+                    int j = i * 2;
+                    int32_t sum = 6 * x[j] + 4 * x[j + 1];
+                    if ( j >= 1 ) sum += 4 * x[j - 1];
+                    if ( j >= 2 ) sum += x[j - 2];
+                    if ( j + 2 < n * 2 ) sum += x[j + 2];
+                    a[i] = sum >> 4;
+                }
+                for ( int i = 0; i < n; i++ ) x[i] = a[i];
+            }
+            // only every stride'th sample, so the spectrum repeats every
+            // fft_size / stride bins, and a smaller FFT is enough
+            for ( int i = 0; i < fft_size / stride; i++ ) {
+                a[i] = ( i < half / stride ) ? x[i * stride] : 0.0f;
+            }
+            real_fft( &sparse_fft_inst, a, fft_size / stride );
+            return;
+        case 1:
+            for ( int i = 0; i < fft_size; i++ ) {
+                p[i] = ( i < n ) ? x[i] : 0.0f;
+            }
+            real_fft( &fft_inst, p, fft_size );
+            return;
+        case 2: {
+            // cross correlation, conj(A) * P, DC and Nyquist are real
+            const int q = fft_size / stride;
+            p[0] *= a[0];
+            p[1] *= a[0];
+            for ( int k = 1; k < fft_size / 2; k++ ) {
+                int j = k & ( q - 1 );
+                float ar, ai;
+                if ( j == 0 ) {
+                    ar = a[0];
+                    ai = 0.0f;
+                } else if ( j == q / 2 ) {
+                    ar = a[1];
+                    ai = 0.0f;
+                } else if ( j < q / 2 ) {
+                    ar = a[j * 2];
+                    ai = a[j * 2 + 1];
+                } else {
+                    ar = a[( q - j ) * 2];
+                    ai = -a[( q - j ) * 2 + 1];
+                }
+                float pr = p[k * 2], pi = p[k * 2 + 1];
+                p[k * 2]     = ar * pr + ai * pi;
+                p[k * 2 + 1] = ar * pi - ai * pr;
+            }
+            inverse_real_fft( &ifft_inst, p, fft_size );
+            return;
+        }
+    }
+    
+    // e(tau) for each tau modulo stride, updated as tau increases
+    uint64_t e[4];
+    for ( int r = 0; r < stride; r++ ) {
+        uint64_t sum = 0;
+        for ( int m = 0; m < half; m += stride ) sum += x[m + r] * x[m + r];
+        e[r] = sum;
+    }
+    const uint64_t e0 = e[0];
+    // the same test as estimate(), but each s(tau) is computed only once
+    uint64_t rs = 0;
+    float s0 = 0.0f, s1 = 0.0f, s2;
+    for ( uint16_t tau = 1; tau <= half - 2; tau++ ) {
+        uint64_t *er = e + ( tau & ( stride - 1 ) );
+        if ( tau >= stride ) {
+            int32_t out = x[tau - stride], in = x[tau - stride + half];
+            *er = *er + in * in - out * out;
+        }
+        float d = ( float )( e0 + *er ) - 2.0f * p[tau];
+        uint64_t sum = ( d > 0.0f ) ? ( uint64_t )( d + 0.5f ) : 0;
+        rs += sum;
+        s2 = ( float )( sum * tau ) / rs;
+        if ( tau > 2 && s1 < yin_threshold && s1 < s2 ) {
+            periodicity = 1 - s1;
+            data = ( tau - 1 ) + 0.5f * ( s0 - s2 ) / ( s0 - 2.0f * s1 + s2 );
+            if ( algorithm == NOTEFREQ_FFT_DECIMATED ) data *= 2.0f;
+            process_buffer  = false;
+            new_output      = true;
+            fft_state       = 0;
+            return;
+        }
+        s0 = s1;
+        s1 = s2;
+    }
+    process_buffer  = false;
+    new_output      = false;
+    fft_state       = 0;
+}
+
 /**
  *  check the sampled data for fundamental frequency
  *
@@ -180,7 +359,7 @@ uint16_t AudioAnalyzeNoteFrequency::estimate( uint64_t *yin, uint64_t *rs, uint1
         idx1 = _head + 1;
         idx1 = ( idx1 >= 5 ) ? 0 : idx1;
         idx2 = head + 2;
-        idx2 = ( idx2 >= 5 ) ? 0 : idx2;
+        idx2 = ( idx2 >= 5 ) ? idx2 - 5 : idx2;
         
         float s0, s1, s2;
         s0 = ( ( float )*( y+idx0 ) / *( r+idx0 ) );
@@ -202,8 +381,34 @@ uint16_t AudioAnalyzeNoteFrequency::estimate( uint64_t *yin, uint64_t *rs, uint1
  *
  *  @param threshold Allowed uncertainty
  */
-void AudioAnalyzeNoteFrequency::begin( float threshold ) {
+void AudioAnalyzeNoteFrequency::begin( float threshold, uint8_t method ) {
+    // the FFT size must be a power of 2, at least the number of samples
+    uint16_t size = 0;
+    if ( method == NOTEFREQ_FFT || method == NOTEFREQ_FFT_DECIMATED ) {
+        uint16_t n = AUDIO_GUITARTUNER_BLOCKS * 128;
+        if ( method == NOTEFREQ_FFT_DECIMATED ) n /= 2;
+        for ( size = 256; size < n; size *= 2 ) ;
+    }
+    __disable_irq( );
+    enabled = false;
+    __enable_irq( );
+    if ( size != fft_size ) {
+        free( fft_buffer );
+        fft_buffer = size ? ( float * )malloc( size * 2 * sizeof( float ) ) : NULL;
+        fft_size = fft_buffer ? size : 0;
+    }
+    if ( fft_size ) {
+        arm_cfft_radix2_init_f32( &fft_inst, fft_size / 2, 0, 1 );
+        arm_cfft_radix2_init_f32( &ifft_inst, fft_size / 2, 1, 1 );
+        // every 4th sample, or every 2nd when decimated
+        uint16_t stride = ( method == NOTEFREQ_FFT_DECIMATED ) ? 2 : 4;
+        arm_cfft_radix2_init_f32( &sparse_fft_inst, fft_size / stride / 2, 0, 1 );
+    } else {
+        method = NOTEFREQ_YIN; // not enough memory
+    }
     __disable_irq( );
+    algorithm      = method;
+    fft_state      = 0;
     process_buffer = false;
     yin_threshold  = threshold;
     periodicity    = 0.0f;
@@ -25,6 +25,7 @@
 
 #include "Arduino.h"
 #include "AudioStream.h"
+#include "arm_math.h"
 /***********************************************************************
  *              Safe to adjust these values below                      *
  *                                                                     *
@@ -39,6 +40,37 @@
  ***********************************************************************/
 #define AUDIO_GUITARTUNER_BLOCKS  24
 /***********************************************************************/
+
+/**
+ *  Methods for begin().  The FFT methods compute the same YIN difference
+ *  function, from the autocorrelation by floating point FFT, in 4 steps
+ *  of one update each, so their CPU time is the same for every note.  YIN
+ *  searches from the shortest period up, so it is slow for low notes and
+ *  fast for high notes.
+ *
+ *  NOTEFREQ_FFT_DECIMATED is the fast method for low notes.  It analyzes
+ *  the signal at half the sample rate, for a quarter of YIN's average CPU
+ *  time at 41 Hz, the same at about 200 Hz, and a longest update about
+ *  1.3 times YIN's.  It is only for notes below 1 kHz, and differs from
+ *  YIN by up to 0.5 cent.
+ *
+ *  NOTEFREQ_FFT gives the same results as YIN, within float rounding, but
+ *  it is not faster.  Its average CPU time is below YIN's only for notes
+ *  below about 130 Hz, and its longest update, with the full size FFT, is
+ *  about 2.7 times YIN's.
+ *
+ *  The FFT methods are for Teensy 3.5, 3.6 and 4.x (FPU), and malloc()
+ *  32 kbytes, or 16 kbytes decimated.
+ *
+ *  NOTEFREQ_YIN results may differ from earlier versions of this library.
+ *  estimate() used to wrap its third ring buffer index to 0 instead of
+ *  index - 5, so at one lag in five it tested the wrong neighbour and
+ *  could report an octave error.
+ */
+#define NOTEFREQ_YIN            0  // time domain (default)
+#define NOTEFREQ_FFT            1  // autocorrelation by FFT
+#define NOTEFREQ_FFT_DECIMATED  2  // FFT, at half the sample rate
+
 class AudioAnalyzeNoteFrequency : public AudioStream {
 public:
     /**
@@ -46,7 +78,7 @@ public:
      *
      *  @return none
      */
-    AudioAnalyzeNoteFrequency( void ) : AudioStream( 1, inputQueueArray ), enabled( false ), new_output(false) {
+    AudioAnalyzeNoteFrequency( void ) : AudioStream( 1, inputQueueArray ), fft_buffer( NULL ), fft_size( 0 ), enabled( false ), new_output(false) {
         
     }
     
@@ -54,11 +86,11 @@ public:
      *  initialize variables and start conversion
      *
      *  @param threshold Allowed uncertainty
-     *  @param cpu_max   How much cpu usage before throttling
+     *  @param method    NOTEFREQ_YIN, NOTEFREQ_FFT or NOTEFREQ_FFT_DECIMATED
      *
      *  @return none
      */
-    void begin( float threshold );
+    void begin( float threshold, uint8_t method = NOTEFREQ_YIN );
     
     /**
      *  sets threshold value
@@ -115,6 +147,13 @@ private:
      */
     void process( void );
     
+    /**
+     *  process audio data with the FFT, one step per call
+     *
+     *  @return none
+     */
+    void process_fft( void );
+    
     /**
      *  Variables
      */
@@ -123,6 +162,10 @@ private:
     uint64_t  yin_buffer[5];
     uint64_t  rs_buffer[5];
     int16_t  AudioBuffer[AUDIO_GUITARTUNER_BLOCKS*128] __attribute__ ( ( aligned ( 4 ) ) );
+    float    *fft_buffer;
+    uint16_t fft_size;
+    uint8_t  algorithm, fft_state;
+    arm_cfft_radix2_instance_f32 fft_inst, ifft_inst, sparse_fft_inst;
     uint8_t  yin_idx, state;
     float    periodicity, yin_threshold, cpu_usage_max, data;
     bool     enabled, next_buffer, first_run;
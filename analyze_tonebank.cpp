@@ -0,0 +1,314 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "analyze_tonebank.h"
+#include "utility/dspinst.h"
+
+// DTMF checks, power ratios for 8 dB and 4 dB
+#define DTMF_NORMAL_TWIST	6.31f	// column tone weaker than row tone
+#define DTMF_REVERSE_TWIST	2.51f	// column tone stronger than row tone
+#define DTMF_RELATIVE_PEAK	6.31f	// over the other tones of its group
+#define DTMF_TO_TOTAL_ENERGY	0.75f	// 2 tones of all the signal energy
+
+static const float dtmf_freqs[8] = {
+	697.0f, 770.0f, 852.0f, 941.0f, 1209.0f, 1336.0f, 1477.0f, 1633.0f
+};
+
+static const char dtmf_keys[16] = {
+	'1', '2', '3', 'A',
+	'4', '5', '6', 'B',
+	'7', '8', '9', 'C',
+	'*', '0', '#', 'D'
+};
+
+// Goertzel power, (level * 16384 * length) squared
+static float goertzel_power(int32_t coef, int32_t q1, int32_t q2)
+{
+	int64_t power64;
+
+	power64 = (int64_t)q2 * (int64_t)q2;
+	power64 += (int64_t)q1 * (int64_t)q1;
+	power64 -= (((int64_t)q1 * (int64_t)q2) >> 30) * (int64_t)coef;
+	return (float)power64;
+}
+
+void AudioAnalyzeToneBank::frequency(unsigned int index, float freq)
+{
+	int32_t coef;
+
+	if (index >= AUDIO_TONEBANK_MAX_TONES) return;
+	coef = cos((double)freq * (2.0 * 3.14159265358979323846
+	  / AUDIO_SAMPLE_RATE_EXACT)) * (double)2147483647.999;
+	__disable_irq();
+	while (ntones <= index) {
+		tone[ntones++].coef = 0;
+	}
+	tone[index].coef = coef;
+	// restart the interval, so all tones give their next result together
+	for (unsigned int i=0; i < ntones; i++) {
+		tone[i].s1 = 0;
+		tone[i].s2 = 0;
+	}
+	sum_squares = 0;
+	count = length;
+	__enable_irq();
+}
+
+void AudioAnalyzeToneBank::duration(float milliseconds)
+{
+	if (milliseconds < 0.1f) milliseconds = 0.1f;
+	else if (milliseconds > 100.0f) milliseconds = 100.0f;
+	// the update processes 2 samples at a time
+	uint16_t len = (int)(milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 2000.0f)
+	  + 0.5f) * 2;
+	if (len < 2) len = 2;
+	__disable_irq();
+	length = len;
+	count = len;
+	for (unsigned int i=0; i < ntones; i++) {
+		tone[i].s1 = 0;
+		tone[i].s2 = 0;
+	}
+	sum_squares = 0;
+	__enable_irq();
+}
+
+void AudioAnalyzeToneBank::dtmf(void)
+{
+	for (int i=0; i < 8; i++) {
+		frequency(i, dtmf_freqs[i]);
+	}
+	// 12.75 ms intervals, as used by Asterisk, separate the tones by
+	// more than 20 dB
+	duration(12.75f);
+	__disable_irq();
+	last_hit = 0;
+	current_key = 0;
+	key_tail = key_head;
+	dtmf_mode = true;
+	__enable_irq();
+}
+
+float AudioAnalyzeToneBank::read(unsigned int index)
+{
+	int32_t coef, q1, q2;
+	uint16_t len;
+
+	if (index >= ntones) return 0.0f;
+	__disable_irq();
+	coef = tone[index].coef;
+	q1 = out1[index];
+	q2 = out2[index];
+	len = length;
+	__enable_irq();
+	return sqrtf(goertzel_power(coef, q1, q2)) / (16384.0f * (float)len);
+}
+
+char AudioAnalyzeToneBank::readKey(void)
+{
+	char key = 0;
+
+	__disable_irq();
+	uint8_t tail = key_tail;
+	if (tail != key_head) {
+		key = keys[tail];
+		key_tail = (tail + 1) & 15;
+	}
+	__enable_irq();
+	return key;
+}
+
+// Called at the end of each interval, after out1 and out2 are updated
+void AudioAnalyzeToneBank::decode_dtmf(int64_t energy)
+{
+	float power[8];
+	int i, row, col;
+	char hit = 0;
+
+	for (i=0; i < 8; i++) {
+		power[i] = goertzel_power(tone[i].coef, out1[i], out2[i]);
+	}
+	row = 0;
+	for (i=1; i < 4; i++) {
+		if (power[i] > power[row]) row = i;
+	}
+	col = 4;
+	for (i=5; i < 8; i++) {
+		if (power[i] > power[col]) col = i;
+	}
+	float level = thresh * 16384.0f * (float)length;
+	level *= level;
+	if (power[row] >= level && power[col] >= level
+	  && power[col] < power[row] * DTMF_REVERSE_TWIST
+	  && power[col] * DTMF_NORMAL_TWIST > power[row]) {
+		for (i=0; i < 8; i++) {
+			if (i == row || i == col) continue;
+			if (power[i] * DTMF_RELATIVE_PEAK > power[i < 4 ? row : col]) break;
+		}
+		// a sine wave of amplitude A has Goertzel power (A * len / 2)^2
+		// and energy A * A * len / 2
+		if (i == 8 && (power[row] + power[col]) * 2.0f / (float)length
+		  >= DTMF_TO_TOTAL_ENERGY * (float)energy) {
+			hit = dtmf_keys[row * 4 + col - 4];
+		}
+	}
+	// report each key once, when found in 2 intervals in a row
+	if (hit == last_hit && hit != current_key) {
+		if (hit) {
+			uint8_t head = (key_head + 1) & 15;
+			if (head != key_tail) {
+				keys[key_head] = hit;
+				key_head = head;
+			}
+		}
+		current_key = hit;
+	}
+	last_hit = hit;
+}
+
+#if defined(__ARM_ARCH_7EM__)
+
+static inline int32_t multiply_32x32_rshift30(int32_t a, int32_t b) __attribute__((always_inline));
+static inline int32_t multiply_32x32_rshift30(int32_t a, int32_t b)
+{
+	return ((int64_t)a * (int64_t)b) >> 30;
+}
+
+// Run the Goertzel filter of 2 tones over n samples, n even.  Each pair of
+// samples is read with one 32 bit load, and the newest state alternates
+// between a1 and a2, so no state needs to be copied.
+static void goertzel_pair(tonebank_state_t *tone1, tonebank_state_t *tone2,
+	const int16_t *data, unsigned int n)
+{
+	const uint32_t *p = (const uint32_t *)data;
+	const uint32_t *end = p + n / 2;
+	int32_t a1, a2, b1, b2;
+	const int32_t ca = tone1->coef, cb = tone2->coef;
+
+	a1 = tone1->s1;
+	a2 = tone1->s2;
+	b1 = tone2->s1;
+	b2 = tone2->s2;
+	while (p < end) {
+		uint32_t in = *p++;
+		int32_t x0 = (int16_t)in;
+		int32_t x1 = (int32_t)in >> 16;
+		a2 = x0 + multiply_32x32_rshift30(ca, a1) - a2;
+		b2 = x0 + multiply_32x32_rshift30(cb, b1) - b2;
+		a1 = x1 + multiply_32x32_rshift30(ca, a2) - a1;
+		b1 = x1 + multiply_32x32_rshift30(cb, b2) - b1;
+	}
+	tone1->s1 = a1;
+	tone1->s2 = a2;
+	tone2->s1 = b1;
+	tone2->s2 = b2;
+}
+
+static void goertzel_single(tonebank_state_t *tone, const int16_t *data, unsigned int n)
+{
+	const uint32_t *p = (const uint32_t *)data;
+	const uint32_t *end = p + n / 2;
+	int32_t a1, a2;
+	const int32_t ca = tone->coef;
+
+	a1 = tone->s1;
+	a2 = tone->s2;
+	while (p < end) {
+		uint32_t in = *p++;
+		a2 = (int16_t)in + multiply_32x32_rshift30(ca, a1) - a2;
+		a1 = ((int32_t)in >> 16) + multiply_32x32_rshift30(ca, a2) - a1;
+	}
+	tone->s1 = a1;
+	tone->s2 = a2;
+}
+
+// Sum of the squares of n samples, n even, 2 at a time with SMLALD
+static int64_t sum_of_squares(int64_t sum, const int16_t *data, unsigned int n)
+{
+	const uint32_t *p = (const uint32_t *)data;
+	const uint32_t *end = p + n / 2;
+
+	while (p < end) {
+		uint32_t in = *p++;
+		sum = multiply_accumulate_16tx16t_add_16bx16b(sum, in, in);
+	}
+	return sum;
+}
+
+void AudioAnalyzeToneBank::update(void)
+{
+	audio_block_t *block;
+	const int16_t *p, *end;
+	unsigned int i, n;
+
+	block = receiveReadOnly();
+	if (!block) return;
+	if (ntones == 0) {
+		release(block);
+		return;
+	}
+	p = block->data;
+	end = p + AUDIO_BLOCK_SAMPLES;
+	do {
+		// process up to the end of the block or the interval
+		n = end - p;
+		if (n > count) n = count;
+		for (i=0; i + 1 < ntones; i += 2) {
+			goertzel_pair(&tone[i], &tone[i + 1], p, n);
+		}
+		if (i < ntones) goertzel_single(&tone[i], p, n);
+		if (dtmf_mode) sum_squares = sum_of_squares(sum_squares, p, n);
+		p += n;
+		count -= n;
+		if (count == 0) {
+			for (i=0; i < ntones; i++) {
+				out1[i] = tone[i].s1;
+				out2[i] = tone[i].s2;
+				tone[i].s1 = 0;
+				tone[i].s2 = 0;
+			}
+			if (dtmf_mode) {
+				decode_dtmf(sum_squares);
+				sum_squares = 0;
+			}
+			new_output = true;
+			count = length;
+		}
+	} while (p < end);
+	release(block);
+}
+
+#elif defined(KINETISL)
+
+void AudioAnalyzeToneBank::update(void)
+{
+	audio_block_t *block;
+	block = receiveReadOnly();
+	if (block) release(block);
+}
+
+#endif
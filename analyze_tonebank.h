@@ -0,0 +1,108 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef analyze_tonebank_h_
+#define analyze_tonebank_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+// Measures the level of up to 32 tones, like many AudioAnalyzeToneDetect,
+// with one pass over each block.  The Goertzel filters are updated in
+// pairs, so each sample is read once for 2 tones, and all tones use the
+// same detection interval, set with duration().  In dtmf() mode, the 8
+// DTMF tones are checked after each interval and the keys pressed are
+// given by readKey().
+
+#define AUDIO_TONEBANK_MAX_TONES 32
+
+// State of one tone's Goertzel filter, kept together so each tone's
+// update reads one small piece of memory
+typedef struct tonebank_state_struct {
+	int32_t coef;		// Goertzel algorithm coefficient
+	int32_t s1, s2;		// Goertzel algorithm state
+} tonebank_state_t;
+
+class AudioAnalyzeToneBank : public AudioStream
+{
+public:
+	AudioAnalyzeToneBank(void) : AudioStream(1, inputQueueArray),
+	  sum_squares(0), ntones(0), length(1102), count(1102), thresh(0.1f),
+	  dtmf_mode(false), last_hit(0), current_key(0), key_head(0),
+	  key_tail(0), new_output(false) { }
+	// Set the frequency of one tone.  Use indexes 0, 1, 2, ... without
+	// gaps, as every tone up to the highest index set is measured.
+	void frequency(unsigned int index, float freq);
+	// Detection interval for all tones, default 25 ms, up to 100 ms.
+	// Longer is more precise, but slower to respond.  Loud tones below
+	// 250 Hz may overflow the filters with intervals near 100 ms.
+	void duration(float milliseconds);
+	// Detect the 8 DTMF tones, with 12.75 ms intervals.  Keys are found
+	// when 2 intervals in a row have the same pair of tones, with no
+	// other tones or noise.
+	void dtmf(void);
+	bool available(void) {
+		__disable_irq();
+		bool flag = new_output;
+		if (flag) new_output = false;
+		__enable_irq();
+		return flag;
+	}
+	// Level of a tone in the last interval, 0 to 1.0
+	float read(unsigned int index);
+	// Minimum level of a tone, for detected() and the DTMF tones
+	void threshold(float level) {
+		if (level < 0.001f) level = 0.001f;
+		else if (level > 0.99f) level = 0.99f;
+		thresh = level;
+	}
+	bool detected(unsigned int index) {
+		return read(index) >= thresh;
+	}
+	// Next DTMF key, '0' to '9', '*', '#' or 'A' to 'D', or 0 if none
+	char readKey(void);
+	virtual void update(void);
+private:
+	void decode_dtmf(int64_t energy);
+	tonebank_state_t tone[AUDIO_TONEBANK_MAX_TONES];
+	int32_t out1[AUDIO_TONEBANK_MAX_TONES];	// state at end of interval
+	int32_t out2[AUDIO_TONEBANK_MAX_TONES];
+	int64_t sum_squares;	// signal energy, dtmf mode only
+	uint16_t ntones;
+	uint16_t length;	// number of samples to analyze, always even
+	uint16_t count;		// how many left to analyze
+	float thresh;
+	bool dtmf_mode;
+	char last_hit;		// key found in the previous interval
+	char current_key;	// key being pressed, already reported
+	char keys[16];		// keys found, not yet read
+	volatile uint8_t key_head;
+	volatile uint8_t key_tail;
+	volatile bool new_output;
+	audio_block_t *inputQueueArray[1];
+};
+
+#endif
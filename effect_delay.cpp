@@ -27,64 +27,306 @@
 #include <Arduino.h>
 #include "effect_delay.h"
 
-void AudioEffectDelay::update(void)
+// One sample from the queue, r is its index counted from the start of
+// the newest block, 127 or less
+static inline int32_t queue_sample(audio_block_t * const *queue, uint32_t head, int32_t r)
+{
+	uint32_t back = (AUDIO_BLOCK_SAMPLES - 1 - r) / AUDIO_BLOCK_SAMPLES;
+	int32_t index = head - back;
+	if (index < 0) index += DELAY_QUEUE_SIZE;
+	const audio_block_t *block = queue[index];
+	return block ? block->data[r + back * AUDIO_BLOCK_SAMPLES] : 0;
+}
+
+static const int16_t zeros[4] = {0, 0, 0, 0};
+
+// The samples from r-2 to r+1, for interpolation, as p[-2] to p[1].
+// Usually p points into a queued block.  Only when they are in 2 blocks
+// are they gathered into tmp.  r+1 is never newer than the newest sample.
+static inline const int16_t * queue_window(audio_block_t * const *queue, uint32_t head,
+	int32_t r, int16_t *tmp)
+{
+	uint32_t back = (AUDIO_BLOCK_SAMPLES - 1 - r) / AUDIO_BLOCK_SAMPLES;
+	int32_t j = r + back * AUDIO_BLOCK_SAMPLES;
+	if (j >= 2 && j < AUDIO_BLOCK_SAMPLES - 1) {
+		int32_t index = head - back;
+		if (index < 0) index += DELAY_QUEUE_SIZE;
+		const audio_block_t *block = queue[index];
+		return block ? block->data + j : zeros + 2;
+	}
+	tmp[0] = queue_sample(queue, head, r - 2);
+	tmp[1] = queue_sample(queue, head, r - 1);
+	tmp[2] = queue_sample(queue, head, r);
+	tmp[3] = (r < AUDIO_BLOCK_SAMPLES - 1) ? queue_sample(queue, head, r + 1) : tmp[2];
+	return tmp + 2;
+}
+
+// The same from the ring buffer, where the newest block starts at head
+static inline int32_t ring_sample(const int16_t *ring, uint32_t length, uint32_t head, int32_t r)
+{
+	int32_t index = head + r;
+	if (index < 0) index += length;
+	else if (index >= (int32_t)length) index -= length;
+	return ring[index];
+}
+
+static inline const int16_t * ring_window(const int16_t *ring, uint32_t length, uint32_t head,
+	int32_t r, int16_t *tmp)
+{
+	int32_t index = head + r;
+	if (index < 0) index += length;
+	else if (index >= (int32_t)length) index -= length;
+	if (index >= 2 && index < (int32_t)length - 1) return ring + index;
+	tmp[0] = ring_sample(ring, length, head, r - 2);
+	tmp[1] = ring_sample(ring, length, head, r - 1);
+	tmp[2] = ring[index];
+	tmp[3] = (r < AUDIO_BLOCK_SAMPLES - 1) ? ring_sample(ring, length, head, r + 1) : tmp[2];
+	return tmp + 2;
+}
+
+// A tap with a fractional, gliding or modulated delay.  Samples are read
+// directly from the queued blocks or the ring buffer, so nothing is
+// copied.  The delay ramps linearly from "from" to "to" across the
+// block, plus input 1 times the modulation depth.
+void AudioEffectDelay::fractional_tap(uint32_t channel, uint32_t head, uint32_t from,
+	uint32_t to, const audio_block_t *mod)
 {
 	audio_block_t *output;
-	uint32_t head, tail, count, channel, index, prev, offset;
-	const int16_t *src, *end;
-	int16_t *dst;
+	const int mode = interp[channel];
+	const int32_t depth = mod ? moddepth[channel] : 0;
+	const int16_t *buffer = ring;
+	const uint32_t length = ringlength;
+	// the oldest sample kept, leaving 2 for cubic interpolation
+	const int32_t limit = buffer ? maxdelay << DELAY_FRACTION_BITS :
+		(AUDIO_BLOCK_SAMPLES * maxblocks - 130) << DELAY_FRACTION_BITS;
+	const int32_t step = ((int32_t)(to - from)) / AUDIO_BLOCK_SAMPLES;
+	int32_t y = allpass[channel];
+	int16_t tmp[4];
 
-	// grab incoming data and put it into the queue
-	head = headindex;
-	tail = tailindex;
-	if (++head >= DELAY_QUEUE_SIZE) head = 0;
-	if (head == tail) {
-		if (queue[tail] != NULL) release(queue[tail]);
-		if (++tail >= DELAY_QUEUE_SIZE) tail = 0;
+	output = allocate();
+	if (!output) return;
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t age = from + step * (i + 1);
+		if (depth) {
+			// the delay and the depth may each be up to maxdelay, so
+			// their sum may not fit in 32 bits
+			int64_t sum = age + (((int64_t)mod->data[i] * depth) >> 15);
+			age = (sum > limit) ? limit : sum;
+		}
+		if (age > limit) age = limit;
+		if (age < 0) age = 0;
+		if (mode == DELAY_INTERPOLATION_NONE) {
+			int32_t n = (age + (1 << (DELAY_FRACTION_BITS - 1))) >> DELAY_FRACTION_BITS;
+			output->data[i] = buffer ? ring_sample(buffer, length, head, i - n) :
+				queue_sample(queue, head, i - n);
+			continue;
+		}
+		int32_t n = age >> DELAY_FRACTION_BITS;
+		int32_t frac = age & ((1 << DELAY_FRACTION_BITS) - 1);
+		const int16_t *p = buffer ? ring_window(buffer, length, head, i - n, tmp) :
+			queue_window(queue, head, i - n, tmp);
+		int32_t out;
+		if (mode == DELAY_INTERPOLATION_LINEAR) {
+			out = p[0] + (((p[-1] - p[0]) * frac) >> DELAY_FRACTION_BITS);
+		} else if (mode == DELAY_INTERPOLATION_ALLPASS) {
+			// first order allpass, with the fraction kept from 0.5 to
+			// 1.5 so its pole stays well inside the unit circle
+			if (frac < (1 << (DELAY_FRACTION_BITS - 1)) && n > 0) {
+				frac += 1 << DELAY_FRACTION_BITS;
+				p++;
+			}
+			int32_t eta = ((1 << DELAY_FRACTION_BITS) - frac) * 32768
+				/ ((1 << DELAY_FRACTION_BITS) + frac);
+			// y is kept unclamped, for the recursion
+			y = p[-1] + (int32_t)(((int64_t)(p[0] - y) * eta) >> 15);
+			out = y;
+		} else {
+			// Catmull-Rom spline through the 4 nearest samples
+			int32_t p0 = (n > 0) ? p[1] : p[0];
+			int32_t p1 = p[0];
+			int32_t p2 = p[-1];
+			int32_t p3 = p[-2];
+			int32_t c1 = p2 - p0;
+			int32_t c2 = 2 * p0 - 5 * p1 + 4 * p2 - p3;
+			int32_t c3 = 3 * (p1 - p2) + p3 - p0;
+			int64_t t = ((int64_t)c3 * frac) >> DELAY_FRACTION_BITS;
+			t = (((t + c2) * frac) >> DELAY_FRACTION_BITS) + c1;
+			out = p1 + (int32_t)((t * frac) >> (DELAY_FRACTION_BITS + 1));
+		}
+		// allpass and cubic overshoot on transients
+		if (out > 32767) out = 32767;
+		else if (out < -32768) out = -32768;
+		output->data[i] = out;
 	}
-	queue[head] = receiveReadOnly();
-	headindex = head;
-
-	// testing only.... don't allow null pointers into the queue
-	// instead, fill the empty times with blocks of zeros
-	//if (queue[head] == NULL) {
-	//	queue[head] = allocate();
-	//	if (queue[head]) {
-	//		dst = queue[head]->data;
-	//		end = dst + AUDIO_BLOCK_SAMPLES;
-	//		do {
-	//			*dst++ = 0;
-	//		} while (dst < end);
-	//	} else {
-	//		digitalWriteFast(2, HIGH);
-	//		delayMicroseconds(5);
-	//		digitalWriteFast(2, LOW);
-	//	}
-	//}
-
-	// discard unneeded blocks from the queue
-	if (head >= tail) {
-		count = head - tail;
+	allpass[channel] = y;
+	transmit(output, channel);
+	release(output);
+}
+
+// A whole sample delay from the ring buffer, in 1 or 2 pieces
+void AudioEffectDelay::ring_tap(uint32_t channel, uint32_t head, uint32_t samples)
+{
+	audio_block_t *output;
+	uint32_t index, n;
+
+	output = allocate();
+	if (!output) return;
+	index = (head >= samples) ? head - samples : head + ringlength - samples;
+	n = ringlength - index;
+	if (n >= AUDIO_BLOCK_SAMPLES) {
+		memcpy(output->data, ring + index, AUDIO_BLOCK_SAMPLES * 2);
 	} else {
-		count = DELAY_QUEUE_SIZE + head - tail;
+		memcpy(output->data, ring + index, n * 2);
+		memcpy(output->data + n, ring, (AUDIO_BLOCK_SAMPLES - n) * 2);
 	}
-	if (count > maxblocks) {
-		count -= maxblocks;
-		do {
-			if (queue[tail] != NULL) {
-				release(queue[tail]);
-				queue[tail] = NULL;
-			}
+	transmit(output, channel);
+	release(output);
+}
+
+// Shorten any delay longer than maxdelay, interrupts must be disabled
+void AudioEffectDelay::limit_delays(void)
+{
+	const uint32_t max = maxdelay << DELAY_FRACTION_BITS;
+
+	for (int i=0; i < 8; i++) {
+		if (position[i] > max) position[i] = max;
+		if (target[i] > max) target[i] = max;
+		if (moddepth[i] > max) moddepth[i] = max;
+	}
+}
+
+bool AudioEffectDelay::begin(int16_t *buffer, uint32_t length)
+{
+	if (!buffer || length < AUDIO_BLOCK_SAMPLES * 2) return false;
+	memset(buffer, 0, length * 2);
+	__disable_irq();
+	ring = buffer;
+	ringlength = length;
+	ringindex = 0;
+	// the newest block and 2 samples for cubic interpolation can not be
+	// delayed, and delays are kept in 32 bits with 12 fraction bits
+	maxdelay = length - AUDIO_BLOCK_SAMPLES - 3;
+	if (maxdelay > 524287) maxdelay = 524287;
+	limit_delays();
+	__enable_irq();
+	// update() no longer uses the queue, so its blocks can be freed
+	for (uint32_t i=0; i < DELAY_QUEUE_SIZE; i++) {
+		if (queue[i]) {
+			release(queue[i]);
+			queue[i] = NULL;
+		}
+	}
+	recompute_maxblocks();
+	return true;
+}
+
+void AudioEffectDelay::end(void)
+{
+	__disable_irq();
+	ring = NULL;
+	ringlength = 0;
+	maxdelay = AUDIO_BLOCK_SAMPLES * (DELAY_QUEUE_SIZE-1) - 3;
+	limit_delays();
+	__enable_irq();
+	recompute_maxblocks();
+}
+
+void AudioEffectDelay::update(void)
+{
+	audio_block_t *output, *mod;
+	uint32_t head, tail, count, channel, index, prev, offset, from, to, samples;
+	const int16_t *src, *end;
+	int16_t *dst;
+
+	if (ring) {
+		// store incoming data in the ring buffer
+		head = ringindex + AUDIO_BLOCK_SAMPLES;
+		if (head >= ringlength) head -= ringlength;
+		ringindex = head;
+		output = receiveReadOnly(0);
+		count = ringlength - head;
+		if (count > AUDIO_BLOCK_SAMPLES) count = AUDIO_BLOCK_SAMPLES;
+		if (output) {
+			memcpy(ring + head, output->data, count * 2);
+			memcpy(ring, output->data + count, (AUDIO_BLOCK_SAMPLES - count) * 2);
+			release(output);
+		} else {
+			memset(ring + head, 0, count * 2);
+			memset(ring, 0, (AUDIO_BLOCK_SAMPLES - count) * 2);
+		}
+	} else {
+		// grab incoming data and put it into the queue
+		head = headindex;
+		tail = tailindex;
+		if (++head >= DELAY_QUEUE_SIZE) head = 0;
+		if (head == tail) {
+			if (queue[tail] != NULL) release(queue[tail]);
 			if (++tail >= DELAY_QUEUE_SIZE) tail = 0;
-		} while (--count > 0);
+		}
+		queue[head] = receiveReadOnly();
+		headindex = head;
+
+		// testing only.... don't allow null pointers into the queue
+		// instead, fill the empty times with blocks of zeros
+		//if (queue[head] == NULL) {
+		//	queue[head] = allocate();
+		//	if (queue[head]) {
+		//		dst = queue[head]->data;
+		//		end = dst + AUDIO_BLOCK_SAMPLES;
+		//		do {
+		//			*dst++ = 0;
+		//		} while (dst < end);
+		//	} else {
+		//		digitalWriteFast(2, HIGH);
+		//		delayMicroseconds(5);
+		//		digitalWriteFast(2, LOW);
+		//	}
+		//}
+
+		// discard unneeded blocks from the queue
+		if (head >= tail) {
+			count = head - tail;
+		} else {
+			count = DELAY_QUEUE_SIZE + head - tail;
+		}
+		if (count > maxblocks) {
+			count -= maxblocks;
+			do {
+				if (queue[tail] != NULL) {
+					release(queue[tail]);
+					queue[tail] = NULL;
+				}
+				if (++tail >= DELAY_QUEUE_SIZE) tail = 0;
+			} while (--count > 0);
+		}
+		tailindex = tail;
 	}
-	tailindex = tail;
 
-	// transmit the delayed outputs using queue data
+	// transmit the delayed outputs using queue or ring buffer data
+	mod = receiveReadOnly(1);
 	for (channel = 0; channel < 8; channel++) {
 		if (!(activemask & (1<<channel))) continue;
-		index =  position[channel] / AUDIO_BLOCK_SAMPLES;
-		offset = position[channel] % AUDIO_BLOCK_SAMPLES;
+		from = position[channel];
+		to = from;
+		if (slewcount[channel]) {
+			// glide by an equal share of the remaining distance
+			to = from + ((int32_t)(target[channel] - from)) / slewcount[channel];
+			position[channel] = to;
+			slewcount[channel]--;
+		}
+		if (interp[channel] != DELAY_INTERPOLATION_NONE || from != to
+		  || (mod && moddepth[channel])) {
+			fractional_tap(channel, head, from, to, mod);
+			continue;
+		}
+		// whole samples, using the queued blocks
+		samples = (to + (1 << (DELAY_FRACTION_BITS - 1))) >> DELAY_FRACTION_BITS;
+		if (ring) {
+			ring_tap(channel, head, samples);
+			continue;
+		}
+		index =  samples / AUDIO_BLOCK_SAMPLES;
+		offset = samples % AUDIO_BLOCK_SAMPLES;
 		if (head >= index) {
 			index = head - index;
 		} else {
@@ -132,7 +374,7 @@ void AudioEffectDelay::update(void)
 			release(output);
 		}
 	}
-
+	if (mod) release(mod);
 }
 
 
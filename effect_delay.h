@@ -47,72 +47,150 @@
   #define DELAY_QUEUE_SIZE  (6144 / AUDIO_BLOCK_SAMPLES)
 #endif
 
+// Interpolation of fractional delays, for each tap
+#define DELAY_INTERPOLATION_NONE	0	// nearest sample (default)
+#define DELAY_INTERPOLATION_LINEAR	1
+#define DELAY_INTERPOLATION_ALLPASS	2	// flat response, for fixed delays
+#define DELAY_INTERPOLATION_CUBIC	3
+
+// Delay times are kept in 1/4096 samples
+#define DELAY_FRACTION_BITS 12
+
 class AudioEffectDelay : public AudioStream
 {
 public:
-	AudioEffectDelay() : AudioStream(1, inputQueueArray) {
+	AudioEffectDelay() : AudioStream(2, inputQueueArray) {
 		activemask = 0;
 		headindex = 0;
 		tailindex = 0;
 		maxblocks = 0;
 		memset(queue, 0, sizeof(queue));
+		memset(position, 0, sizeof(position));
+		memset(target, 0, sizeof(target));
+		memset(slewcount, 0, sizeof(slewcount));
+		memset(slewblocks, 0, sizeof(slewblocks));
+		memset(moddepth, 0, sizeof(moddepth));
+		memset(interp, 0, sizeof(interp));
+		memset(allpass, 0, sizeof(allpass));
+		ring = NULL;
+		ringlength = 0;
+		ringindex = 0;
+		maxdelay = AUDIO_BLOCK_SAMPLES * (DELAY_QUEUE_SIZE-1) - 3;
 	}
+	// Keep the delayed signal in a ring buffer given by the sketch, length
+	// in samples, instead of blocks from AudioMemory().  The buffer may be
+	// in DMAMEM, EXTMEM or from malloc(), for delays of many seconds, up to
+	// 524287 samples (11.8 seconds).  Call begin() before delay(), since
+	// delays are limited to what is available.  Returns false if the
+	// buffer is too small.
+	bool begin(int16_t *buffer, uint32_t length);
+	// Go back to using blocks from AudioMemory()
+	void end(void);
+	// Set a tap's delay.  A tap which was disabled starts at this delay
+	// at once, otherwise the change glides over the slew() time.
 	void delay(uint8_t channel, float milliseconds) {
 		if (channel >= 8) return;
-		if (milliseconds < 0.0) milliseconds = 0.0;
-		uint32_t n = (milliseconds*(AUDIO_SAMPLE_RATE_EXACT/1000.0))+0.5;
-		uint32_t nmax = AUDIO_BLOCK_SAMPLES * (DELAY_QUEUE_SIZE-1);
-		if (n > nmax) n = nmax;
-		uint32_t blks = (n + (AUDIO_BLOCK_SAMPLES-1)) / AUDIO_BLOCK_SAMPLES + 1;
-		if (!(activemask & (1<<channel))) {
-			// enabling a previously disabled channel
-			position[channel] = n;
-			if (blks > maxblocks) maxblocks = blks;
-			activemask |= (1<<channel);
+		if (milliseconds < 0.0f) milliseconds = 0.0f;
+		float n = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f);
+		if (n > maxdelay) n = maxdelay;
+		uint32_t q = n * (float)(1 << DELAY_FRACTION_BITS) + 0.5f;
+		__disable_irq();
+		if (!(activemask & (1<<channel)) || slewblocks[channel] == 0) {
+			position[channel] = q;
+			slewcount[channel] = 0;
 		} else {
-			if (n > position[channel]) {
-				// new delay is greater than previous setting
-				if (blks > maxblocks) maxblocks = blks;
-				position[channel] = n;
-			} else {
-				// new delay is less than previous setting
-				position[channel] = n;
-				recompute_maxblocks();
-			}
+			slewcount[channel] = slewblocks[channel];
 		}
+		target[channel] = q;
+		activemask |= (1<<channel);
+		__enable_irq();
+		recompute_maxblocks();
 	}
 	void disable(uint8_t channel) {
 		if (channel >= 8) return;
 		// diable this channel
+		__disable_irq();
 		activemask &= ~(1<<channel);
+		__enable_irq();
 		// recompute maxblocks for remaining enabled channels
 		recompute_maxblocks();
 	}
+	// Interpolation of fractional delays, DELAY_INTERPOLATION_NONE rounds
+	// to the nearest sample, as before.  LINEAR is the fastest, but dulls
+	// high frequencies.  ALLPASS keeps a flat response, but is only for
+	// fixed or slowly changing delays.  CUBIC suits fast modulation.
+	void interpolation(uint8_t channel, int mode) {
+		if (channel >= 8) return;
+		if (mode < DELAY_INTERPOLATION_NONE || mode > DELAY_INTERPOLATION_CUBIC) {
+			mode = DELAY_INTERPOLATION_NONE;
+		}
+		__disable_irq();
+		interp[channel] = mode;
+		allpass[channel] = 0;
+		__enable_irq();
+	}
+	// Modulate a tap's delay by input 1, which at full scale (+/- 1.0)
+	// adds or subtracts milliseconds.  0 ignores input 1.
+	void modulation(uint8_t channel, float milliseconds) {
+		if (channel >= 8) return;
+		if (milliseconds < 0.0f) milliseconds = 0.0f;
+		float n = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f);
+		if (n > maxdelay) n = maxdelay;
+		moddepth[channel] = n * (float)(1 << DELAY_FRACTION_BITS) + 0.5f;
+		recompute_maxblocks();
+	}
+	// Time for later delay() changes to glide to the new delay, which
+	// changes the pitch while it glides, like a tape delay.  0 jumps to
+	// the new delay at once (default).
+	void slew(uint8_t channel, float milliseconds) {
+		if (channel >= 8) return;
+		if (milliseconds < 0.0f) milliseconds = 0.0f;
+		float blocks = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f)
+			/ AUDIO_BLOCK_SAMPLES + 0.5f;
+		slewblocks[channel] = (blocks < 65535.0f) ? (uint16_t)blocks : 65535;
+	}
 	virtual void update(void);
 private:
 	void recompute_maxblocks(void) {
 		uint32_t max=0;
 		uint32_t channel = 0;
+		__disable_irq();
 		do {
 			if (activemask & (1<<channel)) {
-				uint32_t n = position[channel];
+				// the longest delay while gliding or modulated, plus the
+				// samples used by interpolation
+				uint32_t n = (position[channel] > target[channel]) ?
+					position[channel] : target[channel];
+				n = ((n + moddepth[channel]) >> DELAY_FRACTION_BITS) + 3;
 				n = (n + (AUDIO_BLOCK_SAMPLES-1)) / AUDIO_BLOCK_SAMPLES + 1;
 				if (n > max) max = n;
 			}
 		} while(++channel < 8);
+		if (max > DELAY_QUEUE_SIZE - 1) max = DELAY_QUEUE_SIZE - 1;
 		maxblocks = max;
+		__enable_irq();
 	}
+	void fractional_tap(uint32_t channel, uint32_t head, uint32_t from,
+		uint32_t to, const audio_block_t *mod);
+	void ring_tap(uint32_t channel, uint32_t head, uint32_t samples);
+	void limit_delays(void);
 	uint8_t activemask;   // which output channels are active
 	uint16_t headindex;    // head index (incoming) data in quueu
 	uint16_t tailindex;    // tail index (outgoing) data from queue
 	uint16_t maxblocks;    // number of blocks needed in queue
-#if DELAY_QUEUE_SIZE * AUDIO_BLOCK_SAMPLES < 65535
-	uint16_t position[8]; // # of sample delay for each channel
-#else
-	uint32_t position[8]; // # of sample delay for each channel
-#endif
+	uint32_t position[8];  // delay for each channel, in 1/4096 samples
+	uint32_t target[8];    // where each channel's delay is gliding
+	uint16_t slewcount[8]; // blocks until the glide reaches target
+	uint16_t slewblocks[8]; // glide time, in blocks
+	uint32_t moddepth[8];  // delay change for full scale input 1
+	uint8_t interp[8];
+	int32_t allpass[8];    // allpass interpolation output, for feedback
+	int16_t *ring;         // ring buffer from begin(), or NULL for the queue
+	uint32_t ringlength;
+	uint32_t ringindex;    // where the newest block starts in the ring
+	uint32_t maxdelay;     // longest delay, in samples
 	audio_block_t *queue[DELAY_QUEUE_SIZE];
-	audio_block_t *inputQueueArray[1];
+	audio_block_t *inputQueueArray[2];
 };
 
 #endif
@@ -30,68 +30,49 @@
 
 #include <Arduino.h>
 #include "effect_freeverb.h"
+#include "ReverbRoom.h"
 #include "utility/dspinst.h"
 
+static const uint16_t comb_tuning[8] = {1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617};
+static const uint16_t allpass_tuning[4] = {556, 441, 341, 225};
+
 AudioEffectFreeverb::AudioEffectFreeverb() : AudioStream(1, inputQueueArray)
 {
-	memset(comb1buf, 0, sizeof(comb1buf));
-	memset(comb2buf, 0, sizeof(comb2buf));
-	memset(comb3buf, 0, sizeof(comb3buf));
-	memset(comb4buf, 0, sizeof(comb4buf));
-	memset(comb5buf, 0, sizeof(comb5buf));
-	memset(comb6buf, 0, sizeof(comb6buf));
-	memset(comb7buf, 0, sizeof(comb7buf));
-	memset(comb8buf, 0, sizeof(comb8buf));
-	comb1index = 0;
-	comb2index = 0;
-	comb3index = 0;
-	comb4index = 0;
-	comb5index = 0;
-	comb6index = 0;
-	comb7index = 0;
-	comb8index = 0;
-	comb1filter = 0;
-	comb2filter = 0;
-	comb3filter = 0;
-	comb4filter = 0;
-	comb5filter = 0;
-	comb6filter = 0;
-	comb7filter = 0;
-	comb8filter = 0;
-	combdamp1 = 6553;
-	combdamp2 = 26215;
+	int16_t *p = combbuf;
+	for (int i=0; i < 8; i++) {
+		comb[i].buffer = p;
+		comb[i].length = FREEVERB_LENGTH(comb_tuning[i]);
+		comb[i].index = 0;
+		comb[i].filter = 0;
+		p += comb[i].length;
+	}
+	p = allpassbuf;
+	for (int i=0; i < 4; i++) {
+		allpass[i].buffer = p;
+		allpass[i].length = FREEVERB_LENGTH(allpass_tuning[i]);
+		allpass[i].index = 0;
+		allpass[i].filter = 0;
+		p += allpass[i].length;
+	}
+	memset(combbuf, 0, sizeof(combbuf));
+	memset(allpassbuf, 0, sizeof(allpassbuf));
+	damping(0.5f);
 	combfeeback = 27524;
-	memset(allpass1buf, 0, sizeof(allpass1buf));
-	memset(allpass2buf, 0, sizeof(allpass2buf));
-	memset(allpass3buf, 0, sizeof(allpass3buf));
-	memset(allpass4buf, 0, sizeof(allpass4buf));
-	allpass1index = 0;
-	allpass2index = 0;
-	allpass3index = 0;
-	allpass4index = 0;
 }
 
 
 // cleaner sat16 by http://www.moseleyinstruments.com/
-__attribute__((unused))
-static int16_t sat16(int32_t n, int rshift) {
+static inline int16_t sat16(int32_t n, int rshift) __attribute__((always_inline, unused));
+static inline int16_t sat16(int32_t n, int rshift) {
     // we should always round towards 0
     // to avoid recirculating round-off noise
     //
     // a 2s complement positive number is always
     // rounded down, so we only need to take
-    // care of negative numbers
-    if (n < 0) {
-        n = n + (~(0xFFFFFFFFUL << rshift));
-    }
-    n = n >> rshift;
-    if (n > 32767) {
-        return 32767;
-    }
-    if (n < -32768) {
-        return -32768;
-    }
-    return n;
+    // care of negative numbers, without a branch
+    n += (n >> 31) & ~(0xFFFFFFFFUL << rshift);
+    // SSAT on Cortex-M4 & M7
+    return signed_saturate_rshift(n, 16, rshift);
 }
 
 // TODO: move this to one of the data files, use in output_adat.cpp, output_tdm.cpp, etc
@@ -121,14 +102,79 @@ static const audio_block_t zeroblock = {
 #endif
 } };
 
+// Each comb and allpass runs over the whole block, in pieces between the
+// ends of their delay lines, which are all longer than a block.  The
+// results are identical to running all of them for each sample, as
+// Jezar's code does.  Combs run in pairs, for 2 independent filters at
+// a time without running out of registers.
+static void comb_block(freeverb_delay_t *d1, freeverb_delay_t *d2, const int16_t *input,
+	int32_t *sum, int32_t damp1, int32_t damp2, int32_t feedback)
+{
+	uint32_t index1 = d1->index, index2 = d2->index;
+	int32_t filter1 = d1->filter, filter2 = d2->filter;
+	int i = 0;
+
+	while (i < AUDIO_BLOCK_SAMPLES) {
+		int n = AUDIO_BLOCK_SAMPLES - i;
+		if (n > (int)(d1->length - index1)) n = d1->length - index1;
+		if (n > (int)(d2->length - index2)) n = d2->length - index2;
+		int16_t *p1 = d1->buffer + index1;
+		int16_t *p2 = d2->buffer + index2;
+		const int16_t *in = input + i;
+		int32_t *out = sum + i;
+		for (int j=0; j < n; j++) {
+			int32_t bufout1 = p1[j];
+			int32_t bufout2 = p2[j];
+			out[j] += bufout1 + bufout2;
+			filter1 = sat16(bufout1 * damp2 + filter1 * damp1, 15);
+			filter2 = sat16(bufout2 * damp2 + filter2 * damp1, 15);
+			p1[j] = sat16(in[j] + sat16(filter1 * feedback, 15), 0);
+			p2[j] = sat16(in[j] + sat16(filter2 * feedback, 15), 0);
+		}
+		i += n;
+		index1 += n;
+		if (index1 >= d1->length) index1 = 0;
+		index2 += n;
+		if (index2 >= d2->length) index2 = 0;
+	}
+	d1->index = index1;
+	d1->filter = filter1;
+	d2->index = index2;
+	d2->filter = filter2;
+}
+
+static void allpass_block(freeverb_delay_t *d, int16_t *data)
+{
+	int16_t *buf = d->buffer;
+	uint32_t index = d->index;
+	int i = 0;
+
+	while (i < AUDIO_BLOCK_SAMPLES) {
+		int n = d->length - index;
+		if (n > AUDIO_BLOCK_SAMPLES - i) n = AUDIO_BLOCK_SAMPLES - i;
+		int16_t *p = buf + index;
+		int16_t *io = data + i;
+		for (int j=0; j < n; j++) {
+			int16_t bufout = p[j];
+			int16_t output = io[j];
+			p[j] = output + (bufout >> 1);
+			io[j] = sat16(bufout - output, 1);
+		}
+		i += n;
+		index += n;
+		if (index >= d->length) index = 0;
+	}
+	d->index = index;
+}
+
 void AudioEffectFreeverb::update()
 {
 #if defined(__ARM_ARCH_7EM__)
 	const audio_block_t *block;
 	audio_block_t *outblock;
+	int16_t input[AUDIO_BLOCK_SAMPLES];
+	int32_t sum[AUDIO_BLOCK_SAMPLES];
 	int i;
-	int16_t input, bufout, output;
-	int32_t sum;
 
 	outblock = allocate();
 	if (!outblock) {
@@ -141,84 +187,159 @@ void AudioEffectFreeverb::update()
 
 	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
 		// TODO: scale numerical range depending on roomsize & damping
-		input = sat16(block->data[i] * 8738, 17); // for numerical headroom
-		sum = 0;
-
-		bufout = comb1buf[comb1index];
-		sum += bufout;
-		comb1filter = sat16(bufout * combdamp2 + comb1filter * combdamp1, 15);
-		comb1buf[comb1index] = sat16(input + sat16(comb1filter * combfeeback, 15), 0);
-		if (++comb1index >= sizeof(comb1buf)/sizeof(int16_t)) comb1index = 0;
-
-		bufout = comb2buf[comb2index];
-		sum += bufout;
-		comb2filter = sat16(bufout * combdamp2 + comb2filter * combdamp1, 15);
-		comb2buf[comb2index] = sat16(input + sat16(comb2filter * combfeeback, 15), 0);
-		if (++comb2index >= sizeof(comb2buf)/sizeof(int16_t)) comb2index = 0;
-
-		bufout = comb3buf[comb3index];
-		sum += bufout;
-		comb3filter = sat16(bufout * combdamp2 + comb3filter * combdamp1, 15);
-		comb3buf[comb3index] = sat16(input + sat16(comb3filter * combfeeback, 15), 0);
-		if (++comb3index >= sizeof(comb3buf)/sizeof(int16_t)) comb3index = 0;
-
-		bufout = comb4buf[comb4index];
-		sum += bufout;
-		comb4filter = sat16(bufout * combdamp2 + comb4filter * combdamp1, 15);
-		comb4buf[comb4index] = sat16(input + sat16(comb4filter * combfeeback, 15), 0);
-		if (++comb4index >= sizeof(comb4buf)/sizeof(int16_t)) comb4index = 0;
-
-		bufout = comb5buf[comb5index];
-		sum += bufout;
-		comb5filter = sat16(bufout * combdamp2 + comb5filter * combdamp1, 15);
-		comb5buf[comb5index] = sat16(input + sat16(comb5filter * combfeeback, 15), 0);
-		if (++comb5index >= sizeof(comb5buf)/sizeof(int16_t)) comb5index = 0;
-
-		bufout = comb6buf[comb6index];
-		sum += bufout;
-		comb6filter = sat16(bufout * combdamp2 + comb6filter * combdamp1, 15);
-		comb6buf[comb6index] = sat16(input + sat16(comb6filter * combfeeback, 15), 0);
-		if (++comb6index >= sizeof(comb6buf)/sizeof(int16_t)) comb6index = 0;
+		input[i] = sat16(block->data[i] * 8738, 17); // for numerical headroom
+		sum[i] = 0;
+	}
+	if (block != &zeroblock) release((audio_block_t *)block);
 
-		bufout = comb7buf[comb7index];
-		sum += bufout;
-		comb7filter = sat16(bufout * combdamp2 + comb7filter * combdamp1, 15);
-		comb7buf[comb7index] = sat16(input + sat16(comb7filter * combfeeback, 15), 0);
-		if (++comb7index >= sizeof(comb7buf)/sizeof(int16_t)) comb7index = 0;
+	__disable_irq();
+	int32_t damp1 = combdamp1;
+	int32_t damp2 = combdamp2;
+	__enable_irq();
+	int32_t feedback = combfeeback;
+	for (i=0; i < 8; i += 2) {
+		comb_block(&comb[i], &comb[i + 1], input, sum, damp1, damp2, feedback);
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		outblock->data[i] = sat16(sum[i] * 31457, 17);
+	}
+	for (i=0; i < 4; i++) {
+		allpass_block(&allpass[i], outblock->data);
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		outblock->data[i] = sat16(outblock->data[i] * 30, 0);
+	}
+	transmit(outblock);
+	release(outblock);
 
-		bufout = comb8buf[comb8index];
-		sum += bufout;
-		comb8filter = sat16(bufout * combdamp2 + comb8filter * combdamp1, 15);
-		comb8buf[comb8index] = sat16(input + sat16(comb8filter * combfeeback, 15), 0);
-		if (++comb8index >= sizeof(comb8buf)/sizeof(int16_t)) comb8index = 0;
+#elif defined(KINETISL)
+	audio_block_t *block;
+	block = receiveReadOnly(0);
+	if (block) release(block);
+#endif
+}
 
-		output = sat16(sum * 31457, 17);
 
-		bufout = allpass1buf[allpass1index];
-		allpass1buf[allpass1index] = output + (bufout >> 1);
-		output = sat16(bufout - output, 1);
-		if (++allpass1index >= sizeof(allpass1buf)/sizeof(int16_t)) allpass1index = 0;
+AudioEffectFreeverbFloat::AudioEffectFreeverbFloat() : AudioStream(1, inputQueueArray)
+{
+	float *p = combbuf;
+	for (int i=0; i < 8; i++) {
+		comb[i].buffer = p;
+		comb[i].length = FREEVERB_LENGTH(comb_tuning[i]);
+		comb[i].index = 0;
+		comb[i].filter = 0.0f;
+		p += comb[i].length;
+	}
+	p = allpassbuf;
+	for (int i=0; i < 4; i++) {
+		allpass[i].buffer = p;
+		allpass[i].length = FREEVERB_LENGTH(allpass_tuning[i]);
+		allpass[i].index = 0;
+		allpass[i].filter = 0.0f;
+		p += allpass[i].length;
+	}
+	memset(combbuf, 0, sizeof(combbuf));
+	memset(allpassbuf, 0, sizeof(allpassbuf));
+	damping(0.5f);
+	roomsize(0.5f);
+}
 
-		bufout = allpass2buf[allpass2index];
-		allpass2buf[allpass2index] = output + (bufout >> 1);
-		output = sat16(bufout - output, 1);
-		if (++allpass2index >= sizeof(allpass2buf)/sizeof(int16_t)) allpass2index = 0;
+static void comb_block_float(freeverb_delay_float_t *d, const float *input, float *sum,
+	float damp1, float damp2, float feedback)
+{
+	float *buf = d->buffer;
+	uint32_t index = d->index;
+	float filter = d->filter;
+	int i = 0;
+
+	while (i < AUDIO_BLOCK_SAMPLES) {
+		int n = d->length - index;
+		if (n > AUDIO_BLOCK_SAMPLES - i) n = AUDIO_BLOCK_SAMPLES - i;
+		float *p = buf + index;
+		const float *in = input + i;
+		float *out = sum + i;
+		for (int j=0; j < n; j++) {
+			float bufout = p[j];
+			out[j] += bufout;
+			filter = bufout * damp2 + filter * damp1;
+			p[j] = in[j] + filter * feedback;
+		}
+		i += n;
+		index += n;
+		if (index >= d->length) index = 0;
+	}
+	d->index = index;
+	// the tail decays to denormals, which are slow on some processors
+	d->filter = (fabsf(filter) > 1.0e-20f) ? filter : 0.0f;
+}
 
-		bufout = allpass3buf[allpass3index];
-		allpass3buf[allpass3index] = output + (bufout >> 1);
-		output = sat16(bufout - output, 1);
-		if (++allpass3index >= sizeof(allpass3buf)/sizeof(int16_t)) allpass3index = 0;
+static void allpass_block_float(freeverb_delay_float_t *d, float *data)
+{
+	float *buf = d->buffer;
+	uint32_t index = d->index;
+	int i = 0;
+
+	while (i < AUDIO_BLOCK_SAMPLES) {
+		int n = d->length - index;
+		if (n > AUDIO_BLOCK_SAMPLES - i) n = AUDIO_BLOCK_SAMPLES - i;
+		float *p = buf + index;
+		float *io = data + i;
+		for (int j=0; j < n; j++) {
+			float bufout = p[j];
+			float output = io[j];
+			p[j] = output + bufout * 0.5f;
+			io[j] = (bufout - output) * 0.5f;
+		}
+		i += n;
+		index += n;
+		if (index >= d->length) index = 0;
+	}
+	d->index = index;
+}
 
-		bufout = allpass4buf[allpass4index];
-		allpass4buf[allpass4index] = output + (bufout >> 1);
-		output = sat16(bufout - output, 1);
-		if (++allpass4index >= sizeof(allpass4buf)/sizeof(int16_t)) allpass4index = 0;
+void AudioEffectFreeverbFloat::update()
+{
+#if defined(__ARM_ARCH_7EM__)
+	audio_block_t *block;
+	float input[AUDIO_BLOCK_SAMPLES];
+	float sum[AUDIO_BLOCK_SAMPLES];
+	int i;
 
-		outblock->data[i] = sat16(output * 30, 0);
+	block = receiveWritable(0);
+	if (!block) {
+		block = allocate();
+		if (!block) return;
+		for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) input[i] = 0.0f;
+	} else {
+		// the same gain as the fixed point version, 8738 / 2^17
+		for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			input[i] = block->data[i] * (8738.0f / 131072.0f);
+		}
 	}
-	transmit(outblock);
-	release(outblock);
-	if (block != &zeroblock) release((audio_block_t *)block);
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) sum[i] = 0.0f;
+
+	__disable_irq();
+	float damp1 = combdamp1;
+	float damp2 = combdamp2;
+	__enable_irq();
+	float feedback = combfeeback;
+	for (i=0; i < 8; i++) {
+		comb_block_float(&comb[i], input, sum, damp1, damp2, feedback);
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		sum[i] *= 31457.0f / 131072.0f;
+	}
+	for (i=0; i < 4; i++) {
+		allpass_block_float(&allpass[i], sum);
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		float out = sum[i] * 30.0f;
+		if (out > 32767.0f) out = 32767.0f;
+		else if (out < -32768.0f) out = -32768.0f;
+		block->data[i] = (int16_t)out;
+	}
+	transmit(block);
+	release(block);
 
 #elif defined(KINETISL)
 	audio_block_t *block;
@@ -278,8 +399,7 @@ AudioEffectFreeverbStereo::AudioEffectFreeverbStereo() : AudioStream(1, inputQue
 	comb6filterR = 0;
 	comb7filterR = 0;
 	comb8filterR = 0;
-	combdamp1 = 6553;
-	combdamp2 = 26215;
+	damping(0.5f);
 	combfeeback = 27524;
 	memset(allpass1bufL, 0, sizeof(allpass1bufL));
 	memset(allpass2bufL, 0, sizeof(allpass2bufL));
@@ -468,7 +588,7 @@ void AudioEffectFreeverbStereo::update()
 		outputR = sat16(bufout - outputR, 1);
 		if (++allpass4indexR >= sizeof(allpass4bufR)/sizeof(int16_t)) allpass4indexR = 0;
 
-		outblockR->data[i] = sat16(outputL * 30, 0);
+		outblockR->data[i] = sat16(outputR * 30, 0);
 	}
 	transmit(outblockL, 0);
 	transmit(outblockR, 1);
@@ -485,3 +605,175 @@ void AudioEffectFreeverbStereo::update()
 
 
 
+
+
+// the right channel's delays are this much longer
+#define STEREO_SPREAD 23
+
+static uint32_t scaled_length(uint32_t tuning, float scale)
+{
+	uint32_t n = FREEVERB_LENGTH(tuning) * scale + 0.5f;
+	return (n > 0) ? n : 1;
+}
+
+AudioEffectFreeverbStereoBuffer::AudioEffectFreeverbStereoBuffer() : AudioStream(1, inputQueueArray)
+{
+	memory = NULL;
+	memory_length = 0;
+	used_length = 0;
+	room_scale = 1.0f;
+	running = false;
+	damping(0.5f);
+	combfeeback = 27524;
+}
+
+uint32_t AudioEffectFreeverbStereoBuffer::lengthRequired(float scale)
+{
+	uint32_t length = 0;
+	scale = reverb_room_limit(scale);
+	for (int i=0; i < 8; i++) {
+		length += scaled_length(comb_tuning[i], scale);
+		length += scaled_length(comb_tuning[i] + STEREO_SPREAD, scale);
+	}
+	for (int i=0; i < 4; i++) {
+		length += scaled_length(allpass_tuning[i], scale);
+		length += scaled_length(allpass_tuning[i] + STEREO_SPREAD, scale);
+	}
+	return length;
+}
+
+// for reverb_room_fit(), n is unused
+static uint32_t required_length(float scale, unsigned int n)
+{
+	return AudioEffectFreeverbStereoBuffer::lengthRequired(scale);
+}
+
+static int16_t * assign_delay(freeverb_delay_t *d, int16_t *p, uint32_t length)
+{
+	d->buffer = p;
+	d->length = length;
+	d->index = 0;
+	d->filter = 0;
+	return p + length;
+}
+
+bool AudioEffectFreeverbStereoBuffer::configure(float scale)
+{
+	scale = reverb_room_fit(scale, memory_length, required_length, 0);
+	if (scale == 0.0f) return false;
+	__disable_irq();
+	running = false;
+	__enable_irq();
+	int16_t *p = memory;
+	for (int i=0; i < 8; i++) {
+		p = assign_delay(&combL[i], p, scaled_length(comb_tuning[i], scale));
+		p = assign_delay(&combR[i], p, scaled_length(comb_tuning[i] + STEREO_SPREAD, scale));
+	}
+	for (int i=0; i < 4; i++) {
+		p = assign_delay(&allpassL[i], p, scaled_length(allpass_tuning[i], scale));
+		p = assign_delay(&allpassR[i], p, scaled_length(allpass_tuning[i] + STEREO_SPREAD, scale));
+	}
+	used_length = p - memory;
+	memset(memory, 0, used_length * sizeof(int16_t));
+	room_scale = scale;
+	__disable_irq();
+	running = true;
+	__enable_irq();
+	return true;
+}
+
+bool AudioEffectFreeverbStereoBuffer::begin(int16_t *buffer, uint32_t length, float scale)
+{
+	end();
+	if (!buffer) return false;
+	memory = buffer;
+	memory_length = length;
+	if (!configure(scale)) {
+		memory = NULL;
+		memory_length = 0;
+		return false;
+	}
+	return true;
+}
+
+void AudioEffectFreeverbStereoBuffer::end(void)
+{
+	__disable_irq();
+	running = false;
+	__enable_irq();
+	memory = NULL;
+	memory_length = 0;
+	used_length = 0;
+}
+
+float AudioEffectFreeverbStereoBuffer::roomScale(float scale)
+{
+	if (memory) configure(scale);
+	return room_scale;
+}
+
+void AudioEffectFreeverbStereoBuffer::update()
+{
+#if defined(__ARM_ARCH_7EM__)
+	const audio_block_t *block;
+	audio_block_t *outblockL;
+	audio_block_t *outblockR;
+	int16_t input[AUDIO_BLOCK_SAMPLES];
+	int32_t sumL[AUDIO_BLOCK_SAMPLES];
+	int32_t sumR[AUDIO_BLOCK_SAMPLES];
+	int i;
+
+	block = receiveReadOnly(0);
+	if (!running) {
+		if (block) release((audio_block_t *)block);
+		return;
+	}
+	outblockL = allocate();
+	outblockR = allocate();
+	if (!outblockL || !outblockR) {
+		if (outblockL) release(outblockL);
+		if (outblockR) release(outblockR);
+		if (block) release((audio_block_t *)block);
+		return;
+	}
+	if (!block) block = &zeroblock;
+
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		input[i] = sat16(block->data[i] * 8738, 17); // for numerical headroom
+		sumL[i] = 0;
+		sumR[i] = 0;
+	}
+	if (block != &zeroblock) release((audio_block_t *)block);
+
+	__disable_irq();
+	int32_t damp1 = combdamp1;
+	int32_t damp2 = combdamp2;
+	__enable_irq();
+	int32_t feedback = combfeeback;
+	for (i=0; i < 8; i += 2) {
+		comb_block(&combL[i], &combL[i + 1], input, sumL, damp1, damp2, feedback);
+		comb_block(&combR[i], &combR[i + 1], input, sumR, damp1, damp2, feedback);
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		outblockL->data[i] = sat16(sumL[i] * 31457, 17);
+		outblockR->data[i] = sat16(sumR[i] * 31457, 17);
+	}
+	for (i=0; i < 4; i++) {
+		allpass_block(&allpassL[i], outblockL->data);
+		allpass_block(&allpassR[i], outblockR->data);
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		outblockL->data[i] = sat16(outblockL->data[i] * 30, 0);
+		outblockR->data[i] = sat16(outblockR->data[i] * 30, 0);
+	}
+	transmit(outblockL, 0);
+	transmit(outblockR, 1);
+	release(outblockL);
+	release(outblockR);
+
+#elif defined(KINETISL)
+	audio_block_t *block;
+	block = receiveReadOnly(0);
+	if (block) release(block);
+#endif
+}
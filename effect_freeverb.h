@@ -29,6 +29,45 @@
 #include <Arduino.h>
 #include "AudioStream.h"
 
+// Jezar's delay lengths are for 44.1 kHz.  Other sample rates, like 48 or
+// 96 kHz, scale them to keep the same room, and use more memory.  Teensy's
+// 44117.6 Hz uses them unchanged.
+#define FREEVERB_RATE_SCALE ((AUDIO_SAMPLE_RATE_EXACT > 43000.0f \
+	&& AUDIO_SAMPLE_RATE_EXACT < 45000.0f) ? 1.0f : AUDIO_SAMPLE_RATE_EXACT / 44100.0f)
+#define FREEVERB_LENGTH(n) ((int)((n) * FREEVERB_RATE_SCALE + 0.5f))
+#define FREEVERB_COMB_SAMPLES (FREEVERB_LENGTH(1116) + FREEVERB_LENGTH(1188) \
+	+ FREEVERB_LENGTH(1277) + FREEVERB_LENGTH(1356) + FREEVERB_LENGTH(1422) \
+	+ FREEVERB_LENGTH(1491) + FREEVERB_LENGTH(1557) + FREEVERB_LENGTH(1617))
+#define FREEVERB_ALLPASS_SAMPLES (FREEVERB_LENGTH(556) + FREEVERB_LENGTH(441) \
+	+ FREEVERB_LENGTH(341) + FREEVERB_LENGTH(225))
+
+// Damping is a one pole lowpass in each comb, 0 to 0.4 at 44.1 kHz,
+// adjusted to the same cutoff at other sample rates
+static inline float freeverb_damping(float n) __attribute__((always_inline, unused));
+static inline float freeverb_damping(float n)
+{
+	if (n > 1.0f) n = 1.0f;
+	else if (n < 0.0f) n = 0.0f;
+	n *= 0.4f;
+	if (FREEVERB_RATE_SCALE != 1.0f) n = powf(n, 1.0f / FREEVERB_RATE_SCALE);
+	return n;
+}
+
+// One comb filter or allpass delay line
+typedef struct freeverb_delay_struct {
+	int16_t *buffer;
+	uint16_t length;
+	uint16_t index;
+	int16_t filter;		// comb damping lowpass state
+} freeverb_delay_t;
+
+typedef struct freeverb_delay_float_struct {
+	float *buffer;
+	uint16_t length;
+	uint16_t index;
+	float filter;
+} freeverb_delay_float_t;
+
 class AudioEffectFreeverb : public AudioStream
 {
 public:
@@ -40,9 +79,7 @@ public:
 		combfeeback = (int)(n * 9175.04f) + 22937;
 	}
 	void damping(float n) {
-		if (n > 1.0f) n = 1.0f;
-		else if (n < 0.0) n = 0.0f;
-		int x1 = (int)(n * 13107.2f);
+		int x1 = (int)(freeverb_damping(n) * 32768.0f);
 		int x2 = 32768 - x1;
 		__disable_irq();
 		combdamp1 = x1;
@@ -51,41 +88,44 @@ public:
 	}
 private:
 	audio_block_t *inputQueueArray[1];
-	int16_t comb1buf[1116];
-	int16_t comb2buf[1188];
-	int16_t comb3buf[1277];
-	int16_t comb4buf[1356];
-	int16_t comb5buf[1422];
-	int16_t comb6buf[1491];
-	int16_t comb7buf[1557];
-	int16_t comb8buf[1617];
-	uint16_t comb1index;
-	uint16_t comb2index;
-	uint16_t comb3index;
-	uint16_t comb4index;
-	uint16_t comb5index;
-	uint16_t comb6index;
-	uint16_t comb7index;
-	uint16_t comb8index;
-	int16_t comb1filter;
-	int16_t comb2filter;
-	int16_t comb3filter;
-	int16_t comb4filter;
-	int16_t comb5filter;
-	int16_t comb6filter;
-	int16_t comb7filter;
-	int16_t comb8filter;
+	freeverb_delay_t comb[8];
+	freeverb_delay_t allpass[4];
 	int16_t combdamp1;
 	int16_t combdamp2;
 	int16_t combfeeback;
-	int16_t allpass1buf[556];
-	int16_t allpass2buf[441];
-	int16_t allpass3buf[341];
-	int16_t allpass4buf[225];
-	uint16_t allpass1index;
-	uint16_t allpass2index;
-	uint16_t allpass3index;
-	uint16_t allpass4index;
+	int16_t combbuf[FREEVERB_COMB_SAMPLES];
+	int16_t allpassbuf[FREEVERB_ALLPASS_SAMPLES];
+};
+
+// Freeverb in floating point, without the fixed point version's round-off
+// noise in long, quiet tails.  Uses twice the memory, about 50K at 44.1
+// kHz.  Needs a floating point unit, Teensy 3.5, 3.6 or 4.x.
+class AudioEffectFreeverbFloat : public AudioStream
+{
+public:
+	AudioEffectFreeverbFloat();
+	virtual void update();
+	void roomsize(float n) {
+		if (n > 1.0f) n = 1.0f;
+		else if (n < 0.0) n = 0.0f;
+		combfeeback = n * 0.28f + 0.7f;
+	}
+	void damping(float n) {
+		float x1 = freeverb_damping(n);
+		__disable_irq();
+		combdamp1 = x1;
+		combdamp2 = 1.0f - x1;
+		__enable_irq();
+	}
+private:
+	audio_block_t *inputQueueArray[1];
+	freeverb_delay_float_t comb[8];
+	freeverb_delay_float_t allpass[4];
+	float combdamp1;
+	float combdamp2;
+	float combfeeback;
+	float combbuf[FREEVERB_COMB_SAMPLES];
+	float allpassbuf[FREEVERB_ALLPASS_SAMPLES];
 };
 
 
@@ -100,9 +140,7 @@ public:
 		combfeeback = (int)(n * 9175.04f) + 22937;
 	}
 	void damping(float n) {
-		if (n > 1.0f) n = 1.0f;
-		else if (n < 0.0) n = 0.0f;
-		int x1 = (int)(n * 13107.2f);
+		int x1 = (int)(freeverb_damping(n) * 32768.0f);
 		int x2 = 32768 - x1;
 		__disable_irq();
 		combdamp1 = x1;
@@ -111,14 +149,14 @@ public:
 	}
 private:
 	audio_block_t *inputQueueArray[1];
-	int16_t comb1bufL[1116];
-	int16_t comb2bufL[1188];
-	int16_t comb3bufL[1277];
-	int16_t comb4bufL[1356];
-	int16_t comb5bufL[1422];
-	int16_t comb6bufL[1491];
-	int16_t comb7bufL[1557];
-	int16_t comb8bufL[1617];
+	int16_t comb1bufL[FREEVERB_LENGTH(1116)];
+	int16_t comb2bufL[FREEVERB_LENGTH(1188)];
+	int16_t comb3bufL[FREEVERB_LENGTH(1277)];
+	int16_t comb4bufL[FREEVERB_LENGTH(1356)];
+	int16_t comb5bufL[FREEVERB_LENGTH(1422)];
+	int16_t comb6bufL[FREEVERB_LENGTH(1491)];
+	int16_t comb7bufL[FREEVERB_LENGTH(1557)];
+	int16_t comb8bufL[FREEVERB_LENGTH(1617)];
 	uint16_t comb1indexL;
 	uint16_t comb2indexL;
 	uint16_t comb3indexL;
@@ -135,14 +173,14 @@ private:
 	int16_t comb6filterL;
 	int16_t comb7filterL;
 	int16_t comb8filterL;
-	int16_t comb1bufR[1139];
-	int16_t comb2bufR[1211];
-	int16_t comb3bufR[1300];
-	int16_t comb4bufR[1379];
-	int16_t comb5bufR[1445];
-	int16_t comb6bufR[1514];
-	int16_t comb7bufR[1580];
-	int16_t comb8bufR[1640];
+	int16_t comb1bufR[FREEVERB_LENGTH(1139)];
+	int16_t comb2bufR[FREEVERB_LENGTH(1211)];
+	int16_t comb3bufR[FREEVERB_LENGTH(1300)];
+	int16_t comb4bufR[FREEVERB_LENGTH(1379)];
+	int16_t comb5bufR[FREEVERB_LENGTH(1445)];
+	int16_t comb6bufR[FREEVERB_LENGTH(1514)];
+	int16_t comb7bufR[FREEVERB_LENGTH(1580)];
+	int16_t comb8bufR[FREEVERB_LENGTH(1640)];
 	uint16_t comb1indexR;
 	uint16_t comb2indexR;
 	uint16_t comb3indexR;
@@ -162,18 +200,18 @@ private:
 	int16_t combdamp1;
 	int16_t combdamp2;
 	int16_t combfeeback;
-	int16_t allpass1bufL[556];
-	int16_t allpass2bufL[441];
-	int16_t allpass3bufL[341];
-	int16_t allpass4bufL[225];
+	int16_t allpass1bufL[FREEVERB_LENGTH(556)];
+	int16_t allpass2bufL[FREEVERB_LENGTH(441)];
+	int16_t allpass3bufL[FREEVERB_LENGTH(341)];
+	int16_t allpass4bufL[FREEVERB_LENGTH(225)];
 	uint16_t allpass1indexL;
 	uint16_t allpass2indexL;
 	uint16_t allpass3indexL;
 	uint16_t allpass4indexL;
-	int16_t allpass1bufR[579];
-	int16_t allpass2bufR[464];
-	int16_t allpass3bufR[364];
-	int16_t allpass4bufR[248];
+	int16_t allpass1bufR[FREEVERB_LENGTH(579)];
+	int16_t allpass2bufR[FREEVERB_LENGTH(464)];
+	int16_t allpass3bufR[FREEVERB_LENGTH(364)];
+	int16_t allpass4bufR[FREEVERB_LENGTH(248)];
 	uint16_t allpass1indexR;
 	uint16_t allpass2indexR;
 	uint16_t allpass3indexR;
@@ -181,5 +219,63 @@ private:
 };
 
 
+// Stereo Freeverb with its delay lines in a buffer given by the sketch,
+// which may be in DMAMEM, EXTMEM or from malloc(), so the object itself
+// is small.  The room scale shortens all delay lines in proportion, for
+// a smaller room which needs less memory.  Both channels share the input
+// scaling, and each comb runs over the whole block.
+class AudioEffectFreeverbStereoBuffer : public AudioStream
+{
+public:
+	AudioEffectFreeverbStereoBuffer();
+	virtual void update();
+	// Use buffer for the delay lines, length in 16 bit samples.  When
+	// the buffer is too small for the room scale, the largest scale which
+	// fits is used.  Returns false if it is too small for any room.
+	bool begin(int16_t *buffer, uint32_t length, float scale = 1.0f);
+	void end(void);
+	// Change the room scale, 0.05 to 4.0, while running.  The reverb
+	// restarts silent.  Returns the scale used, which may be less.
+	float roomScale(float scale);
+	float roomScale(void) {
+		return room_scale;
+	}
+	// Buffer length, in 16 bit samples, needed for a room scale
+	static uint32_t lengthRequired(float scale = 1.0f);
+	// Bytes of the buffer used by the delay lines
+	uint32_t memoryUsed(void) {
+		return used_length * sizeof(int16_t);
+	}
+	void roomsize(float n) {
+		if (n > 1.0f) n = 1.0f;
+		else if (n < 0.0) n = 0.0f;
+		combfeeback = (int)(n * 9175.04f) + 22937;
+	}
+	void damping(float n) {
+		int x1 = (int)(freeverb_damping(n) * 32768.0f);
+		int x2 = 32768 - x1;
+		__disable_irq();
+		combdamp1 = x1;
+		combdamp2 = x2;
+		__enable_irq();
+	}
+private:
+	audio_block_t *inputQueueArray[1];
+	freeverb_delay_t combL[8];
+	freeverb_delay_t combR[8];
+	freeverb_delay_t allpassL[4];
+	freeverb_delay_t allpassR[4];
+	bool configure(float scale);
+	int16_t *memory;
+	uint32_t memory_length;
+	uint32_t used_length;
+	float room_scale;
+	int16_t combdamp1;
+	int16_t combdamp2;
+	int16_t combfeeback;
+	volatile bool running;
+};
+
+
 #endif
 
@@ -0,0 +1,496 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Feedback Delay Network reverb, after Jot and Chaigne, "Digital Delay
+// Networks for Designing Artificial Reverberators", AES 1991
+
+#include <Arduino.h>
+#include "effect_reverb_fdn.h"
+#include "ReverbRoom.h"
+
+// Lines are processed in chunks: each line's output for a whole chunk is
+// read, mixed, and written back.  The shortest line must be longer than a
+// chunk, so the chunk never reads samples it has not written yet.
+#if AUDIO_BLOCK_SAMPLES < 32
+#define FDN_CHUNK AUDIO_BLOCK_SAMPLES
+#else
+#define FDN_CHUNK 32
+#endif
+
+// at room scale 1.0, delay lines are spread from 15 to 45 ms
+#define FDN_MIN_DELAY 0.015f
+#define FDN_MAX_DELAY 0.045f
+
+// modulation(1.0) moves each delay by up to 0.2 ms, slowly
+#define FDN_MOD_DEPTH 0.0002f
+#define FDN_MOD_MARGIN ((uint32_t)(FDN_MOD_DEPTH * AUDIO_SAMPLE_RATE_EXACT) + 2)
+
+// wet level, similar to AudioEffectFreeverb
+#define FDN_OUTPUT_GAIN 1.0f
+
+static bool is_prime(uint32_t n)
+{
+	if (n < 2) return false;
+	if ((n & 1) == 0) return n == 2;
+	for (uint32_t d=3; d * d <= n; d += 2) {
+		if (n % d == 0) return false;
+	}
+	return true;
+}
+
+// Delay lengths spread geometrically, then rounded up to distinct primes,
+// so no two lines have echoes which coincide
+static void line_lengths(uint32_t *length, unsigned int nlines, float scale)
+{
+	for (unsigned int k=0; k < nlines; k++) {
+		float t = FDN_MIN_DELAY * powf(FDN_MAX_DELAY / FDN_MIN_DELAY,
+			(float)k / (float)(nlines - 1));
+		uint32_t n = t * scale * AUDIO_SAMPLE_RATE_EXACT + 0.5f;
+		if (n < FDN_CHUNK + FDN_MOD_MARGIN) n = FDN_CHUNK + FDN_MOD_MARGIN;
+		if (k > 0 && n <= length[k-1]) n = length[k-1] + 1;
+		while (!is_prime(n)) n++;
+		length[k] = n;
+	}
+}
+
+AudioEffectReverbFDNBase::AudioEffectReverbFDNBase(audio_fdn_line_t *lines, unsigned int nlines)
+  : AudioStream(1, inputQueueArray), line(lines), num_lines(nlines)
+{
+	memset(line, 0, nlines * sizeof(audio_fdn_line_t));
+	memory = NULL;
+	memory_length = 0;
+	used_length = 0;
+	room_scale = 1.0f;
+	reverb_time = 2.0f;
+	hf_ratio = 5.5f;
+	mod_depth = 0.5f * FDN_MOD_DEPTH * AUDIO_SAMPLE_RATE_EXACT;
+	running = false;
+	compute_gains(AUDIO_FDN_HADAMARD);
+}
+
+// each line also has room for the modulation, and buffer[size]
+uint32_t AudioEffectReverbFDNBase::length_required(float scale, unsigned int nlines)
+{
+	uint32_t length[AUDIO_FDN_MAX_LINES];
+	uint32_t total = 0;
+	line_lengths(length, nlines, reverb_room_limit(scale));
+	for (unsigned int k=0; k < nlines; k++) {
+		total += length[k] + FDN_MOD_MARGIN + 1;
+	}
+	return total;
+}
+
+bool AudioEffectReverbFDNBase::configure(float scale)
+{
+	uint32_t length[AUDIO_FDN_MAX_LINES];
+	scale = reverb_room_fit(scale, memory_length, length_required, num_lines);
+	if (scale == 0.0f) return false;
+	__disable_irq();
+	running = false;
+	__enable_irq();
+	line_lengths(length, num_lines, scale);
+	float *p = memory;
+	for (unsigned int k=0; k < num_lines; k++) {
+		audio_fdn_line_t *d = &line[k];
+		d->buffer = p;
+		d->length = length[k];
+		d->size = length[k] + FDN_MOD_MARGIN;
+		d->index = 0;
+		d->filter = 0.0f;
+		// signs from the Thue-Morse sequence, half positive, half negative
+		d->input = (((0x6996 >> k) & 1) ? -1.0f : 1.0f) / (32768.0f * sqrtf(num_lines));
+		// each line's modulation has a different rate, 0.3 to 0.9 Hz,
+		// and starts at a different phase
+		float rate = 0.3f + 0.6f * fmodf(k * 0.618034f, 1.0f);
+		float w = 2.0f * 3.14159265f * rate * FDN_CHUNK / AUDIO_SAMPLE_RATE_EXACT;
+		float phase = 2.0f * 3.14159265f * fmodf(k * 0.381966f, 1.0f);
+		d->rot_cos = cosf(w);
+		d->rot_sin = sinf(w);
+		d->lfo_cos = cosf(phase);
+		d->lfo_sin = sinf(phase);
+		d->delay = d->length + mod_depth * d->lfo_sin;
+		p += d->size + 1;
+	}
+	used_length = p - memory;
+	memset(memory, 0, used_length * sizeof(float));
+	room_scale = scale;
+	compute_gains(matrix_type);
+	__disable_irq();
+	running = true;
+	__enable_irq();
+	return true;
+}
+
+// A NULL buffer has no room, so configure() fails
+bool AudioEffectReverbFDNBase::begin(float *buffer, uint32_t length, float scale)
+{
+	end();
+	memory = buffer;
+	memory_length = buffer ? length : 0;
+	if (configure(scale)) return true;
+	end();
+	return false;
+}
+
+void AudioEffectReverbFDNBase::end(void)
+{
+	__disable_irq();
+	running = false;
+	__enable_irq();
+	memory = NULL;
+	memory_length = 0;
+	used_length = 0;
+}
+
+float AudioEffectReverbFDNBase::roomScale(float scale)
+{
+	if (memory) configure(scale);
+	return room_scale;
+}
+
+// Each line's lowpass has the gain for its length to decay at the reverb
+// time at DC, and at the high frequency time at Nyquist, so all lines
+// decay alike whatever their lengths.  The Hadamard matrix's 1/sqrt(n) is
+// included, so it changes along with the gains.
+void AudioEffectReverbFDNBase::compute_gains(int type)
+{
+	float gain[AUDIO_FDN_MAX_LINES];
+	float pole[AUDIO_FDN_MAX_LINES];
+	float scale = (type == AUDIO_FDN_HADAMARD) ? 1.0f / sqrtf(num_lines) : 1.0f;
+
+	for (unsigned int k=0; k < num_lines; k++) {
+		float seconds = line[k].length * (1.0f / AUDIO_SAMPLE_RATE_EXACT);
+		float dc = powf(10.0f, -3.0f * seconds / reverb_time);
+		float ratio = powf(10.0f, -3.0f * seconds * (hf_ratio - 1.0f) / reverb_time);
+		pole[k] = (1.0f - ratio) / (1.0f + ratio);
+		gain[k] = dc * (1.0f - pole[k]) * scale;
+	}
+	__disable_irq();
+	for (unsigned int k=0; k < num_lines; k++) {
+		line[k].gain = gain[k];
+		line[k].pole = pole[k];
+	}
+	matrix_type = type;
+	output_gain = 32768.0f * FDN_OUTPUT_GAIN / scale;
+	__enable_irq();
+}
+
+void AudioEffectReverbFDNBase::matrix(int type)
+{
+	if (type != AUDIO_FDN_HOUSEHOLDER) type = AUDIO_FDN_HADAMARD;
+	compute_gains(type);
+}
+
+void AudioEffectReverbFDNBase::reverbTime(float seconds)
+{
+	if (seconds < 0.1f) seconds = 0.1f;
+	else if (seconds > 100.0f) seconds = 100.0f;
+	reverb_time = seconds;
+	compute_gains(matrix_type);
+}
+
+void AudioEffectReverbFDNBase::damping(float n)
+{
+	if (n < 0.0f) n = 0.0f;
+	else if (n > 1.0f) n = 1.0f;
+	hf_ratio = 1.0f + 9.0f * n;
+	compute_gains(matrix_type);
+}
+
+void AudioEffectReverbFDNBase::modulation(float n)
+{
+	if (n < 0.0f) n = 0.0f;
+	else if (n > 1.0f) n = 1.0f;
+	mod_depth = n * FDN_MOD_DEPTH * AUDIO_SAMPLE_RATE_EXACT;
+}
+
+// Read one chunk of a line's output.  Without modulation it is used
+// where it is in the buffer, unless it wraps around the end.  The slow
+// modulation moves the delay by less than 0.05 samples per chunk, so the
+// chunk is read at one delay, halfway between its value at the end of the
+// last chunk and this one, with the same interpolation for every sample.
+static const float * read_line(audio_fdn_line_t *d, float *out, float depth)
+{
+	const float *buf = d->buffer;
+
+	float c = d->lfo_cos * d->rot_cos - d->lfo_sin * d->rot_sin;
+	float s = d->lfo_sin * d->rot_cos + d->lfo_cos * d->rot_sin;
+	float norm = 1.5f - 0.5f * (c * c + s * s);
+	d->lfo_cos = c * norm;
+	d->lfo_sin = s * norm;
+	float start = d->delay;
+	float delay = d->length + depth * d->lfo_sin;
+	d->delay = delay;
+
+	if (depth == 0.0f && start == delay) {
+		int32_t index = d->index - d->length;
+		if (index < 0) index += d->size;
+		uint32_t n = d->size - index;
+		if (n >= FDN_CHUNK) return buf + index;
+		memcpy(out, buf + index, n * sizeof(float));
+		memcpy(out + n, buf, (FDN_CHUNK - n) * sizeof(float));
+	} else {
+		// delay whole + frac is between the samples whole + 1 and whole
+		// back, and buffer[size] repeats buffer[0] for the last pair
+		float mid = 0.5f * (start + delay);
+		uint32_t whole = mid;
+		const float frac = mid - (float)whole;
+		const float rest = 1.0f - frac;
+		int32_t index = d->index - whole - 1;
+		if (index < 0) index += d->size;
+		int j = 0;
+		while (j < FDN_CHUNK) {
+			int n = d->size - index;
+			if (n > FDN_CHUNK - j) n = FDN_CHUNK - j;
+			const float *p = buf + index;
+			for (int i=0; i < n; i++) {
+				out[j + i] = p[i] * frac + p[i + 1] * rest;
+			}
+			j += n;
+			index = 0;
+		}
+	}
+	return out;
+}
+
+// Damping lowpass of an even and an odd line at once, which interleaves
+// their recursions, adding them to the left and right outputs.  With the
+// Hadamard matrix, its first butterfly is done here too.
+static void damp_lines(audio_fdn_line_t *d, const float *src1, const float *src2,
+	float *data1, float *data2, float *left, float *right, bool butterfly)
+{
+	const float gain1 = d[0].gain;
+	const float pole1 = d[0].pole;
+	const float gain2 = d[1].gain;
+	const float pole2 = d[1].pole;
+	float filter1 = d[0].filter;
+	float filter2 = d[1].filter;
+
+	if (butterfly) {
+		for (int j=0; j < FDN_CHUNK; j++) {
+			filter1 = src1[j] * gain1 + filter1 * pole1;
+			filter2 = src2[j] * gain2 + filter2 * pole2;
+			data1[j] = filter1 + filter2;
+			data2[j] = filter1 - filter2;
+			left[j] += filter1;
+			right[j] += filter2;
+		}
+	} else {
+		for (int j=0; j < FDN_CHUNK; j++) {
+			filter1 = src1[j] * gain1 + filter1 * pole1;
+			filter2 = src2[j] * gain2 + filter2 * pole2;
+			data1[j] = filter1;
+			data2[j] = filter2;
+			left[j] += filter1;
+			right[j] += filter2;
+		}
+	}
+	// stop at zero, before a fading tail's state becomes denormal
+	d[0].filter = (fabsf(filter1) > 1.0e-20f) ? filter1 : 0.0f;
+	d[1].filter = (fabsf(filter2) > 1.0e-20f) ? filter2 : 0.0f;
+}
+
+// Middle stages of the fast Walsh-Hadamard transform, n log2(n) adds and
+// subtracts per sample in all.  damp_lines() does the first stage and
+// write_lines() the last, and the 1/sqrt(n) which makes it orthogonal is
+// in each line's gain.
+static void hadamard(float data[][FDN_CHUNK], unsigned int n)
+{
+	for (unsigned int len=2; len < n / 2; len <<= 1) {
+		for (unsigned int k=0; k < n; k += len * 2) {
+			for (unsigned int m=k; m < k + len; m++) {
+				float *a = data[m];
+				float *b = data[m + len];
+				for (int j=0; j < FDN_CHUNK; j++) {
+					float sum = a[j] + b[j];
+					float diff = a[j] - b[j];
+					a[j] = sum;
+					b[j] = diff;
+				}
+			}
+		}
+	}
+}
+
+// Householder reflection, I - 2/n, which subtracts 2/n of the sum of all
+// lines from each, 2n adds per sample
+static void householder(float data[][FDN_CHUNK], unsigned int n)
+{
+	float sum[FDN_CHUNK];
+	const float scale = 2.0f / n;
+
+	for (int j=0; j < FDN_CHUNK; j++) sum[j] = data[0][j];
+	for (unsigned int k=1; k < n; k++) {
+		for (int j=0; j < FDN_CHUNK; j++) sum[j] += data[k][j];
+	}
+	for (int j=0; j < FDN_CHUNK; j++) sum[j] *= scale;
+	for (unsigned int k=0; k < n; k++) {
+		for (int j=0; j < FDN_CHUNK; j++) data[k][j] -= sum[j];
+	}
+}
+
+// Write one chunk, with the input, into a line
+static void write_line(audio_fdn_line_t *d, const float *data, const float *input)
+{
+	float *buf = d->buffer;
+	uint32_t index = d->index;
+	const float in = d->input;
+	int j = 0;
+
+	while (j < FDN_CHUNK) {
+		int n = d->size - index;
+		if (n > FDN_CHUNK - j) n = FDN_CHUNK - j;
+		float *p = buf + index;
+		for (int i=0; i < n; i++) {
+			p[i] = data[j + i] + input[j + i] * in;
+		}
+		j += n;
+		index += n;
+		if (index >= d->size) index = 0;
+	}
+	buf[d->size] = buf[0];
+	d->index = index;
+}
+
+// The last Hadamard butterfly, writing both results into their lines
+static void write_lines(audio_fdn_line_t *d1, audio_fdn_line_t *d2,
+	const float *data1, const float *data2, const float *input)
+{
+	uint32_t index1 = d1->index;
+	uint32_t index2 = d2->index;
+	const float in1 = d1->input;
+	const float in2 = d2->input;
+	int j = 0;
+
+	while (j < FDN_CHUNK) {
+		int n = FDN_CHUNK - j;
+		if (n > (int)(d1->size - index1)) n = d1->size - index1;
+		if (n > (int)(d2->size - index2)) n = d2->size - index2;
+		float *p1 = d1->buffer + index1;
+		float *p2 = d2->buffer + index2;
+		for (int i=0; i < n; i++) {
+			float a = data1[j + i];
+			float b = data2[j + i];
+			float in = input[j + i];
+			p1[i] = a + b + in * in1;
+			p2[i] = a - b + in * in2;
+		}
+		j += n;
+		index1 += n;
+		if (index1 >= d1->size) index1 = 0;
+		index2 += n;
+		if (index2 >= d2->size) index2 = 0;
+	}
+	d1->buffer[d1->size] = d1->buffer[0];
+	d2->buffer[d2->size] = d2->buffer[0];
+	d1->index = index1;
+	d2->index = index2;
+}
+
+static inline int16_t float_to_int16(float n) __attribute__((always_inline, unused));
+static inline int16_t float_to_int16(float n)
+{
+	if (n > 32767.0f) return 32767;
+	if (n < -32768.0f) return -32768;
+	return (int16_t)n;
+}
+
+void AudioEffectReverbFDNBase::update(void)
+{
+#if defined(__ARM_ARCH_7EM__)
+	const audio_block_t *block;
+	audio_block_t *outblockL;
+	audio_block_t *outblockR;
+	float input[AUDIO_BLOCK_SAMPLES];
+	float data[AUDIO_FDN_MAX_LINES][FDN_CHUNK];
+	float left[FDN_CHUNK];
+	float right[FDN_CHUNK];
+	const unsigned int n = num_lines;
+	int i, j;
+	unsigned int k;
+
+	block = receiveReadOnly(0);
+	if (!running) {
+		if (block) release((audio_block_t *)block);
+		return;
+	}
+	outblockL = allocate();
+	outblockR = allocate();
+	if (!outblockL || !outblockR) {
+		if (outblockL) release(outblockL);
+		if (outblockR) release(outblockR);
+		if (block) release((audio_block_t *)block);
+		return;
+	}
+	if (block) {
+		for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) input[i] = block->data[i];
+		release((audio_block_t *)block);
+	} else {
+		for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) input[i] = 0.0f;
+	}
+
+	const float depth = mod_depth;
+	const bool hadamard_matrix = (matrix_type == AUDIO_FDN_HADAMARD);
+	const float gain = output_gain;
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i += FDN_CHUNK) {
+		for (j=0; j < FDN_CHUNK; j++) {
+			left[j] = 0.0f;
+			right[j] = 0.0f;
+		}
+		for (k=0; k < n; k += 2) {
+			const float *src1 = read_line(&line[k], data[k], depth);
+			const float *src2 = read_line(&line[k + 1], data[k + 1], depth);
+			damp_lines(&line[k], src1, src2, data[k], data[k + 1],
+				left, right, hadamard_matrix);
+		}
+		if (hadamard_matrix) {
+			hadamard(data, n);
+			for (k=0; k < n / 2; k++) {
+				write_lines(&line[k], &line[k + n / 2], data[k], data[k + n / 2],
+					input + i);
+			}
+		} else {
+			householder(data, n);
+			for (k=0; k < n; k++) {
+				write_line(&line[k], data[k], input + i);
+			}
+		}
+		for (j=0; j < FDN_CHUNK; j++) {
+			outblockL->data[i + j] = float_to_int16(left[j] * gain);
+			outblockR->data[i + j] = float_to_int16(right[j] * gain);
+		}
+	}
+	transmit(outblockL, 0);
+	transmit(outblockR, 1);
+	release(outblockL);
+	release(outblockR);
+
+#elif defined(KINETISL)
+	audio_block_t *block;
+	block = receiveReadOnly(0);
+	if (block) release(block);
+#endif
+}
@@ -0,0 +1,137 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef effect_reverb_fdn_h_
+#define effect_reverb_fdn_h_
+#include <Arduino.h>
+#include "AudioStream.h"
+
+// Feedback Delay Network reverb, with 4, 8 or 16 delay lines.  Each
+// line's output passes through a damping lowpass, then all lines are
+// mixed by an orthogonal matrix, computed with add and subtract
+// butterflies, and fed back with the input.  More lines give a denser
+// tail sooner.  The delay lines are slowly modulated, which breaks up
+// the metallic ringing of long, quiet tails.  Processing is in floating
+// point, so a Teensy 3.5, 3.6 or 4.x is needed.
+//
+// With 8 lines and the default modulation, it uses about 3/4 of the CPU
+// time of AudioEffectFreeverb.  Its echoes are sparser than Freeverb's
+// for the first 100 ms, then denser.  16 lines are about as dense as
+// Freeverb from the start, for about 1.6 times its CPU time.
+//
+// The delay lines use a buffer given by the sketch, which may be in
+// DMAMEM, EXTMEM or from malloc().  Output 0 is left, 1 is right, both
+// with only the reverberated sound.
+#define AUDIO_FDN_MAX_LINES	16
+
+#define AUDIO_FDN_HADAMARD	0
+#define AUDIO_FDN_HOUSEHOLDER	1
+
+typedef struct audio_fdn_line_struct {
+	float *buffer;
+	uint32_t size;		// buffer[size] repeats buffer[0], for interpolation
+	uint32_t index;		// where the next sample is written
+	uint32_t length;	// delay without modulation
+	float delay;		// modulated delay at the end of the last chunk
+	float gain;		// damping lowpass, including this line's decay
+	float pole;
+	float filter;
+	float input;		// input gain, with a different sign for each line
+	float lfo_cos;		// modulation phasor
+	float lfo_sin;
+	float rot_cos;		// phasor rotation per chunk
+	float rot_sin;
+} audio_fdn_line_t;
+
+class AudioEffectReverbFDNBase : public AudioStream
+{
+public:
+	virtual void update(void);
+	// Use buffer for the delay lines, length in floats.  When the buffer
+	// is too small for the room scale, the largest scale which fits is
+	// used.  Returns false if it is too small for any room.
+	bool begin(float *buffer, uint32_t length, float scale = 1.0f);
+	void end(void);
+	// Change the room scale, 0.05 to 4.0, while running.  1.0 has delay
+	// lines from 15 to 45 ms.  The reverb restarts silent.  Returns the
+	// scale used, which may be less.
+	float roomScale(float scale);
+	float roomScale(void) {
+		return room_scale;
+	}
+	// Bytes of the buffer used by the delay lines
+	uint32_t memoryUsed(void) {
+		return used_length * sizeof(float);
+	}
+	// Time for the low frequencies to decay by 60 dB, 0.1 to 100 seconds
+	void reverbTime(float seconds);
+	// How much faster the high frequencies decay, 0 for the same time, to
+	// 1.0 for 10 times faster
+	void damping(float n);
+	// Depth of the delay line modulation, 0 to 1.0 for +/- 0.2 ms, default
+	// 0.5.  It adds about 30% to the CPU time, 0 turns it off.
+	void modulation(float n);
+	// AUDIO_FDN_HADAMARD (default) mixes every line equally into all the
+	// others.  AUDIO_FDN_HOUSEHOLDER is faster, but with 8 or 16 lines each
+	// line mostly feeds itself, which builds up density more slowly.
+	void matrix(int type);
+	int lines(void) { return num_lines; }
+protected:
+	AudioEffectReverbFDNBase(audio_fdn_line_t *lines, unsigned int nlines);
+	static uint32_t length_required(float scale, unsigned int nlines);
+private:
+	bool configure(float scale);
+	void compute_gains(int type);
+	audio_block_t *inputQueueArray[1];
+	audio_fdn_line_t *line;
+	float *memory;
+	uint32_t memory_length;
+	uint32_t used_length;
+	float room_scale;
+	float reverb_time;
+	float hf_ratio;
+	float mod_depth;	// in samples
+	float output_gain;
+	volatile uint8_t matrix_type;
+	uint8_t num_lines;
+	volatile bool running;
+};
+
+template <int NN>
+class AudioEffectReverbFDN : public AudioEffectReverbFDNBase
+{
+	static_assert(NN == 4 || NN == 8 || NN == 16, "AudioEffectReverbFDN supports 4, 8 or 16 lines");
+public:
+	AudioEffectReverbFDN(void) : AudioEffectReverbFDNBase(lineArray, NN) { }
+	// Buffer length, in floats, needed for a room scale
+	static uint32_t lengthRequired(float scale = 1.0f) {
+		return length_required(scale, NN);
+	}
+private:
+	audio_fdn_line_t lineArray[NN];
+};
+
+#endif
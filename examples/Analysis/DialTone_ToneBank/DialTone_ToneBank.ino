@@ -0,0 +1,105 @@
+// Dial Tone (DTMF) decoding example, with one tone bank.
+//
+// The audio with dial tones is connected to audio shield
+// Left Line-In pin.  Dial tone output is produced on the
+// Line-Out and headphones.
+//
+// Use the Arduino Serial Monitor to watch for incoming
+// dial tones, and to send digits to be played as dial tones.
+//
+// This example code is in the public domain.
+
+
+#include <Audio.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <SD.h>
+#include <SerialFlash.h>
+
+// Create the Audio components.  These should be created in the
+// order data flows, inputs/sources -> processing -> outputs
+//
+AudioInputI2S            audioIn;
+AudioAnalyzeToneBank     dtmf;     // detects all 8 DTMF tones
+AudioSynthWaveformSine   sine1;    // 2 sine wave
+AudioSynthWaveformSine   sine2;    // to create DTMF
+AudioMixer4              mixer;
+AudioOutputI2S           audioOut;
+
+// Create Audio connections between the components
+//
+AudioConnection patchCord01(audioIn, 0, dtmf, 0);
+AudioConnection patchCord10(sine1, 0, mixer, 0);
+AudioConnection patchCord11(sine2, 0, mixer, 1);
+AudioConnection patchCord12(mixer, 0, audioOut, 0);
+AudioConnection patchCord13(mixer, 0, audioOut, 1);
+
+// Create an object to control the audio shield.
+// 
+AudioControlSGTL5000 audioShield;
+
+const char keys[] = "123A456B789C*0#D";
+const int rows[4] = {697, 770, 852, 941};
+const int columns[4] = {1209, 1336, 1477, 1633};
+
+void setup() {
+  // Audio connections require memory to work.  For more
+  // detailed information, see the MemoryAndCpuUsage example
+  AudioMemory(12);
+
+  // Enable the audio shield and set the output volume.
+  audioShield.enable();
+  audioShield.volume(0.5);
+  
+  while (!Serial) ;
+  delay(100);
+  
+  // Decode DTMF keys, with both tones at least 5% of full scale
+  dtmf.dtmf();
+  dtmf.threshold(0.05);
+}
+
+void loop() {
+  // print each key, once per key press
+  char key = dtmf.readKey();
+  if (key) {
+    Serial.print("Key: ");
+    Serial.println(key);
+  }
+
+  // check if any data has arrived from the serial monitor
+  if (Serial.available()) {
+    char c = Serial.read();
+    int low=0;
+    int high=0;
+    for (int i=0; i < 16; i++) {
+      if (c == keys[i]) {
+        low = rows[i / 4];
+        high = columns[i % 4];
+      }
+    }
+
+    // play the DTMF tones, if characters send from the Arduino Serial Monitor
+    if (low > 0 && high > 0) {
+      Serial.print("Output sound for key ");
+      Serial.print(c);
+      Serial.print(", low freq=");
+      Serial.print(low);
+      Serial.print(", high freq=");
+      Serial.print(high);
+      Serial.println();
+      AudioNoInterrupts();  // disable audio library momentarily
+      sine1.frequency(low);
+      sine1.amplitude(0.4);
+      sine2.frequency(high);
+      sine2.amplitude(0.45);
+      AudioInterrupts();    // enable, both tones will start together
+      delay(100);           // let the sound play for 0.1 second
+      AudioNoInterrupts();
+      sine1.amplitude(0);
+      sine2.amplitude(0);
+      AudioInterrupts();
+      delay(50);            // make sure we have 0.05 second silence after
+    }
+  }
+}
@@ -0,0 +1,73 @@
+/* Stereo loudness meter, with peak, true-peak and RMS levels
+ *
+ * Shows the EBU R128 momentary, short-term and integrated loudness
+ * of the audio shield line input, in LUFS.  Broadcast programs are
+ * normally mixed to -23 LUFS integrated, and streaming services
+ * often use -14 to -16 LUFS.  The true-peak, between the samples,
+ * should stay below -1 dBTP, so the signal does not clip after
+ * conversion to analog or lossy compression.
+ *
+ * Send any character in the Arduino Serial Monitor to restart the
+ * integrated loudness.
+ *
+ * This example code is in the public domain
+ */
+
+#include <Audio.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <SD.h>
+#include <SerialFlash.h>
+
+AudioInputI2S         audioInput;
+AudioAnalyzeMeter<2>  meter;        // one meter for both channels
+AudioOutputI2S        audioOutput;
+AudioConnection       patchCord1(audioInput, 0, meter, 0);
+AudioConnection       patchCord2(audioInput, 1, meter, 1);
+AudioConnection       patchCord3(audioInput, 0, audioOutput, 0);
+AudioConnection       patchCord4(audioInput, 1, audioOutput, 1);
+AudioControlSGTL5000  audioShield;
+
+void setup() {
+  AudioMemory(10);
+  audioShield.enable();
+  audioShield.inputSelect(AUDIO_INPUT_LINEIN);
+  audioShield.volume(0.5);
+  Serial.begin(9600);
+}
+
+float decibels(float level) {
+  if (level < 0.00001f) return -100.0f;
+  return 20.0f * log10f(level);
+}
+
+int count = 0;
+
+void loop() {
+  // new loudness every 100 ms, print every 500 ms
+  if (meter.available() && ++count >= 5) {
+    count = 0;
+    Serial.print("M: ");
+    Serial.print(meter.readMomentary(), 1);
+    Serial.print("  S: ");
+    Serial.print(meter.readShortTerm(), 1);
+    Serial.print("  I: ");
+    Serial.print(meter.readIntegrated(), 1);
+    Serial.print(" LUFS");
+    for (int ch=0; ch < 2; ch++) {
+      Serial.print(ch == 0 ? "   Left " : "   Right ");
+      Serial.print(decibels(meter.readPeak(ch)), 1);
+      Serial.print(" dB peak, ");
+      Serial.print(decibels(meter.readTruePeak(ch)), 1);
+      Serial.print(" dBTP, ");
+      Serial.print(decibels(meter.readRMS(ch)), 1);
+      Serial.print(" dB RMS");
+    }
+    Serial.println();
+  }
+  if (Serial.available()) {
+    while (Serial.available()) Serial.read();
+    meter.resetIntegrated();
+    Serial.println("Integrated loudness restarted");
+  }
+}
@@ -0,0 +1,100 @@
+// Record 4 channels to a SD card, as interleaved raw data.
+//
+// Requires Teensy 4.1 with PSRAM, and 2 audio shields or
+// other I2S codecs, for AudioInputI2SQuad.  The samples
+// are written to the SD card in 16 kbyte pieces, directly
+// from a 2 second buffer in PSRAM, so the SD card may pause
+// for wear leveling without losing sound.
+//
+// Send 'r' in the Arduino Serial Monitor to start recording,
+// and 's' to stop.  RECORD4.RAW has 4 channels of 16 bit
+// samples at 44.1 kHz, which can be imported into Audacity
+// (File > Import > Raw Data).
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <SD.h>
+#include <SerialFlash.h>
+
+AudioInputI2SQuad        i2s_quad;
+AudioRecordStream<4>     recorder;
+AudioConnection          patchCord1(i2s_quad, 0, recorder, 0);
+AudioConnection          patchCord2(i2s_quad, 1, recorder, 1);
+AudioConnection          patchCord3(i2s_quad, 2, recorder, 2);
+AudioConnection          patchCord4(i2s_quad, 3, recorder, 3);
+AudioControlSGTL5000     sgtl5000_1;
+AudioControlSGTL5000     sgtl5000_2;
+
+// Write in multiples of 512 byte sectors
+#define WRITE_SAMPLES 8192
+
+// 2 seconds of 4 channels, 705 kbytes, in PSRAM.  A multiple of
+// WRITE_SAMPLES, so the pieces written never wrap around the end.
+#define BUFFER_SAMPLES (43 * WRITE_SAMPLES)
+EXTMEM int16_t buffer[BUFFER_SAMPLES];
+
+File frec;
+bool recording = false;
+
+void setup() {
+  AudioMemory(20);
+  sgtl5000_1.setAddress(LOW);
+  sgtl5000_1.enable();
+  sgtl5000_1.inputSelect(AUDIO_INPUT_LINEIN);
+  sgtl5000_2.setAddress(HIGH);
+  sgtl5000_2.enable();
+  sgtl5000_2.inputSelect(AUDIO_INPUT_LINEIN);
+  if (!SD.begin(BUILTIN_SDCARD)) {
+    while (1) {
+      Serial.println("Unable to access the SD card");
+      delay(500);
+    }
+  }
+}
+
+void loop() {
+  if (Serial.available()) {
+    char c = Serial.read();
+    if (c == 'r' && !recording) startRecording();
+    if (c == 's' && recording) stopRecording();
+  }
+  if (recording) continueRecording();
+}
+
+void startRecording() {
+  if (SD.exists("RECORD4.RAW")) {
+    SD.remove("RECORD4.RAW");
+  }
+  frec = SD.open("RECORD4.RAW", FILE_WRITE);
+  if (frec && recorder.begin(buffer, BUFFER_SAMPLES)) {
+    recording = true;
+    Serial.println("Recording");
+  }
+}
+
+void continueRecording() {
+  uint32_t length;
+  int16_t *data = recorder.readBuffer(&length);
+  if (length >= WRITE_SAMPLES) {
+    frec.write((byte *)data, WRITE_SAMPLES * 2);
+    recorder.freeBuffer(WRITE_SAMPLES);
+  }
+}
+
+void stopRecording() {
+  recorder.end();
+  uint32_t length;
+  int16_t *data;
+  while ((data = recorder.readBuffer(&length)) != NULL) {
+    frec.write((byte *)data, length * 2);
+    recorder.freeBuffer(length);
+  }
+  frec.close();
+  recording = false;
+  Serial.print("Stopped, ");
+  Serial.print(recorder.overruns());
+  Serial.println(" blocks lost");
+}
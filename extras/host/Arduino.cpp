@@ -0,0 +1,178 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "SD.h"
+#include "SPI.h"
+#include <stdarg.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+HostSerial Serial;
+SDClass SD;
+SPIClass SPI;
+
+static uint64_t monotonic_nsec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// The CPU time stamp counter is the closest thing a PC has to the
+// Cortex-M cycle counter (ARM_DWT_CYCCNT).  Other machines count
+// nanoseconds instead.
+uint32_t host_cycle_count(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (uint32_t)__rdtsc();
+#else
+	return (uint32_t)monotonic_nsec();
+#endif
+}
+
+static uint32_t measure_cycle_rate(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint64_t t0 = monotonic_nsec();
+	uint64_t c0 = __rdtsc();
+	while (monotonic_nsec() - t0 < 20000000) ; // 20 ms
+	uint64_t c1 = __rdtsc();
+	uint64_t t1 = monotonic_nsec();
+	return (uint32_t)((c1 - c0) * 1000000000ull / (t1 - t0));
+#else
+	return 1000000000;
+#endif
+}
+
+volatile uint32_t F_CPU_ACTUAL = measure_cycle_rate();
+
+static const uint64_t start_nsec = monotonic_nsec();
+
+uint32_t millis(void)
+{
+	return (monotonic_nsec() - start_nsec) / 1000000;
+}
+
+uint32_t micros(void)
+{
+	return (monotonic_nsec() - start_nsec) / 1000;
+}
+
+void delay(uint32_t msec)
+{
+	struct timespec ts = { (time_t)(msec / 1000), (long)(msec % 1000) * 1000000 };
+	nanosleep(&ts, NULL);
+}
+
+void delayMicroseconds(uint32_t usec)
+{
+	struct timespec ts = { (time_t)(usec / 1000000), (long)(usec % 1000000) * 1000 };
+	nanosleep(&ts, NULL);
+}
+
+void yield(void)
+{
+}
+
+// same linear congruential generator as the Teensy core
+static uint32_t seed;
+
+void randomSeed(uint32_t newseed)
+{
+	if (newseed > 0) seed = newseed;
+}
+
+static int32_t random_uint32(void)
+{
+	int32_t hi, lo, x;
+
+	// the algorithm used in avr-libc 1.6.4
+	x = seed;
+	if (x == 0) x = 123459876;
+	hi = x / 127773;
+	lo = x % 127773;
+	x = 16807 * lo - 2836 * hi;
+	if (x < 0) x += 0x7FFFFFFF;
+	seed = x;
+	return x;
+}
+
+int32_t random(int32_t howbig)
+{
+	if (howbig == 0) return 0;
+	return random_uint32() % howbig;
+}
+
+int32_t random(int32_t howsmall, int32_t howbig)
+{
+	if (howsmall >= howbig) return howsmall;
+	int32_t diff = howbig - howsmall;
+	return random(diff) + howsmall;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t count = 0;
+	while (size--) count += write(*buffer++);
+	return count;
+}
+
+size_t Print::print(long n, int base)
+{
+	if (base == DEC) return printf("%ld", n);
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+	char buf[8 * sizeof(long) + 1];
+	char *str = &buf[sizeof(buf) - 1];
+
+	if (base < 2) base = 10;
+	*str = '\0';
+	do {
+		unsigned long m = n;
+		n /= base;
+		char c = m - base * n;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+	return print(str);
+}
+
+size_t Print::printf(const char *format, ...)
+{
+	char buf[256];
+	va_list ap;
+	va_start(ap, format);
+	int n = vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+	if (n <= 0) return 0;
+	if (n >= (int)sizeof(buf)) n = sizeof(buf) - 1;
+	return write((const uint8_t *)buf, n);
+}
@@ -0,0 +1,171 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Minimal subset of the Teensy Arduino core, just enough for the audio
+// processing objects to compile and run on a PC.  See extras/host/README.md
+
+#ifndef Arduino_h_
+#define Arduino_h_
+
+#ifndef AUDIO_HOST
+#error "extras/host/Arduino.h is only for host builds, compile with -DAUDIO_HOST"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#define TEENSYDUINO 153
+
+// memory placement attributes have no meaning on a PC
+#define DMAMEM
+#define FASTRUN
+#define FLASHMEM
+#define PROGMEM
+#define EXTMEM
+
+// there is only one thread, so interrupts are never pending
+#define __disable_irq() do { } while (0)
+#define __enable_irq() do { } while (0)
+#define cli() __disable_irq()
+#define sei() __enable_irq()
+#define NVIC_DISABLE_IRQ(n) do { } while (0)
+#define NVIC_ENABLE_IRQ(n) do { } while (0)
+#define NVIC_IS_ENABLED(n) 0
+#define IRQ_SOFTWARE 0
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Approximate clock rate of host_cycle_count(), measured at startup.  On
+// Teensy 4 this is also a variable, because the CPU speed can change.
+extern volatile uint32_t F_CPU_ACTUAL;
+#define F_CPU F_CPU_ACTUAL
+
+uint32_t host_cycle_count(void);
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t msec);
+void delayMicroseconds(uint32_t usec);
+void yield(void);
+static inline void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+static inline void digitalWrite(uint8_t pin, uint8_t val) { (void)pin; (void)val; }
+static inline void digitalWriteFast(uint8_t pin, uint8_t val) { (void)pin; (void)val; }
+static inline void arm_dcache_flush_delete(void *addr, uint32_t size) { (void)addr; (void)size; }
+static inline void arm_dcache_delete(void *addr, uint32_t size) { (void)addr; (void)size; }
+
+#ifdef __cplusplus
+}
+
+typedef bool boolean;
+
+template <class A, class B>
+static inline auto min(const A &a, const B &b) -> decltype(a < b ? a : b)
+{
+	return (b < a) ? b : a;
+}
+
+template <class A, class B>
+static inline auto max(const A &a, const B &b) -> decltype(a < b ? a : b)
+{
+	return (a < b) ? b : a;
+}
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+int32_t random(int32_t howbig);
+int32_t random(int32_t howsmall, int32_t howbig);
+void randomSeed(uint32_t newseed);
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// Print works like the Teensy core's Print class, so library functions
+// which take a Print & can write to Serial or a file.
+class Print
+{
+public:
+	virtual ~Print() { }
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(int n, int base = DEC) { return print((long)n, base); }
+	size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2) { return printf("%.*f", digits, n); }
+	size_t println(void) { return print('\n'); }
+	template <typename T> size_t println(T n) { return print(n) + println(); }
+	template <typename T> size_t println(T n, int f) { return print(n, f) + println(); }
+	size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+};
+
+// Serial prints to stdout, so objects like AudioAnalyzePrint and sketch
+// style debugging work unchanged.
+class HostSerial : public Print
+{
+public:
+	void begin(uint32_t baud) { (void)baud; }
+	operator bool() { return true; }
+	int available(void) { return 0; }
+	int read(void) { return -1; }
+	virtual size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+	virtual size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+	void flush(void) { fflush(stdout); }
+};
+
+// Print to a file opened with fopen()
+class HostFilePrint : public Print
+{
+public:
+	HostFilePrint(FILE *f) : file(f) { }
+	virtual size_t write(uint8_t c) { return fwrite(&c, 1, 1, file); }
+	virtual size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, file); }
+private:
+	FILE *file;
+};
+
+extern HostSerial Serial;
+
+#endif // __cplusplus
+
+#endif
@@ -0,0 +1,94 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Minimal SD library for host builds: files are opened from the PC's
+// file system, relative to the current directory.
+
+#ifndef SD_h_
+#define SD_h_
+
+#include "Arduino.h"
+
+#define FILE_READ 0
+#define FILE_WRITE 1
+
+class File
+{
+public:
+	File(void) : file(NULL) { }
+	File(FILE *f) : file(f) { }
+	int read(void *buf, size_t nbyte) {
+		if (!file) return -1;
+		return fread(buf, 1, nbyte, file);
+	}
+	int read(void) {
+		uint8_t c;
+		return (read(&c, 1) == 1) ? c : -1;
+	}
+	size_t write(const void *buf, size_t nbyte) {
+		return file ? fwrite(buf, 1, nbyte, file) : 0;
+	}
+	int available(void) {
+		if (!file) return 0;
+		uint32_t n = size() - position();
+		return n > 0x7FFFFFFF ? 0x7FFFFFFF : n;
+	}
+	uint32_t position(void) { return file ? ftell(file) : 0; }
+	uint32_t size(void) {
+		if (!file) return 0;
+		long pos = ftell(file);
+		fseek(file, 0, SEEK_END);
+		long len = ftell(file);
+		fseek(file, pos, SEEK_SET);
+		return len;
+	}
+	bool seek(uint32_t pos) { return file && fseek(file, pos, SEEK_SET) == 0; }
+	void close(void) {
+		if (file) fclose(file);
+		file = NULL;
+	}
+	operator bool() { return file != NULL; }
+private:
+	FILE *file;
+};
+
+class SDClass
+{
+public:
+	bool begin(uint8_t csPin = 0) { (void)csPin; return true; }
+	File open(const char *filename, uint8_t mode = FILE_READ) {
+		return File(fopen(filename, mode == FILE_WRITE ? "r+b" : "rb"));
+	}
+	bool exists(const char *filename) {
+		FILE *f = fopen(filename, "rb");
+		if (f) fclose(f);
+		return f != NULL;
+	}
+};
+
+extern SDClass SD;
+
+#endif
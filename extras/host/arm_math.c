@@ -0,0 +1,274 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "arm_math.h"
+
+static q15_t twiddle[ARM_HOST_MAX_FFT_SIZE * 2]; // cos, sin pairs
+static uint8_t twiddle_ready = 0;
+static float32_t twiddle_f32[ARM_HOST_MAX_FFT_SIZE * 2];
+static uint8_t twiddle_f32_ready = 0;
+
+static q15_t clip_q15(int32_t x)
+{
+	if (x > 32767) return 32767;
+	if (x < -32768) return -32768;
+	return x;
+}
+
+static q31_t clip_q31(int64_t x)
+{
+	if (x > INT32_MAX) return INT32_MAX;
+	if (x < INT32_MIN) return INT32_MIN;
+	return x;
+}
+
+// swap complex elements (of 4 or 8 bytes) into bit reversed order
+static void bit_reverse(void *data, uint32_t n, uint32_t size)
+{
+	uint8_t *p = (uint8_t *)data;
+	uint8_t tmp[8];
+	uint32_t i, j;
+
+	for (i=0, j=0; i < n; i++) {
+		if (i < j) {
+			memcpy(tmp, p + i * size, size);
+			memcpy(p + i * size, p + j * size, size);
+			memcpy(p + j * size, tmp, size);
+		}
+		uint32_t bit = n >> 1;
+		while (j & bit) {
+			j ^= bit;
+			bit >>= 1;
+		}
+		j |= bit;
+	}
+}
+
+arm_status arm_cfft_radix4_init_q15(arm_cfft_radix4_instance_q15 *S,
+	uint16_t fftLen, uint8_t ifftFlag, uint8_t bitReverseFlag)
+{
+	uint32_t i;
+
+	if (fftLen < 16 || fftLen > ARM_HOST_MAX_FFT_SIZE || (fftLen & (fftLen - 1))) {
+		return ARM_MATH_ARGUMENT_ERROR;
+	}
+	if (!twiddle_ready) {
+		for (i=0; i < ARM_HOST_MAX_FFT_SIZE; i++) {
+			double phase = 2.0 * M_PI * i / ARM_HOST_MAX_FFT_SIZE;
+			twiddle[i * 2] = clip_q15(lrint(cos(phase) * 32768.0));
+			twiddle[i * 2 + 1] = clip_q15(lrint(sin(phase) * 32768.0));
+		}
+		twiddle_ready = 1;
+	}
+	S->fftLen = fftLen;
+	S->ifftFlag = ifftFlag;
+	S->bitReverseFlag = bitReverseFlag;
+	S->pTwiddle = twiddle;
+	S->pBitRevTable = 0;
+	S->twidCoefModifier = ARM_HOST_MAX_FFT_SIZE / fftLen;
+	S->bitRevFactor = S->twidCoefModifier;
+	return ARM_MATH_SUCCESS;
+}
+
+// Radix-2 decimation in frequency, halving the data at every stage so
+// the output is scaled by 1/fftLen, matching CMSIS.
+void arm_cfft_radix4_q15(const arm_cfft_radix4_instance_q15 *S, q15_t *pSrc)
+{
+	uint32_t n = S->fftLen;
+	uint32_t span, start, k;
+	int32_t sign = S->ifftFlag ? -1 : 1;
+
+	for (span = n / 2; span > 0; span >>= 1) {
+		uint32_t step = S->twidCoefModifier * (n / 2 / span);
+		for (start = 0; start < n; start += span * 2) {
+			for (k = 0; k < span; k++) {
+				q15_t *a = pSrc + (start + k) * 2;
+				q15_t *b = a + span * 2;
+				int32_t c = S->pTwiddle[k * step * 2];
+				int32_t s = S->pTwiddle[k * step * 2 + 1] * sign;
+				int32_t sr = (a[0] + b[0]) >> 1;
+				int32_t si = (a[1] + b[1]) >> 1;
+				int32_t dr = (a[0] - b[0]) >> 1;
+				int32_t di = (a[1] - b[1]) >> 1;
+				a[0] = sr;
+				a[1] = si;
+				b[0] = clip_q15((dr * c + di * s) >> 15);
+				b[1] = clip_q15((di * c - dr * s) >> 15);
+			}
+		}
+	}
+	if (S->bitReverseFlag) bit_reverse(pSrc, n, 4);
+}
+
+arm_status arm_cfft_radix2_init_f32(arm_cfft_radix2_instance_f32 *S,
+	uint16_t fftLen, uint8_t ifftFlag, uint8_t bitReverseFlag)
+{
+	uint32_t i;
+
+	if (fftLen < 16 || fftLen > ARM_HOST_MAX_FFT_SIZE || (fftLen & (fftLen - 1))) {
+		return ARM_MATH_ARGUMENT_ERROR;
+	}
+	if (!twiddle_f32_ready) {
+		for (i=0; i < ARM_HOST_MAX_FFT_SIZE; i++) {
+			double phase = 2.0 * M_PI * i / ARM_HOST_MAX_FFT_SIZE;
+			twiddle_f32[i * 2] = cos(phase);
+			twiddle_f32[i * 2 + 1] = sin(phase);
+		}
+		twiddle_f32_ready = 1;
+	}
+	S->fftLen = fftLen;
+	S->ifftFlag = ifftFlag;
+	S->bitReverseFlag = bitReverseFlag;
+	S->pTwiddle = twiddle_f32;
+	S->pBitRevTable = 0;
+	S->twidCoefModifier = ARM_HOST_MAX_FFT_SIZE / fftLen;
+	S->bitRevFactor = S->twidCoefModifier;
+	S->onebyfftLen = 1.0f / fftLen;
+	return ARM_MATH_SUCCESS;
+}
+
+void arm_cfft_radix2_f32(const arm_cfft_radix2_instance_f32 *S, float32_t *pSrc)
+{
+	uint32_t n = S->fftLen;
+	uint32_t span, start, k, i;
+	float32_t sign = S->ifftFlag ? -1.0f : 1.0f;
+
+	for (span = n / 2; span > 0; span >>= 1) {
+		uint32_t step = S->twidCoefModifier * (n / 2 / span);
+		for (start = 0; start < n; start += span * 2) {
+			for (k = 0; k < span; k++) {
+				float32_t *a = pSrc + (start + k) * 2;
+				float32_t *b = a + span * 2;
+				float32_t c = S->pTwiddle[k * step * 2];
+				float32_t s = S->pTwiddle[k * step * 2 + 1] * sign;
+				float32_t dr = a[0] - b[0];
+				float32_t di = a[1] - b[1];
+				a[0] += b[0];
+				a[1] += b[1];
+				b[0] = dr * c + di * s;
+				b[1] = di * c - dr * s;
+			}
+		}
+	}
+	if (S->bitReverseFlag) bit_reverse(pSrc, n, 8);
+	if (S->ifftFlag) {
+		for (i=0; i < n * 2; i++) pSrc[i] *= S->onebyfftLen;
+	}
+}
+
+arm_status arm_fir_init_q15(arm_fir_instance_q15 *S, uint16_t numTaps,
+	const q15_t *pCoeffs, q15_t *pState, uint32_t blockSize)
+{
+	uint32_t i;
+
+	if (numTaps < 4 || (numTaps & 1)) return ARM_MATH_ARGUMENT_ERROR;
+	S->numTaps = numTaps;
+	S->pCoeffs = pCoeffs;
+	S->pState = pState;
+	for (i=0; i < numTaps + blockSize - 1u; i++) {
+		pState[i] = 0;
+	}
+	return ARM_MATH_SUCCESS;
+}
+
+void arm_fir_fast_q15(const arm_fir_instance_q15 *S, const q15_t *pSrc,
+	q15_t *pDst, uint32_t blockSize)
+{
+	q15_t *state = S->pState;
+	uint32_t numTaps = S->numTaps;
+	uint32_t n, i;
+
+	for (n=0; n < blockSize; n++) {
+		state[numTaps - 1 + n] = pSrc[n];
+	}
+	for (n=0; n < blockSize; n++) {
+		int32_t acc = 0;
+		for (i=0; i < numTaps; i++) {
+			acc += (int32_t)state[n + i] * S->pCoeffs[i];
+		}
+		pDst[n] = clip_q15(acc >> 15);
+	}
+	for (i=0; i < numTaps - 1; i++) {
+		state[i] = state[blockSize + i];
+	}
+}
+
+void arm_add_q31(const q31_t *pSrcA, const q31_t *pSrcB, q31_t *pDst, uint32_t blockSize)
+{
+	while (blockSize--) {
+		*pDst++ = clip_q31((int64_t)*pSrcA++ + *pSrcB++);
+	}
+}
+
+void arm_shift_q31(const q31_t *pSrc, int8_t shiftBits, q31_t *pDst, uint32_t blockSize)
+{
+	while (blockSize--) {
+		if (shiftBits >= 0) {
+			*pDst++ = clip_q31((int64_t)*pSrc++ << shiftBits);
+		} else {
+			*pDst++ = *pSrc++ >> -shiftBits;
+		}
+	}
+}
+
+void arm_float_to_q31(const float32_t *pSrc, q31_t *pDst, uint32_t blockSize)
+{
+	while (blockSize--) {
+		float32_t in = *pSrc++ * 2147483648.0f;
+		in += in > 0.0f ? 0.5f : -0.5f;
+		*pDst++ = clip_q31((int64_t)in);
+	}
+}
+
+void arm_q15_to_q31(const q15_t *pSrc, q31_t *pDst, uint32_t blockSize)
+{
+	while (blockSize--) {
+		*pDst++ = (q31_t)*pSrc++ << 16;
+	}
+}
+
+void arm_q31_to_q15(const q31_t *pSrc, q15_t *pDst, uint32_t blockSize)
+{
+	while (blockSize--) {
+		*pDst++ = *pSrc++ >> 16;
+	}
+}
+
+// input 0 to 0x7FFF represents 0 to 2*pi
+q15_t arm_sin_q15(q15_t x)
+{
+	double phase = (double)(x & 0x7FFF) * (2.0 * M_PI / 32768.0);
+	return clip_q15(lrint(sin(phase) * 32768.0));
+}
+
+// input 0 to 0x7FFFFFFF represents 0 to 2*pi
+q31_t arm_sin_q31(q31_t x)
+{
+	double phase = (double)(x & 0x7FFFFFFF) * (2.0 * M_PI / 2147483648.0);
+	return clip_q31(llrint(sin(phase) * 2147483648.0));
+}
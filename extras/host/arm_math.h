@@ -0,0 +1,118 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Portable C versions of the few CMSIS-DSP functions used by the audio
+// library.  The fixed point scaling follows the CMSIS documentation, so
+// results agree with Teensy to within rounding of the last bit, but are
+// not guaranteed to be bit-identical.
+
+#ifndef arm_math_h_
+#define arm_math_h_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int8_t q7_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef int64_t q63_t;
+typedef float float32_t;
+typedef double float64_t;
+
+typedef enum {
+	ARM_MATH_SUCCESS = 0,
+	ARM_MATH_ARGUMENT_ERROR = -1,
+	ARM_MATH_LENGTH_ERROR = -2,
+	ARM_MATH_SIZE_MISMATCH = -3,
+	ARM_MATH_NANINF = -4,
+	ARM_MATH_SINGULAR = -5,
+	ARM_MATH_TEST_FAILURE = -6
+} arm_status;
+
+#define ARM_HOST_MAX_FFT_SIZE 4096
+
+typedef struct {
+	uint16_t fftLen;
+	uint8_t ifftFlag;
+	uint8_t bitReverseFlag;
+	q15_t *pTwiddle;
+	uint16_t *pBitRevTable;
+	uint16_t twidCoefModifier;
+	uint16_t bitRevFactor;
+} arm_cfft_radix4_instance_q15;
+
+typedef struct {
+	uint16_t fftLen;
+	uint8_t ifftFlag;
+	uint8_t bitReverseFlag;
+	float32_t *pTwiddle;
+	uint16_t *pBitRevTable;
+	uint16_t twidCoefModifier;
+	uint16_t bitRevFactor;
+	float32_t onebyfftLen;
+} arm_cfft_radix2_instance_f32;
+
+typedef struct {
+	uint16_t numTaps;
+	q15_t *pState;
+	const q15_t *pCoeffs;
+} arm_fir_instance_q15;
+
+// Complex FFT, interleaved real/imaginary data.  The output is scaled
+// down by fftLen, the same as the CMSIS radix-4 Q15 FFT.
+arm_status arm_cfft_radix4_init_q15(arm_cfft_radix4_instance_q15 *S,
+	uint16_t fftLen, uint8_t ifftFlag, uint8_t bitReverseFlag);
+void arm_cfft_radix4_q15(const arm_cfft_radix4_instance_q15 *S, q15_t *pSrc);
+
+// Complex floating point FFT.  Like CMSIS, the forward transform is not
+// scaled and the inverse transform is scaled by 1/fftLen.
+arm_status arm_cfft_radix2_init_f32(arm_cfft_radix2_instance_f32 *S,
+	uint16_t fftLen, uint8_t ifftFlag, uint8_t bitReverseFlag);
+void arm_cfft_radix2_f32(const arm_cfft_radix2_instance_f32 *S, float32_t *pSrc);
+
+// FIR filter, coefficients are stored in time reversed order and the
+// state buffer must hold numTaps + blockSize - 1 samples.
+arm_status arm_fir_init_q15(arm_fir_instance_q15 *S, uint16_t numTaps,
+	const q15_t *pCoeffs, q15_t *pState, uint32_t blockSize);
+void arm_fir_fast_q15(const arm_fir_instance_q15 *S, const q15_t *pSrc,
+	q15_t *pDst, uint32_t blockSize);
+
+void arm_add_q31(const q31_t *pSrcA, const q31_t *pSrcB, q31_t *pDst, uint32_t blockSize);
+void arm_shift_q31(const q31_t *pSrc, int8_t shiftBits, q31_t *pDst, uint32_t blockSize);
+void arm_float_to_q31(const float32_t *pSrc, q31_t *pDst, uint32_t blockSize);
+void arm_q15_to_q31(const q15_t *pSrc, q31_t *pDst, uint32_t blockSize);
+void arm_q31_to_q15(const q31_t *pSrc, q15_t *pDst, uint32_t blockSize);
+q15_t arm_sin_q15(q15_t x);
+q31_t arm_sin_q31(q31_t x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+// Benchmark: biquad filter precision
+//
+// Measures AudioFilterBiquad's CPU time for 1 to 4 stages, with 16 bit,
+// 32 bit and float processing, and the output error of each compared to
+// a double precision reference, for low pass filters at 40 Hz, where 16
+// bit processing is noisy.  "ideal" is the reference rounded to 16 bits.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+#define BLOCKS 2000
+
+AudioSynthNoiseWhite     noise;
+AudioFilterBiquad        filter[3];
+AudioRecordQueue         inRec;
+AudioRecordQueue         outRec[3];
+AudioConnection          patchCord1(noise, inRec);
+AudioConnection          patchCord2(noise, filter[0]);
+AudioConnection          patchCord3(noise, filter[1]);
+AudioConnection          patchCord4(noise, filter[2]);
+AudioConnection          patchCord5(filter[0], outRec[0]);
+AudioConnection          patchCord6(filter[1], outRec[1]);
+AudioConnection          patchCord7(filter[2], outRec[2]);
+
+const char *names[3] = {"16 bit", "32 bit", "float"};
+
+// the same cookbook low pass as AudioFilterBiquad::setLowpass()
+void lowpass(double *coef, double frequency, double q)
+{
+  double w0 = frequency * (2 * 3.141592654 / AUDIO_SAMPLE_RATE_EXACT);
+  double alpha = sin(w0) / (q * 2.0);
+  double scale = 1.0 / (1.0 + alpha);
+  coef[0] = (1.0 - cos(w0)) / 2.0 * scale;
+  coef[1] = (1.0 - cos(w0)) * scale;
+  coef[2] = coef[0];
+  coef[3] = -2.0 * cos(w0) * scale;
+  coef[4] = (1.0 - alpha) * scale;
+}
+
+int main()
+{
+  AudioMemory(20);
+  noise.amplitude(0.5);
+  inRec.begin();
+  for (int m=0; m < 3; m++) {
+    filter[m].setPrecision(m);
+    outRec[m].begin();
+  }
+  printf("stages  %12s %12s %12s %12s\n", names[0], names[1], names[2], "ideal");
+  for (int stages=1; stages <= 4; stages++) {
+    double coef[5], s1[4] = {0}, s2[4] = {0};
+    lowpass(coef, 40.0, 0.7071);
+    for (int m=0; m < 3; m++) {
+      filter[m].setPrecision(BIQUAD_16BIT); // reset state
+      filter[m].setPrecision(m);
+      for (int n=0; n < stages; n++) filter[m].setCoefficients(n, coef);
+    }
+    uint64_t cycles[3] = {0, 0, 0};
+    double errsq[3] = {0, 0, 0}, refsq = 0, roundsq = 0;
+    for (int b=0; b < BLOCKS; b++) {
+      AudioStream::update_all();
+      const int16_t *in = inRec.readBuffer();
+      const int16_t *out[3];
+      for (int m=0; m < 3; m++) {
+        cycles[m] += filter[m].cpu_cycles;
+        out[m] = outRec[m].readBuffer();
+      }
+      for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        double x = in[i];
+        for (int n=0; n < stages; n++) {
+          double y = coef[0] * x + s1[n];
+          s1[n] = coef[1] * x - coef[3] * y + s2[n];
+          s2[n] = coef[2] * x - coef[4] * y;
+          x = y;
+        }
+        if (b < BLOCKS / 4) continue; // allow the filters to settle
+        refsq += x * x;
+        roundsq += (lrint(x) - x) * (lrint(x) - x);
+        for (int m=0; m < 3; m++) errsq[m] += (out[m][i] - x) * (out[m][i] - x);
+      }
+      inRec.freeBuffer();
+      for (int m=0; m < 3; m++) outRec[m].freeBuffer();
+    }
+    printf("%6d  %12.0f %12.0f %12.0f   cycles/block\n", stages, cycles[0] * 64.0 / BLOCKS,
+      cycles[1] * 64.0 / BLOCKS, cycles[2] * 64.0 / BLOCKS);
+    printf("   SNR  %9.1f dB %9.1f dB %9.1f dB %9.1f dB\n",
+      10.0 * log10(refsq / errsq[0]), 10.0 * log10(refsq / errsq[1]),
+      10.0 * log10(refsq / errsq[2]), 10.0 * log10(refsq / roundsq));
+  }
+  return 0;
+}
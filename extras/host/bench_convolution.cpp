@@ -0,0 +1,87 @@
+// Benchmark: long FIR filters
+//
+// Compares AudioFilterConvolution against direct form FIR filtering
+// (arm_fir_fast_q15, as used by AudioFilterFIR) for 64 to 16384 taps,
+// and checks the convolution output against a double precision
+// reference.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+#define MAX_TAPS  16384
+#define BLOCKS    200
+#define CHECK     20     // blocks compared with the reference
+
+AudioSynthNoiseWhite     noise;
+AudioFilterConvolution   conv;
+AudioRecordQueue         inRec;
+AudioRecordQueue         outRec;
+AudioConnection          patchCord1(noise, conv);
+AudioConnection          patchCord2(noise, inRec);
+AudioConnection          patchCord3(conv, outRec);
+
+float irmem[AUDIO_CONVOLUTION_MEMORY(MAX_TAPS)];
+int16_t coeffs[MAX_TAPS];
+int16_t reversed[MAX_TAPS];
+int16_t firState[MAX_TAPS + AUDIO_BLOCK_SAMPLES];
+int16_t firOut[AUDIO_BLOCK_SAMPLES];
+int16_t inHistory[BLOCKS * AUDIO_BLOCK_SAMPLES];
+int16_t outHistory[BLOCKS * AUDIO_BLOCK_SAMPLES];
+
+// random impulse response, decaying by 60 dB, scaled so output rarely clips
+void makeImpulse(int taps)
+{
+  double sum = 0.0;
+  static double h[MAX_TAPS];
+  for (int i=0; i < taps; i++) {
+    h[i] = (random(65536) - 32768) * pow(0.001, (double)i / taps);
+    sum += fabs(h[i]);
+  }
+  for (int i=0; i < taps; i++) {
+    coeffs[i] = lrint(h[i] * (4.0 * 32767.0 / sum));
+    reversed[taps - 1 - i] = coeffs[i];
+  }
+}
+
+int main()
+{
+  AudioMemory(20);
+  noise.amplitude(0.5);
+  inRec.begin();
+  outRec.begin();
+  printf("  taps   direct FIR   convolution   (cycles/block)   max error\n");
+  for (int taps=64; taps <= MAX_TAPS; taps *= 2) {
+    makeImpulse(taps);
+    conv.begin(coeffs, taps, irmem);
+    arm_fir_instance_q15 fir;
+    arm_fir_init_q15(&fir, taps, reversed, firState, AUDIO_BLOCK_SAMPLES);
+
+    uint64_t fir_cycles = 0, conv_cycles = 0;
+    for (int b=0; b < BLOCKS; b++) {
+      AudioStream::update_all();
+      conv_cycles += conv.cpu_cycles;
+      memcpy(inHistory + b * AUDIO_BLOCK_SAMPLES, inRec.readBuffer(), AUDIO_BLOCK_SAMPLES * 2);
+      memcpy(outHistory + b * AUDIO_BLOCK_SAMPLES, outRec.readBuffer(), AUDIO_BLOCK_SAMPLES * 2);
+      inRec.freeBuffer();
+      outRec.freeBuffer();
+      uint32_t t = host_cycle_count();
+      arm_fir_fast_q15(&fir, inHistory + b * AUDIO_BLOCK_SAMPLES, firOut, AUDIO_BLOCK_SAMPLES);
+      fir_cycles += host_cycle_count() - t;
+    }
+
+    int maxerr = 0;
+    for (int n = (BLOCKS - CHECK) * AUDIO_BLOCK_SAMPLES; n < BLOCKS * AUDIO_BLOCK_SAMPLES; n++) {
+      double y = 0.0;
+      for (int i=0; i < taps && i <= n; i++) y += (double)coeffs[i] * inHistory[n - i];
+      y /= 32768.0;
+      if (y > 32767.0) y = 32767.0;
+      if (y < -32768.0) y = -32768.0;
+      int err = abs((int)lrint(y) - outHistory[n]);
+      if (err > maxerr) maxerr = err;
+    }
+    printf("%6d %12.0f %13.0f %29d\n", taps, (double)fir_cycles / BLOCKS,
+      conv_cycles * 64.0 / BLOCKS, maxerr);
+  }
+  return 0;
+}
@@ -0,0 +1,321 @@
+// Benchmark: AudioEffectDelay fractional, modulated and gliding taps
+//
+// Checks that taps without interpolation still give whole sample delays,
+// exactly.  Then delays sines by a fractional time with each
+// interpolation, and modulates the delay by input 1 like tape wow, and
+// shows how far each output is from the ideal delayed sine.  A delay
+// change with and without slew() shows the largest jump in the output.
+// A full scale square wave checks that interpolation which overshoots
+// is clamped, instead of wrapping around.  Then the CPU cycles per block with 8 taps.  A second delay with the
+// same settings keeps its history in a ring buffer given to begin(),
+// and must give the same output as the queue of audio blocks, for every
+// test.  Last, the ring buffer delays by seconds, without AudioMemory().
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <algorithm>
+#include <vector>
+
+AudioPlayQueue           queue1;
+AudioPlayQueue           queue2;
+AudioEffectDelay         delay1;
+AudioEffectDelay         delay2;
+AudioRecordQueue         rec[8];
+AudioRecordQueue         rec2[8];
+AudioConnection          patchCord1(queue1, 0, delay1, 0);
+AudioConnection          patchCord2(queue2, 0, delay1, 1);
+AudioConnection          patchCord3(delay1, 0, rec[0], 0);
+AudioConnection          patchCord4(delay1, 1, rec[1], 0);
+AudioConnection          patchCord5(delay1, 2, rec[2], 0);
+AudioConnection          patchCord6(delay1, 3, rec[3], 0);
+AudioConnection          patchCord7(delay1, 4, rec[4], 0);
+AudioConnection          patchCord8(delay1, 5, rec[5], 0);
+AudioConnection          patchCord9(delay1, 6, rec[6], 0);
+AudioConnection          patchCord10(delay1, 7, rec[7], 0);
+AudioConnection          patchCord11(queue1, 0, delay2, 0);
+AudioConnection          patchCord12(queue2, 0, delay2, 1);
+AudioConnection          *patchCords[8];
+
+AudioEffectDelay *delays[2] = {&delay1, &delay2};
+
+// 3 seconds
+#define RING_LENGTH 132300
+int16_t ringMemory[RING_LENGTH];
+
+const int modes[4] = {DELAY_INTERPOLATION_NONE, DELAY_INTERPOLATION_LINEAR,
+  DELAY_INTERPOLATION_ALLPASS, DELAY_INTERPOLATION_CUBIC};
+const char *names[4] = {"none", "linear", "allpass", "cubic"};
+const double fs = AUDIO_SAMPLE_RATE_EXACT;
+
+// input 0 is a sine or noise, input 1 (modulation) a slow sine
+double sine_freq = 1000, mod_freq = 0, mod_level = 0;
+bool noise = false, square = false;
+#define HISTORY_MASK ((1 << 18) - 1)
+int16_t history[HISTORY_MASK + 1];
+uint32_t t = 0;
+
+double input(double time) {
+  if (square) return (fmod(time, 64.0) < 32.0) ? 32000 : -32000;
+  return 20000 * sin(2 * M_PI * sine_freq * time / fs);
+}
+int16_t mod_input(uint32_t time) {
+  return round(mod_level * 32767 * sin(2 * M_PI * mod_freq * time / fs));
+}
+
+std::vector<uint32_t> cycles, cycles2;
+// the queue frees blocks older than the longest delay, so after a delay
+// is made longer it gives silence where the ring buffer has the signal
+uint32_t ring_mismatch = 0, ring_longer = 0, settle = 0;
+bool ring_only = false;
+
+// one update, out[tap][sample] are the outputs
+void update(int16_t out[8][AUDIO_BLOCK_SAMPLES]) {
+  int16_t *p1 = queue1.getBuffer();
+  int16_t *p2 = queue2.getBuffer();
+  for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    p1[i] = noise ? random(-20000, 20001) : round(input(t + i));
+    history[(t + i) & HISTORY_MASK] = p1[i];
+    p2[i] = mod_input(t + i);
+  }
+  queue1.playBuffer();
+  queue2.playBuffer();
+  AudioStream::update_all();
+  cycles.push_back(delay1.cpu_cycles * 64);
+  cycles2.push_back(delay2.cpu_cycles * 64);
+  for (int k=0; k < 8; k++) {
+    int16_t *p = rec[k].readBuffer();
+    if (p) memcpy(out[k], p, sizeof(out[k]));
+    else memset(out[k], 0, sizeof(out[k]));
+    if (p) rec[k].freeBuffer();
+    // the ring buffer's output, to compare, or to use alone
+    p = rec2[k].readBuffer();
+    int16_t zeros[AUDIO_BLOCK_SAMPLES] = {};
+    if (!p) p = zeros;
+    if (ring_only) memcpy(out[k], p, sizeof(out[k]));
+    else if (memcmp(out[k], p, sizeof(out[k])) != 0) {
+      if (settle) ring_longer++;
+      else ring_mismatch++;
+    }
+    if (p != zeros) rec2[k].freeBuffer();
+  }
+  t += AUDIO_BLOCK_SAMPLES;
+  if (settle) settle--;
+}
+
+void setup_taps(float ms, float depth_ms, float slew_ms) {
+  for (AudioEffectDelay *d : delays) {
+    for (int k=0; k < 8; k++) {
+      d->disable(k);
+      d->interpolation(k, modes[k % 4]);
+      d->modulation(k, depth_ms);
+      d->slew(k, slew_ms);
+      d->delay(k, ms);
+    }
+  }
+  settle = 60;
+}
+
+// error of taps 0-3 from the ideal delay of the sine, in dB
+void measure_error(double ms, double depth_ms, int blocks, double err[4]) {
+  double sig = 0, e[4] = {};
+  int16_t out[8][AUDIO_BLOCK_SAMPLES];
+  for (int b=0; b < blocks; b++) {
+    uint32_t t0 = t;
+    update(out);
+    if (b < 60) continue;   // fill the delay
+    for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      double d = (ms + depth_ms * mod_input(t0 + i) / 32768.0) * fs / 1000;
+      double ideal = input(t0 + i - d);
+      sig += ideal * ideal;
+      for (int k=0; k < 4; k++) {
+        double diff = out[k][i] - ideal;
+        e[k] += diff * diff;
+      }
+    }
+  }
+  for (int k=0; k < 4; k++) err[k] = 10 * log10(e[k] / sig);
+}
+
+int main()
+{
+  AudioMemory(120);
+  for (int k=0; k < 8; k++) {
+    patchCords[k] = new AudioConnection(delay2, k, rec2[k], 0);
+    rec[k].begin();
+    rec2[k].begin();
+  }
+  delay2.begin(ringMemory, RING_LENGTH);
+  int16_t out[8][AUDIO_BLOCK_SAMPLES];
+
+  // whole samples, with delays on and between block boundaries
+  const float whole_ms[8] = {0, 1.0, 2.9, 5.2, 17.3, 58.05, 100.0, 130.0};
+  noise = true;
+  for (AudioEffectDelay *d : delays) {
+    for (int k=0; k < 8; k++) {
+      d->interpolation(k, DELAY_INTERPOLATION_NONE);
+      d->delay(k, whole_ms[k]);
+    }
+  }
+  uint32_t mismatch = 0, checked = 0;
+  for (int b=0; b < 200; b++) {
+    uint32_t t0 = t;
+    update(out);
+    if (b < 60) continue;
+    for (int k=0; k < 8; k++) {
+      uint32_t n = (uint32_t)(whole_ms[k] * (fs / 1000.0) + 0.5);
+      for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        if (out[k][i] != history[(t0 + i - n) & HISTORY_MASK]) mismatch++;
+        checked++;
+      }
+    }
+  }
+  printf("Whole sample delays: %u of %u samples differ\n\n", mismatch, checked);
+  noise = false;
+
+  double err[4];
+  printf("Fixed delay of 10.37 ms, error from the ideal delayed sine:\n");
+  printf("  %8s", "");
+  for (int m=0; m < 4; m++) printf(" %9s", names[m]);
+  printf("\n");
+  const double freqs[] = {200, 1000, 4000, 10000};
+  for (double f : freqs) {
+    sine_freq = f;
+    setup_taps(10.37, 0, 0);
+    measure_error(10.37, 0, 400, err);
+    printf("  %5.0f Hz", f);
+    for (int m=0; m < 4; m++) printf(" %6.1f dB", err[m]);
+    printf("\n");
+  }
+
+  printf("\nModulated by a 4 Hz sine on input 1, 20 ms +/- 1 ms:\n");
+  mod_freq = 4;
+  mod_level = 0.9;
+  const double mod_freqs[] = {200, 1000, 4000};
+  for (double f : mod_freqs) {
+    sine_freq = f;
+    setup_taps(20, 1, 0);
+    measure_error(20, 1, 800, err);
+    printf("  %5.0f Hz", f);
+    for (int m=0; m < 4; m++) printf(" %6.1f dB", err[m]);
+    printf("\n");
+  }
+  mod_level = 0;
+
+  // change from 20 to 60 ms, the largest step between output samples
+  // compared to the sine's largest step
+  printf("\nDelay changed from 20 to 60 ms, 200 Hz sine, largest step:\n");
+  sine_freq = 200;
+  const float slews[] = {0, 50, 300};
+  for (float slew : slews) {
+    setup_taps(20, 0, slew);
+    for (int b=0; b < 60; b++) update(out);
+    for (int k=0; k < 8; k++) {
+      delay1.delay(k, 60);
+      delay2.delay(k, 60);
+    }
+    settle = 60;
+    double largest[4] = {};
+    int16_t prev[4];
+    for (int k=0; k < 4; k++) prev[k] = out[k][AUDIO_BLOCK_SAMPLES - 1];
+    for (int b=0; b < 200; b++) {
+      update(out);
+      for (int k=0; k < 4; k++) {
+        for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+          double step = fabs(out[k][i] - prev[k]);
+          if (step > largest[k]) largest[k] = step;
+          prev[k] = out[k][i];
+        }
+      }
+    }
+    double sine_step = 20000 * 2 * M_PI * sine_freq / fs;
+    printf("  slew %3.0f ms", slew);
+    for (int m=0; m < 4; m++) printf("  %s %5.1fx", names[m], largest[m] / sine_step);
+    printf("\n");
+  }
+
+  // +/- 32000 square wave, delayed 10.5 samples.  Away from the edges
+  // the output must have the input's sign, a wrapped sample has not.
+  printf("\nFull scale square wave, delayed 10.5 samples:\n");
+  square = true;
+  setup_taps(10.5 * 1000.0 / fs, 0, 0);
+  int32_t wrapped[4] = {}, largest[4] = {};
+  for (int b=0; b < 200; b++) {
+    uint32_t t0 = t;
+    update(out);
+    if (b < 10) continue;
+    for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      int16_t near = history[(t0 + i - 8) & HISTORY_MASK];
+      bool flat = true;
+      for (int j=9; j <= 13; j++) {
+        if (history[(t0 + i - j) & HISTORY_MASK] != near) flat = false;
+      }
+      for (int k=0; k < 4; k++) {
+        if (abs(out[k][i]) > largest[k]) largest[k] = abs(out[k][i]);
+        if (flat && (out[k][i] > 0) != (near > 0)) wrapped[k]++;
+      }
+    }
+  }
+  for (int m=0; m < 4; m++) {
+    printf("  %-8s largest %5d, %d samples wrapped\n", names[m], largest[m], wrapped[m]);
+  }
+  square = false;
+
+  printf("\nCPU cycles per block, 8 taps:\n");
+  for (int m=0; m < 5; m++) {
+    for (AudioEffectDelay *d : delays) {
+      for (int k=0; k < 8; k++) {
+        d->disable(k);
+        d->interpolation(k, modes[m < 4 ? m : 3]);
+        d->slew(k, 0);
+        d->modulation(k, m < 4 ? 0 : 1);
+        d->delay(k, 5 + k * 13.1);
+      }
+    }
+    settle = 60;
+    mod_level = (m < 4) ? 0 : 0.9;
+    for (int b=0; b < 60; b++) update(out);
+    cycles.clear();
+    cycles2.clear();
+    for (int b=0; b < 1000; b++) update(out);
+    std::sort(cycles.begin(), cycles.end());
+    std::sort(cycles2.begin(), cycles2.end());
+    printf("  %-18s %7u median, %7u 99th percentile, ring buffer %7u, %7u\n",
+      m < 4 ? names[m] : "cubic, modulated", cycles[500], cycles[990],
+      cycles2[500], cycles2[990]);
+  }
+  mod_level = 0;
+  printf("\nRing buffer output differs from the queue in %u blocks, and in %u\n"
+    "blocks after delays were made longer\n", ring_mismatch, ring_longer);
+
+  // only the ring buffer, with delays of seconds
+  printf("\nRing buffer of %.2f seconds, whole sample delays:\n", RING_LENGTH / fs);
+  for (int k=0; k < 8; k++) delay1.disable(k);
+  for (int b=0; b < 100; b++) update(out);
+  printf("  %d audio blocks used by the queue, before\n", AudioMemoryUsageMax());
+  AudioMemoryUsageMaxReset();
+  ring_only = true;
+  noise = true;
+  const float long_ms[8] = {0, 250.0, 500.5, 1000.0, 1500.3, 2000.0, 2500.7, 2996.0};
+  for (int k=0; k < 8; k++) {
+    delay2.interpolation(k, DELAY_INTERPOLATION_NONE);
+    delay2.delay(k, long_ms[k]);
+  }
+  mismatch = 0;
+  checked = 0;
+  for (int b=0; b < 1600; b++) {
+    uint32_t t0 = t;
+    update(out);
+    if (b < 1100) continue;
+    for (int k=0; k < 8; k++) {
+      uint32_t n = (uint32_t)(long_ms[k] * (fs / 1000.0) + 0.5);
+      for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        if (out[k][i] != history[(t0 + i - n) & HISTORY_MASK]) mismatch++;
+        checked++;
+      }
+    }
+  }
+  printf("  up to %.0f ms: %u of %u samples differ\n", long_ms[7], mismatch, checked);
+  printf("  %d audio blocks used with the ring buffer\n", AudioMemoryUsageMax());
+  return 0;
+}
@@ -0,0 +1,106 @@
+// Benchmark: AudioAnalyzeFFT1024 real FFT and distributed work
+//
+// Runs a sine plus noise into two AudioAnalyzeFFT1024, one computing
+// each FFT in a single update and the other with distributeWork(),
+// and compares the average update time and the slowest of every 4
+// updates (averaged, because a PC has occasional long interruptions).  The output of the
+// first is checked against a double precision DFT of the same samples,
+// and the second must give exactly the same spectra, 3 updates later.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+#define BLOCKS 4000
+
+AudioSynthWaveformSine   sine1;
+AudioSynthNoiseWhite     noise1;
+AudioMixer4              mixer1;
+AudioAnalyzeFFT1024      fftSingle;
+AudioAnalyzeFFT1024      fftSpread;
+AudioRecordQueue         queue1;
+AudioConnection          patchCord1(sine1, 0, mixer1, 0);
+AudioConnection          patchCord2(noise1, 0, mixer1, 1);
+AudioConnection          patchCord3(mixer1, fftSingle);
+AudioConnection          patchCord4(mixer1, fftSpread);
+AudioConnection          patchCord5(mixer1, queue1);
+
+int16_t samples[BLOCKS * AUDIO_BLOCK_SAMPLES];
+uint16_t spectra[BLOCKS / 4 + 1][512];
+
+// largest difference from a DFT of the 1024 samples ending at "end"
+static double dftError(const uint16_t *output, int end)
+{
+  double worst = 0;
+  const int16_t *x = samples + end - 1024;
+  for (int k=0; k < 512; k++) {
+    double re = 0, im = 0;
+    for (int n=0; n < 1024; n++) {
+      double v = x[n] * (AudioWindowHanning1024[n] / 32768.0);
+      re += v * cos(2.0 * M_PI * k * n / 1024.0);
+      im -= v * sin(2.0 * M_PI * k * n / 1024.0);
+    }
+    double err = fabs(output[k] - sqrt(re * re + im * im) / 1024.0);
+    if (err > worst) worst = err;
+  }
+  return worst;
+}
+
+int main()
+{
+  AudioMemory(40);
+  sine1.frequency(1234.5);
+  sine1.amplitude(0.8);
+  noise1.amplitude(0.1);
+  fftSpread.distributeWork(true);
+  queue1.begin();
+
+  uint64_t single_sum = 0, spread_sum = 0, single_peak = 0, spread_peak = 0;
+  uint32_t single_max = 0, spread_max = 0;
+  int n = 0, single_count = 0, spread_count = 0, differences = 0;
+  double error = 0;
+  for (int b=0; b < BLOCKS; b++) {
+    AudioStream::update_all();
+    while (queue1.available()) {
+      memcpy(samples + n, queue1.readBuffer(), AUDIO_BLOCK_SAMPLES * 2);
+      n += AUDIO_BLOCK_SAMPLES;
+      queue1.freeBuffer();
+    }
+    // skip the first FFTs, while the blocks are being allocated
+    if (b > 16) {
+      single_sum += fftSingle.cpu_cycles;
+      spread_sum += fftSpread.cpu_cycles;
+      if (fftSingle.cpu_cycles > single_max) single_max = fftSingle.cpu_cycles;
+      if (fftSpread.cpu_cycles > spread_max) spread_max = fftSpread.cpu_cycles;
+      if (b % 4 == 0) {
+        single_peak += single_max;
+        spread_peak += spread_max;
+        single_max = 0;
+        spread_max = 0;
+      }
+    }
+    if (fftSingle.available()) {
+      memcpy(spectra[single_count], fftSingle.output, sizeof(spectra[0]));
+      if (single_count < 10) {
+        double e = dftError(fftSingle.output, n);
+        if (e > error) error = e;
+      }
+      single_count++;
+    }
+    if (fftSpread.available()) {
+      if (memcmp(spectra[spread_count], fftSpread.output, sizeof(spectra[0]))) {
+        differences++;
+      }
+      spread_count++;
+    }
+  }
+  int updates = BLOCKS - 17;
+  printf("single update:    %6.0f cycles/update average, %6.0f peak\n",
+    single_sum * 64.0 / updates, single_peak * 256.0 / updates);
+  printf("distributeWork(): %6.0f cycles/update average, %6.0f peak\n",
+    spread_sum * 64.0 / updates, spread_peak * 256.0 / updates);
+  printf("spectra: %d and %d, with different output: %d\n",
+    single_count, spread_count, differences);
+  printf("largest error from DFT: %.2f (output units, read() = output / 16384)\n", error);
+  return 0;
+}
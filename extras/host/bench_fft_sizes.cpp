@@ -0,0 +1,141 @@
+// Benchmark: AudioAnalyzeFFT<N> sizes 256 to 8192, 16 bit and float
+//
+// Runs a quiet sine plus noise into every size and type at once.  The
+// first spectrum of each is checked against a double precision DFT of
+// the same samples, with the same window, and the update time is
+// compared.  The peak is the 99th percentile update, because a PC has
+// occasional long interruptions.  AudioAnalyzeFFT<1024> is also compared
+// to AudioAnalyzeFFT1024.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <algorithm>
+#include <vector>
+
+#define BLOCKS 1200
+
+AudioSynthWaveformSine   sine1;
+AudioSynthNoiseWhite     noise1;
+AudioMixer4              mixer1;
+AudioRecordQueue         queue1;
+AudioAnalyzeFFT1024      fftOld;
+AudioAnalyzeFFT<256>             fft256;
+AudioAnalyzeFFT<512>             fft512;
+AudioAnalyzeFFT<1024>            fft1024;
+AudioAnalyzeFFT<2048>            fft2048;
+AudioAnalyzeFFT<4096>            fft4096;
+AudioAnalyzeFFT<8192>            fft8192;
+AudioAnalyzeFFT<256, float>      fft256f;
+AudioAnalyzeFFT<512, float>      fft512f;
+AudioAnalyzeFFT<1024, float>     fft1024f;
+AudioAnalyzeFFT<2048, float>     fft2048f;
+AudioAnalyzeFFT<4096, float>     fft4096f;
+uint32_t fftmem[AUDIO_FFT_MEMORY(8192, float)];
+AudioAnalyzeFFT<8192, float>     fft8192f(fftmem);
+AudioConnection          patchCord1(sine1, 0, mixer1, 0);
+AudioConnection          patchCord2(noise1, 0, mixer1, 1);
+AudioConnection          patchCord3(mixer1, queue1);
+AudioConnection          patchCord4(mixer1, fftOld);
+AudioConnection          c1(mixer1, fft256), c2(mixer1, fft512), c3(mixer1, fft1024);
+AudioConnection          c4(mixer1, fft2048), c5(mixer1, fft4096), c6(mixer1, fft8192);
+AudioConnection          c7(mixer1, fft256f), c8(mixer1, fft512f), c9(mixer1, fft1024f);
+AudioConnection          c10(mixer1, fft2048f), c11(mixer1, fft4096f), c12(mixer1, fft8192f);
+
+struct Test {
+  const char *name;
+  AudioAnalyzeFFTBase *fft;
+  int size;
+  std::vector<uint32_t> cycles;
+  double error;
+  bool done;
+};
+
+Test tests[] = {
+  {"<256>", &fft256, 256}, {"<512>", &fft512, 512}, {"<1024>", &fft1024, 1024},
+  {"<2048>", &fft2048, 2048}, {"<4096>", &fft4096, 4096}, {"<8192>", &fft8192, 8192},
+  {"<256, float>", &fft256f, 256}, {"<512, float>", &fft512f, 512},
+  {"<1024, float>", &fft1024f, 1024}, {"<2048, float>", &fft2048f, 2048},
+  {"<4096, float>", &fft4096f, 4096}, {"<8192, float>", &fft8192f, 8192}
+};
+
+int16_t samples[BLOCKS * AUDIO_BLOCK_SAMPLES];
+
+// periodic Hanning window, like the one computed by AudioAnalyzeFFT
+static double hanning(int n, int size)
+{
+  return 0.5 - 0.5 * cos(2.0 * M_PI * n / size);
+}
+
+// largest difference from a DFT of the samples ending at "end"
+static double dftError(Test &t, int end)
+{
+  int size = t.size;
+  const int16_t *x = samples + end - size;
+  std::vector<double> c(size), s(size);
+  for (int i=0; i < size; i++) {
+    c[i] = cos(2.0 * M_PI * i / size);
+    s[i] = sin(2.0 * M_PI * i / size);
+  }
+  double worst = 0;
+  for (int k=0; k < size / 2; k++) {
+    double re = 0, im = 0;
+    for (int n=0; n < size; n++) {
+      double v = x[n] / 32768.0 * hanning(n, size);
+      int j = (int)(((long)k * n) % size);
+      re += v * c[j];
+      im -= v * s[j];
+    }
+    double err = fabs(t.fft->read(k) - 2.0 * sqrt(re * re + im * im) / size);
+    if (err > worst) worst = err;
+  }
+  return worst;
+}
+
+int main()
+{
+  AudioMemory(200);
+  sine1.frequency(1234.5);
+  sine1.amplitude(0.01);
+  noise1.amplitude(0.001);
+  queue1.begin();
+
+  int n = 0, oldCount = 0;
+  double oldDiff = 0;
+  for (int b=0; b < BLOCKS; b++) {
+    AudioStream::update_all();
+    while (queue1.available()) {
+      memcpy(samples + n, queue1.readBuffer(), AUDIO_BLOCK_SAMPLES * 2);
+      n += AUDIO_BLOCK_SAMPLES;
+      queue1.freeBuffer();
+    }
+    for (Test &t : tests) {
+      if (b > 70) t.cycles.push_back(t.fft->cpu_cycles);
+      if (!t.done && t.fft->available()) {
+        t.error = dftError(t, n);
+        t.done = true;
+      }
+    }
+    // same signal, window and scaling, so only rounding should differ
+    if (fftOld.available() && fft1024.available()) {
+      for (int k=0; k < 512; k++) {
+        double d = fabs(fftOld.read(k) - fft1024.read(k));
+        if (d > oldDiff) oldDiff = d;
+      }
+      oldCount++;
+    }
+  }
+  printf("sine at -40 dB, noise at -60 dB, error compared to a DFT\n");
+  printf("%-22s %8s %8s %12s\n", "AudioAnalyzeFFT", "average", "peak", "error");
+  for (Test &t : tests) {
+    std::vector<uint32_t> c = t.cycles;
+    double sum = 0;
+    for (uint32_t v : c) sum += v;
+    std::sort(c.begin(), c.end());
+    printf("%-22s %8.0f %8u %9.1f dB\n", t.name, sum * 64.0 / c.size(),
+      c[c.size() * 99 / 100] * 64, 20.0 * log10(t.error + 1e-12));
+  }
+  printf("AudioAnalyzeFFT1024 versus AudioAnalyzeFFT<1024>: %d spectra, "
+    "largest difference %.1f dB\n", oldCount, 20.0 * log10(oldDiff + 1e-12));
+  return 0;
+}
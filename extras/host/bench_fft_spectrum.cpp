@@ -0,0 +1,224 @@
+// Benchmark: FFT analyzer overlap, averaging and log / mel bands
+//
+// Counts how often AudioAnalyzeFFT256 and AudioAnalyzeFFT1024 give a
+// new spectrum with 25, 50 and 75% overlap, and compares the update
+// time.  With 75% overlap, the FFT256 spectrum is checked against a
+// DFT of the 256 samples it should have used.  Then the spread of a
+// bin of white noise is measured without averaging, with a running
+// mean of 8 spectra and with exponential averaging.  A small steady
+// sine must read the same with and without averaging, in FFT256,
+// FFT1024 and AudioAnalyzeFFT<2048>.  Finally a sine is swept through
+// 12 log spaced bands, to show which band it lands in.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+#define BLOCKS 2400
+
+AudioSynthWaveformSine   sine1;
+AudioSynthNoiseWhite     noise1;
+AudioMixer4              mixer1;
+AudioAnalyzeFFT256       fft256;
+AudioAnalyzeFFT1024      fft1024;
+AudioAnalyzeFFT<2048>    fft2048;
+AudioRecordQueue         queue1;
+AudioConnection          patchCord1(sine1, 0, mixer1, 0);
+AudioConnection          patchCord2(noise1, 0, mixer1, 1);
+AudioConnection          patchCord3(mixer1, fft256);
+AudioConnection          patchCord4(mixer1, fft1024);
+AudioConnection          patchCord5(mixer1, queue1);
+AudioConnection          patchCord6(mixer1, fft2048);
+
+int16_t samples[BLOCKS * AUDIO_BLOCK_SAMPLES];
+int nsamples;
+double cycles256, cycles1024;
+
+static void run(int blocks, int *count256, int *count1024, double *error)
+{
+  uint64_t sum256 = 0, sum1024 = 0;
+  int c256 = 0, c1024 = 0;
+  double worst = 0;
+  nsamples = 0;
+  for (int b=0; b < blocks; b++) {
+    AudioStream::update_all();
+    while (queue1.available()) {
+      memcpy(samples + nsamples, queue1.readBuffer(), AUDIO_BLOCK_SAMPLES * 2);
+      nsamples += AUDIO_BLOCK_SAMPLES;
+      queue1.freeBuffer();
+    }
+    sum256 += fft256.cpu_cycles;
+    sum1024 += fft1024.cpu_cycles;
+    if (fft256.available()) {
+      c256++;
+      // with 75% overlap, the latest FFT ends with the newest block
+      if (error && c256 < 20 && b > 4) {
+        const int16_t *x = samples + nsamples - 256;
+        for (int k=0; k < 128; k++) {
+          double re = 0, im = 0;
+          for (int n=0; n < 256; n++) {
+            double v = x[n] * (AudioWindowHanning256[n] / 32768.0);
+            re += v * cos(2.0 * M_PI * k * n / 256.0);
+            im -= v * sin(2.0 * M_PI * k * n / 256.0);
+          }
+          double e = fabs(fft256.output[k] - sqrt(re * re + im * im) / 256.0);
+          if (e > worst) worst = e;
+        }
+      }
+    }
+    if (fft1024.available()) c1024++;
+  }
+  *count256 = c256;
+  *count1024 = c1024;
+  if (error) *error = worst;
+  cycles256 = sum256 * 64.0 / blocks;
+  cycles1024 = sum1024 * 64.0 / blocks;
+}
+
+// mean and relative standard deviation of one noise bin
+static void spread(const char *name, int blocks)
+{
+  double sum = 0, sumsq = 0;
+  int count = 0;
+  for (int b=0; b < blocks; b++) {
+    AudioStream::update_all();
+    while (queue1.available()) {
+      queue1.readBuffer();
+      queue1.freeBuffer();
+    }
+    if (fft256.available() && b > 100) {
+      double v = fft256.read(40);
+      sum += v;
+      sumsq += v * v;
+      count++;
+    }
+  }
+  double mean = sum / count;
+  double sd = sqrt(sumsq / count - mean * mean);
+  printf("  %-24s %4d spectra, bin 40 mean %.5f, deviation %4.1f%%\n",
+    name, count, mean, sd / mean * 100.0);
+}
+
+// bin 40 of FFT256, 160 of FFT1024 and 320 of FFT<2048>, all the same
+// frequency, after enough blocks for the slowest average to settle
+static void steady(float readings[3], int blocks)
+{
+  for (int b=0; b < blocks; b++) {
+    AudioStream::update_all();
+    while (queue1.available()) {
+      queue1.readBuffer();
+      queue1.freeBuffer();
+    }
+  }
+  readings[0] = fft256.read(40);
+  readings[1] = fft1024.read(160);
+  readings[2] = fft2048.read(320);
+}
+
+int main()
+{
+  AudioMemory(60);
+  queue1.begin();
+
+  printf("overlap, blocks per spectrum (%d updates):\n", BLOCKS);
+  sine1.frequency(1000.0);
+  sine1.amplitude(0.5);
+  noise1.amplitude(0.1);
+  fft256.averageTogether(1);
+  const int percent[3] = {25, 50, 75};
+  for (int i=0; i < 3; i++) {
+    int c256, c1024;
+    double error;
+    fft256.overlap(percent[i]);
+    fft1024.overlap(percent[i]);
+    run(BLOCKS, &c256, &c1024, percent[i] == 75 ? &error : NULL);
+    printf(" %d%%: FFT256 %6.0f, FFT1024 %6.0f cycles/update, "
+      "spectra every %.2f and %.2f blocks\n", percent[i], cycles256, cycles1024,
+      (double)BLOCKS / c256, (double)BLOCKS / c1024);
+    if (percent[i] == 75) {
+      printf("  FFT256 largest error from DFT: %.2f (output units)\n", error);
+    }
+  }
+
+  printf("averaging, white noise:\n");
+  sine1.amplitude(0);
+  noise1.amplitude(0.5);
+  fft256.overlap(50);
+  fft256.averageTogether(1);
+  spread("averageTogether(1)", 4000);
+  fft256.averageTogether(8);
+  spread("averageTogether(8)", 4000);
+  fft256.averageExponential(0.125);
+  spread("averageExponential(0.125)", 4000);
+
+  printf("averaging, small steady sine, reading of its bin:\n");
+  noise1.amplitude(0);
+  sine1.frequency(AUDIO_SAMPLE_RATE_EXACT * 40 / 256);
+  sine1.amplitude(0.0028);
+  const char *names[4] = {"no averaging", "averageTogether(8)",
+    "averageExponential(0.1)", "averageExponential(0.01)"};
+  const char *sizes[3] = {"FFT256", "FFT1024", "FFT<2048>"};
+  float unaveraged[3];
+  int wrong = 0;
+  for (int m=0; m < 4; m++) {
+    float readings[3];
+    // start each from silence, so the average must rise to the tone
+    mixer1.gain(0, 0);
+    fft256.averageTogether(1);
+    fft1024.averageTogether(1);
+    fft2048.averageTogether(1);
+    steady(readings, 100);
+    mixer1.gain(0, 1);
+    if (m == 0) {
+      fft256.averageTogether(1);
+      fft1024.averageTogether(1);
+      fft2048.averageTogether(1);
+    } else if (m == 1) {
+      fft256.averageTogether(8);
+      fft1024.averageTogether(8);
+      fft2048.averageTogether(8);
+    } else {
+      float weight = (m == 2) ? 0.1 : 0.01;
+      fft256.averageExponential(weight);
+      fft1024.averageExponential(weight);
+      fft2048.averageExponential(weight);
+    }
+    steady(readings, 4000);
+    printf("  %-24s", names[m]);
+    for (int i=0; i < 3; i++) {
+      if (m == 0) unaveraged[i] = readings[i];
+      // within 1 output unit of the unaveraged reading
+      bool ok = fabsf(readings[i] - unaveraged[i]) <= 1.01f / 16384.0f;
+      if (!ok) wrong++;
+      printf("  %s %.6f%s", sizes[i], readings[i], ok ? "" : " WRONG");
+    }
+    printf("\n");
+  }
+  printf("  %d averaged readings differ from unaveraged\n", wrong);
+
+  printf("logBands(12, 100, 16000), sine sweep:\n");
+  noise1.amplitude(0);
+  sine1.amplitude(0.5);
+  fft1024.averageTogether(1);
+  fft1024.overlap(50);
+  if (!fft1024.logBands(12, 100.0, 16000.0)) printf("  logBands failed\n");
+  const float freq[6] = {110.0, 440.0, 1000.0, 2500.0, 6000.0, 12000.0};
+  for (int f=0; f < 6; f++) {
+    float bands[12];
+    int c256, c1024;
+    sine1.frequency(freq[f]);
+    for (int b=0; b < 40; b++) AudioStream::update_all();
+    while (queue1.available()) {
+      queue1.readBuffer();
+      queue1.freeBuffer();
+    }
+    run(8, &c256, &c1024, NULL);
+    fft1024.readBands(bands);
+    int best = 0;
+    for (int i=1; i < 12; i++) {
+      if (bands[i] > bands[best]) best = i;
+    }
+    printf("%6.0f Hz in band %2d, level %.3f\n", freq[f], best, bands[best]);
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+// Benchmark: filter coefficient updates
+//
+// Measures the cost of changing filter frequency, as done for every
+// block (or every sample) when a filter is modulated, with double
+// precision math library functions before and the shared lookup tables
+// in FilterTables.h after.  Also prints the worst error of the tables.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+#define CALLS 100000
+
+AudioFilterBiquad        biquad;
+AudioFilterStateVariable svf;
+volatile float sink;
+
+// AudioFilterStateVariable::frequency() before the lookup tables
+void svfFrequencyBefore(float freq)
+{
+  if (freq < 20.0) freq = 20.0;
+  else if (freq > AUDIO_SAMPLE_RATE_EXACT/2.5) freq = AUDIO_SAMPLE_RATE_EXACT/2.5;
+  sink = (freq * (3.141592654/(AUDIO_SAMPLE_RATE_EXACT*2.0))) * 2147483647.0;
+  sink = sinf(freq * (3.141592654/(AUDIO_SAMPLE_RATE_EXACT*2.0))) * 2147483647.0;
+}
+
+// AudioFilterLadder's exp2 for octave control, before the lookup tables
+float ladderExp2Before(float x)
+{
+  float i;
+  float f = modff(x, &i);
+  f *= 0.693147f / 256.0f;
+  f += 1.0f;
+  f *= f;
+  f *= f;
+  f *= f;
+  f *= f;
+  f *= f;
+  f *= f;
+  f *= f;
+  f *= f;
+  f = ldexpf(f, i);
+  return f;
+}
+
+float sweep(int n)
+{
+  return 50.0f + (n % 1000) * 15.0f;
+}
+
+void report(const char *name, uint64_t before, uint64_t after)
+{
+  printf("%-34s %8.1f %8.1f   %5.1fx\n", name, (double)before / CALLS,
+    (double)after / CALLS, (double)before / after);
+}
+
+int main()
+{
+  uint32_t t;
+  uint64_t before, after;
+
+  printf("cycles per update                    before    after\n");
+  t = host_cycle_count();
+  for (int n=0; n < CALLS; n++) biquad.setLowpass(0, sweep(n), 0.7071f);
+  before = host_cycle_count() - t;
+  t = host_cycle_count();
+  for (int n=0; n < CALLS; n++) biquad.modulateLowpass(0, sweep(n), 0.7071f);
+  after = host_cycle_count() - t;
+  report("AudioFilterBiquad lowpass", before, after);
+
+  t = host_cycle_count();
+  for (int n=0; n < CALLS; n++) svfFrequencyBefore(sweep(n));
+  before = host_cycle_count() - t;
+  t = host_cycle_count();
+  for (int n=0; n < CALLS; n++) svf.frequency(sweep(n));
+  after = host_cycle_count() - t;
+  report("AudioFilterStateVariable frequency", before, after);
+
+  t = host_cycle_count();
+  for (int n=0; n < CALLS; n++) sink = ladderExp2Before((n % 1000) * 0.007f - 3.5f);
+  before = host_cycle_count() - t;
+  t = host_cycle_count();
+  for (int n=0; n < CALLS; n++) sink = filter_exp2((n % 1000) * 0.007f - 3.5f);
+  after = host_cycle_count() - t;
+  report("AudioFilterLadder octave control", before, after);
+
+  double sin_err = 0.0, exp2_err = 0.0;
+  for (int n=1; n <= 100000; n++) {
+    double x = n * (M_PI / 2.0 / 100000);
+    sin_err = fmax(sin_err, fabs(filter_sin(x) - sin(x)) / sin(x));
+    x = n * (14.0 / 100000) - 7.0;
+    exp2_err = fmax(exp2_err, fabs(filter_exp2(x) - exp2(x)) / exp2(x));
+  }
+  printf("\nworst relative error: filter_sin %.2g, filter_exp2 %.2g\n", sin_err, exp2_err);
+  return 0;
+}
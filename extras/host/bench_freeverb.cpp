@@ -0,0 +1,262 @@
+// Benchmark: AudioEffectFreeverb, per sample versus per block, and float
+//
+// Plays bursts of noise and clicks into AudioEffectFreeverb and
+// AudioEffectFreeverbFloat, and into a copy of the old AudioEffectFreeverb
+// code, which ran all 8 combs and 4 allpasses for each sample.  Checks the
+// per block version gives the same output, shows the CPU cycles per block
+// of all 3, and how far the float version's output is from the fixed
+// point output.  Then compares AudioEffectFreeverbStereoBuffer with
+// AudioEffectFreeverbStereo, and shows its memory for smaller rooms.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <algorithm>
+#include <vector>
+
+#define BLOCKS 3000   // 8.7 seconds
+
+AudioPlayQueue           queue1;
+AudioEffectFreeverb      freeverb1;
+AudioEffectFreeverbFloat freeverb2;
+AudioEffectFreeverbStereo freeverb3;
+AudioEffectFreeverbStereoBuffer freeverb4;
+AudioRecordQueue         rec1;
+AudioRecordQueue         rec2;
+AudioRecordQueue         rec3[2];
+AudioRecordQueue         rec4[2];
+AudioConnection          patchCord1(queue1, freeverb1);
+AudioConnection          patchCord2(queue1, freeverb2);
+AudioConnection          patchCord3(freeverb1, rec1);
+AudioConnection          patchCord4(freeverb2, rec2);
+AudioConnection          patchCord5(queue1, freeverb3);
+AudioConnection          patchCord6(queue1, freeverb4);
+AudioConnection          patchCord7(freeverb3, 0, rec3[0], 0);
+AudioConnection          patchCord8(freeverb3, 1, rec3[1], 0);
+AudioConnection          patchCord9(freeverb4, 0, rec4[0], 0);
+AudioConnection          patchCord10(freeverb4, 1, rec4[1], 0);
+
+int16_t reverbMemory[30000];
+
+static int16_t sat16(int32_t n, int rshift) {
+  if (n < 0) {
+    n = n + (~(0xFFFFFFFFUL << rshift));
+  }
+  n = n >> rshift;
+  if (n > 32767) {
+    return 32767;
+  }
+  if (n < -32768) {
+    return -32768;
+  }
+  return n;
+}
+
+// AudioEffectFreeverb::update() before it was changed to process blocks
+struct OldFreeverb {
+  int16_t comb1buf[1116];
+  int16_t comb2buf[1188];
+  int16_t comb3buf[1277];
+  int16_t comb4buf[1356];
+  int16_t comb5buf[1422];
+  int16_t comb6buf[1491];
+  int16_t comb7buf[1557];
+  int16_t comb8buf[1617];
+  uint16_t comb1index, comb2index, comb3index, comb4index;
+  uint16_t comb5index, comb6index, comb7index, comb8index;
+  int16_t comb1filter, comb2filter, comb3filter, comb4filter;
+  int16_t comb5filter, comb6filter, comb7filter, comb8filter;
+  int16_t combdamp1, combdamp2, combfeeback;
+  int16_t allpass1buf[556];
+  int16_t allpass2buf[441];
+  int16_t allpass3buf[341];
+  int16_t allpass4buf[225];
+  uint16_t allpass1index, allpass2index, allpass3index, allpass4index;
+
+  void process(const int16_t *in, int16_t *out) {
+    int i;
+    int16_t input, bufout, output;
+    int32_t sum;
+
+    for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      input = sat16(in[i] * 8738, 17); // for numerical headroom
+      sum = 0;
+
+      bufout = comb1buf[comb1index];
+      sum += bufout;
+      comb1filter = sat16(bufout * combdamp2 + comb1filter * combdamp1, 15);
+      comb1buf[comb1index] = sat16(input + sat16(comb1filter * combfeeback, 15), 0);
+      if (++comb1index >= sizeof(comb1buf)/sizeof(int16_t)) comb1index = 0;
+
+      bufout = comb2buf[comb2index];
+      sum += bufout;
+      comb2filter = sat16(bufout * combdamp2 + comb2filter * combdamp1, 15);
+      comb2buf[comb2index] = sat16(input + sat16(comb2filter * combfeeback, 15), 0);
+      if (++comb2index >= sizeof(comb2buf)/sizeof(int16_t)) comb2index = 0;
+
+      bufout = comb3buf[comb3index];
+      sum += bufout;
+      comb3filter = sat16(bufout * combdamp2 + comb3filter * combdamp1, 15);
+      comb3buf[comb3index] = sat16(input + sat16(comb3filter * combfeeback, 15), 0);
+      if (++comb3index >= sizeof(comb3buf)/sizeof(int16_t)) comb3index = 0;
+
+      bufout = comb4buf[comb4index];
+      sum += bufout;
+      comb4filter = sat16(bufout * combdamp2 + comb4filter * combdamp1, 15);
+      comb4buf[comb4index] = sat16(input + sat16(comb4filter * combfeeback, 15), 0);
+      if (++comb4index >= sizeof(comb4buf)/sizeof(int16_t)) comb4index = 0;
+
+      bufout = comb5buf[comb5index];
+      sum += bufout;
+      comb5filter = sat16(bufout * combdamp2 + comb5filter * combdamp1, 15);
+      comb5buf[comb5index] = sat16(input + sat16(comb5filter * combfeeback, 15), 0);
+      if (++comb5index >= sizeof(comb5buf)/sizeof(int16_t)) comb5index = 0;
+
+      bufout = comb6buf[comb6index];
+      sum += bufout;
+      comb6filter = sat16(bufout * combdamp2 + comb6filter * combdamp1, 15);
+      comb6buf[comb6index] = sat16(input + sat16(comb6filter * combfeeback, 15), 0);
+      if (++comb6index >= sizeof(comb6buf)/sizeof(int16_t)) comb6index = 0;
+
+      bufout = comb7buf[comb7index];
+      sum += bufout;
+      comb7filter = sat16(bufout * combdamp2 + comb7filter * combdamp1, 15);
+      comb7buf[comb7index] = sat16(input + sat16(comb7filter * combfeeback, 15), 0);
+      if (++comb7index >= sizeof(comb7buf)/sizeof(int16_t)) comb7index = 0;
+
+      bufout = comb8buf[comb8index];
+      sum += bufout;
+      comb8filter = sat16(bufout * combdamp2 + comb8filter * combdamp1, 15);
+      comb8buf[comb8index] = sat16(input + sat16(comb8filter * combfeeback, 15), 0);
+      if (++comb8index >= sizeof(comb8buf)/sizeof(int16_t)) comb8index = 0;
+
+      output = sat16(sum * 31457, 17);
+
+      bufout = allpass1buf[allpass1index];
+      allpass1buf[allpass1index] = output + (bufout >> 1);
+      output = sat16(bufout - output, 1);
+      if (++allpass1index >= sizeof(allpass1buf)/sizeof(int16_t)) allpass1index = 0;
+
+      bufout = allpass2buf[allpass2index];
+      allpass2buf[allpass2index] = output + (bufout >> 1);
+      output = sat16(bufout - output, 1);
+      if (++allpass2index >= sizeof(allpass2buf)/sizeof(int16_t)) allpass2index = 0;
+
+      bufout = allpass3buf[allpass3index];
+      allpass3buf[allpass3index] = output + (bufout >> 1);
+      output = sat16(bufout - output, 1);
+      if (++allpass3index >= sizeof(allpass3buf)/sizeof(int16_t)) allpass3index = 0;
+
+      bufout = allpass4buf[allpass4index];
+      allpass4buf[allpass4index] = output + (bufout >> 1);
+      output = sat16(bufout - output, 1);
+      if (++allpass4index >= sizeof(allpass4buf)/sizeof(int16_t)) allpass4index = 0;
+
+      out[i] = sat16(output * 30, 0);
+    }
+  }
+} old;
+
+int main()
+{
+  AudioMemory(20);
+  freeverb1.roomsize(0.7);
+  freeverb1.damping(0.5);
+  freeverb2.roomsize(0.7);
+  freeverb2.damping(0.5);
+  memset(&old, 0, sizeof(old));
+  old.combfeeback = (int)(0.7f * 9175.04f) + 22937;
+  old.combdamp1 = (int)(0.5f * 13107.2f);
+  old.combdamp2 = 32768 - old.combdamp1;
+  freeverb3.roomsize(0.7);
+  freeverb3.damping(0.5);
+  freeverb4.begin(reverbMemory, 30000);
+  freeverb4.roomsize(0.7);
+  freeverb4.damping(0.5);
+  rec1.begin();
+  rec2.begin();
+  for (int ch=0; ch < 2; ch++) {
+    rec3[ch].begin();
+    rec4[ch].begin();
+  }
+
+  std::vector<uint32_t> cycles[5];
+  uint32_t mismatch = 0, mismatch_stereo = 0;
+  double sig = 0, err = 0, tail1 = 0, tail2 = 0;
+  int16_t in[AUDIO_BLOCK_SAMPLES], out[AUDIO_BLOCK_SAMPLES];
+  for (int b=0; b < BLOCKS; b++) {
+    // 0.5 s of noise or a click every 2 seconds, then silence
+    int t = b % 700;
+    for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      if (b < 1400 && t < 170) in[i] = random(-12000, 12001);
+      else if (b >= 1400 && t == 0 && i == 0) in[i] = 30000;
+      else in[i] = 0;
+    }
+    memcpy(queue1.getBuffer(), in, sizeof(in));
+    queue1.playBuffer();
+    AudioStream::update_all();
+    uint32_t c = host_cycle_count();
+    old.process(in, out);
+    cycles[0].push_back(host_cycle_count() - c);
+    cycles[1].push_back(freeverb1.cpu_cycles * 64);
+    cycles[2].push_back(freeverb2.cpu_cycles * 64);
+    cycles[3].push_back(freeverb3.cpu_cycles * 64);
+    cycles[4].push_back(freeverb4.cpu_cycles * 64);
+    for (int ch=0; ch < 2; ch++) {
+      int16_t *p3 = rec3[ch].readBuffer();
+      int16_t *p4 = rec4[ch].readBuffer();
+      for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        if (p3[i] != p4[i]) mismatch_stereo++;
+      }
+      rec3[ch].freeBuffer();
+      rec4[ch].freeBuffer();
+    }
+    int16_t *p1 = rec1.readBuffer();
+    int16_t *p2 = rec2.readBuffer();
+    for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      if (p1[i] != out[i]) mismatch++;
+      double d = p2[i] - p1[i];
+      if (t < 170 || b >= 1400) {
+        sig += (double)p1[i] * p1[i];
+        err += d * d;
+      } else if (t > 500) {
+        // the quiet end of each tail
+        tail1 += (double)p1[i] * p1[i];
+        tail2 += (double)p2[i] * p2[i];
+      }
+    }
+    rec1.freeBuffer();
+    rec2.freeBuffer();
+  }
+
+  printf("%u of %u samples differ from the per sample version\n",
+    mismatch, BLOCKS * AUDIO_BLOCK_SAMPLES);
+  printf("float - fixed point difference %.1f dB\n", 10 * log10(err / sig));
+  printf("end of the tails, fixed point %.1f dB, float %.1f dB\n",
+    10 * log10(tail1 / sig), 10 * log10(tail2 / sig));
+  printf("%u of %u stereo samples differ, StereoBuffer from Stereo\n",
+    mismatch_stereo, BLOCKS * AUDIO_BLOCK_SAMPLES * 2);
+  const char *names[5] = {"per sample", "per block", "float", "Stereo", "StereoBuffer"};
+  printf("CPU cycles per block:\n");
+  for (int m=0; m < 5; m++) {
+    uint64_t total = 0;
+    for (uint32_t n : cycles[m]) total += n;
+    std::sort(cycles[m].begin(), cycles[m].end());
+    printf("  %-12s %7.0f average, %7u 99th percentile\n", names[m],
+      (double)total / BLOCKS, cycles[m][BLOCKS * 99 / 100]);
+  }
+  printf("Memory, bytes:\n");
+  printf("  %-24s %6u\n", "AudioEffectFreeverb", (unsigned)sizeof(AudioEffectFreeverb));
+  printf("  %-24s %6u\n", "AudioEffectFreeverbFloat", (unsigned)sizeof(AudioEffectFreeverbFloat));
+  printf("  %-24s %6u\n", "AudioEffectFreeverbStereo", (unsigned)sizeof(AudioEffectFreeverbStereo));
+  printf("  StereoBuffer object %u, plus buffer:\n", (unsigned)sizeof(AudioEffectFreeverbStereoBuffer));
+  const float scales[] = {2.0, 1.0, 0.5, 0.25};
+  for (float scale : scales) {
+    float used = freeverb4.roomScale(scale);
+    printf("    room scale %.2f: %6u required, ", scale,
+      AudioEffectFreeverbStereoBuffer::lengthRequired(scale) * 2);
+    printf("%.3f fits in %u, using %u\n", used, (unsigned)sizeof(reverbMemory),
+      freeverb4.memoryUsed());
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+// Benchmark: AudioAmplifier and AudioMixer4 gain ramps
+//
+// Ramps the gain of a constant input, slow and fast, by large and small
+// amounts, and checks the output moves every sample with no step larger
+// than the ideal per sample change, and ends exactly on the target.  A
+// ramp whose per sample change is below the 16.16 multiplier's precision
+// used to stay flat, then jump on its last block.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+AudioPlayQueue           queue1;
+AudioAmplifier           amp1;
+AudioMixer4              mixer1;
+AudioRecordQueue         rec1;
+AudioRecordQueue         rec2;
+AudioConnection          patchCord1(queue1, amp1);
+AudioConnection          patchCord2(queue1, 0, mixer1, 1);
+AudioConnection          patchCord3(amp1, rec1);
+AudioConnection          patchCord4(mixer1, rec2);
+
+#define INPUT_LEVEL 16384
+
+struct Ramp {
+  float from, to, ms;
+};
+
+// one update, with the outputs of the amplifier and the mixer
+void update(int16_t out[2][AUDIO_BLOCK_SAMPLES]) {
+  int16_t *p = queue1.getBuffer();
+  for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) p[i] = INPUT_LEVEL;
+  queue1.playBuffer();
+  AudioStream::update_all();
+  AudioRecordQueue *rec[2] = {&rec1, &rec2};
+  for (int k=0; k < 2; k++) {
+    int16_t *r = rec[k]->readBuffer();
+    if (r) memcpy(out[k], r, sizeof(out[k]));
+    else memset(out[k], 0, sizeof(out[k]));
+    if (r) rec[k]->freeBuffer();
+  }
+}
+
+int main()
+{
+  AudioMemory(20);
+  rec1.begin();
+  rec2.begin();
+  mixer1.gain(0, 0);
+
+  const Ramp ramps[] = {
+    {0.0, 0.5, 2000}, {0.0, 1.0, 500}, {0.5, 0.51, 1000},
+    {1.0, 0.99, 3000}, {0.25, 0.2501, 1500}, {1.0, 0.0, 5}, {0.0, 1.9, 100},
+  };
+  const char *names[2] = {"AudioAmplifier", "AudioMixer4"};
+  int16_t out[2][AUDIO_BLOCK_SAMPLES];
+  int failures = 0;
+
+  printf("%-16s %14s %8s %8s %8s %10s %8s\n", "", "ramp", "ms", "ideal",
+    "largest", "flat for", "final");
+  for (const Ramp &r : ramps) {
+    amp1.gain(r.from);
+    mixer1.gain(1, r.from);
+    for (int b=0; b < 4; b++) update(out);
+    amp1.gain(r.to, r.ms);
+    mixer1.gain(1, r.to, r.ms);
+    int blocks = (int)(r.ms * (AUDIO_SAMPLE_RATE_EXACT / 1000.0) / AUDIO_BLOCK_SAMPLES + 0.5);
+    if (blocks < 1) blocks = 1;
+    int16_t prev[2] = {out[0][AUDIO_BLOCK_SAMPLES - 1], out[1][AUDIO_BLOCK_SAMPLES - 1]};
+    int32_t largest[2] = {}, flat[2] = {}, longest[2] = {};
+    for (int b=0; b < blocks + 2; b++) {
+      update(out);
+      for (int k=0; k < 2; k++) {
+        for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+          int32_t step = abs(out[k][i] - prev[k]);
+          if (step > largest[k]) largest[k] = step;
+          if (b < blocks && step == 0) {
+            if (++flat[k] > longest[k]) longest[k] = flat[k];
+          } else {
+            flat[k] = 0;
+          }
+          prev[k] = out[k][i];
+        }
+      }
+    }
+    // from the 16.16 multipliers the gains are stored as
+    int32_t from = r.from * 65536.0f, to = r.to * 65536.0f;
+    double ideal = fabs(to - from) / 65536.0 * INPUT_LEVEL / (blocks * AUDIO_BLOCK_SAMPLES);
+    double target = r.to * INPUT_LEVEL;
+    if (target > 32767) target = 32767;
+    // a change of less than 1 per sample still steps by 1, as often as
+    // needed, so the flat stretches are no longer than 1 / ideal
+    int32_t flat_limit = (ideal < 1.0) ? (int32_t)(1.0 / ideal) + 2 : 1;
+    for (int k=0; k < 2; k++) {
+      bool ok = largest[k] <= ceil(ideal) + 1 && longest[k] <= flat_limit
+        && fabs(prev[k] - target) <= 1;
+      if (!ok) failures++;
+      printf("%-16s %6.4f-%6.4f %8.0f %8.3f %8d %10d %8d %s\n", names[k],
+        r.from, r.to, r.ms, ideal, largest[k], longest[k], prev[k],
+        ok ? "ok" : "STEPS");
+    }
+  }
+  printf("%d ramps with steps or not on target\n", failures);
+  return 0;
+}
@@ -0,0 +1,134 @@
+// Benchmark: AudioAnalyzeMeter versus AudioAnalyzePeak and AudioAnalyzeRMS
+//
+// Measures the CPU time of 8 AudioAnalyzePeak plus 8 AudioAnalyzeRMS, as
+// used by the PeakAndRMSMeter8Channel example, against one
+// AudioAnalyzeMeter<8>, with everything measured and with only the peak
+// and RMS, truePeak(false) and loudness(false).  Then checks the loudness with the EBU Tech 3341
+// minimum requirement tests 1 to 5, and the true-peak of sines whose
+// peaks fall between the samples.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <algorithm>
+#include <vector>
+
+AudioPlayQueue       queue[8];
+AudioAnalyzePeak     peak[8];
+AudioAnalyzeRMS      rms[8];
+AudioAnalyzeMeter<8> meter8;
+AudioAnalyzeMeter<8> level8;
+AudioAnalyzeMeter<2> meter2;
+AudioConnection      *cords[34];
+
+// sine in channels 0 and 1 of 8, amplitude in dBFS
+double phase;
+void play(double seconds, double freq, double dbfs)
+{
+  int blocks = seconds * AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES + 0.5;
+  double amp = 32767.0 * pow(10.0, dbfs / 20.0);
+  for (int b=0; b < blocks; b++) {
+    int16_t *p[8];
+    for (int ch=0; ch < 8; ch++) p[ch] = queue[ch].getBuffer();
+    for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      int16_t s = lrint(amp * sin(phase));
+      phase += 2.0 * M_PI * freq / AUDIO_SAMPLE_RATE_EXACT;
+      for (int ch=0; ch < 8; ch++) p[ch][i] = (ch < 2) ? s : s / 4;
+    }
+    for (int ch=0; ch < 8; ch++) queue[ch].playBuffer();
+    AudioStream::update_all();
+  }
+}
+
+void ebu(const char *name, const double *sections, int n, double expect)
+{
+  play(1.0, 1000.0, -200.0);  // silence, below the -70 LUFS gate
+  meter2.resetIntegrated();
+  for (int i=0; i < n; i++) {
+    play(sections[i * 2], 1000.0, sections[i * 2 + 1]);
+  }
+  printf("  %-32s M %6.2f  S %6.2f  I %6.2f  (expect %.1f)\n", name,
+    meter2.readMomentary(), meter2.readShortTerm(), meter2.readIntegrated(), expect);
+}
+
+int main()
+{
+  AudioMemory(60);
+  int n = 0;
+  for (int ch=0; ch < 8; ch++) {
+    cords[n++] = new AudioConnection(queue[ch], 0, peak[ch], 0);
+    cords[n++] = new AudioConnection(queue[ch], 0, rms[ch], 0);
+    cords[n++] = new AudioConnection(queue[ch], 0, meter8, ch);
+    cords[n++] = new AudioConnection(queue[ch], 0, level8, ch);
+  }
+  level8.truePeak(false);
+  level8.loudness(false);
+  cords[n++] = new AudioConnection(queue[0], 0, meter2, 0);
+  cords[n++] = new AudioConnection(queue[1], 0, meter2, 1);
+
+  // CPU time
+  std::vector<uint32_t> cpu[3];
+  for (int b=0; b < 2000; b++) {
+    play(AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT, 440.0, -6.0);
+    uint32_t c = 0;
+    for (int ch=0; ch < 8; ch++) c += peak[ch].cpu_cycles + rms[ch].cpu_cycles;
+    cpu[0].push_back(c);
+    cpu[1].push_back(meter8.cpu_cycles);
+    cpu[2].push_back(level8.cpu_cycles);
+  }
+  const char *names[3] = {"8 Peak + 8 RMS", "AudioAnalyzeMeter<8>",
+    "  peak and RMS only"};
+  printf("CPU cycles per update, average and 99th percentile:\n");
+  for (int m=0; m < 3; m++) {
+    std::vector<uint32_t> &c = cpu[m];
+    double sum = 0;
+    for (uint32_t v : c) sum += v;
+    std::sort(c.begin(), c.end());
+    printf("  %-22s %6.0f %6u\n", names[m], sum * 64.0 / c.size(),
+      c[c.size() * 99 / 100] * 64);
+  }
+  printf("Peak and RMS of -6 dBFS sine, channel 0 and 2:\n");
+  printf("  AudioAnalyzePeak %.4f %.4f, AudioAnalyzeRMS %.4f %.4f\n",
+    peak[0].read(), peak[2].read(), rms[0].read(), rms[2].read());
+  printf("  AudioAnalyzeMeter %.4f %.4f,               %.4f %.4f\n",
+    meter8.readPeak(0), meter8.readPeak(2), meter8.readRMS(0), meter8.readRMS(2));
+  printf("  peak and RMS only %.4f %.4f,               %.4f %.4f\n",
+    level8.readPeak(0), level8.readPeak(2), level8.readRMS(0), level8.readRMS(2));
+
+  printf("EBU Tech 3341 loudness, 1 kHz stereo sine:\n");
+  const double test1[] = {20, -23};
+  const double test2[] = {20, -33};
+  const double test3[] = {10, -36, 60, -23, 10, -36};
+  const double test4[] = {10, -72, 10, -36, 60, -23, 10, -36, 10, -72};
+  const double test5[] = {20, -26, 20.1, -20, 20, -26};
+  ebu("1: -23 dBFS", test1, 1, -23.0);
+  ebu("2: -33 dBFS", test2, 1, -33.0);
+  ebu("3: -36, -23, -36 dBFS", test3, 3, -23.0);
+  ebu("4: -72, -36, -23, -36, -72 dBFS", test4, 5, -23.0);
+  ebu("5: -26, -20, -26 dBFS", test5, 3, -23.0);
+
+  // frequencies which repeat every few samples, so the sample peak
+  // depends on the phase
+  printf("True-peak of -6 dBFS sines (0.501), worst of 20 phases:\n");
+  const double freqs[] = {AUDIO_SAMPLE_RATE_EXACT / 8, AUDIO_SAMPLE_RATE_EXACT / 6,
+    AUDIO_SAMPLE_RATE_EXACT / 5, AUDIO_SAMPLE_RATE_EXACT / 4,
+    AUDIO_SAMPLE_RATE_EXACT / 3, AUDIO_SAMPLE_RATE_EXACT * 3 / 8};
+  for (double f : freqs) {
+    double lo = 10, hi = 0, spk = 10;
+    for (int i=0; i < 20; i++) {
+      phase = i * (2.0 * M_PI * f / AUDIO_SAMPLE_RATE_EXACT) / 20.0;
+      play(0.05, f, -6.0);
+      meter2.readTruePeak(0);
+      meter2.readPeak(0);
+      play(0.05, f, -6.0);
+      double tp = meter2.readTruePeak(0);
+      double sp = meter2.readPeak(0);
+      if (tp < lo) lo = tp;
+      if (tp > hi) hi = tp;
+      if (sp < spk) spk = sp;
+    }
+    printf("  %6.0f Hz  true-peak %.3f to %.3f (%+.2f to %+.2f dB), sample peak down to %.3f\n",
+      f, lo, hi, 20 * log10(lo / 0.501), 20 * log10(hi / 0.501), spk);
+  }
+  return 0;
+}
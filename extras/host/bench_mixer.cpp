@@ -0,0 +1,56 @@
+// Benchmark: 16 input mixing bus
+//
+// Compares one AudioMixer<16> against the tree of five AudioMixer4
+// previously needed for 16 inputs, and checks they produce the same
+// output when no intermediate stage clips.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+#define BLOCKS 20000
+
+AudioSynthWaveformSine   sine[16];
+AudioMixer4              tree[5];
+AudioMixer<16>           mixer16;
+AudioRecordQueue         outTree;
+AudioRecordQueue         outMixer;
+AudioConnection         *cords[64];
+
+int main()
+{
+  int n = 0;
+  AudioMemory(120);
+  for (int i=0; i < 16; i++) {
+    sine[i].frequency(110.0f * (i + 1));
+    sine[i].amplitude(0.05f);
+    cords[n++] = new AudioConnection(sine[i], 0, tree[i / 4], i % 4);
+    cords[n++] = new AudioConnection(sine[i], 0, mixer16, i);
+  }
+  for (int i=0; i < 4; i++) {
+    cords[n++] = new AudioConnection(tree[i], 0, tree[4], i);
+  }
+  cords[n++] = new AudioConnection(tree[4], outTree);
+  cords[n++] = new AudioConnection(mixer16, outMixer);
+  outTree.begin();
+  outMixer.begin();
+
+  uint64_t tree_cycles = 0, mixer_cycles = 0;
+  int differences = 0;
+  for (int b=0; b < BLOCKS; b++) {
+    AudioStream::update_all();
+    for (int i=0; i < 5; i++) tree_cycles += tree[i].cpu_cycles;
+    mixer_cycles += mixer16.cpu_cycles;
+    while (outTree.available() && outMixer.available()) {
+      if (memcmp(outTree.readBuffer(), outMixer.readBuffer(), AUDIO_BLOCK_SAMPLES * 2)) {
+        differences++;
+      }
+      outTree.freeBuffer();
+      outMixer.freeBuffer();
+    }
+  }
+  printf("5 x AudioMixer4:  %6.0f cycles/block\n", tree_cycles * 64.0 / BLOCKS);
+  printf("AudioMixer<16>:   %6.0f cycles/block\n", mixer_cycles * 64.0 / BLOCKS);
+  printf("blocks with different output: %d\n", differences);
+  return 0;
+}
@@ -0,0 +1,178 @@
+// Benchmark: AudioAnalyzeMultiPitch on plucked chords
+//
+// Plucks several Karplus-Strong strings at once, for guitar chords,
+// intervals and single notes, with and without background noise.  Each
+// result is compared to the notes played: a note is correct when a
+// frequency is reported within 40 cents of it, a report matching no note
+// played is extra.  The pitch classes (note names, ignoring the octave)
+// found are also counted, since that is what recognizing a chord needs.
+// The first result after each pluck is skipped, since its FFT still
+// holds the previous chord.  "Explained" is the sum of the confidence of
+// the notes reported.  Also shows the update time, compared to the FFT
+// alone.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <algorithm>
+#include <vector>
+
+#define UPDATES_PER_CHORD 160
+
+AudioPlayQueue           strings;
+AudioSynthNoiseWhite     noise1;
+AudioMixer4              mixer1;
+AudioAnalyzeMultiPitch   multipitch;
+AudioAnalyzeFFT<4096, float> fft4096;
+AudioConnection          patchCord1(strings, 0, mixer1, 0);
+AudioConnection          patchCord2(noise1, 0, mixer1, 1);
+AudioConnection          patchCord3(mixer1, multipitch);
+AudioConnection          patchCord4(mixer1, fft4096);
+
+// Karplus-Strong string, averaging with the next sample shortens the
+// period by half a sample
+struct KarplusStrong {
+  double delay[2048];
+  int len, index;
+  // a string pulled aside at 1/5 of its length, plus a little noise, or
+  // only noise like AudioSynthKarplusStrong
+  double pluck(double freq, bool burst) {
+    len = (int)(AUDIO_SAMPLE_RATE_EXACT / freq + 0.5);
+    index = 0;
+    int point = len / 5;
+    for (int i=0; i < len; i++) {
+      double shape = (i < point) ? (double)i / point : (double)(len - i) / (len - point);
+      if (burst) {
+        delay[i] = random(-10000, 10001);
+      } else {
+        delay[i] = 10000.0 * (shape - 0.5) + random(-1000, 1001);
+      }
+    }
+    return AUDIO_SAMPLE_RATE_EXACT / (len - 0.5);
+  }
+  double next() {
+    int n = (index + 1 < len) ? index + 1 : 0;
+    double out = delay[index];
+    delay[index] = 0.4985 * (delay[index] + delay[n]);
+    index = n;
+    return out;
+  }
+} ks[6];
+
+struct Chord {
+  const char *name;
+  std::vector<int> notes;	// MIDI note numbers
+};
+
+const Chord chords[] = {
+  {"E2 (single)", {40}},
+  {"A3 (single)", {57}},
+  {"E4 (single)", {64}},
+  {"E2 + E3 (octave)", {40, 52}},
+  {"A2 + E3 (fifth)", {45, 52}},
+  {"C4 + E4 (third)", {60, 64}},
+  {"E5 (power chord)", {40, 47, 52}},
+  {"C major (triad)", {48, 52, 55}},
+  {"A minor (open)", {45, 52, 57, 60, 64}},
+  {"C major (open)", {48, 52, 55, 60, 64}},
+  {"G major (open)", {43, 47, 50, 55, 59, 67}},
+  {"E major (open)", {40, 47, 52, 56, 59, 64}},
+  {"D7 (open)", {50, 57, 60, 66}},
+};
+
+static double midiFreq(int note)
+{
+  return 440.0 * pow(2.0, (note - 69) / 12.0);
+}
+
+int main()
+{
+  AudioMemory(60);
+  mixer1.gain(0, 1.0);
+  mixer1.gain(1, 1.0);
+
+  const char *testName[3] = {"plucked strings", "plucked strings, noise at -34 dB",
+    "noise burst strings (like AudioSynthKarplusStrong)"};
+  std::vector<uint32_t> cycles, fftCycles;
+  for (int test=0; test < 3; test++) {
+    noise1.amplitude(test == 1 ? 0.02 : 0.0);
+    printf("%s:\n", testName[test]);
+    printf("  %-20s %8s %8s %8s  %s\n", "chord", "results", "correct", "extra",
+      "explained");
+    int tplayed = 0, tcorrect = 0, textra = 0;
+    int tclasses = 0, tclassesFound = 0, wrongClasses = 0;
+    for (const Chord &c : chords) {
+      int nstrings = c.notes.size();
+      double f[6];
+      for (int s=0; s < nstrings; s++) f[s] = ks[s].pluck(midiFreq(c.notes[s]), test == 2);
+      int results = 0, correct = 0, extra = 0;
+      double confsum = 0;
+      for (int b=0; b < UPDATES_PER_CHORD; b++) {
+        int16_t *p = strings.getBuffer();
+        for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+          double sum = 0;
+          for (int s=0; s < nstrings; s++) sum += ks[s].next();
+          p[i] = sum / nstrings;
+        }
+        strings.playBuffer();
+        AudioStream::update_all();
+        cycles.push_back(multipitch.cpu_cycles);
+        fftCycles.push_back(fft4096.cpu_cycles);
+        if (multipitch.available() && b >= 32) {
+          float freq[AUDIO_MULTIPITCH_MAX_NOTES], conf[AUDIO_MULTIPITCH_MAX_NOTES];
+          int n = multipitch.readNotes(freq, conf);
+          results++;
+          for (int s=0; s < nstrings; s++) {
+            for (int i=0; i < n; i++) {
+              if (fabs(1200.0 * log2(freq[i] / f[s])) < 40.0) {
+                correct++;
+                break;
+              }
+            }
+          }
+          // pitch classes, all a chord recognizer needs
+          int classes = 0, found = 0;
+          for (int s=0; s < nstrings; s++) classes |= 1 << (c.notes[s] % 12);
+          for (int i=0; i < n; i++) {
+            int pc = ((int)lround(69.0 + 12.0 * log2(freq[i] / 440.0)) + 120) % 12;
+            if (classes & (1 << pc)) {
+              found |= 1 << pc;
+            } else {
+              wrongClasses++;
+            }
+          }
+          tclasses += __builtin_popcount(classes);
+          tclassesFound += __builtin_popcount(found);
+          for (int i=0; i < n; i++) {
+            bool match = false;
+            for (int s=0; s < nstrings; s++) {
+              if (fabs(1200.0 * log2(freq[i] / f[s])) < 40.0) match = true;
+            }
+            if (!match) extra++;
+            confsum += conf[i];
+          }
+        }
+      }
+      printf("  %-20s %8d %5d/%-3d %8d  %.2f\n", c.name, results, correct,
+        results * nstrings, extra, confsum / results);
+      tplayed += results * nstrings;
+      tcorrect += correct;
+      textra += extra;
+    }
+    printf("  found %d of %d notes (%.1f%%), %d extra\n", tcorrect, tplayed,
+      100.0 * tcorrect / tplayed, textra);
+    printf("  found %d of %d pitch classes (%.1f%%), %d not in the chord\n",
+      tclassesFound, tclasses, 100.0 * tclassesFound / tclasses, wrongClasses);
+  }
+  // the FFT alone, to show the time for finding the notes
+  printf("CPU cycles per update, average and 99th percentile:\n");
+  for (int i=0; i < 2; i++) {
+    std::vector<uint32_t> &c = i ? fftCycles : cycles;
+    double sum = 0;
+    for (uint32_t v : c) sum += v;
+    std::sort(c.begin(), c.end());
+    printf("  %-28s %8.0f %8u\n", i ? "AudioAnalyzeFFT<4096, float>" :
+      "AudioAnalyzeMultiPitch", sum * 64.0 / c.size(), c[c.size() * 99 / 100] * 64);
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+// Benchmark: AudioAnalyzeNoteFrequency, YIN versus FFT
+//
+// Plucks Karplus-Strong strings at the open string pitches of a bass
+// and a guitar (AudioSynthKarplusStrong only runs on Teensy, and can not
+// play the low bass strings), and analyzes each with the YIN method,
+// NOTEFREQ_FFT and NOTEFREQ_FFT_DECIMATED.  Shows the error of each
+// from the string's frequency, the largest difference between the FFT
+// results and YIN for the same buffer, and the CPU time: the average for
+// all notes, the lowest and the highest note, and the longest update, as
+// the median over the notes so the host's interrupts don't count.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <algorithm>
+
+#define UPDATES_PER_NOTE (AUDIO_GUITARTUNER_BLOCKS * 8)
+
+AudioPlayQueue            string1;
+AudioAnalyzeNoteFrequency notefreq[3];
+AudioConnection           patchCord1(string1, notefreq[0]);
+AudioConnection           patchCord2(string1, notefreq[1]);
+AudioConnection           patchCord3(string1, notefreq[2]);
+
+const char *names[3] = {"YIN", "FFT", "FFT_DECIMATED"};
+
+// Karplus-Strong string, averaging with the next sample shortens the
+// period by half a sample
+struct KarplusStrong {
+  double delay[2048];
+  int len, index;
+  double pluck(double freq) {
+    len = (int)(AUDIO_SAMPLE_RATE_EXACT / freq);
+    index = 0;
+    for (int i=0; i < len; i++) delay[i] = random(-20000, 20001);
+    return AUDIO_SAMPLE_RATE_EXACT / (len - 0.5);
+  }
+  void play(AudioPlayQueue &queue) {
+    int16_t *p = queue.getBuffer();
+    for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      int next = (index + 1 < len) ? index + 1 : 0;
+      double out = delay[index];
+      delay[index] = 0.498 * (delay[index] + delay[next]);
+      index = next;
+      p[i] = out;
+    }
+    queue.playBuffer();
+  }
+} ks;
+
+int main()
+{
+  AudioMemory(120);
+  notefreq[0].begin(0.15, NOTEFREQ_YIN);
+  notefreq[1].begin(0.15, NOTEFREQ_FFT);
+  notefreq[2].begin(0.15, NOTEFREQ_FFT_DECIMATED);
+
+  const float notes[] = {41.20, 55.00, 73.42, 98.00,                // bass
+    82.41, 110.00, 146.83, 196.00, 246.94, 329.63, 659.26};        // guitar
+  const int num_notes = sizeof(notes) / sizeof(notes[0]);
+  uint64_t total[3] = {0, 0, 0};
+  uint64_t note_total[3][num_notes] = {};
+  uint32_t note_peak[3][num_notes] = {};
+  int updates = 0, n = 0;
+
+  printf("%8s", "string");
+  for (int m=0; m < 3; m++) printf(" %24s", names[m]);
+  printf("  FFT-YIN difference\n");
+  for (float note : notes) {
+    double f = ks.pluck(note);
+    // results for each buffer, the same buffer for all 3 methods
+    float freq[3][16], prob[3][16];
+    bool found[3][16] = {};
+    for (int b=0; b < UPDATES_PER_NOTE; b++) {
+      ks.play(string1);
+      AudioStream::update_all();
+      for (int m=0; m < 3; m++) {
+        uint32_t cycles = notefreq[m].cpu_cycles;
+        total[m] += cycles;
+        note_total[m][n] += cycles;
+        if (cycles > note_peak[m][n]) note_peak[m][n] = cycles;
+        if (notefreq[m].available()) {
+          int buf = b / AUDIO_GUITARTUNER_BLOCKS;
+          freq[m][buf] = notefreq[m].read();
+          prob[m][buf] = notefreq[m].probability();
+          found[m][buf] = true;
+        }
+      }
+      updates++;
+    }
+    printf("%6.2f Hz", note);
+    double worst_diff = 0;
+    for (int m=0; m < 3; m++) {
+      double cents = 0, p = 0;
+      int count = 0;
+      // skip the first 2 buffers, with the previous note and the pluck
+      for (int buf=2; buf < 8; buf++) {
+        if (!found[m][buf]) continue;
+        cents += fabs(1200.0 * log2(freq[m][buf] / f));
+        p += prob[m][buf];
+        count++;
+        if (m > 0 && found[0][buf]) {
+          double d = fabs(1200.0 * log2(freq[m][buf] / freq[0][buf]));
+          if (m == 1 && d > worst_diff) worst_diff = d;
+        }
+      }
+      if (count) {
+        printf("  %d/6 %6.2f cents p=%.3f", count, cents / count, p / count);
+      } else {
+        printf("  %24s", "not found");
+      }
+    }
+    printf("  %.4f cents\n", worst_diff);
+    n++;
+  }
+  printf("CPU cycles per update:  average  %.0f Hz  %.0f Hz  longest\n",
+    notes[0], notes[num_notes - 1]);
+  for (int m=0; m < 3; m++) {
+    std::sort(note_peak[m], note_peak[m] + num_notes);
+    printf("  %-14s %13.0f %8.0f %8.0f %8u\n", names[m],
+      total[m] * 64.0 / updates,
+      note_total[m][0] * 64.0 / UPDATES_PER_NOTE,
+      note_total[m][num_notes - 1] * 64.0 / UPDATES_PER_NOTE,
+      note_peak[m][num_notes / 2] * 64);
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+// Benchmark: AudioPlayStream, non-blocking playback from a ring buffer
+//
+// Feeds a stereo AudioPlayStream<2> with packets of random sizes, as from
+// a network, using only non-blocking write() calls, and records its
+// output with AudioRecordStream<2> to check every sample.  Then stops
+// the packets for 4 updates, in the middle of a block, and shows what each
+// underrun policy plays.  Also shows how AudioPlayQueue::write() takes
+// only what fits in its queue, where play() would wait.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+AudioPlayStream<2>     player;
+AudioRecordStream<2>   recorder;
+AudioPlayQueue         queue1;
+AudioConnection        patchCord1(player, 0, recorder, 0);
+AudioConnection        patchCord2(player, 1, recorder, 1);
+
+int16_t playbuf[2 * 4096];         // 93 ms
+int16_t recbuf[2 * 128 * 4096];
+
+int16_t sample(uint32_t frame, int ch)
+{
+  return (int16_t)(frame * 3 + ch * 5000 + 1);  // never 0 for both
+}
+
+// packets of 1 to 8 ms, whose frames are written as space allows
+uint32_t sent;  // frames given to write()
+int16_t packet[2 * 400];
+uint32_t packet_len, packet_pos;
+uint32_t writes, partial;
+
+void feed(bool more)
+{
+  while (true) {
+    if (packet_pos >= packet_len) {
+      if (!more) return;
+      packet_len = random(44, 353) * 2;
+      for (uint32_t i=0; i < packet_len; i++) {
+        packet[i] = sample(sent + i / 2, i % 2);
+      }
+      sent += packet_len / 2;
+      packet_pos = 0;
+      more = random(0, 3) > 0;  // 1 to a few packets per update
+    }
+    uint32_t n = player.write(packet + packet_pos, packet_len - packet_pos);
+    writes++;
+    packet_pos += n;
+    if (packet_pos < packet_len) {
+      partial++;
+      return;  // full, keep the rest for later
+    }
+  }
+}
+
+uint32_t checked;
+void check(uint32_t *errors, uint32_t *zeros)
+{
+  uint32_t len;
+  int16_t *p;
+  while ((p = recorder.readBuffer(&len)) != NULL) {
+    for (uint32_t i=0; i < len; i += 2) {
+      if (p[i] == 0 && p[i + 1] == 0) {
+        (*zeros)++;
+      } else {
+        if (p[i] != sample(checked, 0) || p[i + 1] != sample(checked, 1)) (*errors)++;
+        checked++;
+      }
+    }
+    recorder.freeBuffer(len);
+  }
+}
+
+int main()
+{
+  AudioMemory(100);
+  player.begin(playbuf, sizeof(playbuf) / 2);
+  recorder.begin(recbuf, sizeof(recbuf) / 2);
+
+  // 20 seconds of random packets, written faster than they play
+  const int blocks = 20 * AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES;
+  uint32_t errors = 0, zeros = 0;
+  while (player.available() < 2 * AUDIO_BLOCK_SAMPLES) feed(true);  // prefill
+  for (int b=0; b < blocks; b++) {
+    feed(true);
+    AudioStream::update_all();
+    check(&errors, &zeros);
+  }
+  printf("Random packets, 20 seconds:\n");
+  printf("  %u write() calls, %u returned early with the buffer full\n", writes, partial);
+  printf("  %u frames played, %u errors, %u silent, %u underruns\n",
+    checked, errors, zeros, player.underruns());
+
+  // a 12 ms gap in the packets, starting in the middle of a block.  The
+  // recorder records nothing for updates where the player sends nothing.
+  printf("300 frames, a gap of 4 updates, then 300 frames:\n");
+  const char *names[3] = {"AUDIO_UNDERRUN_SILENCE", "AUDIO_UNDERRUN_HOLD", "AUDIO_UNDERRUN_SKIP"};
+  for (int policy=0; policy < 3; policy++) {
+    player.begin(playbuf, sizeof(playbuf) / 2);
+    player.underrun(policy);
+    recorder.clear();
+    int16_t data[2 * 300];
+    for (int i=0; i < 300; i++) {
+      data[i * 2] = 1000 + i;
+      data[i * 2 + 1] = -1000 - i;
+    }
+    player.write(data, 2 * 300);   // 2 blocks and 44 frames
+    for (int b=0; b < 7; b++) AudioStream::update_all();
+    player.write(data, 2 * 300);
+    for (int b=0; b < 3; b++) AudioStream::update_all();
+    uint32_t len, frames = 0, silent = 0, held = 0;
+    int16_t *p;
+    while ((p = recorder.readBuffer(&len)) != NULL) {
+      for (uint32_t i=0; i < len; i += 2) {
+        if (frames >= 300 && frames < 300 + 128 * 6) {
+          if (p[i] == 0) silent++;
+          if (p[i] == 1299) held++;
+        }
+        frames++;
+      }
+      recorder.freeBuffer(len);
+    }
+    printf("  %-22s %4u frames out, %3u silent, %3u held, underruns %u\n",
+      names[policy], frames, silent, held, player.underruns());
+  }
+
+  // AudioPlayQueue, nothing plays it, so it fills up
+  static int16_t mono[20000];
+  uint32_t n = queue1.write(mono, 20000);
+  printf("AudioPlayQueue::write of 20000 samples to a full queue: %u accepted\n", n);
+  n = queue1.write(mono, 20000);
+  printf("  and again: %u accepted\n", n);
+  return 0;
+}
@@ -0,0 +1,156 @@
+// Benchmark: AudioRecordStream versus AudioRecordQueue, 8 channels
+//
+// Records 8 channels of counting samples, as a recorder would write them
+// to SD, with 8 AudioRecordQueue objects, whose blocks loop() copies into
+// an interleaved buffer, and with one AudioRecordStream<8> writing
+// into a ring buffer which loop() reads without copying.  Then records
+// through simulated SD card stalls, too long for the buffer, and checks
+// every sample and the overrun accounting.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+#define CHANNELS 8
+
+AudioPlayQueue                  source[CHANNELS];
+AudioRecordQueue                queue[CHANNELS];
+AudioRecordStream<CHANNELS>     stream;
+AudioConnection                 *cords[CHANNELS * 2];
+
+// 0.5 seconds, which would be in PSRAM (EXTMEM) on Teensy 4.1
+const uint32_t ringlen = CHANNELS * 22016;
+int16_t ring[ringlen];
+
+uint32_t frame;  // frames played
+
+int16_t expected(uint32_t f, int ch)
+{
+  return (int16_t)(f * 7 + ch * 1000);
+}
+
+void play_block()
+{
+  for (int ch=0; ch < CHANNELS; ch++) {
+    int16_t *p = source[ch].getBuffer();
+    for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) p[i] = expected(frame + i, ch);
+    source[ch].playBuffer();
+  }
+  frame += AUDIO_BLOCK_SAMPLES;
+  AudioStream::update_all();
+}
+
+// the "SD card", which checks the samples, knowing the frames lost
+uint32_t start_frame, written, lost, errors;
+void sd_write(const int16_t *data, uint32_t samples)
+{
+  for (uint32_t i=0; i < samples; i++) {
+    uint32_t f = start_frame + lost + (written + i) / CHANNELS;
+    int ch = (written + i) % CHANNELS;
+    if (data[i] != expected(f, ch)) errors++;
+  }
+  written += samples;
+}
+
+int main()
+{
+  AudioMemory(200);
+  for (int ch=0; ch < CHANNELS; ch++) {
+    cords[ch * 2] = new AudioConnection(source[ch], 0, queue[ch], 0);
+    cords[ch * 2 + 1] = new AudioConnection(source[ch], 0, stream, ch);
+  }
+
+  // Cost of recording 30 seconds, writing 4 kbyte to SD when available
+  const int blocks = 30 * AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES;
+  static int16_t sdbuf[2048 + CHANNELS * AUDIO_BLOCK_SAMPLES];
+  uint64_t update[2] = {0, 0}, loopcycles[2] = {0, 0};
+  uint32_t calls[2] = {0, 0};
+  uint32_t sdlen = 0;
+  for (int ch=0; ch < CHANNELS; ch++) queue[ch].begin();
+  stream.begin(ring, ringlen);
+  for (int b=0; b < blocks; b++) {
+    play_block();
+    for (int ch=0; ch < CHANNELS; ch++) update[0] += queue[ch].cpu_cycles;
+    update[1] += stream.cpu_cycles;
+
+    // AudioRecordQueue: read a block of every channel and interleave
+    uint32_t start = host_cycle_count();
+    while (queue[CHANNELS - 1].available() > 0) {
+      for (int ch=0; ch < CHANNELS; ch++) {
+        const int16_t *p = queue[ch].readBuffer();
+        for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+          sdbuf[sdlen + i * CHANNELS + ch] = p[i];
+        }
+        queue[ch].freeBuffer();
+        calls[0] += 2;
+      }
+      sdlen += CHANNELS * AUDIO_BLOCK_SAMPLES;
+      if (sdlen >= 2048) {
+        // SD.write(sdbuf, 4096)
+        memmove(sdbuf, sdbuf + 2048, (sdlen - 2048) * 2);
+        sdlen -= 2048;
+      }
+    }
+    loopcycles[0] += (uint32_t)(host_cycle_count() - start);
+
+    // AudioRecordStream: write straight from the ring buffer
+    start = host_cycle_count();
+    uint32_t len;
+    int16_t *p;
+    while ((p = stream.readBuffer(&len)) != NULL && len >= 2048) {
+      // SD.write(p, 4096)
+      stream.freeBuffer(2048);
+      calls[1] += 2;
+    }
+    loopcycles[1] += (uint32_t)(host_cycle_count() - start);
+  }
+  for (int ch=0; ch < CHANNELS; ch++) queue[ch].end();
+  printf("Recording %d channels, cycles per block:\n", CHANNELS);
+  printf("  %-34s %5.0f update, %5.0f loop, %4.1f calls\n",
+    "8 AudioRecordQueue + interleave", update[0] * 64.0 / blocks,
+    (double)loopcycles[0] / blocks, (double)calls[0] / blocks);
+  printf("  %-34s %5.0f update, %5.0f loop, %4.1f calls\n",
+    "AudioRecordStream<8>", update[1] * 64.0 / blocks,
+    (double)loopcycles[1] / blocks, (double)calls[1] / blocks);
+
+  // Record through SD stalls of 100 to 800 ms, writing in 4 kbyte pieces
+  printf("Recording into a 0.5 second buffer, with SD card stalls:\n");
+  const int stalls[] = {100, 300, 480, 600, 800};
+  stream.begin(ring, ringlen);
+  written = 0;
+  start_frame = frame;
+  uint32_t gaps = 0;
+  for (int stall : stalls) {
+    int stall_blocks = stall * AUDIO_SAMPLE_RATE_EXACT / 1000.0 / AUDIO_BLOCK_SAMPLES;
+    uint32_t overruns = stream.overruns();
+    for (int b=0; b < stall_blocks; b++) play_block();
+    // the card is fast again, writing up to 16 kbyte per block
+    for (int b=0; b < 200; b++) {
+      play_block();
+      uint32_t len, total = 0;
+      int16_t *p;
+      while ((p = stream.readBuffer(&len)) != NULL && total < 8192) {
+        if (len > 2048) len = 2048;
+        if (stream.overruns() > gaps) {
+          // stop at the gap, as a recorder would insert silence or mark it
+          uint32_t gap = stream.overrunPosition() * CHANNELS;
+          if (written == gap) {
+            lost += (stream.overruns() - gaps) * AUDIO_BLOCK_SAMPLES;
+            gaps = stream.overruns();
+          } else if (written + len > gap) {
+            len = gap - written;
+          }
+        }
+        sd_write(p, len);
+        stream.freeBuffer(len);
+        total += len;
+      }
+    }
+    printf("  %3d ms stall: %3u blocks overrun, at frame %7u, %u sample errors\n",
+      stall, stream.overruns() - overruns, stream.overrunPosition(), errors);
+  }
+  printf("Frames played %u, written %u, lost %u, %u in overrun blocks\n",
+    frame - start_frame, written / CHANNELS + stream.available() / CHANNELS,
+    lost, stream.overruns() * AUDIO_BLOCK_SAMPLES);
+  return 0;
+}
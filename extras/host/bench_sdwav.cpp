@@ -0,0 +1,203 @@
+// Benchmark: AudioPlaySdWav streaming and format conversion
+//
+// Plays the same WAV file with the normal 512 byte reads in the audio
+// update and with streaming mode, where prefetch() fills a buffer from
+// loop(), and checks both produce the same samples.  Then plays it with
+// prefetch() called too rarely for the buffer size, to show underruns
+// are counted and playback recovers.  Last, plays a 1 kHz sine in
+// formats which need conversion, and measures the noise of the result.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <SD.h>
+
+#define FILENAME "bench_sdwav.wav"
+#define SECONDS  5
+
+AudioPlaySdWav           playClassic;
+AudioPlaySdWav           playStream;
+AudioRecordQueue         outClassic;
+AudioRecordQueue         outStream;
+AudioConnection          patchCord1(playClassic, 0, outClassic, 0);
+AudioConnection          patchCord2(playStream, 0, outStream, 0);
+
+uint8_t streamBuffer[16384];
+int16_t recording[SECONDS * 44100 + 1000];
+
+static void put32(FILE *f, uint32_t n) { fwrite(&n, 4, 1, f); }
+static void put16(FILE *f, uint16_t n) { fwrite(&n, 2, 1, f); }
+
+// format 1 is integer PCM, 3 is float.  With frequency 0, the file is
+// full scale 16 bit noise.
+static void writeTestFile(int format, int bits, int channels, uint32_t rate,
+  bool extensible, float frequency)
+{
+  uint32_t frames = SECONDS * rate;
+  uint32_t align = channels * bits / 8;
+  uint32_t fmtsize = extensible ? 40 : 16;
+  FILE *f = fopen(FILENAME, "wb");
+  fwrite("RIFF", 4, 1, f);
+  put32(f, 20 + fmtsize + frames * align);
+  fwrite("WAVEfmt ", 8, 1, f);
+  put32(f, fmtsize);
+  put16(f, extensible ? 0xFFFE : format);
+  put16(f, channels);
+  put32(f, rate);
+  put32(f, rate * align);
+  put16(f, align);
+  put16(f, bits);
+  if (extensible) {
+    put16(f, 22);
+    put16(f, bits);
+    put32(f, 0);
+    put16(f, format); // SubFormat GUID, 00000001-0000-0010-8000-00aa00389b71
+    put16(f, 0);
+    put32(f, 0x00100000);
+    put32(f, 0xAA000080);
+    put32(f, 0x719B3800);
+  }
+  fwrite("data", 4, 1, f);
+  put32(f, frames * align);
+  uint32_t seed = 1;
+  for (uint32_t i=0; i < frames; i++) {
+    double x = 0.5 * sin(2.0 * M_PI * frequency * i / rate);
+    for (int ch=0; ch < channels; ch++) {
+      if (frequency == 0) {
+        seed = seed * 1664525 + 1013904223;
+        put16(f, seed >> 16);
+      } else if (format == 3) {
+        float v = x;
+        fwrite(&v, 4, 1, f);
+      } else if (bits == 8) {
+        fputc((int)lrint(x * 127.0) + 128, f);
+      } else if (bits == 16) {
+        put16(f, lrint(x * 32767.0));
+      } else if (bits == 24) {
+        int32_t v = lrint(x * 8388607.0);
+        fwrite(&v, 3, 1, f);
+      }
+    }
+  }
+  fclose(f);
+}
+
+// Play the test file and fit a sine to the middle of the output.
+// Returns the noise relative to the sine, in dB.
+static double measureSine(float frequency, double *cycles)
+{
+  uint32_t n = 0;
+  uint64_t sum = 0;
+  int blocks = 0;
+  playClassic.play(FILENAME);
+  outClassic.begin();
+  do {
+    AudioStream::update_all();
+    sum += playClassic.cpu_cycles;
+    blocks++;
+    while (outClassic.available()) {
+      if (n + AUDIO_BLOCK_SAMPLES <= sizeof(recording) / 2) {
+        memcpy(recording + n, outClassic.readBuffer(), AUDIO_BLOCK_SAMPLES * 2);
+        n += AUDIO_BLOCK_SAMPLES;
+      }
+      outClassic.freeBuffer();
+    }
+  } while (blocks < 8 || playClassic.isPlaying());
+  outClassic.end();
+  *cycles = sum * 64.0 / blocks;
+  if (n < 44100) return 0;
+
+  double w = 2.0 * M_PI * frequency / AUDIO_SAMPLE_RATE_EXACT;
+  double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+  uint32_t begin = 4096, end = n - 4096;
+  for (uint32_t i=begin; i < end; i++) {
+    double s = sin(w * i), c = cos(w * i), y = recording[i];
+    ss += s * s; sc += s * c; cc += c * c; ys += y * s; yc += y * c;
+  }
+  double det = ss * cc - sc * sc;
+  double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+  double signal = 0, noise = 0;
+  for (uint32_t i=begin; i < end; i++) {
+    double fit = a * sin(w * i) + b * cos(w * i);
+    signal += fit * fit;
+    noise += (recording[i] - fit) * (recording[i] - fit);
+  }
+  return 10.0 * log10(noise / signal);
+}
+
+int main()
+{
+  AudioMemory(40);
+  writeTestFile(1, 16, 2, 44100, false, 0);
+  SD.begin();
+  playStream.beginStreaming(streamBuffer, sizeof(streamBuffer));
+  outClassic.begin();
+  outStream.begin();
+
+  // pass 1: prefetch every update, output must match the classic mode
+  playClassic.play(FILENAME);
+  playStream.play(FILENAME);
+  uint64_t classic_cycles = 0, stream_cycles = 0;
+  int blocks = 0, differences = 0;
+  // isPlaying() is false until the header is parsed in the first updates
+  do {
+    AudioStream::update_all();
+    AudioPlaySdWav::prefetchAll();
+    classic_cycles += playClassic.cpu_cycles;
+    stream_cycles += playStream.cpu_cycles;
+    blocks++;
+    while (outClassic.available() && outStream.available()) {
+      if (memcmp(outClassic.readBuffer(), outStream.readBuffer(), AUDIO_BLOCK_SAMPLES * 2)) {
+        differences++;
+      }
+      outClassic.freeBuffer();
+      outStream.freeBuffer();
+    }
+  } while (blocks < 8 || playClassic.isPlaying() || playStream.isPlaying());
+  printf("classic:   %6.0f cycles/block\n", classic_cycles * 64.0 / blocks);
+  printf("streaming: %6.0f cycles/block, underruns: %u\n",
+    stream_cycles * 64.0 / blocks, playStream.underruns());
+  printf("blocks with different output: %d\n", differences);
+
+  // pass 2: 16 kbytes holds 32 blocks of stereo, prefetch every 48 updates
+  outClassic.end();
+  outClassic.clear();
+  playStream.play(FILENAME);
+  int count = 0;
+  do {
+    AudioStream::update_all();
+    if (++count % 48 == 0) playStream.prefetch();
+    while (outStream.available()) {
+      outStream.readBuffer();
+      outStream.freeBuffer();
+    }
+  } while (count < 8 || playStream.isPlaying());
+  printf("prefetch every 48 blocks, underruns: %u\n", playStream.underruns());
+  outStream.end();
+
+  // pass 3: formats which need conversion
+  struct {
+    const char *name;
+    int format, bits, channels;
+    uint32_t rate;
+    bool extensible;
+  } formats[] = {
+    {"16 bit stereo 44100 Hz", 1, 16, 2, 44100, false},
+    {"8 bit mono 44100 Hz", 1, 8, 1, 44100, false},
+    {"24 bit stereo 44100 Hz", 1, 24, 2, 44100, false},
+    {"float stereo 44100 Hz", 3, 32, 2, 44100, false},
+    {"24 bit 6 channel 44100 Hz", 1, 24, 6, 44100, true},
+    {"16 bit mono 22050 Hz", 1, 16, 1, 22050, false},
+    {"24 bit stereo 48000 Hz", 1, 24, 2, 48000, false},
+    {"float stereo 96000 Hz", 3, 32, 2, 96000, true},
+    {"24 bit 8 channel 48000 Hz", 1, 24, 8, 48000, true},
+  };
+  for (auto &f : formats) {
+    double cycles;
+    writeTestFile(f.format, f.bits, f.channels, f.rate, f.extensible, 1000.0f);
+    double noise = measureSine(1000.0f, &cycles);
+    printf("%-26s %7.0f cycles/block, noise %6.1f dB\n", f.name, cycles, noise);
+  }
+  remove(FILENAME);
+  return 0;
+}
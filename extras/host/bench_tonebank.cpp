@@ -0,0 +1,157 @@
+// Benchmark: AudioAnalyzeToneBank versus AudioAnalyzeToneDetect
+//
+// Measures the CPU time of 8 AudioAnalyzeToneDetect objects, as used for
+// DTMF decoding by the DialTone_Serial example, against one tone bank
+// with the same 8 tones, and the tone bank in dtmf() mode.  Then plays
+// all 16 DTMF keys with noise, twist and short tones, and some signals
+// which are not keys, and prints the keys decoded.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include <algorithm>
+#include <vector>
+
+AudioPlayQueue         queue1;
+AudioAnalyzeToneDetect tone[8];
+AudioAnalyzeToneBank   bank;
+AudioAnalyzeToneBank   dtmf;
+AudioConnection        patchCord1(queue1, tone[0]);
+AudioConnection        patchCord2(queue1, tone[1]);
+AudioConnection        patchCord3(queue1, tone[2]);
+AudioConnection        patchCord4(queue1, tone[3]);
+AudioConnection        patchCord5(queue1, tone[4]);
+AudioConnection        patchCord6(queue1, tone[5]);
+AudioConnection        patchCord7(queue1, tone[6]);
+AudioConnection        patchCord8(queue1, tone[7]);
+AudioConnection        patchCord9(queue1, bank);
+AudioConnection        patchCord10(queue1, dtmf);
+
+const char keys[] = "123A456B789C*0#D";
+const float rows[4] = {697, 770, 852, 941};
+const float columns[4] = {1209, 1336, 1477, 1633};
+const int cycles[8] = {21, 23, 25, 28, 36, 40, 44, 48};
+
+// signal generator, 2 sines plus noise
+struct Generator {
+  double phase1, phase2;
+  int16_t buffer[AUDIO_BLOCK_SAMPLES];
+  int index = AUDIO_BLOCK_SAMPLES;
+  void sample(double f1, double a1, double f2, double a2, double noise) {
+    double out = a1 * sin(phase1) + a2 * sin(phase2);
+    out += noise * random(-10000, 10001) / 10000.0 * sqrt(3.0);
+    phase1 += 2.0 * M_PI * f1 / AUDIO_SAMPLE_RATE_EXACT;
+    phase2 += 2.0 * M_PI * f2 / AUDIO_SAMPLE_RATE_EXACT;
+    out *= 32767.0;
+    if (out > 32767.0) out = 32767.0;
+    if (out < -32767.0) out = -32767.0;
+    if (index >= AUDIO_BLOCK_SAMPLES) index = 0;
+    buffer[index++] = out;
+    if (index == AUDIO_BLOCK_SAMPLES) play();
+  }
+  void play() {
+    int16_t *p = queue1.getBuffer();
+    memcpy(p, buffer, sizeof(buffer));
+    queue1.playBuffer();
+    AudioStream::update_all();
+  }
+  void silence(double ms, double noise) {
+    int n = ms * AUDIO_SAMPLE_RATE_EXACT / 1000.0;
+    for (int i=0; i < n; i++) sample(0, 0, 0, 0, noise);
+  }
+} gen;
+
+std::vector<uint32_t> cpu[3];
+
+void measure() {
+  uint32_t cycles = 0;
+  for (int i=0; i < 8; i++) cycles += tone[i].cpu_cycles;
+  cpu[0].push_back(cycles);
+  cpu[1].push_back(bank.cpu_cycles);
+  cpu[2].push_back(dtmf.cpu_cycles);
+}
+
+// play all 16 keys, return the keys decoded
+void test(const char *name, double ms, double gap, double level,
+  double twist_db, double noise_db)
+{
+  double noise = pow(10.0, noise_db / 20.0);
+  double col = level * pow(10.0, twist_db / 20.0);
+  char decoded[64];
+  int count = 0;
+  for (int k=0; k < 16; k++) {
+    int n = ms * AUDIO_SAMPLE_RATE_EXACT / 1000.0;
+    for (int i=0; i < n; i++) {
+      gen.sample(rows[k / 4], level, columns[k % 4], col, noise);
+    }
+    gen.silence(gap, noise);
+    char c;
+    while ((c = dtmf.readKey()) != 0 && count < 63) decoded[count++] = c;
+  }
+  decoded[count] = 0;
+  printf("  %-34s %-16s %s\n", name, decoded,
+    strcmp(decoded, keys) == 0 ? "ok" : "");
+}
+
+// play a signal which is not a key, return the number of keys decoded
+void test_false(const char *name, double f1, double f2, double a2, double noise)
+{
+  int n = 2.0 * AUDIO_SAMPLE_RATE_EXACT;
+  for (int i=0; i < n; i++) gen.sample(f1, 0.3, f2, a2, noise);
+  gen.silence(50, 0);
+  int count = 0;
+  while (dtmf.readKey()) count++;
+  printf("  %-34s %d keys\n", name, count);
+}
+
+int main()
+{
+  AudioMemory(20);
+  for (int i=0; i < 8; i++) {
+    float f = (i < 4) ? rows[i] : columns[i - 4];
+    tone[i].frequency(f, cycles[i]);
+    bank.frequency(i, f);
+  }
+  bank.duration(30);
+  dtmf.dtmf();
+  dtmf.threshold(0.02);
+
+  // CPU time, with a steady key
+  for (int i=0; i < 20000; i++) {
+    gen.sample(rows[1], 0.3, columns[2], 0.3, 0.01);
+    if (gen.index == AUDIO_BLOCK_SAMPLES) measure();
+  }
+  const char *names[3] = {"8 x ToneDetect", "ToneBank, 8 tones", "ToneBank, dtmf()"};
+  printf("CPU cycles per update, average and 99th percentile:\n");
+  for (int m=0; m < 3; m++) {
+    std::vector<uint32_t> &c = cpu[m];
+    double sum = 0;
+    for (uint32_t v : c) sum += v;
+    std::sort(c.begin(), c.end());
+    printf("  %-18s %6.0f %6u\n", names[m], sum * 64.0 / c.size(),
+      c[c.size() * 99 / 100] * 64);
+  }
+  printf("Levels for key 6, -10.5 dB, 0.3 of full scale:\n ");
+  for (int i=0; i < 8; i++) printf(" %.3f", tone[i].read());
+  printf("  (ToneDetect)\n ");
+  for (int i=0; i < 8; i++) printf(" %.3f", bank.read(i));
+  printf("  (ToneBank)\n");
+  while (dtmf.readKey()) ;
+
+  printf("DTMF keys decoded, of %s:\n", keys);
+  test("50 ms, 50 ms gap", 50, 50, 0.3, 0, -100);
+  test("40 ms, 40 ms gap", 40, 40, 0.3, 0, -100);
+  test("20 ms, too short, most rejected", 20, 40, 0.3, 0, -100);
+  test("50 ms, -30 dB, 20 dB SNR", 50, 50, 0.03, 0, -50);
+  test("50 ms, noise 12 dB below tones", 50, 50, 0.3, 0, -22);
+  test("50 ms, column 4 dB louder", 50, 50, 0.2, 3.5, -100);
+  test("50 ms, column 6 dB weaker", 50, 50, 0.3, -6, -100);
+  test("50 ms, column 10 dB weaker, none", 50, 50, 0.3, -10, -100);
+  printf("Not DTMF keys:\n");
+  test_false("noise", 0, 0, 0, 0.3);
+  test_false("row tone only", 770, 0, 0, 0);
+  test_false("row and 1000 Hz", 770, 1000, 0.3, 0);
+  test_false("key 5 with loud noise", 770, 1336, 0.3, 0.4);
+  test_false("440 and 880 Hz", 440, 880, 0.3, 0.01);
+  return 0;
+}
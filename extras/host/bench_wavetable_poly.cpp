@@ -0,0 +1,167 @@
+// Benchmark: AudioSynthWavetablePoly versus AudioSynthWavetable voices
+//
+// Plays the Viola instrument from the MidiSynth example with 32
+// AudioSynthWavetable objects summed by a tree of 11 AudioMixer4, the
+// usual way to play it polyphonically, and with one
+// AudioSynthWavetablePoly<32>.  Compares the output of a single note,
+// then the CPU time with 1 to 32 notes sounding, and shows voices being
+// taken when more than 32 notes are played.
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+#include "../../examples/Synthesis/Wavetable/MidiSynth/Viola_samples.cpp"
+
+#define VOICES 32
+
+AudioSynthWavetable             wavetable[VOICES];
+AudioMixer4                     mixer[11];
+AudioSynthWavetablePoly<VOICES> poly;
+AudioRecordQueue                queue1;
+AudioRecordQueue                queue2;
+AudioConnection                 patchCord1(mixer[10], queue1);
+AudioConnection                 patchCord2(poly, 0, queue2, 0);
+
+uint32_t cycles_voices, cycles_poly;
+
+void update(int16_t *out1, int16_t *out2)
+{
+  AudioStream::update_all();
+  cycles_voices = 0;
+  for (int i=0; i < VOICES; i++) cycles_voices += wavetable[i].cpu_cycles;
+  for (int i=0; i < 11; i++) cycles_voices += mixer[i].cpu_cycles;
+  cycles_poly = poly.cpu_cycles;
+  if (queue1.available()) {
+    int16_t *p = queue1.readBuffer();
+    if (out1) memcpy(out1, p, AUDIO_BLOCK_SAMPLES * 2);
+    queue1.freeBuffer();
+  } else if (out1) {
+    memset(out1, 0, AUDIO_BLOCK_SAMPLES * 2);
+  }
+  if (queue2.available()) {
+    int16_t *p = queue2.readBuffer();
+    if (out2) memcpy(out2, p, AUDIO_BLOCK_SAMPLES * 2);
+    queue2.freeBuffer();
+  } else if (out2) {
+    memset(out2, 0, AUDIO_BLOCK_SAMPLES * 2);
+  }
+}
+
+void silence(void)
+{
+  for (int i=0; i < VOICES; i++) wavetable[i].stop();
+  poly.allNotesOff();
+  while (poly.voicesPlaying() > 0) update(NULL, NULL);
+  for (int i=0; i < 500; i++) update(NULL, NULL);
+}
+
+int main()
+{
+  AudioMemory(60);
+  // 8 mixers of 4 voices, then 2 and 1
+  for (int i=0; i < VOICES; i++) {
+    new AudioConnection(wavetable[i], 0, mixer[i / 4], i % 4);
+    wavetable[i].setInstrument(Viola);
+    wavetable[i].amplitude(1.0);
+  }
+  for (int i=0; i < 8; i++) new AudioConnection(mixer[i], 0, mixer[8 + i / 4], i % 4);
+  for (int i=0; i < 2; i++) new AudioConnection(mixer[8 + i], 0, mixer[10], i);
+  poly.setInstrument(Viola);
+  queue1.begin();
+  queue2.begin();
+
+  // one note, 1 second, then its release
+  const int blocks = 2 * AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES;
+  int16_t out1[AUDIO_BLOCK_SAMPLES], out2[AUDIO_BLOCK_SAMPLES];
+  printf("One note, AudioSynthWavetablePoly - AudioSynthWavetable:\n");
+  printf("  %4s %6s %16s %16s %16s\n", "note", "peak", "first 12 ms", "to 170 ms", "worst level");
+  const int notes1[] = {48, 60, 69, 84};
+  for (int note : notes1) {
+    // waveform difference until the modulation LFO starts, after 190 ms,
+    // and slightly changes the phase, then the level of each 29 ms
+    double sig[2] = {0, 0}, err[2] = {0, 0}, level1 = 0, level2 = 0, worst = 0;
+    int peak = 0;
+    wavetable[0].playNote(note, 100);
+    poly.noteOn(note, 100);
+    for (int b=0; b < blocks; b++) {
+      if (b == blocks / 2) {
+        wavetable[0].stop();
+        poly.noteOff(note);
+      }
+      update(out1, out2);
+      for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        int d = out2[i] - out1[i];
+        int n = (b < 4) ? 0 : 1;
+        if (b < 60) {
+          sig[n] += (double)out1[i] * out1[i];
+          err[n] += (double)d * d;
+        }
+        level1 += (double)out1[i] * out1[i];
+        level2 += (double)out2[i] * out2[i];
+        if (abs(out1[i]) > peak) peak = abs(out1[i]);
+      }
+      if (b % 10 == 9) {
+        if (level1 > 1280.0 * 100 * 100) {
+          double db = fabs(10 * log10(level2 / level1));
+          if (db > worst) worst = db;
+        }
+        level1 = level2 = 0;
+      }
+    }
+    printf("  %4d %6d %13.1f dB %13.1f dB %13.2f dB\n", note, peak,
+      10 * log10(err[0] / sig[0]), 10 * log10(err[1] / sig[1]), worst);
+    silence();
+  }
+
+  // held chords, with mixer gains low enough not to clip
+  for (int i=0; i < 11; i++) {
+    for (int ch=0; ch < 4; ch++) mixer[i].gain(ch, i == 10 ? 0.125 : 1.0);
+  }
+  poly.amplitude(0.125);
+  printf("CPU cycles per update, notes held:\n");
+  printf("  %5s %26s %26s\n", "notes", "32 voices + 11 mixers", "AudioSynthWavetablePoly");
+  const int counts[] = {0, 1, 4, 8, 16, 32};
+  for (int count : counts) {
+    for (int i=0; i < count; i++) {
+      int note = 36 + i * 48 / VOICES;
+      wavetable[i].playNote(note, 100);
+      poly.noteOn(note, 100);
+    }
+    // skip the attack, then measure 200 updates
+    for (int b=0; b < 20; b++) update(NULL, NULL);
+    uint64_t total1 = 0, total2 = 0;
+    for (int b=0; b < 200; b++) {
+      update(NULL, NULL);
+      total1 += cycles_voices;
+      total2 += cycles_poly;
+    }
+    printf("  %5d %26.0f %26.0f\n", count, total1 * 64.0 / 200, total2 * 64.0 / 200);
+    silence();
+  }
+  poly.stereoWidth(1.0);
+  for (int i=0; i < VOICES; i++) poly.noteOn(36 + i * 48 / VOICES, 100);
+  for (int b=0; b < 20; b++) update(NULL, NULL);
+  uint64_t total = 0;
+  for (int b=0; b < 200; b++) {
+    update(NULL, NULL);
+    total += cycles_poly;
+  }
+  printf("  %5d %26s %26.0f  (stereoWidth 1.0)\n", VOICES, "", total * 64.0 / 200);
+  silence();
+
+  // more notes than voices, all held, then all released
+  printf("Playing 48 notes, every 23 ms:\n");
+  for (int n=0; n < 48; n++) {
+    poly.noteOn(40 + n, 100);
+    for (int b=0; b < 8; b++) update(NULL, NULL);
+    if (n % 8 == 7) printf("  %2d notes on, %2d voices playing\n", n + 1, poly.voicesPlaying());
+  }
+  poly.allNotesOff();
+  int b = 0;
+  while (poly.voicesPlaying() > 0) {
+    update(NULL, NULL);
+    b++;
+  }
+  printf("  all released, silent after %.2f seconds\n", b * AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT);
+  return 0;
+}
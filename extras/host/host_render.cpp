@@ -0,0 +1,277 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "host_render.h"
+
+// WAV file format:
+// http://www-mmsp.ece.mcgill.ca/Documents/AudioFormats/WAVE/WAVE.html
+
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint32_t get_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le16(uint8_t *p, uint32_t n)
+{
+	p[0] = n;
+	p[1] = n >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t n)
+{
+	p[0] = n;
+	p[1] = n >> 8;
+	p[2] = n >> 16;
+	p[3] = n >> 24;
+}
+
+AudioInputWavFile * AudioInputWavFile::first_input = NULL;
+
+AudioInputWavFile::AudioInputWavFile(void) : AudioStream(0, NULL), file(NULL)
+{
+	next_input = first_input;
+	first_input = this;
+}
+
+AudioInputWavFile::~AudioInputWavFile()
+{
+	close();
+	for (AudioInputWavFile **p = &first_input; *p; p = &(*p)->next_input) {
+		if (*p == this) {
+			*p = next_input;
+			break;
+		}
+	}
+}
+
+// Inputs which are not connected to anything never update, so they
+// must not keep AudioHostRender() waiting.
+bool AudioInputWavFile::anyPlaying(void)
+{
+	for (AudioInputWavFile *p = first_input; p; p = p->next_input) {
+		if (p->file && p->isActive()) return true;
+	}
+	return false;
+}
+
+bool AudioInputWavFile::open(const char *filename)
+{
+	uint8_t header[40];
+	bool have_format = false;
+
+	close();
+	file = fopen(filename, "rb");
+	if (!file) return false;
+	if (fread(header, 1, 12, file) != 12
+	  || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+		goto fail;
+	}
+	while (fread(header, 1, 8, file) == 8) {
+		uint32_t len = get_le32(header + 4);
+		if (memcmp(header, "fmt ", 4) == 0) {
+			if (len < 16 || len > sizeof(header)) goto fail;
+			if (fread(header, 1, len, file) != len) goto fail;
+			format = get_le16(header);
+			if (format == WAVE_FORMAT_EXTENSIBLE && len >= 26) {
+				format = get_le16(header + 24); // SubFormat GUID
+			}
+			num_channels = get_le16(header + 2);
+			sample_rate = get_le32(header + 4);
+			bytes_per_sample = get_le16(header + 14) / 8;
+			if (num_channels < 1 || num_channels > AUDIO_HOST_WAV_MAX_CHANNELS) goto fail;
+			if (format == WAVE_FORMAT_PCM) {
+				if (bytes_per_sample < 1 || bytes_per_sample > 4) goto fail;
+			} else if (format == WAVE_FORMAT_IEEE_FLOAT) {
+				if (bytes_per_sample != 4) goto fail;
+			} else {
+				goto fail;
+			}
+			have_format = true;
+			if (len & 1) fseek(file, 1, SEEK_CUR);
+		} else if (memcmp(header, "data", 4) == 0) {
+			if (!have_format) goto fail;
+			data_remaining = len;
+			return true;
+		} else {
+			if (fseek(file, len + (len & 1), SEEK_CUR) != 0) goto fail;
+		}
+	}
+fail:
+	fclose(file);
+	file = NULL;
+	return false;
+}
+
+void AudioInputWavFile::close(void)
+{
+	if (!file) return;
+	fclose(file);
+	file = NULL;
+}
+
+void AudioInputWavFile::update(void)
+{
+	audio_block_t *block[AUDIO_HOST_WAV_MAX_CHANNELS];
+	uint8_t buf[AUDIO_BLOCK_SAMPLES * AUDIO_HOST_WAV_MAX_CHANNELS * 4];
+	unsigned int ch, i, n, frame_bytes;
+
+	if (!file) return;
+	for (ch=0; ch < num_channels; ch++) {
+		block[ch] = allocate();
+		if (!block[ch]) {
+			while (ch > 0) release(block[--ch]);
+			return;
+		}
+	}
+	frame_bytes = bytes_per_sample * num_channels;
+	n = AUDIO_BLOCK_SAMPLES * frame_bytes;
+	if (n > data_remaining) n = data_remaining - (data_remaining % frame_bytes);
+	n = fread(buf, 1, n, file) / frame_bytes;
+	data_remaining -= n * frame_bytes;
+
+	const uint8_t *p = buf;
+	for (i=0; i < n; i++) {
+		for (ch=0; ch < num_channels; ch++) {
+			int16_t sample;
+			if (format == WAVE_FORMAT_IEEE_FLOAT) {
+				uint32_t bits = get_le32(p);
+				float f;
+				memcpy(&f, &bits, 4);
+				f *= 32768.0f;
+				sample = f > 32767.0f ? 32767 : (f < -32768.0f ? -32768 : (int16_t)f);
+			} else if (bytes_per_sample == 1) {
+				sample = ((int16_t)p[0] - 128) << 8;
+			} else {
+				// keep the 16 most significant bits
+				sample = get_le16(p + bytes_per_sample - 2);
+			}
+			block[ch]->data[i] = sample;
+			p += bytes_per_sample;
+		}
+	}
+	for (ch=0; ch < num_channels; ch++) {
+		if (n < AUDIO_BLOCK_SAMPLES) {
+			memset(block[ch]->data + n, 0, (AUDIO_BLOCK_SAMPLES - n) * 2);
+		}
+		transmit(block[ch], ch);
+		release(block[ch]);
+	}
+	if (n < AUDIO_BLOCK_SAMPLES) close();
+}
+
+bool AudioOutputWavFile::open(const char *filename, unsigned int channels, uint32_t rate)
+{
+	uint8_t header[44];
+
+	close();
+	if (channels < 1 || channels > AUDIO_HOST_WAV_MAX_CHANNELS) return false;
+	file = fopen(filename, "wb");
+	if (!file) return false;
+	num_channels = channels;
+	sample_rate = rate;
+	samples_written = 0;
+	memset(header, 0, sizeof(header)); // sizes are filled in by close()
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+	return true;
+}
+
+void AudioOutputWavFile::close(void)
+{
+	uint8_t header[44];
+
+	if (!file) return;
+	uint32_t data_bytes = samples_written * num_channels * 2;
+	memcpy(header, "RIFF", 4);
+	put_le32(header + 4, 36 + data_bytes);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	put_le32(header + 16, 16);
+	put_le16(header + 20, WAVE_FORMAT_PCM);
+	put_le16(header + 22, num_channels);
+	put_le32(header + 24, sample_rate);
+	put_le32(header + 28, sample_rate * num_channels * 2);
+	put_le16(header + 32, num_channels * 2);
+	put_le16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	put_le32(header + 40, data_bytes);
+	fseek(file, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), file);
+	fclose(file);
+	file = NULL;
+}
+
+void AudioOutputWavFile::update(void)
+{
+	audio_block_t *block[AUDIO_HOST_WAV_MAX_CHANNELS];
+	uint8_t buf[AUDIO_BLOCK_SAMPLES * AUDIO_HOST_WAV_MAX_CHANNELS * 2];
+	unsigned int ch, i;
+
+	for (ch=0; ch < AUDIO_HOST_WAV_MAX_CHANNELS; ch++) {
+		block[ch] = receiveReadOnly(ch);
+	}
+	if (file) {
+		uint8_t *p = buf;
+		for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			for (ch=0; ch < num_channels; ch++) {
+				put_le16(p, block[ch] ? block[ch]->data[i] : 0);
+				p += 2;
+			}
+		}
+		fwrite(buf, 1, p - buf, file);
+		samples_written += AUDIO_BLOCK_SAMPLES;
+	}
+	for (ch=0; ch < AUDIO_HOST_WAV_MAX_CHANNELS; ch++) {
+		if (block[ch]) release(block[ch]);
+	}
+}
+
+uint32_t AudioHostRender(uint32_t tail_blocks)
+{
+	uint32_t count = 0;
+
+	while (AudioInputWavFile::anyPlaying()) {
+		AudioStream::update_all();
+		count++;
+	}
+	while (tail_blocks-- > 0) {
+		AudioStream::update_all();
+		count++;
+	}
+	return count;
+}
@@ -0,0 +1,90 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2014, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef host_render_h_
+#define host_render_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+
+#define AUDIO_HOST_WAV_MAX_CHANNELS 8
+
+// Reads a WAV file (8, 16, 24 bit PCM or 32 bit float, up to 8 channels)
+// and transmits one channel per output, in place of a hardware input.
+// The sample rate is not converted.
+class AudioInputWavFile : public AudioStream
+{
+public:
+	AudioInputWavFile(void);
+	virtual ~AudioInputWavFile();
+	bool open(const char *filename);
+	void close(void);
+	bool isPlaying(void) { return file != NULL; }
+	unsigned int channels(void) { return num_channels; }
+	uint32_t sampleRate(void) { return sample_rate; }
+	static bool anyPlaying(void);
+	virtual void update(void);
+private:
+	FILE *file;
+	uint32_t data_remaining;
+	uint32_t sample_rate;
+	uint16_t num_channels;
+	uint16_t format;
+	uint16_t bytes_per_sample;
+	AudioInputWavFile *next_input;
+	static AudioInputWavFile *first_input;
+};
+
+// Writes each block received on inputs 0 to channels-1 to a 16 bit WAV
+// file, in place of a hardware output.  Silence is written for inputs
+// which did not receive a block.
+class AudioOutputWavFile : public AudioStream
+{
+public:
+	AudioOutputWavFile(void) : AudioStream(AUDIO_HOST_WAV_MAX_CHANNELS, inputQueueArray),
+		file(NULL) { }
+	virtual ~AudioOutputWavFile() { close(); }
+	bool open(const char *filename, unsigned int channels = 2,
+		uint32_t rate = AUDIO_SAMPLE_RATE_EXACT);
+	void close(void);
+	uint32_t samplesWritten(void) { return samples_written; }
+	virtual void update(void);
+private:
+	FILE *file;
+	uint32_t samples_written;
+	uint32_t sample_rate;
+	uint16_t num_channels;
+	audio_block_t *inputQueueArray[AUDIO_HOST_WAV_MAX_CHANNELS];
+};
+
+// Run the audio library, one update per block, as fast as the PC allows.
+// Rendering stops when every AudioInputWavFile has reached the end of its
+// file, then continues for tail_blocks more so reverb and delay tails can
+// ring out.  A patch without any input file renders exactly tail_blocks.
+// Returns the number of blocks rendered.
+uint32_t AudioHostRender(uint32_t tail_blocks = 0);
+
+#endif
@@ -0,0 +1,2 @@
+// effect_reverb.cpp includes this CMSIS example header to get arm_math.h
+#include "arm_math.h"
@@ -0,0 +1,68 @@
+// Freeverb - offline render on a PC
+//
+// Reads a stereo (or mono) WAV file, runs it through the same patch as
+// examples/Effects/Freeverb, and writes the result to another WAV file.
+//
+//   ./render_freeverb input.wav output.wav
+//
+// This example code is in the public domain.
+
+#include <Audio.h>
+
+// GUItool: begin automatically generated code
+AudioInputWavFile        wavIn;
+AudioMixer4              mixer1;
+AudioEffectFreeverb      freeverb1;
+AudioMixer4              mixer2;
+AudioOutputWavFile       wavOut;
+AudioConnection          patchCord1(wavIn, 0, mixer1, 0);
+AudioConnection          patchCord2(wavIn, 1, mixer1, 1);
+AudioConnection          patchCord3(mixer1, freeverb1);
+AudioConnection          patchCord4(mixer1, 0, mixer2, 1);
+AudioConnection          patchCord5(freeverb1, 0, mixer2, 0);
+AudioConnection          patchCord6(mixer2, 0, wavOut, 0);
+AudioConnection          patchCord7(mixer2, 0, wavOut, 1);
+// GUItool: end automatically generated code
+AudioProfiler            profiler;   // create after the objects it measures
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s input.wav output.wav\n", argv[0]);
+    return 1;
+  }
+  AudioMemory(20);
+  mixer1.gain(0, 0.5);
+  mixer1.gain(1, 0.5);
+  mixer2.gain(0, 0.9); // hear 90% "wet"
+  mixer2.gain(1, 0.1); // and  10% "dry"
+  freeverb1.roomsize(0.7);
+  freeverb1.damping(0.5);
+  profiler.add(wavIn, "wavIn");
+  profiler.add(mixer1, "mixer1");
+  profiler.add(freeverb1, "freeverb1");
+  profiler.add(mixer2, "mixer2");
+  profiler.add(wavOut, "wavOut");
+  profiler.begin();
+
+  if (!wavIn.open(argv[1])) {
+    fprintf(stderr, "unable to read %s\n", argv[1]);
+    return 1;
+  }
+  if (!wavOut.open(argv[2], 2, wavIn.sampleRate())) {
+    fprintf(stderr, "unable to write %s\n", argv[2]);
+    return 1;
+  }
+  uint32_t usec = micros();
+  uint32_t blocks = AudioHostRender(400); // 1.2 seconds of reverb tail
+  usec = micros() - usec;
+  wavOut.close();
+
+  float seconds = blocks * (AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT);
+  printf("rendered %.1f seconds of audio in %.3f seconds\n", seconds, usec * 1e-6f);
+  printf("cpu usage (percent of real time) max: %.2f  freeverb max: %.2f\n",
+    AudioProcessorUsageMax(), freeverb1.processorUsageMax());
+  printf("audio memory max: %d blocks\n", AudioMemoryUsageMax());
+  profiler.printCSV(Serial);
+  return 0;
+}
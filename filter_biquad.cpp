@@ -26,10 +26,173 @@
 
 #include <Arduino.h>
 #include "filter_biquad.h"
+#include "FilterTables.h"
 #include "utility/dspinst.h"
 
 #if defined(__ARM_ARCH_7EM__)
 
+// The 32 bit and float versions run every stage for each sample, so the
+// cascade makes a single pass over the block.  Templates for each number
+// of stages allow the compiler to keep all the state in registers.
+
+// 32 bit samples have 12 bits below the 16 bit LSB and 4 bits headroom,
+// coefficients are Q30.  The state uses words 5 and 6 of each stage's
+// definition, which the 16 bit version uses for its own state.  Results
+// saturate, because wrapping on overflow can cause oscillation which
+// never decays.
+static inline int32_t saturate32(int64_t n)
+{
+	if (n > 2147483647) return 2147483647;
+	if (n < -2147483648ll) return -2147483648ll;
+	return n;
+}
+
+template <int stages>
+static void biquad_cascade_32bit(int16_t *data, int32_t *definition)
+{
+	int32_t s1[stages], s2[stages];
+	int i, n;
+
+	for (n=0; n < stages; n++) {
+		s1[n] = definition[n * 8 + 5];
+		s2[n] = definition[n * 8 + 6];
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t x = (int32_t)data[i] << 12;
+		for (n=0; n < stages; n++) {
+			const int32_t *c = definition + n * 8;
+			int32_t y = saturate32(((int64_t)c[0] * x + ((int64_t)s1[n] << 30) + (1 << 29)) >> 30);
+			s1[n] = saturate32(((int64_t)c[1] * x + (int64_t)c[3] * y + ((int64_t)s2[n] << 30) + (1 << 29)) >> 30);
+			s2[n] = saturate32(((int64_t)c[2] * x + (int64_t)c[4] * y + (1 << 29)) >> 30);
+			x = y;
+		}
+		data[i] = signed_saturate_rshift(x, 16, 12);
+	}
+	for (n=0; n < stages; n++) {
+		definition[n * 8 + 5] = s1[n];
+		definition[n * 8 + 6] = s2[n];
+	}
+}
+
+template <int stages>
+static void biquad_cascade_float(int16_t *data, const float *coef, float *state)
+{
+	float s1[stages], s2[stages];
+	int i, n;
+
+	for (n=0; n < stages; n++) {
+		s1[n] = state[n * 2];
+		s2[n] = state[n * 2 + 1];
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		float x = data[i];
+		for (n=0; n < stages; n++) {
+			const float *c = coef + n * 5;
+			float y = c[0] * x + s1[n];
+			s1[n] = c[1] * x + c[3] * y + s2[n];
+			s2[n] = c[2] * x + c[4] * y;
+			x = y;
+		}
+		if (x > 32767.0f) x = 32767.0f;
+		else if (x < -32768.0f) x = -32768.0f;
+		data[i] = (int16_t)(x + (x >= 0.0f ? 0.5f : -0.5f));
+	}
+	for (n=0; n < stages; n++) {
+		// flush denormals, which are very slow on some CPUs
+		if (fabsf(s1[n]) < 1.0e-20f) s1[n] = 0.0f;
+		if (fabsf(s2[n]) < 1.0e-20f) s2[n] = 0.0f;
+		state[n * 2] = s1[n];
+		state[n * 2 + 1] = s2[n];
+	}
+}
+
+// Float coefficient to Q30.  A -a1 near 2.0 may round up to 2.0f in
+// float, one more than the largest Q30.  Symmetric, so it can be negated.
+static inline int32_t biquad_q30(float f)
+{
+	if (f >= 2.0f) return 2147483647;
+	if (f <= -2.0f) return -2147483647;
+	return f * 1073741824.0f;
+}
+
+// Versions for modulation, which linearly interpolate from the current
+// coefficients to the target coefficients over the block.  Only the stages
+// in mask have a new target; the others keep their exact Q30 coefficients.
+template <int stages>
+static void biquad_cascade_32bit_ramp(int16_t *data, int32_t *definition,
+  const float *target, uint32_t mask)
+{
+	int32_t c[stages * 5], dc[stages * 5], s1[stages], s2[stages];
+	int i, n, k;
+
+	for (n=0; n < stages; n++) {
+		for (k=0; k < 5; k++) {
+			c[n * 5 + k] = definition[n * 8 + k];
+			dc[n * 5 + k] = 0;
+			if (mask & (1 << n)) {
+				int32_t t = biquad_q30(target[n * 5 + k]);
+				dc[n * 5 + k] = ((int64_t)t - c[n * 5 + k]) / AUDIO_BLOCK_SAMPLES;
+				definition[n * 8 + k] = t;
+			}
+		}
+		s1[n] = definition[n * 8 + 5];
+		s2[n] = definition[n * 8 + 6];
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t x = (int32_t)data[i] << 12;
+		for (n=0; n < stages; n++) {
+			int32_t *cn = c + n * 5;
+			int32_t y = saturate32(((int64_t)cn[0] * x + ((int64_t)s1[n] << 30) + (1 << 29)) >> 30);
+			s1[n] = saturate32(((int64_t)cn[1] * x + (int64_t)cn[3] * y + ((int64_t)s2[n] << 30) + (1 << 29)) >> 30);
+			s2[n] = saturate32(((int64_t)cn[2] * x + (int64_t)cn[4] * y + (1 << 29)) >> 30);
+			x = y;
+		}
+		for (k=0; k < stages * 5; k++) c[k] += dc[k];
+		data[i] = signed_saturate_rshift(x, 16, 12);
+	}
+	for (n=0; n < stages; n++) {
+		definition[n * 8 + 5] = s1[n];
+		definition[n * 8 + 6] = s2[n];
+	}
+}
+
+template <int stages>
+static void biquad_cascade_float_ramp(int16_t *data, float *coef, const float *target, float *state)
+{
+	float c[stages * 5], dc[stages * 5], s1[stages], s2[stages];
+	int i, n, k;
+
+	for (k=0; k < stages * 5; k++) {
+		c[k] = coef[k];
+		dc[k] = (target[k] - coef[k]) * (1.0f / AUDIO_BLOCK_SAMPLES);
+		coef[k] = target[k];
+	}
+	for (n=0; n < stages; n++) {
+		s1[n] = state[n * 2];
+		s2[n] = state[n * 2 + 1];
+	}
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		float x = data[i];
+		for (n=0; n < stages; n++) {
+			const float *cn = c + n * 5;
+			float y = cn[0] * x + s1[n];
+			s1[n] = cn[1] * x + cn[3] * y + s2[n];
+			s2[n] = cn[2] * x + cn[4] * y;
+			x = y;
+		}
+		for (k=0; k < stages * 5; k++) c[k] += dc[k];
+		if (x > 32767.0f) x = 32767.0f;
+		else if (x < -32768.0f) x = -32768.0f;
+		data[i] = (int16_t)(x + (x >= 0.0f ? 0.5f : -0.5f));
+	}
+	for (n=0; n < stages; n++) {
+		if (fabsf(s1[n]) < 1.0e-20f) s1[n] = 0.0f;
+		if (fabsf(s2[n]) < 1.0e-20f) s2[n] = 0.0f;
+		state[n * 2] = s1[n];
+		state[n * 2 + 1] = s2[n];
+	}
+}
+
 void AudioFilterBiquad::update(void)
 {
 	audio_block_t *block;
@@ -39,6 +202,47 @@ void AudioFilterBiquad::update(void)
 	int32_t *state;
 	block = receiveWritable();
 	if (!block) return;
+	if (precision != BIQUAD_16BIT) {
+		int stages = 1;
+		while (stages < 4 && (definition[stages * 8 - 1] & 0x80000000)) stages++;
+		if (ramp_pending) {
+			uint32_t mask = ramp_pending;
+			ramp_pending = 0;
+			if (precision == BIQUAD_FLOAT) {
+				switch (stages) {
+				case 1: biquad_cascade_float_ramp<1>(block->data, coef_float, coef_target, state_float); break;
+				case 2: biquad_cascade_float_ramp<2>(block->data, coef_float, coef_target, state_float); break;
+				case 3: biquad_cascade_float_ramp<3>(block->data, coef_float, coef_target, state_float); break;
+				default: biquad_cascade_float_ramp<4>(block->data, coef_float, coef_target, state_float);
+				}
+			} else {
+				for (int i=0; i < 20; i++) coef_float[i] = coef_target[i];
+				switch (stages) {
+				case 1: biquad_cascade_32bit_ramp<1>(block->data, definition, coef_target, mask); break;
+				case 2: biquad_cascade_32bit_ramp<2>(block->data, definition, coef_target, mask); break;
+				case 3: biquad_cascade_32bit_ramp<3>(block->data, definition, coef_target, mask); break;
+				default: biquad_cascade_32bit_ramp<4>(block->data, definition, coef_target, mask);
+				}
+			}
+		} else if (precision == BIQUAD_FLOAT) {
+			switch (stages) {
+			case 1: biquad_cascade_float<1>(block->data, coef_float, state_float); break;
+			case 2: biquad_cascade_float<2>(block->data, coef_float, state_float); break;
+			case 3: biquad_cascade_float<3>(block->data, coef_float, state_float); break;
+			default: biquad_cascade_float<4>(block->data, coef_float, state_float);
+			}
+		} else {
+			switch (stages) {
+			case 1: biquad_cascade_32bit<1>(block->data, definition); break;
+			case 2: biquad_cascade_32bit<2>(block->data, definition); break;
+			case 3: biquad_cascade_32bit<3>(block->data, definition); break;
+			default: biquad_cascade_32bit<4>(block->data, definition);
+			}
+		}
+		transmit(block);
+		release(block);
+		return;
+	}
 	end = (uint32_t *)(block->data) + AUDIO_BLOCK_SAMPLES/2;
 	state = (int32_t *)definition;
 	do {
@@ -101,9 +305,152 @@ void AudioFilterBiquad::setCoefficients(uint32_t stage, const int *coefficients)
 	//*dest++ = 0;  // clearing filter state causes loud pop
 	dest += 2;
 	*dest   &= 0x80000000;
+	float *fdest = coef_float + stage * 5;
+	coefficients -= 5;
+	fdest[0] = coefficients[0] * (1.0f / 1073741824.0f);
+	fdest[1] = coefficients[1] * (1.0f / 1073741824.0f);
+	fdest[2] = coefficients[2] * (1.0f / 1073741824.0f);
+	fdest[3] = coefficients[3] * (-1.0f / 1073741824.0f);
+	fdest[4] = coefficients[4] * (-1.0f / 1073741824.0f);
+	for (int i=0; i < 5; i++) coef_target[stage * 5 + i] = fdest[i];
 	__enable_irq();
 }
 
+// Float coefficients are converted directly, keeping more resolution for
+// the tiny b0, b1, b2 of low frequency filters than Q30 can represent.
+void AudioFilterBiquad::setCoefficients(uint32_t stage, const double *coefficients)
+{
+	int coef[5];
+	if (stage >= 4) return;
+	coef[0] = coefficients[0] * 1073741824.0;
+	coef[1] = coefficients[1] * 1073741824.0;
+	coef[2] = coefficients[2] * 1073741824.0;
+	coef[3] = coefficients[3] * 1073741824.0;
+	coef[4] = coefficients[4] * 1073741824.0;
+	setCoefficients(stage, coef);
+	float *fdest = coef_float + stage * 5;
+	__disable_irq();
+	fdest[0] = coefficients[0];
+	fdest[1] = coefficients[1];
+	fdest[2] = coefficients[2];
+	fdest[3] = -coefficients[3];
+	fdest[4] = -coefficients[4];
+	for (int i=0; i < 5; i++) coef_target[stage * 5 + i] = fdest[i];
+	__enable_irq();
+}
+
+void AudioFilterBiquad::setPrecision(int mode)
+{
+	if (mode < BIQUAD_16BIT || mode > BIQUAD_FLOAT) return;
+	__disable_irq();
+	if (mode != precision) {
+		// each version uses the state differently, so start from silence
+		for (int i=0; i < 4; i++) {
+			definition[i * 8 + 5] = 0;
+			definition[i * 8 + 6] = 0;
+			definition[i * 8 + 7] &= 0x80000000;
+		}
+		for (int i=0; i < 8; i++) state_float[i] = 0.0f;
+		for (int i=0; i < 20; i++) {
+			if (!(ramp_pending & (1 << (i / 5)))) continue;
+			coef_float[i] = coef_target[i];
+			definition[(i / 5) * 8 + (i % 5)] = biquad_q30(coef_target[i]);
+		}
+		ramp_pending = 0;
+		precision = mode;
+	}
+	__enable_irq();
+}
+
+// sin and cos of half the filter angle, from 0 to pi/2.  Using the half
+// angle avoids the loss of precision computing 1 - cos(w0) in float, for
+// low frequencies.
+static void biquad_half_angle(float frequency, float *sinhalf, float *coshalf)
+{
+	if (frequency < 1.0f) frequency = 1.0f;
+	else if (frequency > AUDIO_SAMPLE_RATE_EXACT * 0.499f) frequency = AUDIO_SAMPLE_RATE_EXACT * 0.499f;
+	float x = frequency * (float)(3.14159265358979 / AUDIO_SAMPLE_RATE_EXACT);
+	*sinhalf = filter_sin(x);
+	*coshalf = filter_cos(x);
+}
+
+// coefficients in coef_float order: b0, b1, b2, -a1, -a2
+void AudioFilterBiquad::setTarget(uint32_t stage, const float *coefficients)
+{
+	if (stage >= 4) return;
+	if (precision == BIQUAD_16BIT) {
+		int coef[5];
+		coef[0] = biquad_q30(coefficients[0]);
+		coef[1] = biquad_q30(coefficients[1]);
+		coef[2] = biquad_q30(coefficients[2]);
+		coef[3] = -biquad_q30(coefficients[3]);
+		coef[4] = -biquad_q30(coefficients[4]);
+		setCoefficients(stage, coef);
+		return;
+	}
+	__disable_irq();
+	if (stage > 0) definition[stage * 8 - 1] |= 0x80000000;
+	for (int i=0; i < 5; i++) coef_target[stage * 5 + i] = coefficients[i];
+	ramp_pending |= 1 << stage;
+	__enable_irq();
+}
+
+void AudioFilterBiquad::modulateLowpass(uint32_t stage, float frequency, float q)
+{
+	float sn, cs, coef[5];
+	biquad_half_angle(frequency, &sn, &cs);
+	float alpha = sn * cs / q;
+	float scale = 1.0f / (1.0f + alpha);
+	coef[0] = sn * sn * scale;
+	coef[1] = 2.0f * coef[0];
+	coef[2] = coef[0];
+	coef[3] = 2.0f * (1.0f - 2.0f * sn * sn) * scale;
+	coef[4] = (alpha - 1.0f) * scale;
+	setTarget(stage, coef);
+}
+
+void AudioFilterBiquad::modulateHighpass(uint32_t stage, float frequency, float q)
+{
+	float sn, cs, coef[5];
+	biquad_half_angle(frequency, &sn, &cs);
+	float alpha = sn * cs / q;
+	float scale = 1.0f / (1.0f + alpha);
+	coef[0] = cs * cs * scale;
+	coef[1] = -2.0f * coef[0];
+	coef[2] = coef[0];
+	coef[3] = 2.0f * (1.0f - 2.0f * sn * sn) * scale;
+	coef[4] = (alpha - 1.0f) * scale;
+	setTarget(stage, coef);
+}
+
+void AudioFilterBiquad::modulateBandpass(uint32_t stage, float frequency, float q)
+{
+	float sn, cs, coef[5];
+	biquad_half_angle(frequency, &sn, &cs);
+	float alpha = sn * cs / q;
+	float scale = 1.0f / (1.0f + alpha);
+	coef[0] = alpha * scale;
+	coef[1] = 0.0f;
+	coef[2] = -coef[0];
+	coef[3] = 2.0f * (1.0f - 2.0f * sn * sn) * scale;
+	coef[4] = (alpha - 1.0f) * scale;
+	setTarget(stage, coef);
+}
+
+void AudioFilterBiquad::modulateNotch(uint32_t stage, float frequency, float q)
+{
+	float sn, cs, coef[5];
+	biquad_half_angle(frequency, &sn, &cs);
+	float alpha = sn * cs / q;
+	float scale = 1.0f / (1.0f + alpha);
+	coef[0] = scale;
+	coef[1] = -2.0f * (1.0f - 2.0f * sn * sn) * scale;
+	coef[2] = scale;
+	coef[3] = -coef[1];
+	coef[4] = (alpha - 1.0f) * scale;
+	setTarget(stage, coef);
+}
+
 #elif defined(KINETISL)
 
 void AudioFilterBiquad::update(void)
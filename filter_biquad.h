@@ -30,36 +30,53 @@
 #include "Arduino.h"
 #include "AudioStream.h"
 
+// Processing precision, for setPrecision()
+#define BIQUAD_16BIT  0  // 16 bit state, direct form I (default)
+#define BIQUAD_32BIT  1  // 32 bit fixed point state, transposed direct form II
+#define BIQUAD_FLOAT  2  // 32 bit float state, transposed direct form II
+
 class AudioFilterBiquad : public AudioStream
 {
 public:
-	AudioFilterBiquad(void) : AudioStream(1, inputQueueArray) {
+	AudioFilterBiquad(void) : AudioStream(1, inputQueueArray), precision(BIQUAD_16BIT),
+	  ramp_pending(0) {
 		// by default, the filter will not pass anything
 		for (int i=0; i<32; i++) definition[i] = 0;
+		for (int i=0; i<20; i++) coef_float[i] = coef_target[i] = 0.0f;
+		for (int i=0; i<8; i++) state_float[i] = 0.0f;
 	}
 	virtual void update(void);
 
+	// The default 16 bit processing adds noise to filters with very low
+	// corner frequencies.  32 bit fixed point and float keep the filter
+	// state at higher resolution, at the cost of more CPU time.  Float
+	// is fastest on Teensy 4.x, 32 bit on Teensy 3.x.
+	void setPrecision(int mode);
+
 	// Set the biquad coefficients directly
 	void setCoefficients(uint32_t stage, const int *coefficients);
-	void setCoefficients(uint32_t stage, const double *coefficients) {
-		int coef[5];
-		coef[0] = coefficients[0] * 1073741824.0;
-		coef[1] = coefficients[1] * 1073741824.0;
-		coef[2] = coefficients[2] * 1073741824.0;
-		coef[3] = coefficients[3] * 1073741824.0;
-		coef[4] = coefficients[4] * 1073741824.0;
-		setCoefficients(stage, coef);
-	}
+	void setCoefficients(uint32_t stage, const double *coefficients);
+
+	// Change a filter quickly, for sweeps and modulation.  These compute
+	// coefficients with float and lookup tables instead of double precision
+	// trig.  With 32 bit or float precision, the coefficients move linearly
+	// from the old to the new response over the next block, so changes
+	// every block do not click.  With 16 bit precision, the new response
+	// begins on the next block.
+	void modulateLowpass(uint32_t stage, float frequency, float q = 0.7071f);
+	void modulateHighpass(uint32_t stage, float frequency, float q = 0.7071f);
+	void modulateBandpass(uint32_t stage, float frequency, float q = 1.0f);
+	void modulateNotch(uint32_t stage, float frequency, float q = 1.0f);
 
 	// Compute common filter functions
 	// http://www.musicdsp.org/files/Audio-EQ-Cookbook.txt
 	void setLowpass(uint32_t stage, float frequency, float q = 0.7071) {
-		int coef[5];
+		double coef[5];
 		double w0 = frequency * (2 * 3.141592654 / AUDIO_SAMPLE_RATE_EXACT);
 		double sinW0 = sin(w0);
 		double alpha = sinW0 / ((double)q * 2.0);
 		double cosW0 = cos(w0);
-		double scale = 1073741824.0 / (1.0 + alpha);
+		double scale = 1.0 / (1.0 + alpha);
 		/* b0 */ coef[0] = ((1.0 - cosW0) / 2.0) * scale;
 		/* b1 */ coef[1] = (1.0 - cosW0) * scale;
 		/* b2 */ coef[2] = coef[0];
@@ -68,12 +85,12 @@ public:
 		setCoefficients(stage, coef);
 	}
 	void setHighpass(uint32_t stage, float frequency, float q = 0.7071) {
-		int coef[5];
+		double coef[5];
 		double w0 = frequency * (2 * 3.141592654 / AUDIO_SAMPLE_RATE_EXACT);
 		double sinW0 = sin(w0);
 		double alpha = sinW0 / ((double)q * 2.0);
 		double cosW0 = cos(w0);
-		double scale = 1073741824.0 / (1.0 + alpha);
+		double scale = 1.0 / (1.0 + alpha);
 		/* b0 */ coef[0] = ((1.0 + cosW0) / 2.0) * scale;
 		/* b1 */ coef[1] = -(1.0 + cosW0) * scale;
 		/* b2 */ coef[2] = coef[0];
@@ -82,26 +99,26 @@ public:
 		setCoefficients(stage, coef);
 	}
 	void setBandpass(uint32_t stage, float frequency, float q = 1.0) {
-		int coef[5];
+		double coef[5];
 		double w0 = frequency * (2 * 3.141592654 / AUDIO_SAMPLE_RATE_EXACT);
 		double sinW0 = sin(w0);
 		double alpha = sinW0 / ((double)q * 2.0);
 		double cosW0 = cos(w0);
-		double scale = 1073741824.0 / (1.0 + alpha);
+		double scale = 1.0 / (1.0 + alpha);
 		/* b0 */ coef[0] = alpha * scale;
-		/* b1 */ coef[1] = 0;
+		/* b1 */ coef[1] = 0.0;
 		/* b2 */ coef[2] = (-alpha) * scale;
 		/* a1 */ coef[3] = (-2.0 * cosW0) * scale;
 		/* a2 */ coef[4] = (1.0 - alpha) * scale;
 		setCoefficients(stage, coef);
 	}
 	void setNotch(uint32_t stage, float frequency, float q = 1.0) {
-		int coef[5];
+		double coef[5];
 		double w0 = frequency * (2 * 3.141592654 / AUDIO_SAMPLE_RATE_EXACT);
 		double sinW0 = sin(w0);
 		double alpha = sinW0 / ((double)q * 2.0);
 		double cosW0 = cos(w0);
-		double scale = 1073741824.0 / (1.0 + alpha);
+		double scale = 1.0 / (1.0 + alpha);
 		/* b0 */ coef[0] = scale;
 		/* b1 */ coef[1] = (-2.0 * cosW0) * scale;
 		/* b2 */ coef[2] = coef[0];
@@ -110,7 +127,7 @@ public:
 		setCoefficients(stage, coef);
 	}
 	void setLowShelf(uint32_t stage, float frequency, float gain, float slope = 1.0f) {
-		int coef[5];
+		double coef[5];
 		double a = pow(10.0, gain/40.0);
 		double w0 = frequency * (2 * 3.141592654 / AUDIO_SAMPLE_RATE_EXACT);
 		double sinW0 = sin(w0);
@@ -120,7 +137,7 @@ public:
 		double sinsq = sinW0 * sqrt( (pow(a,2.0)+1.0)*(1.0/slope-1.0)+2.0*a );
 		double aMinus = (a-1.0)*cosW0;
 		double aPlus = (a+1.0)*cosW0;
-		double scale = 1073741824.0 / ( (a+1.0) + aMinus + sinsq);
+		double scale = 1.0 / ( (a+1.0) + aMinus + sinsq);
 		/* b0 */ coef[0] =		a *	( (a+1.0) - aMinus + sinsq	) * scale;
 		/* b1 */ coef[1] =  2.0*a * ( (a-1.0) - aPlus  			) * scale;
 		/* b2 */ coef[2] =		a * ( (a+1.0) - aMinus - sinsq 	) * scale;
@@ -129,7 +146,7 @@ public:
 		setCoefficients(stage, coef);
 	}
 	void setHighShelf(uint32_t stage, float frequency, float gain, float slope = 1.0f) {
-		int coef[5];
+		double coef[5];
 		double a = pow(10.0, gain/40.0);
 		double w0 = frequency * (2 * 3.141592654 / AUDIO_SAMPLE_RATE_EXACT);
 		double sinW0 = sin(w0);
@@ -139,7 +156,7 @@ public:
 		double sinsq = sinW0 * sqrt( (pow(a,2.0)+1.0)*(1.0/slope-1.0)+2.0*a );
 		double aMinus = (a-1.0)*cosW0;
 		double aPlus = (a+1.0)*cosW0;
-		double scale = 1073741824.0 / ( (a+1.0) - aMinus + sinsq);
+		double scale = 1.0 / ( (a+1.0) - aMinus + sinsq);
 		/* b0 */ coef[0] =		a *	( (a+1.0) + aMinus + sinsq	) * scale;
 		/* b1 */ coef[1] = -2.0*a * ( (a-1.0) + aPlus  			) * scale;
 		/* b2 */ coef[2] =		a * ( (a+1.0) + aMinus - sinsq 	) * scale;
@@ -150,6 +167,12 @@ public:
 
 private:
 	int32_t definition[32];  // up to 4 cascaded biquads
+	float coef_float[20];    // b0, b1, b2, -a1, -a2 for each stage
+	float state_float[8];    // transposed direct form II state
+	float coef_target[20];   // coef_float at the end of the next block
+	int precision;
+	volatile uint8_t ramp_pending;  // bit for each stage with a new target
+	void setTarget(uint32_t stage, const float *coefficients);
 	audio_block_t *inputQueueArray[1];
 };
 
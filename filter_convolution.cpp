@@ -0,0 +1,207 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "filter_convolution.h"
+
+// Uniformly partitioned overlap-save convolution.  Every update, the last
+// two input blocks are transformed and added to the frequency domain delay
+// line.  Each partition's spectrum is multiplied by the spectrum of the
+// input from that many blocks ago, summed, and transformed back.  The
+// second half of the result is the filtered output for the newest block.
+
+#define M AUDIO_BLOCK_SAMPLES   // complex FFT size
+#define N CONVOLUTION_FFT_SIZE  // real FFT size, and floats per spectrum
+
+static float split_twiddle[M * 2]; // cos, sin of 2*pi*k/N
+static bool split_twiddle_ready = false;
+
+// Real FFT of N samples, computed with a complex FFT of N/2 points which
+// treats even samples as real and odd samples as imaginary.  The output
+// is bins 0 to N/2-1, with the real Nyquist bin packed into the imaginary
+// part of bin 0, which is always zero.
+void AudioFilterConvolution::realFFT(const arm_cfft_radix2_instance_f32 *fft, float *data)
+{
+	arm_cfft_radix2_f32(fft, data);
+	float z0r = data[0], z0i = data[1];
+	data[0] = z0r + z0i;
+	data[1] = z0r - z0i;
+	for (int k=1; k <= M/2; k++) {
+		float *a = data + k * 2;
+		float *b = data + (M - k) * 2;
+		float c = split_twiddle[k * 2], s = split_twiddle[k * 2 + 1];
+		// spectra of the even and odd samples
+		float er = 0.5f * (a[0] + b[0]), ei = 0.5f * (a[1] - b[1]);
+		float or_ = 0.5f * (a[1] + b[1]), oi = 0.5f * (b[0] - a[0]);
+		float wr = c * or_ + s * oi, wi = c * oi - s * or_;
+		a[0] = er + wr;
+		a[1] = ei + wi;
+		b[0] = er - wr;
+		b[1] = wi - ei;
+	}
+}
+
+// Inverse of realFFT(), including the 1/N scaling
+void AudioFilterConvolution::inverseRealFFT(const arm_cfft_radix2_instance_f32 *ifft, float *data)
+{
+	float dc = data[0], nyquist = data[1];
+	data[0] = 0.5f * (dc + nyquist);
+	data[1] = 0.5f * (dc - nyquist);
+	for (int k=1; k <= M/2; k++) {
+		float *a = data + k * 2;
+		float *b = data + (M - k) * 2;
+		float c = split_twiddle[k * 2], s = split_twiddle[k * 2 + 1];
+		float er = 0.5f * (a[0] + b[0]), ei = 0.5f * (a[1] - b[1]);
+		float gr = 0.5f * (a[0] - b[0]), gi = 0.5f * (a[1] + b[1]);
+		float or_ = gr * c - gi * s, oi = gr * s + gi * c;
+		a[0] = er - oi;
+		a[1] = ei + or_;
+		b[0] = er + oi;
+		b[1] = or_ - ei;
+	}
+	arm_cfft_radix2_f32(ifft, data);
+}
+
+bool AudioFilterConvolution::init(unsigned int n_coeffs, float *memory)
+{
+	unsigned int n_partitions = AUDIO_CONVOLUTION_PARTITIONS(n_coeffs);
+
+	__disable_irq();
+	num_partitions = 0;
+	__enable_irq();
+	if (n_coeffs == 0 || n_partitions > 65535 || memory == NULL) return false;
+	if (arm_cfft_radix2_init_f32(&fft_inst, M, 0, 1) != ARM_MATH_SUCCESS) return false;
+	if (arm_cfft_radix2_init_f32(&ifft_inst, M, 1, 1) != ARM_MATH_SUCCESS) return false;
+	if (!split_twiddle_ready) {
+		for (int k=0; k < M; k++) {
+			float phase = (float)k * (float)(2.0 * M_PI / N);
+			split_twiddle[k * 2] = cosf(phase);
+			split_twiddle[k * 2 + 1] = sinf(phase);
+		}
+		split_twiddle_ready = true;
+	}
+	filter = memory;
+	history = memory + n_partitions * N;
+	memset(memory, 0, n_partitions * N * 2 * sizeof(float));
+	return true;
+}
+
+// The coefficients of each partition have been written to the first half
+// of its spectrum, the second half is zero padding.
+void AudioFilterConvolution::start(unsigned int n_partitions)
+{
+	for (unsigned int p=0; p < n_partitions; p++) {
+		realFFT(&fft_inst, filter + p * N);
+	}
+	memset(input, 0, sizeof(input));
+	__disable_irq();
+	head = 0;
+	silent_blocks = n_partitions + 1;
+	num_partitions = n_partitions;
+	__enable_irq();
+}
+
+bool AudioFilterConvolution::begin(const int16_t *coefficients, unsigned int n_coeffs, float *memory)
+{
+	if (!coefficients || !init(n_coeffs, memory)) return false;
+	for (unsigned int i=0; i < n_coeffs; i++) {
+		filter[(i / M) * N + (i % M)] = coefficients[i] * (1.0f / 32768.0f);
+	}
+	start(AUDIO_CONVOLUTION_PARTITIONS(n_coeffs));
+	return true;
+}
+
+bool AudioFilterConvolution::begin(const float *coefficients, unsigned int n_coeffs, float *memory)
+{
+	if (!coefficients || !init(n_coeffs, memory)) return false;
+	for (unsigned int i=0; i < n_coeffs; i++) {
+		filter[(i / M) * N + (i % M)] = coefficients[i];
+	}
+	start(AUDIO_CONVOLUTION_PARTITIONS(n_coeffs));
+	return true;
+}
+
+void AudioFilterConvolution::update(void)
+{
+	audio_block_t *block;
+	unsigned int i, n, p;
+
+	block = receiveReadOnly();
+	if (num_partitions == 0) {
+		if (block) release(block);
+		return;
+	}
+	if (block) {
+		silent_blocks = 0;
+	} else if (silent_blocks > num_partitions) {
+		// the impulse response has completely decayed
+		return;
+	} else {
+		silent_blocks++;
+	}
+
+	// input holds the previous and current block
+	memcpy(input, input + M, M * sizeof(float));
+	if (block) {
+		for (i=0; i < M; i++) input[M + i] = block->data[i];
+		release(block);
+	} else {
+		memset(input + M, 0, M * sizeof(float));
+	}
+	if (++head >= num_partitions) head = 0;
+	float *x = history + head * N;
+	memcpy(x, input, N * sizeof(float));
+	realFFT(&fft_inst, x);
+
+	// multiply and accumulate every partition
+	memset(output, 0, sizeof(output));
+	const float *h = filter;
+	p = head;
+	for (n=0; n < num_partitions; n++) {
+		x = history + p * N;
+		output[0] += h[0] * x[0]; // DC
+		output[1] += h[1] * x[1]; // Nyquist
+		for (i=2; i < N; i += 2) {
+			output[i] += h[i] * x[i] - h[i+1] * x[i+1];
+			output[i+1] += h[i] * x[i+1] + h[i+1] * x[i];
+		}
+		h += N;
+		p = (p == 0) ? num_partitions - 1 : p - 1;
+	}
+	inverseRealFFT(&ifft_inst, output);
+
+	// the first half is circular convolution wrap around, discard it
+	block = allocate();
+	if (!block) return;
+	for (i=0; i < M; i++) {
+		float f = output[M + i];
+		if (f > 32767.0f) f = 32767.0f;
+		else if (f < -32768.0f) f = -32768.0f;
+		block->data[i] = (int16_t)(f + (f >= 0.0f ? 0.5f : -0.5f));
+	}
+	transmit(block);
+	release(block);
+}
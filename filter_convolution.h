@@ -0,0 +1,81 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef filter_convolution_h_
+#define filter_convolution_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "arm_math.h"
+
+// Impulse responses are split into partitions of one audio block.  Each
+// partition is convolved in the frequency domain with an FFT twice the
+// block length (overlap-save), so the output of every block is complete
+// when update() returns: no latency is added, regardless of length.
+#define CONVOLUTION_PARTITION_SIZE  AUDIO_BLOCK_SAMPLES
+#define CONVOLUTION_FFT_SIZE        (AUDIO_BLOCK_SAMPLES * 2)
+
+// Number of floats needed for the memory given to begin(), to convolve
+// with an impulse response of n_coeffs samples.  On Teensy 4.x, large
+// buffers should be DMAMEM or EXTMEM, for example:
+//   DMAMEM float irmem[AUDIO_CONVOLUTION_MEMORY(8192)];
+#define AUDIO_CONVOLUTION_PARTITIONS(n_coeffs) \
+	(((n_coeffs) + CONVOLUTION_PARTITION_SIZE - 1) / CONVOLUTION_PARTITION_SIZE)
+#define AUDIO_CONVOLUTION_MEMORY(n_coeffs) \
+	(AUDIO_CONVOLUTION_PARTITIONS(n_coeffs) * CONVOLUTION_FFT_SIZE * 2)
+
+// Long FIR filter or impulse response (cabinet, room) convolution, with
+// thousands of coefficients.  Uses floating point, so it is intended for
+// Teensy 3.5, 3.6 and 4.x.  For short filters, AudioFilterFIR is faster.
+class AudioFilterConvolution : public AudioStream
+{
+public:
+	AudioFilterConvolution(void) : AudioStream(1, inputQueueArray),
+		num_partitions(0) { }
+	// coefficients are Q15 (32767 = 1.0), like AudioFilterFIR
+	bool begin(const int16_t *coefficients, unsigned int n_coeffs, float *memory);
+	bool begin(const float *coefficients, unsigned int n_coeffs, float *memory);
+	void end(void) { num_partitions = 0; }
+	unsigned int partitions(void) { return num_partitions; }
+	virtual void update(void);
+private:
+	bool init(unsigned int n_coeffs, float *memory);
+	void start(unsigned int n_partitions);
+	static void realFFT(const arm_cfft_radix2_instance_f32 *fft, float *data);
+	static void inverseRealFFT(const arm_cfft_radix2_instance_f32 *ifft, float *data);
+	audio_block_t *inputQueueArray[1];
+	float *filter;  // spectrum of each partition of the impulse response
+	float *history; // frequency domain delay line, spectra of past inputs
+	uint16_t num_partitions;
+	uint16_t head;
+	uint16_t silent_blocks;
+	arm_cfft_radix2_instance_f32 fft_inst;
+	arm_cfft_radix2_instance_f32 ifft_inst;
+	float input[CONVOLUTION_FFT_SIZE];
+	float output[CONVOLUTION_FFT_SIZE];
+};
+
+#endif
@@ -37,6 +37,7 @@
 
 #include <Arduino.h>
 #include "filter_ladder.h"
+#include "FilterTables.h"
 #include <math.h>
 #include <stdint.h>
 #define MOOG_PI ((float)3.14159265358979323846264338327950288)
@@ -138,24 +139,6 @@ bool AudioFilterLadder::resonating()
 	return false;
 }
 
-static inline float fast_exp2f(float x)
-{
-	float i;
-	float f = modff(x, &i);
-	f *= 0.693147f / 256.0f;
-	f += 1.0f;
-	f *= f;
-	f *= f;
-	f *= f;
-	f *= f;
-	f *= f;
-	f *= f;
-	f *= f;
-	f *= f;
-	f = ldexpf(f, i);
-	return f;
-}
-
 static inline float fast_tanh(float x)
 {
 	float x2 = x * x;
@@ -198,7 +181,7 @@ void AudioFilterLadder::update(void)
 		float input = blocka->data[i] * (1.0f/32768.0f) * overdrive;
 		if (FCmodActive) {
 			float FCmod = blockb->data[i] * octaveScale;
-			float ftot = Fbase * fast_exp2f(FCmod);
+			float ftot = Fbase * filter_exp2(FCmod);
 			if (ftot > MAX_FREQUENCY) ftot = MAX_FREQUENCY;
 			compute_coeffs(ftot);
 		}
@@ -29,6 +29,7 @@
 
 #include "Arduino.h"
 #include "AudioStream.h"
+#include "FilterTables.h"
 
 class AudioFilterStateVariable: public AudioStream
 {
@@ -42,14 +43,11 @@ public:
 		state_bandpass = 0;
 	}
 	void frequency(float freq) {
-		if (freq < 20.0) freq = 20.0;
-		else if (freq > AUDIO_SAMPLE_RATE_EXACT/2.5) freq = AUDIO_SAMPLE_RATE_EXACT/2.5;
-		setting_fcenter = (freq * (3.141592654/(AUDIO_SAMPLE_RATE_EXACT*2.0)))
-			* 2147483647.0;
-		// TODO: should we use an approximation when freq is not a const,
-		// so the sinf() function isn't linked?
-		setting_fmult = sinf(freq * (3.141592654/(AUDIO_SAMPLE_RATE_EXACT*2.0)))
-			* 2147483647.0;
+		if (freq < 20.0f) freq = 20.0f;
+		else if (freq > AUDIO_SAMPLE_RATE_EXACT/2.5f) freq = AUDIO_SAMPLE_RATE_EXACT/2.5f;
+		float w = freq * (float)(3.141592654/(AUDIO_SAMPLE_RATE_EXACT*2.0));
+		setting_fcenter = w * 2147483647.0f;
+		setting_fmult = filter_sin(w) * 2147483647.0f;
 	}
 	void resonance(float q) {
 		if (q < 0.7) q = 0.7;
@@ -28,31 +28,67 @@
 #include "mixer.h"
 #include "utility/dspinst.h"
 
-#if defined(__ARM_ARCH_7EM__)
+// All mixers store gain as a 16.16 fixed point multiplier
 #define MULTI_UNITYGAIN 65536
+#define MULTI_UNITYPOSITION ((int64_t)MULTI_UNITYGAIN << 32)
+
+// The applyGain functions take the multiplier for the first sample and
+// an increment added after every sample, for gain ramps, both with 32
+// more fraction bits than the 16.16 multiplier.  When not ramping,
+// increment is zero and the original fixed gain loops are used.
 
-static void applyGain(int16_t *data, int32_t mult)
+#if defined(__ARM_ARCH_7EM__)
+
+static void applyGain(int16_t *data, int64_t pos, int64_t inc)
 {
 	uint32_t *p = (uint32_t *)data;
 	const uint32_t *end = (uint32_t *)(data + AUDIO_BLOCK_SAMPLES);
+	int32_t mult = pos >> 32;
 
-	do {
-		uint32_t tmp32 = *p; // read 2 samples from *data
-		int32_t val1 = signed_multiply_32x16b(mult, tmp32);
-		int32_t val2 = signed_multiply_32x16t(mult, tmp32);
-		val1 = signed_saturate_rshift(val1, 16, 0);
-		val2 = signed_saturate_rshift(val2, 16, 0);
-		*p++ = pack_16b_16b(val2, val1);
-	} while (p < end);
+	if (inc == 0) {
+		do {
+			uint32_t tmp32 = *p; // read 2 samples from *data
+			int32_t val1 = signed_multiply_32x16b(mult, tmp32);
+			int32_t val2 = signed_multiply_32x16t(mult, tmp32);
+			val1 = signed_saturate_rshift(val1, 16, 0);
+			val2 = signed_saturate_rshift(val2, 16, 0);
+			*p++ = pack_16b_16b(val2, val1);
+		} while (p < end);
+	} else {
+		do {
+			uint32_t tmp32 = *p; // read 2 samples from *data
+			int32_t val1 = signed_multiply_32x16b(pos >> 32, tmp32);
+			pos += inc;
+			int32_t val2 = signed_multiply_32x16t(pos >> 32, tmp32);
+			pos += inc;
+			val1 = signed_saturate_rshift(val1, 16, 0);
+			val2 = signed_saturate_rshift(val2, 16, 0);
+			*p++ = pack_16b_16b(val2, val1);
+		} while (p < end);
+	}
 }
 
-static void applyGainThenAdd(int16_t *data, const int16_t *in, int32_t mult)
+static void applyGainThenAdd(int16_t *data, const int16_t *in, int64_t pos, int64_t inc)
 {
 	uint32_t *dst = (uint32_t *)data;
 	const uint32_t *src = (uint32_t *)in;
 	const uint32_t *end = (uint32_t *)(data + AUDIO_BLOCK_SAMPLES);
+	int32_t mult = pos >> 32;
 
-	if (mult == MULTI_UNITYGAIN) {
+	if (inc != 0) {
+		do {
+			uint32_t tmp32 = *src++; // read 2 samples from *data
+			int32_t val1 = signed_multiply_32x16b(pos >> 32, tmp32);
+			pos += inc;
+			int32_t val2 = signed_multiply_32x16t(pos >> 32, tmp32);
+			pos += inc;
+			val1 = signed_saturate_rshift(val1, 16, 0);
+			val2 = signed_saturate_rshift(val2, 16, 0);
+			tmp32 = pack_16b_16b(val2, val1);
+			uint32_t tmp32b = *dst;
+			*dst++ = signed_add_16_and_16(tmp32, tmp32b);
+		} while (dst < end);
+	} else if (mult == MULTI_UNITYGAIN) {
 		do {
 			uint32_t tmp32 = *dst;
 			*dst++ = signed_add_16_and_16(tmp32, *src++);
@@ -74,28 +110,46 @@ static void applyGainThenAdd(int16_t *data, const int16_t *in, int32_t mult)
 }
 
 #elif defined(KINETISL)
-#define MULTI_UNITYGAIN 256
+// Cortex-M0+ has only a 32x32 multiply, so the upper 8 fractional bits
+// of the multiplier are used, which limits gain to +/-127
 
-static void applyGain(int16_t *data, int32_t mult)
+static void applyGain(int16_t *data, int64_t pos, int64_t inc)
 {
 	const int16_t *end = data + AUDIO_BLOCK_SAMPLES;
 
-	do {
-		int32_t val = *data * mult;
-		*data++ = signed_saturate_rshift(val, 16, 0);
-	} while (data < end);
+	if (inc == 0) {
+		int32_t mult = pos >> 40;
+		do {
+			int32_t val = *data * mult;
+			*data++ = signed_saturate_rshift(val, 16, 8);
+		} while (data < end);
+	} else {
+		do {
+			int32_t val = *data * (int32_t)(pos >> 40);
+			pos += inc;
+			*data++ = signed_saturate_rshift(val, 16, 8);
+		} while (data < end);
+	}
 }
 
-static void applyGainThenAdd(int16_t *dst, const int16_t *src, int32_t mult)
+static void applyGainThenAdd(int16_t *dst, const int16_t *src, int64_t pos, int64_t inc)
 {
 	const int16_t *end = dst + AUDIO_BLOCK_SAMPLES;
+	int32_t mult = pos >> 32;
 
-	if (mult == MULTI_UNITYGAIN) {
+	if (inc != 0) {
+		do {
+			int32_t val = *dst + ((*src++ * (int32_t)(pos >> 40)) >> 8);
+			pos += inc;
+			*dst++ = signed_saturate_rshift(val, 16, 0);
+		} while (dst < end);
+	} else if (mult == MULTI_UNITYGAIN) {
 		do {
 			int32_t val = *dst + *src++;
 			*dst++ = signed_saturate_rshift(val, 16, 0);
 		} while (dst < end);
 	} else {
+		mult >>= 8;
 		do {
 			int32_t val = *dst + ((*src++ * mult) >> 8); // overflow possible??
 			*dst++ = signed_saturate_rshift(val, 16, 0);
@@ -105,22 +159,267 @@ static void applyGainThenAdd(int16_t *dst, const int16_t *src, int32_t mult)
 
 #endif
 
+// Compute the multiplier and per sample increment for the next block,
+// and advance the ramp to the following block.  Returns the increment.
+static int64_t gainRampStep(int32_t *multiplier, struct audio_gain_ramp_struct *ramp, int64_t *pos)
+{
+	__disable_irq();
+	int64_t p = (int64_t)*multiplier << 32;
+	int64_t inc = 0;
+	if (ramp->blocks > 0) {
+		p = ramp->position;
+		if (--ramp->blocks == 0) {
+			// the last block lands exactly on target
+			inc = ((int64_t)ramp->target << 32) / AUDIO_BLOCK_SAMPLES
+				- p / AUDIO_BLOCK_SAMPLES;
+			*multiplier = ramp->target;
+		} else {
+			inc = ramp->increment;
+			ramp->position = p + inc * AUDIO_BLOCK_SAMPLES;
+			*multiplier = ramp->position >> 32;
+		}
+	}
+	__enable_irq();
+	*pos = p;
+	return inc;
+}
+
+static void gainRampBegin(int32_t *multiplier, struct audio_gain_ramp_struct *ramp,
+	float gain, float milliseconds)
+{
+	if (gain > AUDIO_MIXER_MAX_GAIN) gain = AUDIO_MIXER_MAX_GAIN;
+	else if (gain < -AUDIO_MIXER_MAX_GAIN) gain = -AUDIO_MIXER_MAX_GAIN;
+	int32_t target = gain * 65536.0f;
+	float blocks = milliseconds * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f / AUDIO_BLOCK_SAMPLES);
+	uint32_t n = (blocks < 1.0f) ? 1 : ((blocks > 65535.0f) ? 65535 : (uint32_t)(blocks + 0.5f));
+	__disable_irq();
+	if (milliseconds <= 0.0f) {
+		*multiplier = target;
+		ramp->blocks = 0;
+	} else {
+		int32_t samples = n * AUDIO_BLOCK_SAMPLES;
+		ramp->position = (int64_t)*multiplier << 32;
+		ramp->target = target;
+		ramp->increment = ((int64_t)target << 32) / samples - ramp->position / samples;
+		ramp->blocks = n;
+	}
+	__enable_irq();
+}
+
+#if defined(AUDIO_HOST)
+// Host builds on a PC use GCC generic vectors, which compile to SSE2 on
+// x86 or NEON on ARM.  The multiply is split into 16 bit halves, so
+// 32 bit lanes give exactly the same result as smulwb/smlawb on Teensy.
+typedef int32_t mixer_vec4_t __attribute__((vector_size(16)));
+typedef int16_t mixer_vec4_16_t __attribute__((vector_size(8)));
+
+static inline mixer_vec4_t load4(const int16_t *p)
+{
+	mixer_vec4_16_t v;
+	memcpy(&v, p, sizeof(v));
+	return __builtin_convertvector(v, mixer_vec4_t);
+}
+
+static inline mixer_vec4_t multiply4(mixer_vec4_t s, int32_t mult)
+{
+	mixer_vec4_t hi = s * (mult >> 16);
+	mixer_vec4_t lo = (s * (mult & 0xFFFF)) >> 16;
+	return hi + lo;
+}
+
+static void applyGainToAccumulator(int32_t *acc, const int16_t *data, int32_t mult)
+{
+	mixer_vec4_t *dst = (mixer_vec4_t *)acc;
+
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i += 4) {
+		*dst++ = multiply4(load4(data + i), mult);
+	}
+}
+
+static void applyGainThenAccumulate(int32_t *acc, const int16_t *data, int32_t mult)
+{
+	mixer_vec4_t *dst = (mixer_vec4_t *)acc;
+
+	if (mult == MULTI_UNITYGAIN) {
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i += 4) {
+			*dst++ += load4(data + i);
+		}
+	} else {
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i += 4) {
+			*dst++ += multiply4(load4(data + i), mult);
+		}
+	}
+}
+
+static void saturateAccumulator(int16_t *data, const int32_t *acc)
+{
+	const mixer_vec4_t *src = (const mixer_vec4_t *)acc;
+	const mixer_vec4_t max = { 32767, 32767, 32767, 32767 };
+	const mixer_vec4_t min = -max - 1;
+
+	for (int i=0; i < AUDIO_BLOCK_SAMPLES; i += 4) {
+		mixer_vec4_t v = *src++;
+		v = v > max ? max : v;
+		v = v < min ? min : v;
+		mixer_vec4_16_t out = __builtin_convertvector(v, mixer_vec4_16_t);
+		memcpy(data + i, &out, sizeof(out));
+	}
+}
+
+#elif defined(__ARM_ARCH_7EM__)
+
+static void applyGainToAccumulator(int32_t *acc, const int16_t *data, int32_t mult)
+{
+	const uint32_t *src = (uint32_t *)data;
+	const int32_t *end = acc + AUDIO_BLOCK_SAMPLES;
+
+	do {
+		uint32_t tmp32 = *src++; // read 2 samples from *data
+		*acc++ = signed_multiply_32x16b(mult, tmp32);
+		*acc++ = signed_multiply_32x16t(mult, tmp32);
+	} while (acc < end);
+}
+
+static void applyGainThenAccumulate(int32_t *acc, const int16_t *data, int32_t mult)
+{
+	const uint32_t *src = (uint32_t *)data;
+	const int32_t *end = acc + AUDIO_BLOCK_SAMPLES;
+
+	if (mult == MULTI_UNITYGAIN) {
+		do {
+			uint32_t tmp32 = *src++;
+			*acc++ += (int16_t)tmp32;
+			*acc++ += (int32_t)tmp32 >> 16;
+		} while (acc < end);
+	} else {
+		do {
+			uint32_t tmp32 = *src++;
+			int32_t val1 = signed_multiply_accumulate_32x16b(acc[0], mult, tmp32);
+			int32_t val2 = signed_multiply_accumulate_32x16t(acc[1], mult, tmp32);
+			*acc++ = val1;
+			*acc++ = val2;
+		} while (acc < end);
+	}
+}
+
+static void saturateAccumulator(int16_t *data, const int32_t *acc)
+{
+	uint32_t *dst = (uint32_t *)data;
+	const uint32_t *end = (uint32_t *)(data + AUDIO_BLOCK_SAMPLES);
+
+	do {
+		int32_t val1 = signed_saturate_rshift(*acc++, 16, 0);
+		int32_t val2 = signed_saturate_rshift(*acc++, 16, 0);
+		*dst++ = pack_16b_16b(val2, val1);
+	} while (dst < end);
+}
+
+#elif defined(KINETISL)
+
+static void applyGainToAccumulator(int32_t *acc, const int16_t *data, int32_t mult)
+{
+	const int32_t *end = acc + AUDIO_BLOCK_SAMPLES;
+
+	mult >>= 8;
+	do {
+		*acc++ = (*data++ * mult) >> 8;
+	} while (acc < end);
+}
+
+static void applyGainThenAccumulate(int32_t *acc, const int16_t *data, int32_t mult)
+{
+	const int32_t *end = acc + AUDIO_BLOCK_SAMPLES;
+
+	if (mult == MULTI_UNITYGAIN) {
+		do {
+			*acc++ += *data++;
+		} while (acc < end);
+	} else {
+		mult >>= 8;
+		do {
+			*acc++ += (*data++ * mult) >> 8;
+		} while (acc < end);
+	}
+}
+
+static void saturateAccumulator(int16_t *data, const int32_t *acc)
+{
+	const int16_t *end = data + AUDIO_BLOCK_SAMPLES;
+
+	do {
+		*data++ = signed_saturate_rshift(*acc++, 16, 0);
+	} while (data < end);
+}
+
+#endif
+
+void AudioMixerBase::gain(unsigned int channel, float gain)
+{
+	if (channel >= num_inputs) return;
+	float limit = 65536.0f / num_inputs;
+	if (limit > AUDIO_MIXER_MAX_GAIN) limit = AUDIO_MIXER_MAX_GAIN;
+	if (gain > limit) gain = limit;
+	else if (gain < -limit) gain = -limit;
+	multiplier[channel] = gain * 65536.0f;
+}
+
+void AudioMixerBase::update(void)
+{
+	int32_t acc[AUDIO_BLOCK_SAMPLES] __attribute__((aligned(16)));
+	audio_block_t *in, *out;
+	unsigned int channel;
+	bool mixed = false;
+
+	for (channel=0; channel < num_inputs; channel++) {
+		in = receiveReadOnly(channel);
+		if (!in) continue;
+		int32_t mult = multiplier[channel];
+		if (mult != 0) {
+			if (!mixed) {
+				applyGainToAccumulator(acc, in->data, mult);
+				mixed = true;
+			} else {
+				applyGainThenAccumulate(acc, in->data, mult);
+			}
+		}
+		release(in);
+	}
+	if (!mixed) return;
+	out = allocate();
+	if (!out) return;
+	saturateAccumulator(out->data, acc);
+	transmit(out);
+	release(out);
+}
+
+void AudioMixer4::gain(unsigned int channel, float gain, float milliseconds)
+{
+	if (channel >= 4) return;
+	gainRampBegin(&multiplier[channel], &ramp[channel], gain, milliseconds);
+}
+
 void AudioMixer4::update(void)
 {
 	audio_block_t *in, *out=NULL;
 	unsigned int channel;
+	int64_t pos[4], inc[4];
 
+	// ramps advance every block, even for inputs without data
+	for (channel=0; channel < 4; channel++) {
+		inc[channel] = gainRampStep(&multiplier[channel], &ramp[channel], &pos[channel]);
+	}
 	for (channel=0; channel < 4; channel++) {
 		if (!out) {
 			out = receiveWritable(channel);
 			if (out) {
-				int32_t mult = multiplier[channel];
-				if (mult != MULTI_UNITYGAIN) applyGain(out->data, mult);
+				if (pos[channel] != MULTI_UNITYPOSITION || inc[channel] != 0) {
+					applyGain(out->data, pos[channel], inc[channel]);
+				}
 			}
 		} else {
 			in = receiveReadOnly(channel);
 			if (in) {
-				applyGainThenAdd(out->data, in->data, multiplier[channel]);
+				applyGainThenAdd(out->data, in->data, pos[channel], inc[channel]);
 				release(in);
 			}
 		}
@@ -131,16 +430,22 @@ void AudioMixer4::update(void)
 	}
 }
 
+void AudioAmplifier::gain(float n, float milliseconds)
+{
+	gainRampBegin(&multiplier, &ramp, n, milliseconds);
+}
+
 void AudioAmplifier::update(void)
 {
 	audio_block_t *block;
-	int32_t mult = multiplier;
+	int64_t pos, inc;
 
-	if (mult == 0) {
+	inc = gainRampStep(&multiplier, &ramp, &pos);
+	if (pos == 0 && inc == 0) {
 		// zero gain, discard any input and transmit nothing
 		block = receiveReadOnly(0);
 		if (block) release(block);
-	} else if (mult == MULTI_UNITYGAIN) {
+	} else if (pos == MULTI_UNITYPOSITION && inc == 0) {
 		// unity gain, pass input to output without any change
 		block = receiveReadOnly(0);
 		if (block) {
@@ -151,7 +456,7 @@ void AudioAmplifier::update(void)
 		// apply gain to signal
 		block = receiveWritable(0);
 		if (block) {
-			applyGain(block->data, mult);
+			applyGain(block->data, pos, inc);
 			transmit(block);
 			release(block);
 		}
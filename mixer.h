@@ -30,55 +30,103 @@
 #include "Arduino.h"
 #include "AudioStream.h"
 
+// Gain is stored as a 16.16 fixed point multiplier.  Teensy LC lacks
+// a 32x16 bit multiply, so gain is limited to +/-127 and only the upper
+// 8 fractional bits are used.
+#if defined(KINETISL)
+#define AUDIO_MIXER_MAX_GAIN 127.0f
+#else
+#define AUDIO_MIXER_MAX_GAIN 32767.0f
+#endif
+
+// Linear gain ramp, applied sample by sample over whole blocks, which
+// avoids the "zipper" noise of changing gain instantly.
+// The position and increment keep 32 more fraction bits than the 16.16
+// multiplier, so slow ramps move every sample and end on target.
+struct audio_gain_ramp_struct {
+	int64_t position;   // multiplier, with 32 more fraction bits
+	int64_t increment;  // change of position per sample
+	int32_t target;
+	uint16_t blocks;    // number of blocks remaining, 0 = not ramping
+};
+
 class AudioMixer4 : public AudioStream
 {
-#if defined(__ARM_ARCH_7EM__)
 public:
 	AudioMixer4(void) : AudioStream(4, inputQueueArray) {
-		for (int i=0; i<4; i++) multiplier[i] = 65536;
+		for (int i=0; i<4; i++) {
+			multiplier[i] = 65536;
+			ramp[i].blocks = 0;
+		}
 	}
 	virtual void update(void);
 	void gain(unsigned int channel, float gain) {
 		if (channel >= 4) return;
-		if (gain > 32767.0f) gain = 32767.0f;
-		else if (gain < -32767.0f) gain = -32767.0f;
+		if (gain > AUDIO_MIXER_MAX_GAIN) gain = AUDIO_MIXER_MAX_GAIN;
+		else if (gain < -AUDIO_MIXER_MAX_GAIN) gain = -AUDIO_MIXER_MAX_GAIN;
+		__disable_irq();
 		multiplier[channel] = gain * 65536.0f; // TODO: proper roundoff?
+		ramp[channel].blocks = 0;
+		__enable_irq();
 	}
+	// Change gain smoothly, from its present value, over the given time.
+	void gain(unsigned int channel, float gain, float milliseconds);
 private:
 	int32_t multiplier[4];
+	struct audio_gain_ramp_struct ramp[4];
 	audio_block_t *inputQueueArray[4];
+};
 
-#elif defined(KINETISL)
+// Mixer with any number of inputs, from 1 to 32.  All inputs are summed
+// in a 32 bit accumulator and saturated to 16 bits only once, so one large
+// mixer is faster than a tree of AudioMixer4 and never clips at an
+// intermediate stage.  Gain is limited to 65536/N (127 on Teensy LC), so
+// the accumulator can not overflow.
+class AudioMixerBase : public AudioStream
+{
 public:
-	AudioMixer4(void) : AudioStream(4, inputQueueArray) {
-		for (int i=0; i<4; i++) multiplier[i] = 256;
-	}
+	void gain(unsigned int channel, float gain);
 	virtual void update(void);
-	void gain(unsigned int channel, float gain) {
-		if (channel >= 4) return;
-		if (gain > 127.0f) gain = 127.0f;
-		else if (gain < -127.0f) gain = -127.0f;
-		multiplier[channel] = gain * 256.0f; // TODO: proper roundoff?
+protected:
+	AudioMixerBase(unsigned char ninput, audio_block_t **iqueue, int32_t *mult) :
+		AudioStream(ninput, iqueue), multiplier(mult) { }
+private:
+	int32_t *multiplier;
+};
+
+template <int NN>
+class AudioMixer : public AudioMixerBase
+{
+	static_assert(NN >= 1 && NN <= 32, "AudioMixer supports 1 to 32 inputs");
+public:
+	AudioMixer(void) : AudioMixerBase(NN, inputQueueArray, multiplierArray) {
+		for (int i=0; i < NN; i++) gain(i, 1.0f);
 	}
 private:
-	int16_t multiplier[4];
-	audio_block_t *inputQueueArray[4];
-#endif
+	int32_t multiplierArray[NN];
+	audio_block_t *inputQueueArray[NN];
 };
 
 class AudioAmplifier : public AudioStream
 {
 public:
 	AudioAmplifier(void) : AudioStream(1, inputQueueArray), multiplier(65536) {
+		ramp.blocks = 0;
 	}
 	virtual void update(void);
 	void gain(float n) {
-		if (n > 32767.0f) n = 32767.0f;
-		else if (n < -32767.0f) n = -32767.0f;
+		if (n > AUDIO_MIXER_MAX_GAIN) n = AUDIO_MIXER_MAX_GAIN;
+		else if (n < -AUDIO_MIXER_MAX_GAIN) n = -AUDIO_MIXER_MAX_GAIN;
+		__disable_irq();
 		multiplier = n * 65536.0f;
+		ramp.blocks = 0;
+		__enable_irq();
 	}
+	// Change gain smoothly, from its present value, over the given time.
+	void gain(float n, float milliseconds);
 private:
 	int32_t multiplier;
+	struct audio_gain_ramp_struct ramp;
 	audio_block_t *inputQueueArray[1];
 };
 
@@ -57,6 +57,59 @@ void AudioPlayQueue::playBuffer(void)
 	queue[h] = userblock;
 	head = h;
 	userblock = NULL;
+	uptr = 0;
+}
+
+void AudioPlayQueue::play(int16_t data)
+{
+	int16_t *buf = getBuffer();
+	buf[uptr++] = data;
+	if (uptr >= AUDIO_BLOCK_SAMPLES) {
+		playBuffer();
+	}
+}
+
+void AudioPlayQueue::play(const int16_t *data, uint32_t len)
+{
+	while (len > 0) {
+		uint32_t n = AUDIO_BLOCK_SAMPLES - uptr;
+		if (n > len) n = len;
+		int16_t *buf = getBuffer();
+		memcpy(buf + uptr, data, n * sizeof(int16_t));
+		uptr += n;
+		data += n;
+		len -= n;
+		if (uptr >= AUDIO_BLOCK_SAMPLES) {
+			playBuffer();
+		}
+	}
+}
+
+uint32_t AudioPlayQueue::write(const int16_t *data, uint32_t len)
+{
+	uint32_t count = 0;
+
+	while (len > 0) {
+		// a block can be filled only if playBuffer will not wait
+		uint32_t h = head + 1;
+		if (h >= max_buffers) h = 0;
+		if (tail == h) break;
+		if (!userblock) {
+			userblock = allocate();
+			if (!userblock) break;
+		}
+		uint32_t n = AUDIO_BLOCK_SAMPLES - uptr;
+		if (n > len) n = len;
+		memcpy(userblock->data + uptr, data, n * sizeof(int16_t));
+		uptr += n;
+		data += n;
+		len -= n;
+		count += n;
+		if (uptr >= AUDIO_BLOCK_SAMPLES) {
+			playBuffer();
+		}
+	}
+	return count;
 }
 
 void AudioPlayQueue::update(void)
@@ -74,3 +127,144 @@ void AudioPlayQueue::update(void)
 	}
 }
 
+
+bool AudioPlayStreamBase::begin(int16_t *buffer, uint32_t length)
+{
+	length -= length % channels;
+	if (buffer == NULL || length < channels * AUDIO_BLOCK_SAMPLES * 2) return false;
+	__disable_irq();
+	data = buffer;
+	size = length;
+	head = 0;
+	tail = 0;
+	underrun_count = 0;
+	for (int i=0; i < 16; i++) last[i] = 0;
+	playing = false;
+	__enable_irq();
+	return true;
+}
+
+uint32_t AudioPlayStreamBase::available(void)
+{
+	uint32_t h, t;
+
+	h = head;
+	t = tail;
+	if (h >= t) return h - t;
+	return size + h - t;
+}
+
+uint32_t AudioPlayStreamBase::availableForWrite(void)
+{
+	if (!data) return 0;
+	// the buffer is never filled completely, so full and empty differ
+	return size - available() - channels;
+}
+
+void AudioPlayStreamBase::clear(void)
+{
+	__disable_irq();
+	tail = head;
+	__enable_irq();
+}
+
+uint32_t AudioPlayStreamBase::write(const int16_t *src, uint32_t length)
+{
+	uint32_t h, n, space;
+
+	space = availableForWrite();
+	if (length > space) length = space;
+	length -= length % channels;
+	if (length == 0) return 0;
+	h = head;
+	n = size - h;
+	if (n > length) n = length;
+	memcpy(data + h, src, n * sizeof(int16_t));
+	if (length > n) memcpy(data, src + n, (length - n) * sizeof(int16_t));
+	h += length;
+	if (h >= size) h -= size;
+	// the samples must be in the buffer before the update sees the head
+	asm volatile("" ::: "memory");
+	head = h;
+	return length;
+}
+
+// Copy frames from the ring buffer into one block per channel
+static void deinterleave(int16_t **dst, uint32_t nch, const int16_t *src,
+	uint32_t frames)
+{
+	if (nch == 1) {
+		memcpy(dst[0], src, frames * sizeof(int16_t));
+		dst[0] += frames;
+		return;
+	}
+	for (uint32_t ch=0; ch < nch; ch++) {
+		const int16_t *p = src + ch;
+		int16_t *d = dst[ch];
+		int16_t *end = d + frames;
+		while (d < end) {
+			*d++ = *p;
+			p += nch;
+		}
+		dst[ch] = end;
+	}
+}
+
+void AudioPlayStreamBase::update(void)
+{
+	audio_block_t *block[16];
+	int16_t *dst[16];
+	const uint32_t nch = channels;
+	uint32_t h, t, frames, n, ch;
+
+	if (!data) return;
+	h = head;
+	t = tail;
+	frames = ((h >= t) ? h - t : size + h - t) / nch;
+	if (frames < AUDIO_BLOCK_SAMPLES) {
+		if (playing) {
+			underrun_count = underrun_count + 1;
+			playing = false;
+		}
+		if (underrun_policy == AUDIO_UNDERRUN_SKIP) return;
+		if (frames == 0) {
+			if (underrun_policy == AUDIO_UNDERRUN_SILENCE) return;
+			for (ch=0; ch < nch; ch++) {
+				if (last[ch] != 0) break;
+			}
+			if (ch == nch) return;  // holding silence
+		}
+	} else {
+		frames = AUDIO_BLOCK_SAMPLES;
+		playing = true;
+	}
+	for (ch=0; ch < nch; ch++) {
+		block[ch] = allocate();
+		if (!block[ch]) {
+			while (ch > 0) release(block[--ch]);
+			return;
+		}
+		dst[ch] = block[ch]->data;
+	}
+	// the frames may wrap around the end of the buffer
+	n = (size - t) / nch;
+	if (n > frames) n = frames;
+	deinterleave(dst, nch, data + t, n);
+	if (frames > n) deinterleave(dst, nch, data, frames - n);
+	t += frames * nch;
+	if (t >= size) t -= size;
+	tail = t;
+	for (ch=0; ch < nch; ch++) {
+		int16_t *p = block[ch]->data;
+		int16_t fill = 0;
+		if (frames > 0) {
+			last[ch] = p[frames - 1];
+		}
+		if (underrun_policy == AUDIO_UNDERRUN_HOLD) fill = last[ch];
+		for (n=frames; n < AUDIO_BLOCK_SAMPLES; n++) {
+			p[n] = fill;
+		}
+		transmit(block[ch], ch);
+		release(block[ch]);
+	}
+}
@@ -40,9 +40,12 @@ private:
 #endif
 public:
 	AudioPlayQueue(void) : AudioStream(0, NULL),
-		userblock(NULL), head(0), tail(0) { }
+		userblock(NULL), uptr(0), head(0), tail(0) { }
+	// Add samples, waiting while the queue is full
 	void play(int16_t data);
 	void play(const int16_t *data, uint32_t len);
+	// Add as many samples as fit without waiting, and return how many
+	uint32_t write(const int16_t *data, uint32_t len);
 	bool available(void);
 	int16_t * getBuffer(void);
 	void playBuffer(void);
@@ -52,7 +55,69 @@ public:
 private:
 	audio_block_t *queue[max_buffers];
 	audio_block_t *userblock;
+	uint32_t uptr;		// samples in userblock, for play and write
 	volatile uint8_t head, tail;
 };
 
+// What AudioPlayStream does when less than a block is waiting
+#define AUDIO_UNDERRUN_SILENCE	0  // the samples waiting, then silence
+#define AUDIO_UNDERRUN_HOLD	1  // the samples waiting, then repeat the last
+#define AUDIO_UNDERRUN_SKIP	2  // nothing, until a whole block is waiting
+
+// Plays 1 to 16 channels from a ring buffer given by the sketch, which may
+// be in external PSRAM (EXTMEM).  write() takes interleaved samples, as
+// from a WAV file or network packets, and never waits: it returns how
+// many samples fit.  loop() only ever writes the head and the update only
+// the tail, so no interrupts need to be disabled.
+class AudioPlayStreamBase : public AudioStream
+{
+public:
+	// Start playing from buffer, length in 16 bit samples.  The usable
+	// length is rounded down to whole frames (a sample of each channel),
+	// and must be at least 2 blocks of all channels.
+	bool begin(int16_t *buffer, uint32_t length);
+	// Add interleaved samples, returning how many were added, always
+	// whole frames
+	uint32_t write(const int16_t *data, uint32_t length);
+	// Number of samples write() can add now
+	uint32_t availableForWrite(void);
+	// Number of samples waiting to play
+	uint32_t available(void);
+	// Discard all waiting samples
+	void clear(void);
+	// AUDIO_UNDERRUN_SILENCE (default), AUDIO_UNDERRUN_HOLD or
+	// AUDIO_UNDERRUN_SKIP
+	void underrun(int policy) {
+		underrun_policy = policy;
+	}
+	// Times the samples ran out while playing, since begin()
+	uint32_t underruns(void) {
+		return underrun_count;
+	}
+	virtual void update(void);
+protected:
+	AudioPlayStreamBase(unsigned char nchannels) : AudioStream(0, NULL),
+		data(NULL), size(0), head(0), tail(0), underrun_count(0),
+		channels(nchannels), underrun_policy(AUDIO_UNDERRUN_SILENCE),
+		playing(false) { }
+private:
+	int16_t *data;
+	uint32_t size;		// ring buffer length, multiple of a frame
+	volatile uint32_t head;	// written only by write
+	volatile uint32_t tail;	// written only by update and clear
+	volatile uint32_t underrun_count;
+	int16_t last[16];	// last sample played, for AUDIO_UNDERRUN_HOLD
+	uint8_t channels;
+	uint8_t underrun_policy;
+	bool playing;
+};
+
+template <int NN>
+class AudioPlayStream : public AudioPlayStreamBase
+{
+	static_assert(NN >= 1 && NN <= 16, "AudioPlayStream supports 1 to 16 channels");
+public:
+	AudioPlayStream(void) : AudioPlayStreamBase(NN) { }
+};
+
 #endif
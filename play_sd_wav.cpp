@@ -27,16 +27,12 @@
 #include <Arduino.h>
 #include "play_sd_wav.h"
 #include "spi_interrupt.h"
+#include "Resampler.h"
 
 
-#define STATE_DIRECT_8BIT_MONO		0  // playing mono at native sample rate
-#define STATE_DIRECT_8BIT_STEREO	1  // playing stereo at native sample rate
 #define STATE_DIRECT_16BIT_MONO		2  // playing mono at native sample rate
 #define STATE_DIRECT_16BIT_STEREO	3  // playing stereo at native sample rate
-#define STATE_CONVERT_8BIT_MONO		4  // playing mono, converting sample rate
-#define STATE_CONVERT_8BIT_STEREO	5  // playing stereo, converting sample rate
-#define STATE_CONVERT_16BIT_MONO	6  // playing mono, converting sample rate
-#define STATE_CONVERT_16BIT_STEREO	7  // playing stereo, converting sample rate
+#define STATE_CONVERT			4  // playing any other format, converting
 #define STATE_PARSE1			8  // looking for 20 byte ID header
 #define STATE_PARSE2			9  // looking for 16 byte format header
 #define STATE_PARSE3			10 // looking for 8 byte data header
@@ -45,6 +41,41 @@
 #define STATE_PAUSED			13
 #define STATE_STOP			14
 
+// sample encodings handled by the converter
+#define WAV_PCM8	0
+#define WAV_PCM16	1
+#define WAV_PCM24	2
+#define WAV_PCM32	3
+#define WAV_FLOAT32	4
+
+#define WAV_CONVERT_FRAMES	256  // input frames decoded at once
+
+typedef struct {
+	uint32_t rate;
+	uint8_t channels;
+	uint8_t encoding;
+	uint8_t frame_bytes;
+} wav_format_t;
+
+struct wav_convert_struct {
+	Resampler *resampler;		// only allocated for rates other than 44100
+	float resampler_rate;
+	bool resampling;
+	uint8_t max_channels;		// channels the buffers were allocated for
+	uint8_t channels;
+	uint8_t encoding;
+	uint8_t frame_bytes;
+	uint8_t partial_length;		// bytes of an incomplete frame
+	uint8_t partial[32];
+	uint16_t in_offset;		// first unused frame in "in"
+	uint16_t in_count;		// frames in "in"
+	uint16_t out_count;		// samples in "out"
+	float *in[MAX_NO_CHANNELS];	// decoded file data
+	float *out[MAX_NO_CHANNELS];	// converted to 44100 Hz
+};
+
+AudioPlaySdWav * AudioPlaySdWav::first_stream = NULL;
+
 void AudioPlaySdWav::begin(void)
 {
 	state = STATE_STOP;
@@ -64,6 +95,25 @@ void AudioPlaySdWav::begin(void)
 bool AudioPlaySdWav::play(const char *filename)
 {
 	stop();
+	if (stream_buffer) {
+		// the file is only accessed from loop(), SPI is never
+		// used by the audio update
+		wavfile = SD.open(filename);
+		if (!wavfile) return false;
+		stream_head = 0;
+		stream_tail = 0;
+		stream_eof = false;
+		underrun_count = 0;
+		stream_fill();
+		prepare_convert(stream_buffer, stream_head);
+		buffer_length = 0;
+		buffer_offset = 0;
+		state_play = STATE_STOP;
+		data_length = 20;
+		header_offset = 0;
+		state = STATE_PARSE1;
+		return true;
+	}
 	bool irq = false;
 	if (NVIC_IS_ENABLED(IRQ_SOFTWARE)) {
 		NVIC_DISABLE_IRQ(IRQ_SOFTWARE);
@@ -84,13 +134,16 @@ bool AudioPlaySdWav::play(const char *filename)
 		if (irq) NVIC_ENABLE_IRQ(IRQ_SOFTWARE);
 		return false;
 	}
-	buffer_length = 0;
+	buffer = filebuffer;
+	buffer_length = wavfile.read(filebuffer, 512);
 	buffer_offset = 0;
+	if (irq) NVIC_ENABLE_IRQ(IRQ_SOFTWARE);
+	// update() does nothing until state changes from STATE_STOP
+	prepare_convert(filebuffer, buffer_length);
 	state_play = STATE_STOP;
 	data_length = 20;
 	header_offset = 0;
 	state = STATE_PARSE1;
-	if (irq) NVIC_ENABLE_IRQ(IRQ_SOFTWARE);
 	return true;
 }
 
@@ -110,15 +163,109 @@ void AudioPlaySdWav::stop(void)
 		if (b1) release(b1);
 		if (b2) release(b2);
 		wavfile.close();
+		if (!stream_buffer) {
 #if defined(HAS_KINETIS_SDHC)
-		if (!(SIM_SCGC3 & SIM_SCGC3_SDHC)) AudioStopUsingSPI();
+			if (!(SIM_SCGC3 & SIM_SCGC3_SDHC)) AudioStopUsingSPI();
 #else
-		AudioStopUsingSPI();
+			AudioStopUsingSPI();
 #endif
+		}
+	} else if (stream_buffer) {
+		// playback ended in update(), which leaves the file open
+		wavfile.close();
 	}
 	if (irq) NVIC_ENABLE_IRQ(IRQ_SOFTWARE);
 }
 
+bool AudioPlaySdWav::beginStreaming(uint8_t *buf, uint32_t size)
+{
+	size &= ~511;
+	if (!buf || size < 1024) return false;
+	endStreaming();
+	stream_size = size;
+	stream_buffer = buf;
+	next_stream = first_stream;
+	first_stream = this;
+	return true;
+}
+
+void AudioPlaySdWav::endStreaming(void)
+{
+	if (!stream_buffer) return;
+	stop();
+	for (AudioPlaySdWav **p = &first_stream; *p; p = &(*p)->next_stream) {
+		if (*p == this) {
+			*p = next_stream;
+			break;
+		}
+	}
+	stream_buffer = NULL;
+	buffer = filebuffer;
+}
+
+// Read from the file into the free part of the ring buffer.  Reads are
+// multiples of 512 bytes, starting from the beginning of the file, so
+// they are always aligned to the SD card's sectors.
+void AudioPlaySdWav::stream_fill(void)
+{
+	uint32_t chunk = stream_size / 2;
+	if (chunk > AUDIO_SD_STREAM_CHUNK) chunk = AUDIO_SD_STREAM_CHUNK;
+
+	while (!stream_eof) {
+		uint32_t head = stream_head;
+		uint32_t space = stream_size - (head - stream_tail);
+		uint32_t index = head % stream_size;
+		uint32_t len = stream_size - index;
+		if (len > space) len = space;
+		len &= ~511;
+		// wait for enough space for a large read, except at the
+		// end of the buffer, where no more space can become available
+		if (len == 0 || (len < chunk && index + len < stream_size)) return;
+		int n = wavfile.read(stream_buffer + index, len);
+		if (n > 0) stream_head = head + n;
+		if (n < (int)len) {
+			stream_eof = true;
+			wavfile.close();
+		}
+	}
+}
+
+void AudioPlaySdWav::prefetch(void)
+{
+	if (!stream_buffer || !wavfile) return;
+	if (state == STATE_STOP) {
+		wavfile.close();
+		return;
+	}
+	stream_fill();
+}
+
+void AudioPlaySdWav::prefetchAll(void)
+{
+	for (AudioPlaySdWav *p = first_stream; p; p = p->next_stream) {
+		p->prefetch();
+	}
+}
+
+// Called from update() when all of "buffer" has been used.  Frees that
+// part of the ring buffer and points "buffer" at the next available data.
+uint32_t AudioPlaySdWav::stream_read(void)
+{
+	uint32_t tail = stream_tail + buffer_length;
+	stream_tail = tail;
+	buffer_offset = 0;
+	buffer_length = 0;
+	uint32_t avail = stream_head - tail;
+	if (avail == 0) return 0;
+	uint32_t index = tail % stream_size;
+	uint32_t len = stream_size - index;
+	if (len > avail) len = avail;
+	if (len > 512) len = 512;
+	buffer = stream_buffer + index;
+	buffer_length = len;
+	return len;
+}
+
 void AudioPlaySdWav::togglePlayPause(void) {
 	// take no action if wave header is not parsed OR
 	// state is explicitly STATE_STOP
@@ -168,10 +315,27 @@ void AudioPlaySdWav::update(void)
 	}
 
 	// we only get to this point when buffer[512] is empty
+	if (stream_buffer) {
+		while (1) {
+			if (stream_read() == 0) {
+				if (stream_eof) break;
+				// prefetch() has not kept up with playback
+				if (state < 8) underrun_count = underrun_count + 1;
+				goto cleanup;
+			}
+			bool txok = consume(buffer_length);
+			if (state == STATE_STOP) break;
+			if (txok) return;
+		}
+		// end of file, the file is closed by prefetch() or stop()
+		state_play = STATE_STOP;
+		state = STATE_STOP;
+		goto cleanup;
+	}
 	if (state != STATE_STOP && wavfile.available()) {
 		// we can read more data from the file...
 		readagain:
-		buffer_length = wavfile.read(buffer, 512);
+		buffer_length = wavfile.read(filebuffer, 512);
 		if (buffer_length == 0) goto end;
 		buffer_offset = 0;
 		bool parsing = (state >= 8);
@@ -377,14 +541,6 @@ start:
 		state = STATE_PARSE1;
 		goto start;
 
-	  // playing mono at native sample rate
-	  case STATE_DIRECT_8BIT_MONO:
-		return false;
-
-	  // playing stereo at native sample rate
-	  case STATE_DIRECT_8BIT_STEREO:
-		return false;
-
 	  // playing mono at native sample rate
 	  case STATE_DIRECT_16BIT_MONO:
 		if (size > data_length) size = data_length;
@@ -469,21 +625,38 @@ start:
 		state = STATE_STOP;
 		return false;
 
-	  // playing mono, converting sample rate
-	  case STATE_CONVERT_8BIT_MONO :
-		return false;
-
-	  // playing stereo, converting sample rate
-	  case STATE_CONVERT_8BIT_STEREO:
-		return false;
-
-	  // playing mono, converting sample rate
-	  case STATE_CONVERT_16BIT_MONO:
-		return false;
-
-	  // playing stereo, converting sample rate
-	  case STATE_CONVERT_16BIT_STEREO:
-		return false;
+	  // playing any other format, converted to 16 bits at 44100 Hz
+	  case STATE_CONVERT:
+		if (size > data_length) size = data_length;
+		data_length -= size;
+		while (1) {
+			convert_run();
+			if (convert->out_count >= AUDIO_BLOCK_SAMPLES) {
+				convert_transmit();
+				data_length += size;
+				buffer_offset = p - buffer;
+				if (data_length == 0) state = STATE_STOP;
+				return true;
+			}
+			if (size == 0) break;
+			len = convert_decode(p, size);
+			p += len;
+			size -= len;
+		}
+		// all the data was used without filling a block
+		buffer_offset = p - buffer;
+		if (data_length > 0) return false;
+		// end of file reached, transmit the last partial block
+		state = STATE_STOP;
+		if (convert->out_count == 0) return false;
+		for (int ch=0; ch < convert->channels; ch++) {
+			float *out = convert->out[ch];
+			for (int i=convert->out_count; i < AUDIO_BLOCK_SAMPLES; i++) {
+				out[i] = 0.0f;
+			}
+		}
+		convert_transmit();
+		return true;
 
 	  // ignore any extra data after playing
 	  // or anything following any error
@@ -521,70 +694,295 @@ start:
 //  256 byte chunks, speed is 443272 bytes/sec
 //  512 byte chunks, speed is 468023 bytes/sec
 
-#define B2M_44100 (uint32_t)((double)4294967296000.0 / AUDIO_SAMPLE_RATE_EXACT) // 97352592
-#define B2M_22050 (uint32_t)((double)4294967296000.0 / AUDIO_SAMPLE_RATE_EXACT * 2.0)
-#define B2M_11025 (uint32_t)((double)4294967296000.0 / AUDIO_SAMPLE_RATE_EXACT * 4.0)
-
-bool AudioPlaySdWav::parse_format(void)
+// Decode a "fmt " chunk, which is "len" bytes.
+static bool wav_format(const uint32_t *fmt, uint32_t len, wav_format_t *f)
 {
-	uint8_t num = 0;
-	uint16_t format;
-	uint16_t channels;
-	uint32_t rate, b2m;
-	uint16_t bits;
-
-	format = header[0];
-	//Serial.print("  format = ");
-	//Serial.println(format);
-	if (format != 1) return false;
-
-	rate = header[1];
-	//Serial.print("  rate = ");
-	//Serial.println(rate);
-	if (rate == 44100) {
-		b2m = B2M_44100;
-	} else if (rate == 22050) {
-		b2m = B2M_22050;
-		num |= 4;
-	} else if (rate == 11025) {
-		b2m = B2M_11025;
-		num |= 4;
+	uint32_t format = fmt[0] & 0xFFFF;
+	uint32_t channels = fmt[0] >> 16;
+	uint32_t block_align = fmt[3] & 0xFFFF;
+
+	if (format == 0xFFFE) {
+		// WAVE_FORMAT_EXTENSIBLE, the format is the
+		// first 2 bytes of the SubFormat GUID
+		if (len < 40) return false;
+		format = fmt[6] & 0xFFFF;
+	}
+	if (channels < 1 || channels > MAX_NO_CHANNELS) return false;
+	if (block_align % channels) return false;
+	// the container size, 24 bit samples in 32 bits play as 32 bit
+	uint32_t bytes = block_align / channels;
+	if (format == 1) {
+		if (bytes < 1 || bytes > 4) return false;
+		f->encoding = WAV_PCM8 + bytes - 1;
+	} else if (format == 3) {
+		if (bytes != 4) return false;
+		f->encoding = WAV_FLOAT32;
 	} else {
 		return false;
 	}
+	f->rate = fmt[1];
+	if (f->rate < 8000 || f->rate > 192000) return false;
+	f->channels = channels;
+	f->frame_bytes = block_align;
+	return true;
+}
 
-	channels = header[0] >> 16;
-	//Serial.print("  channels = ");
-	//Serial.println(channels);
-	if (channels == 1) {
-	} else if (channels == 2) {
-		b2m >>= 1;
-		num |= 1;
-	} else {
-		return false;
+static bool wav_direct(const wav_format_t *f)
+{
+	return f->encoding == WAV_PCM16 && f->rate == 44100 && f->channels <= 2;
+}
+
+bool AudioPlaySdWav::parse_format(void)
+{
+	wav_format_t f;
+
+	if (!wav_format(header, header_offset, &f)) return false;
+
+	// 44100 Hz files play at the actual rate, which is
+	// 44117 Hz on Teensy 3.  Others are resampled.
+	double rate = (f.rate == 44100) ? AUDIO_SAMPLE_RATE_EXACT : f.rate;
+	bytes2millis = (uint32_t)(4294967296000.0 / rate / f.frame_bytes);
+
+	if (wav_direct(&f)) {
+		state_play = (f.channels == 1) ? STATE_DIRECT_16BIT_MONO : STATE_DIRECT_16BIT_STEREO;
+		return true;
+	}
+	// play() allocates the converter when it finds the "fmt " chunk in
+	// the first data read from the file.  Otherwise, this file can't play.
+	wav_convert_struct *c = convert;
+	if (!c || c->max_channels < f.channels) return false;
+	c->resampling = (f.rate != 44100);
+	if (c->resampling && (!c->resampler || c->resampler_rate != f.rate)) return false;
+	c->channels = f.channels;
+	c->encoding = f.encoding;
+	c->frame_bytes = f.frame_bytes;
+	c->partial_length = 0;
+	c->in_offset = 0;
+	c->in_count = 0;
+	c->out_count = 0;
+	state_play = STATE_CONVERT;
+	return true;
+}
+
+// Called by play() with the first data from the file, before update()
+// parses the header.  Files which need conversion get buffers and the
+// resampler set up here, because configuring the resampler takes much
+// too long for the audio library interrupt.
+void AudioPlaySdWav::prepare_convert(const uint8_t *p, uint32_t len)
+{
+	uint32_t fmt[10], chunk, offset = 12;
+	wav_format_t f;
+
+	if (len < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) return;
+	while (1) {
+		if (offset + 8 > len) return;
+		memcpy(&chunk, p + offset + 4, 4);
+		if (memcmp(p + offset, "fmt ", 4) == 0) {
+			if (chunk < 16 || chunk > sizeof(fmt)) return;
+			if (offset + 8 + chunk > len) return;
+			memcpy(fmt, p + offset + 8, chunk);
+			break;
+		}
+		if (chunk > len) return;
+		offset += chunk + 8;
+	}
+	if (!wav_format(fmt, chunk, &f) || wav_direct(&f)) return;
+
+	wav_convert_struct *c = convert;
+	if (!c) {
+		c = (wav_convert_struct *)malloc(sizeof(wav_convert_struct));
+		if (!c) return;
+		memset(c, 0, sizeof(wav_convert_struct));
+		convert = c;
+	}
+	if (c->max_channels < f.channels) {
+		free(c->in[0]);
+		c->max_channels = 0;
+		uint32_t size = WAV_CONVERT_FRAMES + AUDIO_BLOCK_SAMPLES;
+		float *mem = (float *)malloc(f.channels * size * sizeof(float));
+		if (!mem) return;
+		for (int ch=0; ch < f.channels; ch++) {
+			c->in[ch] = mem + ch * size;
+			c->out[ch] = c->in[ch] + WAV_CONVERT_FRAMES;
+		}
+		c->max_channels = f.channels;
+	}
+	if (f.rate != 44100) {
+		if (!c->resampler) {
+			c->resampler = new Resampler();
+			if (!c->resampler) return;
+		}
+		// also clears the filter history from the last file
+		c->resampler->configure(f.rate, AUDIO_SAMPLE_RATE_EXACT);
+		c->resampler_rate = f.rate;
+	}
+}
+
+// Append "frames" frames to "in", with one loop per channel.
+static void wav_decode(wav_convert_struct *c, const uint8_t *p, uint32_t frames)
+{
+	const uint32_t frame_bytes = c->frame_bytes;
+	const uint32_t bytes = frame_bytes / c->channels;
+
+	for (int ch=0; ch < c->channels; ch++) {
+		const uint8_t *s = p + ch * bytes;
+		float *d = c->in[ch] + c->in_count;
+		switch (c->encoding) {
+		  case WAV_PCM8:
+			for (uint32_t i=0; i < frames; i++) {
+				d[i] = (float)((int32_t)s[0] - 128) * (1.0f / 128.0f);
+				s += frame_bytes;
+			}
+			break;
+		  case WAV_PCM16:
+			for (uint32_t i=0; i < frames; i++) {
+				d[i] = (float)(int16_t)(s[0] | (s[1] << 8)) * (1.0f / 32768.0f);
+				s += frame_bytes;
+			}
+			break;
+		  case WAV_PCM24:
+			for (uint32_t i=0; i < frames; i++) {
+				int32_t n = (s[0] << 8) | (s[1] << 16) | (s[2] << 24);
+				d[i] = (float)n * (1.0f / 2147483648.0f);
+				s += frame_bytes;
+			}
+			break;
+		  case WAV_PCM32:
+			for (uint32_t i=0; i < frames; i++) {
+				int32_t n = s[0] | (s[1] << 8) | (s[2] << 16) | (s[3] << 24);
+				d[i] = (float)n * (1.0f / 2147483648.0f);
+				s += frame_bytes;
+			}
+			break;
+		  case WAV_FLOAT32:
+			for (uint32_t i=0; i < frames; i++) {
+				memcpy(d + i, s, 4);
+				s += frame_bytes;
+			}
+			break;
+		}
+	}
+	c->in_count += frames;
+}
+
+// Decode as much of the file data as fits into "in".  Returns the
+// number of bytes used.
+uint32_t AudioPlaySdWav::convert_decode(const uint8_t *p, uint32_t size)
+{
+	wav_convert_struct *c = convert;
+	const uint32_t frame_bytes = c->frame_bytes;
+	const uint8_t *start = p;
+
+	if (c->in_offset > 0) {
+		uint32_t count = c->in_count - c->in_offset;
+		for (int ch=0; ch < c->channels; ch++) {
+			memmove(c->in[ch], c->in[ch] + c->in_offset, count * sizeof(float));
+		}
+		c->in_offset = 0;
+		c->in_count = count;
+	}
+	if (c->partial_length > 0) {
+		// a frame was split between 2 reads
+		uint32_t len = frame_bytes - c->partial_length;
+		if (len > size) len = size;
+		memcpy(c->partial + c->partial_length, p, len);
+		c->partial_length += len;
+		p += len;
+		size -= len;
+		if (c->partial_length < frame_bytes) return p - start;
+		if (c->in_count >= WAV_CONVERT_FRAMES) return p - start;
+		wav_decode(c, c->partial, 1);
+		c->partial_length = 0;
+	}
+	uint32_t frames = size / frame_bytes;
+	uint32_t space = WAV_CONVERT_FRAMES - c->in_count;
+	if (frames > space) frames = space;
+	wav_decode(c, p, frames);
+	p += frames * frame_bytes;
+	size -= frames * frame_bytes;
+	if (size < frame_bytes) {
+		memcpy(c->partial, p, size);
+		c->partial_length = size;
+		p += size;
 	}
+	return p - start;
+}
+
+template <uint8_t channels>
+static void wav_resample(wav_convert_struct *c)
+{
+	float *in[channels], *out[channels];
+	uint16_t used, count;
 
-	bits = header[3] >> 16;
-	//Serial.print("  bits = ");
-	//Serial.println(bits);
-	if (bits == 8) {
-	} else if (bits == 16) {
-		b2m >>= 1;
-		num |= 2;
+	for (int ch=0; ch < channels; ch++) {
+		in[ch] = c->in[ch] + c->in_offset;
+		out[ch] = c->out[ch] + c->out_count;
+	}
+	c->resampler->resample<channels>(in, c->in_count - c->in_offset, used,
+		out, AUDIO_BLOCK_SAMPLES - c->out_count, count);
+	c->in_offset += used;
+	c->out_count += count;
+}
+
+// Move decoded data from "in" to "out", resampling if needed.
+void AudioPlaySdWav::convert_run(void)
+{
+	wav_convert_struct *c = convert;
+
+	if (c->in_offset >= c->in_count) return;
+	if (c->resampling) {
+		switch (c->channels) {
+			case 1: wav_resample<1>(c); break;
+			case 2: wav_resample<2>(c); break;
+			case 3: wav_resample<3>(c); break;
+			case 4: wav_resample<4>(c); break;
+			case 5: wav_resample<5>(c); break;
+			case 6: wav_resample<6>(c); break;
+			case 7: wav_resample<7>(c); break;
+			case 8: wav_resample<8>(c); break;
+		}
 	} else {
-		return false;
+		uint32_t n = c->in_count - c->in_offset;
+		uint32_t space = AUDIO_BLOCK_SAMPLES - c->out_count;
+		if (n > space) n = space;
+		for (int ch=0; ch < c->channels; ch++) {
+			memcpy(c->out[ch] + c->out_count, c->in[ch] + c->in_offset, n * sizeof(float));
+		}
+		c->in_offset += n;
+		c->out_count += n;
+	}
+	if (c->in_offset >= c->in_count) {
+		c->in_offset = 0;
+		c->in_count = 0;
 	}
+}
 
-	bytes2millis = b2m;
-	//Serial.print("  bytes2millis = ");
-	//Serial.println(b2m);
+// Transmit a full "out" buffer.  Each channel has its own output, and
+// mono files play on both outputs 0 and 1.
+void AudioPlaySdWav::convert_transmit(void)
+{
+	wav_convert_struct *c = convert;
 
-	// we're not checking the byte rate and block align fields
-	// if they're not the expected values, all we could do is
-	// return false.  Do any real wav files have unexpected
-	// values in these other fields?
-	state_play = num;
-	return true;
+	for (int ch=0; ch < c->channels; ch++) {
+		audio_block_t *block = block_left;
+		block_left = NULL;
+		if (!block) block = allocate();
+		if (!block) continue;
+		const float *out = c->out[ch];
+		for (int i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			float f = out[i];
+			if (f > 1.0f) f = 1.0f;
+			if (f < -1.0f) f = -1.0f;
+			// round to nearest, the + 32768 keeps this positive
+			int32_t n = (int32_t)(f * 32768.0f + 32768.5f) - 32768;
+			if (n > 32767) n = 32767;
+			block->data[i] = n;
+		}
+		transmit(block, ch);
+		if (c->channels == 1) transmit(block, 1);
+		release(block);
+	}
+	c->out_count = 0;
 }
 
 
@@ -31,11 +31,28 @@
 #include "AudioStream.h"
 #include "SD.h"
 
+// Streaming reads must be at least this large, unless the buffer is small
+#define AUDIO_SD_STREAM_CHUNK 4096
+
+class Resampler;
+struct wav_convert_struct;
+
 class AudioPlaySdWav : public AudioStream
 {
 public:
-	AudioPlaySdWav(void) : AudioStream(0, NULL), block_left(NULL), block_right(NULL) { begin(); }
+	AudioPlaySdWav(void) : AudioStream(0, NULL), block_left(NULL), block_right(NULL),
+	  buffer(filebuffer), stream_buffer(NULL), underrun_count(0), convert(NULL) { begin(); }
 	void begin(void);
+	// Streaming mode reads the file in prefetch(), which must be called
+	// often from loop(), into a buffer (8 to 32 kbytes is typical).  The
+	// audio update only copies from memory, so slow SD card access can
+	// not delay the other audio objects.  Without streaming, the file is
+	// read 512 bytes at a time in the audio update.
+	bool beginStreaming(uint8_t *buf, uint32_t size);
+	void endStreaming(void);
+	void prefetch(void);
+	static void prefetchAll(void);
+	uint32_t underruns(void) { return underrun_count; }
 	bool play(const char *filename);
 	void togglePlayPause(void);
 	void stop(void);
@@ -48,7 +65,13 @@ public:
 private:
 	File wavfile;
 	bool consume(uint32_t size);
+	void stream_fill(void);
+	uint32_t stream_read(void);
 	bool parse_format(void);
+	void prepare_convert(const uint8_t *p, uint32_t len);
+	void convert_run(void);
+	uint32_t convert_decode(const uint8_t *p, uint32_t size);
+	void convert_transmit(void);
 	uint32_t header[10];		// temporary storage of wav header data
 	uint32_t data_length;		// number of bytes remaining in current section
 	uint32_t total_length;		// number of audio data bytes in file
@@ -56,9 +79,19 @@ private:
 	audio_block_t *block_left;
 	audio_block_t *block_right;
 	uint16_t block_offset;		// how much data is in block_left & block_right
-	uint8_t buffer[512];		// buffer one block of data
+	uint8_t filebuffer[512];	// buffer one block of data
+	const uint8_t *buffer;		// filebuffer, or part of stream_buffer
 	uint16_t buffer_offset;		// where we're at consuming "buffer"
 	uint16_t buffer_length;		// how much data is in "buffer" (512 until last read)
+	uint8_t *stream_buffer;		// ring buffer filled by prefetch()
+	uint32_t stream_size;
+	volatile uint32_t stream_head;	// total bytes written by prefetch()
+	volatile uint32_t stream_tail;	// total bytes used by update()
+	volatile bool stream_eof;	// prefetch() reached the end of the file
+	volatile uint32_t underrun_count;
+	AudioPlaySdWav *next_stream;
+	static AudioPlaySdWav *first_stream;
+	struct wav_convert_struct *convert; // formats other than 16 bit 44100 Hz
 	uint8_t header_offset;		// number of bytes in header[]
 	uint8_t state;
 	uint8_t state_play;
@@ -97,3 +97,128 @@ void AudioRecordQueue::update(void)
 }
 
 
+
+bool AudioRecordStreamBase::begin(int16_t *buffer, uint32_t length)
+{
+	const uint32_t blocksize = num_inputs * AUDIO_BLOCK_SAMPLES;
+
+	length -= length % blocksize;
+	if (buffer == NULL || length < blocksize * 2) return false;
+	__disable_irq();
+	data = buffer;
+	size = length;
+	head = 0;
+	tail = 0;
+	position = 0;
+	overrun_count = 0;
+	overrun_position = 0;
+	overrun_millis = 0;
+	enabled = 1;
+	__enable_irq();
+	return true;
+}
+
+uint32_t AudioRecordStreamBase::available(void)
+{
+	uint32_t h, t;
+
+	h = head;
+	t = tail;
+	if (h >= t) return h - t;
+	return size + h - t;
+}
+
+void AudioRecordStreamBase::clear(void)
+{
+	tail = head;
+}
+
+int16_t * AudioRecordStreamBase::readBuffer(uint32_t *length)
+{
+	uint32_t h, t;
+
+	h = head;
+	t = tail;
+	if (h == t) {
+		*length = 0;
+		return NULL;
+	}
+	// up to the head, or to the end of the buffer when the head wrapped
+	*length = (h > t) ? h - t : size - t;
+	return data + t;
+}
+
+void AudioRecordStreamBase::freeBuffer(uint32_t length)
+{
+	uint32_t t, avail;
+
+	avail = available();
+	if (length > avail) length = avail;
+	t = tail + length;
+	if (t >= size) t -= size;
+	tail = t;
+}
+
+void AudioRecordStreamBase::update(void)
+{
+	const int16_t *src[16];
+	audio_block_t *block[16];
+	const uint32_t nch = num_inputs;
+	const uint32_t blocksize = nch * AUDIO_BLOCK_SAMPLES;
+	uint32_t h, t, used, ch;
+	bool any = false;
+
+	for (ch=0; ch < nch; ch++) {
+		block[ch] = receiveReadOnly(ch);
+		if (block[ch]) any = true;
+	}
+	if (!any) return;
+	if (!enabled) {
+		for (ch=0; ch < nch; ch++) {
+			if (block[ch]) release(block[ch]);
+		}
+		return;
+	}
+	h = head;
+	t = tail;
+	used = (h >= t) ? h - t : size + h - t;
+	// the buffer is never filled completely, so full and empty differ
+	if (used + blocksize >= size) {
+		overrun_count = overrun_count + 1;
+		overrun_position = position;
+		overrun_millis = millis();
+	} else {
+		int16_t *dst = data + h;
+		if (nch == 1) {
+			memcpy(dst, block[0]->data, sizeof(block[0]->data));
+		} else {
+			// missing blocks are recorded as silence
+			for (ch=0; ch < nch; ch++) {
+				src[ch] = block[ch] ? block[ch]->data : NULL;
+			}
+			for (ch=0; ch < nch; ch++) {
+				const int16_t *p = src[ch];
+				int16_t *d = dst + ch;
+				int16_t *end = d + blocksize;
+				if (p) {
+					do {
+						*d = *p++;
+						d += nch;
+					} while (d < end);
+				} else {
+					do {
+						*d = 0;
+						d += nch;
+					} while (d < end);
+				}
+			}
+		}
+		h += blocksize;
+		if (h >= size) h = 0;
+		head = h;
+		position = position + AUDIO_BLOCK_SAMPLES;
+	}
+	for (ch=0; ch < nch; ch++) {
+		if (block[ch]) release(block[ch]);
+	}
+}
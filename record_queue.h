@@ -60,4 +60,72 @@ private:
 	volatile uint8_t head, tail, enabled;
 };
 
+// Records 1 to 16 channels into a large ring buffer given by the sketch,
+// which may be in external PSRAM (EXTMEM).  The samples are interleaved,
+// as in a WAV file, and readBuffer() gives as many samples as are in one
+// contiguous piece of the buffer, so they can be written to SD directly.
+// The update only ever writes the head and loop() only the tail, so no
+// interrupts need to be disabled.  When the buffer is full, incoming
+// blocks are dropped, and counted by overruns().
+class AudioRecordStreamBase : public AudioStream
+{
+public:
+	// Start recording into buffer, length in 16 bit samples.  The usable
+	// length is rounded down to whole blocks of all channels, and must
+	// be at least 2 blocks.
+	bool begin(int16_t *buffer, uint32_t length);
+	// Stop recording.  Samples already recorded may still be read.
+	void end(void) {
+		enabled = 0;
+	}
+	// Number of samples waiting, all channels
+	uint32_t available(void);
+	// Discard all waiting samples
+	void clear(void);
+	// Pointer to the oldest samples, and in length the number which
+	// are contiguous, or NULL if none
+	int16_t * readBuffer(uint32_t *length);
+	// Remove samples from the buffer, after they have been used
+	void freeBuffer(uint32_t length);
+	// Blocks dropped because the buffer was full, since begin()
+	uint32_t overruns(void) {
+		return overrun_count;
+	}
+	// Frames (samples of each channel) recorded before the latest
+	// overrun, which is where the recording has a gap
+	uint32_t overrunPosition(void) {
+		return overrun_position;
+	}
+	// millis() at the latest overrun
+	uint32_t overrunMillis(void) {
+		return overrun_millis;
+	}
+	virtual void update(void);
+protected:
+	AudioRecordStreamBase(unsigned char ninput, audio_block_t **iqueue) :
+		AudioStream(ninput, iqueue), data(NULL), size(0), head(0),
+		tail(0), position(0), overrun_count(0), overrun_position(0),
+		overrun_millis(0), enabled(0) { }
+private:
+	int16_t *data;
+	uint32_t size;		// ring buffer length, multiple of a block
+	volatile uint32_t head;	// written only by update
+	volatile uint32_t tail;	// written only by freeBuffer and clear
+	volatile uint32_t position;
+	volatile uint32_t overrun_count;
+	volatile uint32_t overrun_position;
+	volatile uint32_t overrun_millis;
+	volatile uint8_t enabled;
+};
+
+template <int NN>
+class AudioRecordStream : public AudioRecordStreamBase
+{
+	static_assert(NN >= 1 && NN <= 16, "AudioRecordStream supports 1 to 16 channels");
+public:
+	AudioRecordStream(void) : AudioRecordStreamBase(NN, inputQueueArray) { }
+private:
+	audio_block_t *inputQueueArray[NN];
+};
+
 #endif
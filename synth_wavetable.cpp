@@ -27,7 +27,6 @@
 #include <Arduino.h>
 #include "synth_wavetable.h"
 #include <dspinst.h>
-#include <SerialFlash.h>
 
 //#define TIME_TEST_ON
 //#define ENVELOPE_DEBUG
@@ -164,7 +163,7 @@ void AudioSynthWavetable::setFrequency(float freq) {
  *
  */
 void AudioSynthWavetable::update(void) {
-#if defined(KINETISK) || defined(__IMXRT1062__)
+#if defined(__ARM_ARCH_7EM__)
 	// exit if nothing to do
 	if (env_state == STATE_IDLE || (current_sample->LOOP == false && tone_phase >= current_sample->MAX_PHASE)) {
 		env_state = STATE_IDLE;
@@ -335,7 +334,8 @@ void AudioSynthWavetable::update(void) {
 		case STATE_DELAY:
 			env_state = STATE_ATTACK;
 			env_count = s->ATTACK_COUNT;
-			env_incr = UNITY_GAIN / (env_count * ENVELOPE_PERIOD);
+			// a zero count divides by zero, which gives 0 on Cortex-M
+			env_incr = env_count > 0 ? UNITY_GAIN / (env_count * ENVELOPE_PERIOD) : 0;
 			PRINT_ENV(STATE_ATTACK);
 			continue;
 		case STATE_ATTACK:
@@ -348,7 +348,7 @@ void AudioSynthWavetable::update(void) {
 		case STATE_HOLD:
 			env_state = STATE_DECAY;
 			env_count = s->DECAY_COUNT;
-			env_incr = (-s->SUSTAIN_MULT) / (env_count * ENVELOPE_PERIOD);
+			env_incr = env_count > 0 ? (-s->SUSTAIN_MULT) / (env_count * ENVELOPE_PERIOD) : 0;
 			PRINT_ENV(STATE_DECAY);
 			continue;
 		case STATE_DECAY:
@@ -0,0 +1,415 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include "synth_wavetable_poly.h"
+#include "utility/dspinst.h"
+
+typedef AudioSynthWavetable wt;
+
+// LFO_PERIOD steps in each block
+#define LFO_STEPS (1 << (wt::LFO_SMOOTHNESS - 1))
+
+AudioSynthWavetablePolyBase::AudioSynthWavetablePolyBase(wavetable_voice_t *voices,
+  unsigned int nvoices) : AudioStream(0, NULL)
+{
+	instrument = NULL;
+	voice = voices;
+	num_voices = nvoices;
+	voice_age = 0;
+	output_gain = 65536;
+	stereo_width = 0;
+	memset(voice, 0, nvoices * sizeof(wavetable_voice_t));
+}
+
+void AudioSynthWavetablePolyBase::setInstrument(const AudioSynthWavetable::instrument_data &instrument)
+{
+	__disable_irq();
+	this->instrument = &instrument;
+	for (int i=0; i < num_voices; i++) {
+		voice[i].env_state = wt::STATE_IDLE;
+		voice[i].pending = false;
+		voice[i].gain_left = 0;
+		voice[i].gain_right = 0;
+	}
+	__enable_irq();
+}
+
+void AudioSynthWavetablePolyBase::noteOn(int note, int velocity)
+{
+	if (note < 0 || note > 127) return;
+	if (velocity <= 0) {
+		noteOff(note);
+		return;
+	}
+	if (velocity > 127) velocity = 127;
+	wavetable_voice_t *v = NULL, *released = NULL, *oldest = NULL;
+	__disable_irq();
+	if (instrument == NULL) {
+		__enable_irq();
+		return;
+	}
+	// the same note again, or a free voice
+	for (int i=0; i < num_voices; i++) {
+		if ((voice[i].env_state != wt::STATE_IDLE || voice[i].pending)
+		  && voice[i].note == note) {
+			v = &voice[i];
+			break;
+		}
+	}
+	for (int i=0; v == NULL && i < num_voices; i++) {
+		if (voice[i].env_state == wt::STATE_IDLE && !voice[i].pending) {
+			v = &voice[i];
+		}
+	}
+	// or take the quietest released voice, else the oldest voice
+	if (v == NULL) {
+		for (int i=0; i < num_voices; i++) {
+			wavetable_voice_t *p = &voice[i];
+			if (!p->pending && p->env_state == wt::STATE_RELEASE
+			  && (released == NULL || p->env_mult < released->env_mult)) {
+				released = p;
+			}
+			if (oldest == NULL || (int32_t)(p->age - oldest->age) < 0) {
+				oldest = p;
+			}
+		}
+		v = released ? released : oldest;
+	}
+	v->note = note;
+	v->velocity = velocity;
+	v->pending = true;
+	v->age = voice_age++;
+	__enable_irq();
+}
+
+void AudioSynthWavetablePolyBase::noteOff(int note)
+{
+	__disable_irq();
+	for (int i=0; i < num_voices; i++) {
+		wavetable_voice_t *v = &voice[i];
+		if (v->note != note) continue;
+		if (v->pending) {
+			// not started yet, so a taken voice keeps fading out
+			v->pending = false;
+			if (v->env_state != wt::STATE_IDLE) release_voice(v);
+		} else if (v->env_state != wt::STATE_IDLE && v->env_state != wt::STATE_RELEASE) {
+			release_voice(v);
+		}
+	}
+	__enable_irq();
+}
+
+void AudioSynthWavetablePolyBase::allNotesOff(void)
+{
+	__disable_irq();
+	for (int i=0; i < num_voices; i++) {
+		wavetable_voice_t *v = &voice[i];
+		v->pending = false;
+		if (v->env_state != wt::STATE_IDLE && v->env_state != wt::STATE_RELEASE) {
+			release_voice(v);
+		}
+	}
+	__enable_irq();
+}
+
+int AudioSynthWavetablePolyBase::voicesPlaying(void)
+{
+	int count = 0;
+	__disable_irq();
+	for (int i=0; i < num_voices; i++) {
+		if (voice[i].env_state != wt::STATE_IDLE || voice[i].pending) count++;
+	}
+	__enable_irq();
+	return count;
+}
+
+// like AudioSynthWavetable::stop(), from the envelope's present level
+void AudioSynthWavetablePolyBase::release_voice(wavetable_voice_t *v)
+{
+	v->env_state = wt::STATE_RELEASE;
+	v->env_count = v->sample->RELEASE_COUNT;
+	if (v->env_count == 0) v->env_count = 1;
+	v->env_incr = -(v->env_mult) / (v->env_count * wt::ENVELOPE_PERIOD);
+}
+
+// like AudioSynthWavetable::setState()
+void AudioSynthWavetablePolyBase::start_voice(wavetable_voice_t *v)
+{
+	const wt::instrument_data *inst = instrument;
+	int i = 0;
+	while (i < inst->sample_count - 1 && v->note > inst->sample_note_ranges[i]) i++;
+	const wt::sample_data *s = &inst->samples[i];
+	v->sample = s;
+
+	float incr = wt::noteToFreq(v->note) * s->PER_HERTZ_PHASE_INCREMENT;
+	v->tone_phase = 0;
+	v->tone_incr = incr;
+	v->vib_pitch_offset_init = incr * s->VIBRATO_PITCH_COEFFICIENT_INITIAL;
+	v->vib_pitch_offset_scnd = incr * s->VIBRATO_PITCH_COEFFICIENT_SECOND;
+	v->mod_pitch_offset_init = incr * s->MODULATION_PITCH_COEFFICIENT_INITIAL;
+	v->mod_pitch_offset_scnd = incr * s->MODULATION_PITCH_COEFFICIENT_SECOND;
+	v->tone_amp = ((uint32_t)v->velocity * (UINT16_MAX / 127) * s->INITIAL_ATTENUATION_SCALAR) >> 16;
+	v->vib_count = v->mod_count = 0;
+	v->vib_phase = v->mod_phase = wt::TRIANGLE_INITIAL_PHASE;
+	v->env_state = wt::STATE_DELAY;
+	v->env_count = s->DELAY_COUNT;
+	v->env_mult = 0;
+	v->env_incr = 0;
+
+	// balance, with piano keys 21 to 108 spread by the stereo width
+	int32_t pan = stereo_width * (2 * v->note - 129) / 87;
+	if (pan > 32768) pan = 32768;
+	else if (pan < -32768) pan = -32768;
+	v->pan_left = (pan > 0) ? 32768 - pan : 32768;
+	v->pan_right = (pan < 0) ? 32768 + pan : 32768;
+	v->pending = false;
+}
+
+// Step the envelope state machine of AudioSynthWavetable::update() over
+// one block, whole envelope segments at a time.  Returns false when the
+// voice has finished.
+bool AudioSynthWavetablePolyBase::advance_envelope(wavetable_voice_t *v)
+{
+	const wt::sample_data *s = v->sample;
+	int32_t count = v->env_count;
+	int32_t mult = v->env_mult;
+	int32_t incr = v->env_incr;
+	int state = v->env_state;
+	int32_t n = AUDIO_BLOCK_SAMPLES / wt::ENVELOPE_PERIOD;
+
+	while (n > 0) {
+		if (count <= 0) {
+			switch (state) {
+			case wt::STATE_DELAY:
+				state = wt::STATE_ATTACK;
+				count = s->ATTACK_COUNT;
+				incr = (count > 0) ? wt::UNITY_GAIN / (count * wt::ENVELOPE_PERIOD) : 0;
+				continue;
+			case wt::STATE_ATTACK:
+				mult = wt::UNITY_GAIN;
+				state = wt::STATE_HOLD;
+				count = s->HOLD_COUNT;
+				incr = 0;
+				continue;
+			case wt::STATE_HOLD:
+				state = wt::STATE_DECAY;
+				count = s->DECAY_COUNT;
+				incr = (count > 0) ? (-s->SUSTAIN_MULT) / (count * wt::ENVELOPE_PERIOD) : 0;
+				continue;
+			case wt::STATE_DECAY:
+				mult = wt::UNITY_GAIN - s->SUSTAIN_MULT;
+				state = (mult < wt::UNITY_GAIN / UINT16_MAX) ? wt::STATE_RELEASE : wt::STATE_SUSTAIN;
+				incr = 0;
+				continue;
+			case wt::STATE_SUSTAIN:
+				count = INT32_MAX;
+				continue;
+			default:
+				v->env_state = wt::STATE_IDLE;
+				v->env_mult = 0;
+				return false;
+			}
+		}
+		int32_t k = (count < n) ? count : n;
+		mult += incr * wt::ENVELOPE_PERIOD * k;
+		count -= k;
+		n -= k;
+	}
+	v->env_state = state;
+	v->env_count = count;
+	v->env_mult = (mult > 0) ? mult : 0;
+	v->env_incr = incr;
+	return true;
+}
+
+// Linear interpolation between 2 samples, as AudioSynthWavetable::update()
+static inline int32_t wavetable_interpolate(const int16_t *data, int bits, uint32_t phase)
+	__attribute__((always_inline, unused));
+static inline int32_t wavetable_interpolate(const int16_t *data, int bits, uint32_t phase)
+{
+	uint32_t index = phase >> (32 - bits);
+	uint32_t tmp = *((uint32_t *)(data + index));
+	uint32_t scale = (phase << bits) >> 16;
+	int32_t val = signed_multiply_32x16t(scale, tmp);
+	return signed_multiply_accumulate_32x16b(val, 0xFFFF - scale, tmp);
+}
+
+// Add one block of a voice into the accumulators, or only into left when
+// right is NULL.  The pitch and tremolo LFOs are evaluated at the middle
+// of the block, the envelope at its end, and the gain ramps from the end
+// of the previous block.
+void AudioSynthWavetablePolyBase::render_voice(wavetable_voice_t *v, int32_t *left, int32_t *right)
+{
+	const wt::sample_data *s = v->sample;
+
+	int32_t incr_offset = 0;
+	v->vib_count += LFO_STEPS;
+	if (v->vib_count > s->VIBRATO_DELAY) {
+		uint32_t phase = v->vib_phase + s->VIBRATO_INCREMENT * (LFO_STEPS / 2);
+		v->vib_phase += s->VIBRATO_INCREMENT * LFO_STEPS;
+		int32_t scale = (phase & 0x80000000) ? 0x40000000 + phase : 0x3FFFFFFF - phase;
+		int32_t offset = (scale >= 0) ? v->vib_pitch_offset_init : v->vib_pitch_offset_scnd;
+		incr_offset = multiply_accumulate_32x32_rshift32_rounded(incr_offset, scale, offset);
+	}
+	int32_t amp = v->tone_amp;
+	v->mod_count += LFO_STEPS;
+	if (v->mod_count > s->MODULATION_DELAY) {
+		uint32_t phase = v->mod_phase + s->MODULATION_INCREMENT * (LFO_STEPS / 2);
+		v->mod_phase += s->MODULATION_INCREMENT * LFO_STEPS;
+		int32_t scale = (phase & 0x80000000) ? 0x40000000 + phase : 0x3FFFFFFF - phase;
+		int32_t offset = (scale >= 0) ? v->mod_pitch_offset_init : v->mod_pitch_offset_scnd;
+		incr_offset = multiply_accumulate_32x32_rshift32_rounded(incr_offset, scale, offset);
+		offset = (scale >= 0) ? s->MODULATION_AMPLITUDE_INITIAL_GAIN : s->MODULATION_AMPLITUDE_SECOND_GAIN;
+		scale = multiply_32x32_rshift32(scale, offset);
+		amp += ((int64_t)scale * amp) >> 16;
+	}
+
+	bool playing = advance_envelope(v);
+	int32_t gain = 0;
+	if (!v->pending) gain = ((int64_t)v->env_mult * amp) >> 31;
+	int32_t gain_left = ((int64_t)gain * v->pan_left) >> 15;
+	int32_t gain_right = ((int64_t)gain * v->pan_right) >> 15;
+	int32_t gl = v->gain_left;
+	int32_t gr = v->gain_right;
+	int32_t incr_left = (gain_left - gl) / AUDIO_BLOCK_SAMPLES;
+	int32_t incr_right = (gain_right - gr) / AUDIO_BLOCK_SAMPLES;
+
+	uint32_t phase = v->tone_phase;
+	uint32_t incr = v->tone_incr + incr_offset;
+	uint32_t loop_end = 0xFFFFFFFF, loop_length = 0;
+	int n = AUDIO_BLOCK_SAMPLES;
+	if (s->LOOP) {
+		loop_end = s->LOOP_PHASE_END;
+		loop_length = s->LOOP_PHASE_LENGTH;
+	} else if (phase >= s->MAX_PHASE) {
+		n = 0;
+		playing = false;
+	} else if (incr > 0) {
+		// samples left before the end, a non-looped sample stops there
+		uint32_t remain = (s->MAX_PHASE - phase - 1) / incr + 1;
+		if (remain < (uint32_t)n) {
+			n = remain;
+			playing = false;
+		}
+	}
+	const int16_t *data = s->sample;
+	const int bits = s->INDEX_BITS;
+
+	if (right) {
+		for (int i=0; i < n; i++) {
+			int32_t val = wavetable_interpolate(data, bits, phase);
+			gl += incr_left;
+			gr += incr_right;
+			left[i] += signed_multiply_32x16b(gl, val);
+			right[i] += signed_multiply_32x16b(gr, val);
+			phase += incr;
+			if (phase >= loop_end) phase -= loop_length;
+		}
+	} else {
+		for (int i=0; i < n; i++) {
+			int32_t val = wavetable_interpolate(data, bits, phase);
+			gl += incr_left;
+			left[i] += signed_multiply_32x16b(gl, val);
+			phase += incr;
+			if (phase >= loop_end) phase -= loop_length;
+		}
+	}
+	v->tone_phase = phase;
+	if (playing) {
+		v->gain_left = gain_left;
+		v->gain_right = gain_right;
+	} else {
+		v->env_state = wt::STATE_IDLE;
+		v->gain_left = 0;
+		v->gain_right = 0;
+	}
+}
+
+void AudioSynthWavetablePolyBase::update(void)
+{
+#if defined(__ARM_ARCH_7EM__)
+	int32_t center[AUDIO_BLOCK_SAMPLES];
+	int32_t left[AUDIO_BLOCK_SAMPLES];
+	int32_t right[AUDIO_BLOCK_SAMPLES];
+	bool mono = false, stereo = false;
+	audio_block_t *block_left, *block_right;
+	int i;
+
+	if (instrument == NULL) return;
+	for (wavetable_voice_t *v = voice; v < voice + num_voices; v++) {
+		if (v->pending && v->env_state == wt::STATE_IDLE) start_voice(v);
+		if (v->env_state == wt::STATE_IDLE) continue;
+		// centered voices only need one accumulator
+		if (v->pan_left == v->pan_right) {
+			if (!mono) {
+				memset(center, 0, sizeof(center));
+				mono = true;
+			}
+			render_voice(v, center, NULL);
+		} else {
+			if (!stereo) {
+				memset(left, 0, sizeof(left));
+				memset(right, 0, sizeof(right));
+				stereo = true;
+			}
+			render_voice(v, left, right);
+		}
+		// a taken voice has faded out, so start its new note
+		if (v->pending) start_voice(v);
+	}
+	if (!mono && !stereo) return;
+
+	block_left = allocate();
+	if (!block_left) return;
+	if (!stereo) {
+		for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+			int32_t val = ((int64_t)center[i] * output_gain) >> 16;
+			block_left->data[i] = signed_saturate_rshift(val, 16, 0);
+		}
+		transmit(block_left, 0);
+		transmit(block_left, 1);
+		release(block_left);
+		return;
+	}
+	block_right = allocate();
+	if (!block_right) {
+		release(block_left);
+		return;
+	}
+	if (!mono) memset(center, 0, sizeof(center));
+	for (i=0; i < AUDIO_BLOCK_SAMPLES; i++) {
+		int32_t val = ((int64_t)(center[i] + left[i]) * output_gain) >> 16;
+		block_left->data[i] = signed_saturate_rshift(val, 16, 0);
+		val = ((int64_t)(center[i] + right[i]) * output_gain) >> 16;
+		block_right->data[i] = signed_saturate_rshift(val, 16, 0);
+	}
+	transmit(block_left, 0);
+	release(block_left);
+	transmit(block_right, 1);
+	release(block_right);
+#endif
+}
@@ -0,0 +1,132 @@
+/* Audio Library for Teensy 3.X
+ * Copyright (c) 2021, Paul Stoffregen, paul@pjrc.com
+ *
+ * Development of this audio library was funded by PJRC.COM, LLC by sales of
+ * Teensy and Audio Adaptor boards.  Please support PJRC's efforts to develop
+ * open source software by purchasing Teensy or other PJRC products.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice, development funding notice, and this permission
+ * notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef synth_wavetable_poly_h_
+#define synth_wavetable_poly_h_
+
+#include "Arduino.h"
+#include "AudioStream.h"
+#include "synth_wavetable.h"
+
+// Polyphonic wavetable synth, playing SoundFont instruments decoded for
+// AudioSynthWavetable with up to 64 voices in one object.  Each voice is
+// an AudioSynthWavetable voice, with the same samples, envelope and LFOs,
+// but the envelope and LFOs are computed once per block and the gain is
+// ramped linearly across the block.  All voices add into one 32 bit
+// accumulator, so no mixers are needed, and a voice costs nothing while
+// it is not playing.  Output 0 is left, 1 is right.
+//
+// When all voices are playing, noteOn() takes the quietest voice in its
+// release phase, or else the oldest voice.  A voice which is taken, or a
+// note played again while it is still sounding, fades out over one block
+// before the new note starts.
+
+typedef struct wavetable_voice_struct {
+	const AudioSynthWavetable::sample_data *sample;
+	uint32_t tone_phase;
+	uint32_t tone_incr;
+	int32_t tone_amp;		// velocity and attenuation, 65535 = 1.0
+	int32_t env_mult;		// envelope at the end of the last block
+	int32_t env_incr;		// per sample, as AudioSynthWavetable
+	int32_t env_count;		// in ENVELOPE_PERIOD samples
+	uint32_t vib_count;		// in LFO_PERIOD samples
+	uint32_t vib_phase;
+	int32_t vib_pitch_offset_init;
+	int32_t vib_pitch_offset_scnd;
+	uint32_t mod_count;
+	uint32_t mod_phase;
+	int32_t mod_pitch_offset_init;
+	int32_t mod_pitch_offset_scnd;
+	int32_t gain_left;		// at the end of the last block, 65536 = 1.0
+	int32_t gain_right;
+	int32_t pan_left;		// 32768 = 1.0
+	int32_t pan_right;
+	uint32_t age;			// order of noteOn
+	uint8_t env_state;
+	uint8_t note;
+	uint8_t velocity;
+	bool pending;			// note and velocity are waiting to start
+} wavetable_voice_t;
+
+class AudioSynthWavetablePolyBase : public AudioStream
+{
+public:
+	// Set the instrument, commonly made by the SoundFont decoder script
+	// which accompanies this library.  Stops all voices at once.
+	void setInstrument(const AudioSynthWavetable::instrument_data &instrument);
+	// Play a MIDI note, 0 to 127.  Velocity is a linear amplitude, 0 to
+	// 127, like AudioSynthWavetable::playNote(); 0 releases the note.
+	void noteOn(int note, int velocity = AudioSynthWavetable::DEFAULT_AMPLITUDE);
+	// Release all voices playing a note, which fade out by the
+	// instrument's release time
+	void noteOff(int note);
+	void allNotesOff(void);
+	// Level of the output, 0 to 1.0.  Each voice can reach full scale,
+	// so several loud voices together will clip unless this is lowered.
+	void amplitude(float level) {
+		if (level < 0.0f) level = 0.0f;
+		else if (level > 1.0f) level = 1.0f;
+		output_gain = level * 65536.0f;
+	}
+	// Spread the notes across the stereo outputs like a piano, low notes
+	// left and high notes right.  0 (default) plays all notes in the
+	// center, with identical outputs, 1.0 pans the lowest and highest
+	// piano keys fully to one side.  Used by notes started afterward.
+	void stereoWidth(float width) {
+		if (width < 0.0f) width = 0.0f;
+		else if (width > 1.0f) width = 1.0f;
+		stereo_width = width * 32768.0f;
+	}
+	// Voices in use, including those fading out by their release time
+	int voicesPlaying(void);
+	int maxVoices(void) { return num_voices; }
+	virtual void update(void);
+protected:
+	AudioSynthWavetablePolyBase(wavetable_voice_t *voices, unsigned int nvoices);
+private:
+	void start_voice(wavetable_voice_t *v);
+	static void release_voice(wavetable_voice_t *v);
+	static bool advance_envelope(wavetable_voice_t *v);
+	static void render_voice(wavetable_voice_t *v, int32_t *left, int32_t *right);
+	const AudioSynthWavetable::instrument_data *instrument;
+	wavetable_voice_t *voice;
+	uint32_t voice_age;
+	int32_t output_gain;
+	int32_t stereo_width;
+	uint8_t num_voices;
+};
+
+template <int NN>
+class AudioSynthWavetablePoly : public AudioSynthWavetablePolyBase
+{
+	static_assert(NN >= 1 && NN <= 64, "AudioSynthWavetablePoly supports 1 to 64 voices");
+public:
+	AudioSynthWavetablePoly(void) : AudioSynthWavetablePolyBase(voiceArray, NN) { }
+private:
+	wavetable_voice_t voiceArray[NN];
+};
+
+#endif
@@ -29,15 +29,22 @@
 
 #include <stdint.h>
 
+// The ARM DSP extension instructions are used when compiling for Cortex-M4
+// and Cortex-M7.  Teensy LC, and host builds (AUDIO_HOST, see extras/host)
+// which compile the Cortex-M4 code paths on a PC, use portable C instead.
+#if defined(__ARM_ARCH_7EM__) && !defined(AUDIO_HOST)
+#define DSPINST_USE_ASM
+#endif
+
 // computes limit((val >> rshift), 2**bits)
 static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift) __attribute__((always_inline, unused));
 static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("ssat %0, %1, %2, asr %3" : "=r" (out) : "I" (bits), "r" (val), "I" (rshift));
 	return out;
-#elif defined(KINETISL)
+#else
 	int32_t out, max;
 	out = val >> rshift;
 	max = 1 << (bits - 1);
@@ -54,7 +61,7 @@ static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift)
 static inline int16_t saturate16(int32_t val) __attribute__((always_inline, unused));
 static inline int16_t saturate16(int32_t val)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int16_t out;
 	int32_t tmp;
 	asm volatile("ssat %0, %1, %2" : "=r" (tmp) : "I" (16), "r" (val) );
@@ -71,11 +78,11 @@ static inline int16_t saturate16(int32_t val)
 static inline int32_t signed_multiply_32x16b(int32_t a, uint32_t b) __attribute__((always_inline, unused));
 static inline int32_t signed_multiply_32x16b(int32_t a, uint32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("smulwb %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
 	return out;
-#elif defined(KINETISL)
+#else
 	return ((int64_t)a * (int16_t)(b & 0xFFFF)) >> 16;
 #endif
 }
@@ -84,11 +91,11 @@ static inline int32_t signed_multiply_32x16b(int32_t a, uint32_t b)
 static inline int32_t signed_multiply_32x16t(int32_t a, uint32_t b) __attribute__((always_inline, unused));
 static inline int32_t signed_multiply_32x16t(int32_t a, uint32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("smulwt %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
 	return out;
-#elif defined(KINETISL)
+#else
 	return ((int64_t)a * (int16_t)(b >> 16)) >> 16;
 #endif
 }
@@ -97,51 +104,51 @@ static inline int32_t signed_multiply_32x16t(int32_t a, uint32_t b)
 static inline int32_t multiply_32x32_rshift32(int32_t a, int32_t b) __attribute__((always_inline, unused));
 static inline int32_t multiply_32x32_rshift32(int32_t a, int32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("smmul %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
 	return out;
-#elif defined(KINETISL)
+#else
 	return ((int64_t)a * (int64_t)b) >> 32;
 #endif
 }
 
-// computes (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x8000000) >> 32)
+// computes (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x80000000) >> 32)
 static inline int32_t multiply_32x32_rshift32_rounded(int32_t a, int32_t b) __attribute__((always_inline, unused));
 static inline int32_t multiply_32x32_rshift32_rounded(int32_t a, int32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("smmulr %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
 	return out;
-#elif defined(KINETISL)
-	return (((int64_t)a * (int64_t)b) + 0x8000000) >> 32;
+#else
+	return (((int64_t)a * (int64_t)b) + 0x80000000LL) >> 32;
 #endif
 }
 
-// computes sum + (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x8000000) >> 32)
+// computes sum + (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x80000000) >> 32)
 static inline int32_t multiply_accumulate_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b) __attribute__((always_inline, unused));
 static inline int32_t multiply_accumulate_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("smmlar %0, %2, %3, %1" : "=r" (out) : "r" (sum), "r" (a), "r" (b));
 	return out;
-#elif defined(KINETISL)
-	return sum + ((((int64_t)a * (int64_t)b) + 0x8000000) >> 32);
+#else
+	return sum + ((((int64_t)a * (int64_t)b) + 0x80000000LL) >> 32);
 #endif
 }
 
-// computes sum - (((int64_t)a[31:0] * (int64_t)b[31:0] + 0x8000000) >> 32)
+// computes ((sum << 32) - ((int64_t)a[31:0] * (int64_t)b[31:0]) + 0x80000000) >> 32
 static inline int32_t multiply_subtract_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b) __attribute__((always_inline, unused));
 static inline int32_t multiply_subtract_32x32_rshift32_rounded(int32_t sum, int32_t a, int32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("smmlsr %0, %2, %3, %1" : "=r" (out) : "r" (sum), "r" (a), "r" (b));
 	return out;
-#elif defined(KINETISL)
-	return sum - ((((int64_t)a * (int64_t)b) + 0x8000000) >> 32);
+#else
+	return ((((int64_t)sum << 32) - ((int64_t)a * (int64_t)b)) + 0x80000000LL) >> 32;
 #endif
 }
 
@@ -150,11 +157,11 @@ static inline int32_t multiply_subtract_32x32_rshift32_rounded(int32_t sum, int3
 static inline uint32_t pack_16t_16t(int32_t a, int32_t b) __attribute__((always_inline, unused));
 static inline uint32_t pack_16t_16t(int32_t a, int32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("pkhtb %0, %1, %2, asr #16" : "=r" (out) : "r" (a), "r" (b));
 	return out;
-#elif defined(KINETISL)
+#else
 	return (a & 0xFFFF0000) | ((uint32_t)b >> 16);
 #endif
 }
@@ -163,11 +170,11 @@ static inline uint32_t pack_16t_16t(int32_t a, int32_t b)
 static inline uint32_t pack_16t_16b(int32_t a, int32_t b) __attribute__((always_inline, unused));
 static inline uint32_t pack_16t_16b(int32_t a, int32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("pkhtb %0, %1, %2" : "=r" (out) : "r" (a), "r" (b));
 	return out;
-#elif defined(KINETISL)
+#else
 	return (a & 0xFFFF0000) | (b & 0x0000FFFF);
 #endif
 }
@@ -176,11 +183,11 @@ static inline uint32_t pack_16t_16b(int32_t a, int32_t b)
 static inline uint32_t pack_16b_16b(int32_t a, int32_t b) __attribute__((always_inline, unused));
 static inline uint32_t pack_16b_16b(int32_t a, int32_t b)
 {
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 	int32_t out;
 	asm volatile("pkhbt %0, %1, %2, lsl #16" : "=r" (out) : "r" (b), "r" (a));
 	return out;
-#elif defined(KINETISL)
+#else
 	return (a << 16) | (b & 0x0000FFFF);
 #endif
 }
@@ -195,7 +202,7 @@ static inline uint32_t pack_16x16(int32_t a, int32_t b)
 	return out;
 }
 */
-#if defined (__ARM_ARCH_7EM__)
+#if defined(DSPINST_USE_ASM)
 // computes (((a[31:16] + b[31:16]) << 16) | (a[15:0 + b[15:0]))  (saturates)
 static inline uint32_t signed_add_16_and_16(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
 static inline uint32_t signed_add_16_and_16(uint32_t a, uint32_t b)
@@ -351,8 +358,154 @@ static inline int32_t FRACMUL_SHL(int32_t x, int32_t y, int z)
     return t;
 }
 
+#else
+// Portable C versions of the DSP extension instructions above.  These
+// produce bit-identical results to the Cortex-M4 instructions, so code
+// built for a PC (AUDIO_HOST) or Teensy LC matches Teensy 3.x/4.x output.
+
+static inline int16_t dspinst_sat16(int32_t val) __attribute__((always_inline, unused));
+static inline int16_t dspinst_sat16(int32_t val)
+{
+	if (val > 32767) return 32767;
+	if (val < -32768) return -32768;
+	return val;
+}
+
+// computes (((a[31:16] + b[31:16]) << 16) | (a[15:0 + b[15:0]))  (saturates)
+static inline uint32_t signed_add_16_and_16(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline uint32_t signed_add_16_and_16(uint32_t a, uint32_t b)
+{
+	int32_t lo = dspinst_sat16((int16_t)a + (int16_t)b);
+	int32_t hi = dspinst_sat16((int16_t)(a >> 16) + (int16_t)(b >> 16));
+	return ((uint32_t)hi << 16) | ((uint32_t)lo & 0xFFFF);
+}
+
+// computes (((a[31:16] - b[31:16]) << 16) | (a[15:0 - b[15:0]))  (saturates)
+static inline int32_t signed_subtract_16_and_16(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_subtract_16_and_16(int32_t a, int32_t b)
+{
+	int32_t lo = dspinst_sat16((int16_t)a - (int16_t)b);
+	int32_t hi = dspinst_sat16((int16_t)((uint32_t)a >> 16) - (int16_t)((uint32_t)b >> 16));
+	return ((uint32_t)hi << 16) | ((uint32_t)lo & 0xFFFF);
+}
+
+// computes out = (((a[31:16]+b[31:16])/2) <<16) | ((a[15:0]+b[15:0])/2)
+static inline int32_t signed_halving_add_16_and_16(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_halving_add_16_and_16(int32_t a, int32_t b)
+{
+	int32_t lo = ((int16_t)a + (int16_t)b) >> 1;
+	int32_t hi = ((int16_t)((uint32_t)a >> 16) + (int16_t)((uint32_t)b >> 16)) >> 1;
+	return ((uint32_t)hi << 16) | ((uint32_t)lo & 0xFFFF);
+}
+
+// computes out = (((a[31:16]-b[31:16])/2) <<16) | ((a[15:0]-b[15:0])/2)
+static inline int32_t signed_halving_subtract_16_and_16(int32_t a, int32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_halving_subtract_16_and_16(int32_t a, int32_t b)
+{
+	int32_t lo = ((int16_t)a - (int16_t)b) >> 1;
+	int32_t hi = ((int16_t)((uint32_t)a >> 16) - (int16_t)((uint32_t)b >> 16)) >> 1;
+	return ((uint32_t)hi << 16) | ((uint32_t)lo & 0xFFFF);
+}
+
+// computes (sum + ((a[31:0] * b[15:0]) >> 16))
+static inline int32_t signed_multiply_accumulate_32x16b(int32_t sum, int32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_multiply_accumulate_32x16b(int32_t sum, int32_t a, uint32_t b)
+{
+	return sum + (int32_t)(((int64_t)a * (int16_t)(b & 0xFFFF)) >> 16);
+}
+
+// computes (sum + ((a[31:0] * b[31:16]) >> 16))
+static inline int32_t signed_multiply_accumulate_32x16t(int32_t sum, int32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t signed_multiply_accumulate_32x16t(int32_t sum, int32_t a, uint32_t b)
+{
+	return sum + (int32_t)(((int64_t)a * (int16_t)(b >> 16)) >> 16);
+}
+
+// computes logical and
+static inline uint32_t logical_and(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline uint32_t logical_and(uint32_t a, uint32_t b)
+{
+	return a & b;
+}
+
+// computes ((a[15:0] * b[15:0]) + (a[31:16] * b[31:16]))
+static inline int32_t multiply_16tx16t_add_16bx16b(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16tx16t_add_16bx16b(uint32_t a, uint32_t b)
+{
+	return (int32_t)((uint32_t)((int16_t)a * (int16_t)b)
+		+ (uint32_t)((int16_t)(a >> 16) * (int16_t)(b >> 16)));
+}
+
+// computes ((a[15:0] * b[31:16]) + (a[31:16] * b[15:0]))
+static inline int32_t multiply_16tx16b_add_16bx16t(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16tx16b_add_16bx16t(uint32_t a, uint32_t b)
+{
+	return (int32_t)((uint32_t)((int16_t)a * (int16_t)(b >> 16))
+		+ (uint32_t)((int16_t)(a >> 16) * (int16_t)b));
+}
+
+// // computes sum += ((a[15:0] * b[15:0]) + (a[31:16] * b[31:16]))
+static inline int64_t multiply_accumulate_16tx16t_add_16bx16b(int64_t sum, uint32_t a, uint32_t b)
+{
+	return sum + (int32_t)((int16_t)a * (int16_t)b)
+		+ (int32_t)((int16_t)(a >> 16) * (int16_t)(b >> 16));
+}
+
+// // computes sum += ((a[15:0] * b[31:16]) + (a[31:16] * b[15:0]))
+static inline int64_t multiply_accumulate_16tx16b_add_16bx16t(int64_t sum, uint32_t a, uint32_t b)
+{
+	return sum + (int32_t)((int16_t)a * (int16_t)(b >> 16))
+		+ (int32_t)((int16_t)(a >> 16) * (int16_t)b);
+}
+
+// computes ((a[15:0] * b[15:0])
+static inline int32_t multiply_16bx16b(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16bx16b(uint32_t a, uint32_t b)
+{
+	return (int16_t)a * (int16_t)b;
+}
+
+// computes ((a[15:0] * b[31:16])
+static inline int32_t multiply_16bx16t(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16bx16t(uint32_t a, uint32_t b)
+{
+	return (int16_t)a * (int16_t)(b >> 16);
+}
+
+// computes ((a[31:16] * b[15:0])
+static inline int32_t multiply_16tx16b(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16tx16b(uint32_t a, uint32_t b)
+{
+	return (int16_t)(a >> 16) * (int16_t)b;
+}
+
+// computes ((a[31:16] * b[31:16])
+static inline int32_t multiply_16tx16t(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t multiply_16tx16t(uint32_t a, uint32_t b)
+{
+	return (int16_t)(a >> 16) * (int16_t)(b >> 16);
+}
+
+// computes (a - b), result saturated to 32 bit integer range
+static inline int32_t substract_32_saturate(uint32_t a, uint32_t b) __attribute__((always_inline, unused));
+static inline int32_t substract_32_saturate(uint32_t a, uint32_t b)
+{
+	int64_t out = (int64_t)(int32_t)a - (int64_t)(int32_t)b;
+	if (out > INT32_MAX) return INT32_MAX;
+	if (out < INT32_MIN) return INT32_MIN;
+	return out;
+}
+
+// Multiply two S.31 fractional integers, and return the 32 most significant
+// bits after a shift left by the constant z.
+static inline int32_t FRACMUL_SHL(int32_t x, int32_t y, int z)
+{
+	return (int32_t)(((uint64_t)((int64_t)x * (int64_t)y) << (z + 1)) >> 32);
+}
+
 #endif
 
+#if !defined(AUDIO_HOST)
 //get Q from PSR
 static inline uint32_t get_q_psr(void) __attribute__((always_inline, unused));
 static inline uint32_t get_q_psr(void)
@@ -370,6 +523,7 @@ static inline void clr_q_psr(void)
   asm ("mov %[t],#0\n"
        "msr APSR_nzcvq,%0\n" : [t] "=&r" (t)::"cc");
 }
+#endif
 
 
 #endif
@@ -35,6 +35,10 @@ extern const uint16_t sqrt_integer_guess_table[];
 inline uint32_t sqrt_uint32(uint32_t in) __attribute__((always_inline,unused));
 inline uint32_t sqrt_uint32(uint32_t in)
 {
+#if defined(AUDIO_HOST)
+	// zero divides by zero below, which gives zero on Cortex-M but traps on a PC
+	if (in == 0) return 0;
+#endif
 	uint32_t n = sqrt_integer_guess_table[__builtin_clz(in)];
 	n = ((in / n) + n) / 2;
 	n = ((in / n) + n) / 2;
@@ -45,6 +49,10 @@ inline uint32_t sqrt_uint32(uint32_t in)
 inline uint32_t sqrt_uint32_approx(uint32_t in) __attribute__((always_inline,unused));
 inline uint32_t sqrt_uint32_approx(uint32_t in)
 {
+#if defined(AUDIO_HOST)
+	// zero divides by zero below, which gives zero on Cortex-M but traps on a PC
+	if (in == 0) return 0;
+#endif
 	uint32_t n = sqrt_integer_guess_table[__builtin_clz(in)];
 	n = ((in / n) + n) / 2;
 	n = ((in / n) + n) / 2;